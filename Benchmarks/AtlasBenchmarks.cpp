@@ -0,0 +1,386 @@
+// CPU cost and packing density of the TextureAtlas module on sets of small images like the renderer's glyphs,
+// UI sprites and shape textures. Each case packs --images images of one set into pages of --page-size texels with
+// --padding texels of gutter, --reps times after one warm up, and reports the best and mean time, the time per
+// image, the pages it took and how much of them the images and their gutters cover. Without an atlas every image is
+// its own texture and descriptor, so images / pages is how many fewer descriptor tables the draws bind.
+// online inserts the images in arrival order, offline packs them as one set, largest first. churn fills the atlas
+// online, then --rounds times evicts a random quarter of the images and inserts as many new ones, the way glyph
+// caches and streamed sprites turn over, and reports the time per eviction or insertion and the pages and
+// occupancy after the last round. copy writes every packed image into RGBA8 pages with copyToAtlas, gutters
+// included, and reports time per image. Every case checks that no two images or gutters overlap and all of them
+// are inside their page; the program exits with 1 if any did not.
+// Results go out as JSON lines (or CSV) on stdout or to --out; a readable table goes to stderr.
+//
+//   AtlasBenchmarks [--reps N] [--images N] [--page-size N] [--padding N] [--rounds N] [--format json|csv] [--out FILE]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+import TextureFormat;
+import TextureAtlas;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		uint32_t reps = 10;
+		uint32_t images = 4096;
+		uint32_t pageSize = 1024;
+		uint32_t padding = 1;
+		uint32_t rounds = 20;
+		std::string format = "json";
+		std::string out;
+	};
+
+	struct Result
+	{
+		std::string set;
+		std::string mode;
+		uint32_t images = 0;
+		double bestNs = 0.0;
+		double meanNs = 0.0;
+		double nsPerOp = 0.0;
+		uint32_t pages = 0;
+		double occupancy = 0.0;
+		double bindingReduction = 0.0;
+		uint64_t failed = 0;
+		bool valid = true;
+	};
+
+	enum class IMAGE_SET
+	{
+		GLYPHS,
+		SPRITES,
+		MIXED
+	};
+
+	std::string_view setName(IMAGE_SET set)
+	{
+		switch (set)
+		{
+		case IMAGE_SET::GLYPHS:
+			return "glyphs";
+		case IMAGE_SET::SPRITES:
+			return "sprites";
+		case IMAGE_SET::MIXED:
+			return "mixed";
+		}
+		return "?";
+	}
+
+	// Glyphs of a few font sizes, square-ish sprites and icons, or those plus large panels and thin strips
+	LS::AtlasSize randomSize(IMAGE_SET set, std::mt19937& rng)
+	{
+		const auto between = [&](uint32_t low, uint32_t high)
+			{
+				return std::uniform_int_distribution<uint32_t>(low, high)(rng);
+			};
+		switch (set)
+		{
+		case IMAGE_SET::GLYPHS:
+		{
+			const uint32_t heights[] = { 12, 16, 24, 32 };
+			const auto height = heights[between(0, 3)];
+			return LS::AtlasSize{ .width = between(height / 4, height), .height = height };
+		}
+		case IMAGE_SET::SPRITES:
+		{
+			const auto side = between(16, 128);
+			return LS::AtlasSize{ .width = side, .height = std::max(16u, side + between(0, 32) - 16) };
+		}
+		case IMAGE_SET::MIXED:
+			switch (between(0, 9))
+			{
+			case 0:
+				return LS::AtlasSize{ .width = between(128, 256), .height = between(128, 256) };
+			case 1:
+				return LS::AtlasSize{ .width = between(128, 256), .height = between(4, 12) };
+			case 2:
+				return LS::AtlasSize{ .width = between(4, 12), .height = between(128, 256) };
+			default:
+				return LS::AtlasSize{ .width = between(8, 64), .height = between(8, 64) };
+			}
+		}
+		return {};
+	}
+
+	std::vector<LS::AtlasSize> randomSizes(IMAGE_SET set, uint32_t count, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<LS::AtlasSize> sizes(count);
+		for (auto& size : sizes)
+		{
+			size = randomSize(set, rng);
+		}
+		return sizes;
+	}
+
+	// No two entries or their gutters overlap and every one is inside its page
+	bool validate(const LS::TextureAtlas& atlas, const std::vector<uint32_t>& ids, const Options& options)
+	{
+		const auto padding = atlas.Padding();
+		std::vector<std::vector<LS::AtlasRect>> pages(atlas.PageCount());
+		for (const auto id : ids)
+		{
+			const auto& entry = atlas.Entry(id);
+			if (entry.page >= pages.size() || entry.rect.x < padding || entry.rect.y < padding ||
+				entry.rect.Right() + padding > options.pageSize || entry.rect.Bottom() + padding > options.pageSize)
+				return false;
+
+			pages[entry.page].push_back(LS::AtlasRect{ .x = entry.rect.x - padding, .y = entry.rect.y - padding,
+				.width = entry.rect.width + 2 * padding, .height = entry.rect.height + 2 * padding });
+		}
+		for (auto& rects : pages)
+		{
+			// Sorted by x, a rect can only overlap the ones that start before it ends
+			std::sort(rects.begin(), rects.end(), [](const LS::AtlasRect& a, const LS::AtlasRect& b) { return a.x < b.x; });
+			for (size_t i = 0; i < rects.size(); ++i)
+			{
+				for (size_t j = i + 1; j < rects.size() && rects[j].x < rects[i].Right(); ++j)
+				{
+					if (rects[i].Overlaps(rects[j]))
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	std::vector<uint32_t> liveIds(const std::vector<std::optional<uint32_t>>& ids)
+	{
+		std::vector<uint32_t> live;
+		for (const auto& id : ids)
+		{
+			if (id)
+			{
+				live.push_back(*id);
+			}
+		}
+		return live;
+	}
+
+	// Times run() --reps times after one warm up, setup() before each run outside the timing
+	template<class Setup, class Fn>
+	Result measure(const Options& options, double ops, Setup&& setup, Fn&& run)
+	{
+		setup();
+		run();
+		double best = 0.0;
+		double total = 0.0;
+		for (uint32_t i = 0; i < options.reps; ++i)
+		{
+			setup();
+			const auto start = Clock::now();
+			run();
+			const auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			best = i == 0 ? ns : std::min(best, ns);
+			total += ns;
+		}
+		return Result{ .images = options.images, .bestNs = best, .meanNs = total / options.reps, .nsPerOp = best / ops };
+	}
+
+	void describe(Result& result, const LS::TextureAtlas& atlas, const std::vector<uint32_t>& ids, const Options& options)
+	{
+		result.pages = atlas.PageCount();
+		result.occupancy = atlas.Occupancy();
+		result.bindingReduction = result.pages == 0 ? 0.0 : static_cast<double>(ids.size()) / result.pages;
+		result.failed = atlas.Stats().failedInsertions;
+		result.valid = validate(atlas, ids, options);
+	}
+
+	void report(const Options& options, std::ostream& out, const Result& r)
+	{
+		if (options.format == "csv")
+		{
+			out << r.set << ',' << r.mode << ',' << r.images << ',' << r.bestNs << ',' << r.meanNs << ',' << r.nsPerOp << ',' << r.pages << ','
+				<< r.occupancy << ',' << r.bindingReduction << ',' << r.failed << ',' << r.valid << '\n';
+		}
+		else
+		{
+			out << "{\"set\":\"" << r.set << "\",\"mode\":\"" << r.mode << "\",\"images\":" << r.images << ",\"best_ns\":" << r.bestNs
+				<< ",\"mean_ns\":" << r.meanNs << ",\"ns_per_op\":" << r.nsPerOp << ",\"pages\":" << r.pages << ",\"occupancy\":" << r.occupancy
+				<< ",\"binding_reduction\":" << r.bindingReduction << ",\"failed\":" << r.failed << ",\"valid\":" << (r.valid ? "true" : "false") << "}\n";
+		}
+		out.flush();
+
+		std::fprintf(stderr, "%-8s %-8s %7u %14.1f %14.1f %10.1f %6u %9.3f %9.1f %7llu %-5s\n", r.set.c_str(), r.mode.c_str(), r.images,
+			r.bestNs, r.meanNs, r.nsPerOp, r.pages, r.occupancy, r.bindingReduction, static_cast<unsigned long long>(r.failed), r.valid ? "yes" : "NO");
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const auto value = [&]() -> const char*
+				{
+					return i + 1 < argc ? argv[++i] : nullptr;
+				};
+			const char* v = nullptr;
+			if (arg == "--reps" && (v = value()))
+				options.reps = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--images" && (v = value()))
+				options.images = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--page-size" && (v = value()))
+				options.pageSize = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--padding" && (v = value()))
+				options.padding = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--rounds" && (v = value()))
+				options.rounds = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--format" && (v = value()))
+				options.format = v;
+			else if (arg == "--out" && (v = value()))
+				options.out = v;
+			else
+			{
+				std::fprintf(stderr, "Unknown or incomplete option %s\n", argv[i]);
+				return false;
+			}
+		}
+		// The largest mixed image and its gutter has to fit a page
+		return options.reps > 0 && options.images > 0 && options.pageSize >= 256 + 2 * options.padding;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: AtlasBenchmarks [--reps N] [--images N] [--page-size N] [--padding N] [--rounds N] [--format json|csv] [--out FILE]\n");
+		return 1;
+	}
+
+	std::ofstream file;
+	if (!options.out.empty())
+	{
+		file.open(options.out, std::ios::trunc);
+	}
+	auto& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+	if (options.format == "csv")
+	{
+		out << "set,mode,images,best_ns,mean_ns,ns_per_op,pages,occupancy,binding_reduction,failed,valid\n";
+	}
+	std::fprintf(stderr, "%-8s %-8s %7s %14s %14s %10s %6s %9s %9s %7s %-5s\n", "set", "mode", "images", "best ns", "mean ns", "ns/op",
+		"pages", "occupancy", "bind/page", "failed", "valid");
+
+	auto valid = true;
+	for (const auto set : { IMAGE_SET::GLYPHS, IMAGE_SET::SPRITES, IMAGE_SET::MIXED })
+	{
+		const auto sizes = randomSizes(set, options.images, 1);
+		const auto finish = [&](Result& result, std::string_view mode)
+			{
+				result.set = setName(set);
+				result.mode = mode;
+				valid = valid && result.valid;
+				report(options, out, result);
+			};
+
+		std::optional<LS::TextureAtlas> atlas;
+		std::vector<std::optional<uint32_t>> ids;
+		const auto reset = [&]()
+			{
+				atlas.emplace(options.pageSize, options.pageSize, options.padding);
+			};
+
+		auto online = measure(options, options.images, reset, [&]()
+			{
+				ids.resize(sizes.size());
+				for (size_t i = 0; i < sizes.size(); ++i)
+				{
+					ids[i] = atlas->Insert(sizes[i].width, sizes[i].height);
+				}
+			});
+		describe(online, *atlas, liveIds(ids), options);
+		finish(online, "online");
+
+		auto offline = measure(options, options.images, reset, [&]()
+			{
+				ids = atlas->Pack(sizes);
+			});
+		describe(offline, *atlas, liveIds(ids), options);
+		finish(offline, "offline");
+
+		// Pages of RGBA8 texels the offline packing is copied into, each image a solid colour
+		const auto texel = LS::texelSize(LS::TEXEL_FORMAT::R8G8B8A8_UNORM);
+		const auto pitch = static_cast<size_t>(options.pageSize) * texel;
+		std::vector<std::vector<std::byte>> pages(atlas->PageCount(), std::vector<std::byte>(pitch * options.pageSize));
+		const auto largest = std::max_element(sizes.begin(), sizes.end(), [](const LS::AtlasSize& a, const LS::AtlasSize& b)
+			{
+				return static_cast<uint64_t>(a.width) * a.height < static_cast<uint64_t>(b.width) * b.height;
+			});
+		std::vector<std::byte> image(static_cast<size_t>(largest->width) * largest->height * texel, std::byte{ 0x7f });
+		const auto live = liveIds(ids);
+		auto copy = measure(options, static_cast<double>(live.size()), []() {}, [&]()
+			{
+				for (const auto id : live)
+				{
+					const auto& entry = atlas->Entry(id);
+					const LS::TextureData source{ .data = image.data(), .rowPitch = static_cast<size_t>(entry.rect.width) * texel,
+						.width = entry.rect.width, .height = entry.rect.height };
+					const LS::TextureData page{ .data = pages[entry.page].data(), .rowPitch = pitch, .width = options.pageSize,
+						.height = options.pageSize };
+					LS::copyToAtlas(source, page, entry.rect, atlas->Padding());
+				}
+			});
+		describe(copy, *atlas, live, options);
+		finish(copy, "copy");
+
+		// Each run starts from the same online fill and turns over the same images
+		std::vector<uint32_t> churned;
+		auto turnover = 0.0;
+		auto churn = measure(options, 1.0, [&]()
+			{
+				reset();
+				churned.clear();
+				for (const auto& size : sizes)
+				{
+					if (const auto id = atlas->Insert(size.width, size.height))
+					{
+						churned.push_back(*id);
+					}
+				}
+			},
+			[&]()
+			{
+				std::mt19937 rng(2);
+				turnover = 0.0;
+				for (uint32_t round = 0; round < options.rounds; ++round)
+				{
+					std::shuffle(churned.begin(), churned.end(), rng);
+					const auto count = churned.size() / 4;
+					for (size_t i = churned.size() - count; i < churned.size(); ++i)
+					{
+						atlas->Evict(churned[i]);
+					}
+					churned.resize(churned.size() - count);
+					for (size_t i = 0; i < count; ++i)
+					{
+						const auto size = randomSize(set, rng);
+						if (const auto id = atlas->Insert(size.width, size.height))
+						{
+							churned.push_back(*id);
+						}
+					}
+					turnover += 2.0 * count;
+				}
+			});
+		churn.nsPerOp = turnover == 0.0 ? 0.0 : churn.bestNs / turnover;
+		describe(churn, *atlas, churned, options);
+		finish(churn, "churn");
+	}
+
+	return valid ? 0 : 1;
+}
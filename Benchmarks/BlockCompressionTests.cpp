@@ -0,0 +1,256 @@
+// BC7 decoding of every mode against known answers. Each block is random bits under its mode's prefix, so it
+// reaches partitions, p-bits, rotations and index modes an encoder may never pick, and its texels come from an
+// independent decoder. Every partition of the partitioned modes is checked as well, through one hash. A reserved
+// block has to decode as zero and be reported, and blocks the encoder writes have to decode back close to their
+// source.
+//
+//   BlockCompressionTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include "TestCheck.h"
+
+import TextureFormat;
+import BlockCompression;
+
+namespace
+{
+	struct KnownBlock
+	{
+		std::array<uint8_t, 16> block;
+		std::array<uint8_t, 64> texels;// RGBA, row by row
+	};
+
+	const KnownBlock KNOWN_BLOCKS[8] =
+	{
+		// Mode 0
+		{
+			{ 0x87, 0xdd, 0x57, 0x78, 0x6e, 0x49, 0x84, 0x2e, 0x5c, 0x87, 0x6f, 0xba, 0x3c, 0xee, 0x0e, 0x94 },
+			{
+				203, 58, 73, 255, 111, 41, 124, 255, 87, 41, 140, 255, 111, 41, 124, 255,
+				222, 96, 101, 255, 217, 87, 94, 255, 206, 41, 57, 255, 41, 41, 173, 255,
+				231, 115, 115, 255, 226, 106, 108, 255, 203, 106, 179, 255, 218, 140, 115, 255,
+				198, 49, 66, 255, 210, 123, 148, 255, 225, 157, 84, 255, 225, 157, 84, 255
+			}
+		},
+		// Mode 1
+		{
+			{ 0x26, 0xa6, 0xc2, 0x4d, 0xc4, 0x6b, 0x40, 0x33, 0xa6, 0xfa, 0x25, 0xe3, 0x1e, 0x45, 0x38, 0xb9 },
+			{
+				139, 42, 192, 255, 123, 67, 176, 255, 81, 58, 238, 255, 112, 24, 169, 255,
+				42, 191, 98, 255, 81, 58, 238, 255, 97, 41, 203, 255, 91, 47, 215, 255,
+				102, 35, 192, 255, 91, 47, 215, 255, 112, 24, 169, 255, 81, 58, 238, 255,
+				107, 30, 180, 255, 107, 30, 180, 255, 76, 64, 249, 255, 102, 35, 192, 255
+			}
+		},
+		// Mode 2
+		{
+			{ 0xd4, 0x90, 0xfb, 0x68, 0xc1, 0xfa, 0xd8, 0xc1, 0x63, 0x0a, 0x74, 0xb7, 0x2b, 0x4e, 0x35, 0xc2 },
+			{
+				82, 157, 110, 255, 128, 71, 149, 255, 255, 99, 66, 255, 99, 139, 62, 255,
+				66, 57, 189, 255, 90, 198, 222, 255, 104, 141, 187, 255, 128, 71, 149, 255,
+				255, 99, 66, 255, 104, 141, 187, 255, 132, 24, 115, 255, 255, 99, 66, 255,
+				99, 139, 62, 255, 255, 99, 66, 255, 255, 99, 66, 255, 115, 123, 16, 255
+			}
+		},
+		// Mode 3
+		{
+			{ 0x48, 0x88, 0xe5, 0x43, 0x00, 0x84, 0x7e, 0x88, 0xd6, 0x3d, 0xc3, 0x3e, 0xa8, 0x95, 0xda, 0xa2 },
+			{
+				196, 32, 234, 255, 207, 98, 177, 255, 207, 98, 177, 255, 228, 232, 60, 255,
+				218, 166, 117, 255, 218, 166, 117, 255, 196, 32, 234, 255, 90, 63, 172, 255,
+				207, 98, 177, 255, 228, 232, 60, 255, 218, 166, 117, 255, 90, 63, 172, 255,
+				207, 98, 177, 255, 196, 32, 234, 255, 90, 63, 172, 255, 90, 63, 172, 255
+			}
+		},
+		// Mode 4
+		{
+			{ 0x70, 0x59, 0x05, 0xd0, 0x56, 0xd7, 0x38, 0xbc, 0xe7, 0xad, 0x90, 0x7f, 0x37, 0x0a, 0xab, 0x5a },
+			{
+				206, 8, 117, 107, 82, 0, 99, 90, 165, 5, 61, 101, 206, 8, 52, 107,
+				123, 3, 52, 96, 82, 0, 61, 90, 165, 5, 70, 101, 82, 0, 108, 90,
+				82, 0, 99, 90, 206, 8, 108, 107, 82, 0, 79, 90, 82, 0, 70, 90,
+				123, 3, 99, 96, 165, 5, 70, 101, 165, 5, 61, 101, 165, 5, 99, 101
+			}
+		},
+		// Mode 5
+		{
+			{ 0x20, 0x98, 0x76, 0x6a, 0xe2, 0x0d, 0xff, 0x86, 0x36, 0x6c, 0x4e, 0xba, 0x2a, 0x53, 0x9b, 0x9d },
+			{
+				104, 68, 191, 181, 163, 52, 193, 171, 104, 68, 191, 171, 48, 82, 189, 191,
+				163, 52, 193, 161, 104, 68, 191, 191, 219, 38, 195, 181, 48, 82, 189, 181,
+				219, 38, 195, 161, 104, 68, 191, 171, 163, 52, 193, 181, 48, 82, 189, 171,
+				104, 68, 191, 181, 219, 38, 195, 161, 104, 68, 191, 181, 104, 68, 191, 171
+			}
+		},
+		// Mode 6
+		{
+			{ 0x40, 0x87, 0x97, 0xf6, 0x4a, 0x2e, 0xd7, 0x37, 0x7b, 0x4e, 0x3d, 0x4f, 0x64, 0x90, 0x38, 0x8b },
+			{
+				81, 101, 148, 180, 103, 100, 148, 166, 179, 96, 151, 117, 71, 102, 147, 187,
+				166, 96, 150, 125, 61, 102, 147, 193, 189, 95, 151, 111, 71, 102, 147, 187,
+				71, 102, 147, 187, 93, 100, 148, 172, 28, 104, 146, 214, 124, 99, 149, 153,
+				114, 99, 149, 159, 61, 102, 147, 193, 146, 97, 150, 138, 114, 99, 149, 159
+			}
+		},
+		// Mode 7
+		{
+			{ 0x80, 0x43, 0x3d, 0xb4, 0xa5, 0x84, 0x8a, 0x54, 0x4b, 0x2b, 0xf4, 0x84, 0x18, 0xb6, 0x1d, 0x13 },
+			{
+				170, 73, 146, 81, 60, 77, 85, 69, 170, 73, 146, 81, 162, 65, 89, 121,
+				60, 77, 85, 69, 96, 76, 105, 73, 143, 57, 129, 87, 105, 40, 211, 16,
+				96, 76, 105, 73, 60, 77, 85, 69, 162, 65, 89, 121, 124, 48, 171, 50,
+				134, 74, 126, 77, 124, 48, 171, 50, 162, 65, 89, 121, 162, 65, 89, 121
+			}
+		}
+
+	};
+
+	// Decodes one block into a 4x4 texture of format
+	std::vector<uint8_t> decodeBlock(const std::array<uint8_t, 16>& block, LS::TEXEL_FORMAT format, bool& decoded)
+	{
+		auto bytes = block;
+		std::vector<uint8_t> texels(64);
+		const LS::BlockData source{ .data = reinterpret_cast<std::byte*>(bytes.data()), .rowPitch = 16, .width = 4, .height = 4,
+			.format = LS::BLOCK_FORMAT::BC7_UNORM };
+		const LS::TextureData destination{ .data = reinterpret_cast<std::byte*>(texels.data()), .rowPitch = 16, .width = 4,
+			.height = 4, .format = format };
+		decoded = LS::decompressTexture(source, destination);
+		return texels;
+	}
+
+	void testKnownBlocks()
+	{
+		for (const auto& known : KNOWN_BLOCKS)
+		{
+			bool decoded = false;
+			const auto rgba = decodeBlock(known.block, LS::TEXEL_FORMAT::R8G8B8A8_UNORM, decoded);
+			CHECK(decoded);
+			CHECK(std::equal(rgba.begin(), rgba.end(), known.texels.begin()));
+
+			const auto bgra = decodeBlock(known.block, LS::TEXEL_FORMAT::B8G8R8A8_UNORM, decoded);
+			for (size_t i = 0; i < 64; i += 4)
+			{
+				CHECK(bgra[i] == rgba[i + 2] && bgra[i + 1] == rgba[i + 1] && bgra[i + 2] == rgba[i] && bgra[i + 3] == rgba[i + 3]);
+			}
+		}
+
+		// No mode bit set
+		bool decoded = true;
+		const auto texels = decodeBlock({}, LS::TEXEL_FORMAT::R8G8B8A8_UNORM, decoded);
+		CHECK(!decoded);
+		CHECK(std::all_of(texels.begin(), texels.end(), [](uint8_t t) { return t == 0; }));
+	}
+
+	// Every partition of every partitioned mode, one random block each, decoded side by side into one row of blocks.
+	// The FNV-1a hash of the RGBA texels is the independent decoder's.
+	void testEveryPartition()
+	{
+		constexpr uint64_t EXPECTED_HASH = 0xb687056848c5430aull;
+		struct PartitionedMode
+		{
+			uint32_t mode;
+			uint32_t partitionBits;
+		};
+		constexpr PartitionedMode MODES[] = { { 0, 4 }, { 1, 6 }, { 2, 6 }, { 3, 6 }, { 7, 6 } };
+
+		auto state = uint64_t{ 0x9e3779b97f4a7c15ull };
+		const auto next = [&state]()
+			{
+				state ^= state << 13;
+				state ^= state >> 7;
+				state ^= state << 17;
+				return state;
+			};
+
+		std::vector<uint8_t> blocks;
+		for (const auto& [mode, partitionBits] : MODES)
+		{
+			for (uint64_t partition = 0; partition < (uint64_t{ 1 } << partitionBits); ++partition)
+			{
+				// The low word takes the mode and partition, the bits above them stay random
+				const auto prefix = mode + 1 + partitionBits;
+				auto low = next();
+				const auto high = next();
+				low = (low & ~((uint64_t{ 1 } << prefix) - 1)) | uint64_t{ 1 } << mode | partition << (mode + 1);
+				for (uint32_t b = 0; b < 8; ++b)
+				{
+					blocks.push_back(static_cast<uint8_t>(low >> (b * 8)));
+				}
+				for (uint32_t b = 0; b < 8; ++b)
+				{
+					blocks.push_back(static_cast<uint8_t>(high >> (b * 8)));
+				}
+			}
+		}
+
+		const auto width = static_cast<uint32_t>(blocks.size() / 16 * 4);
+		std::vector<uint8_t> texels(width * 4 * 4);
+		const LS::BlockData source{ .data = reinterpret_cast<std::byte*>(blocks.data()), .rowPitch = blocks.size(), .width = width,
+			.height = 4, .format = LS::BLOCK_FORMAT::BC7_UNORM };
+		const LS::TextureData destination{ .data = reinterpret_cast<std::byte*>(texels.data()), .rowPitch = width * 4, .width = width,
+			.height = 4, .format = LS::TEXEL_FORMAT::R8G8B8A8_UNORM };
+		CHECK(LS::decompressTexture(source, destination));
+
+		auto hash = uint64_t{ 0xcbf29ce484222325ull };
+		for (const auto texel : texels)
+		{
+			hash = (hash ^ texel) * 0x100000001b3ull;
+		}
+		CHECK(hash == EXPECTED_HASH);
+	}
+
+	void testRoundTrip(LS::COMPRESSION_QUALITY quality)
+	{
+		constexpr uint32_t SIZE = 32;
+		std::vector<uint8_t> source(SIZE * SIZE * 4);
+		for (uint32_t y = 0; y < SIZE; ++y)
+		{
+			for (uint32_t x = 0; x < SIZE; ++x)
+			{
+				auto* texel = &source[(y * SIZE + x) * 4];
+				texel[0] = static_cast<uint8_t>(x * 8);
+				texel[1] = static_cast<uint8_t>(y * 8);
+				texel[2] = static_cast<uint8_t>((x + y) * 4);
+				texel[3] = static_cast<uint8_t>(255 - x * 4);
+			}
+		}
+
+		std::vector<uint8_t> blocks(SIZE * SIZE);
+		std::vector<uint8_t> decoded(source.size());
+		const LS::TextureData texels{ .data = reinterpret_cast<std::byte*>(source.data()), .rowPitch = SIZE * 4, .width = SIZE,
+			.height = SIZE, .format = LS::TEXEL_FORMAT::R8G8B8A8_UNORM };
+		const LS::BlockData compressed{ .data = reinterpret_cast<std::byte*>(blocks.data()), .rowPitch = SIZE * 4, .width = SIZE,
+			.height = SIZE, .format = LS::BLOCK_FORMAT::BC7_UNORM };
+		LS::compressTexture(texels, compressed, quality);
+		const LS::TextureData output{ .data = reinterpret_cast<std::byte*>(decoded.data()), .rowPitch = SIZE * 4, .width = SIZE,
+			.height = SIZE, .format = LS::TEXEL_FORMAT::R8G8B8A8_UNORM };
+		CHECK(LS::decompressTexture(compressed, output));
+
+		// Smooth gradients in all four channels, which one line per block cannot follow exactly: every channel has
+		// to come back within a few steps, and close on average
+		auto worst = 0;
+		auto total = 0;
+		for (size_t i = 0; i < source.size(); ++i)
+		{
+			const auto error = std::abs(static_cast<int>(source[i]) - static_cast<int>(decoded[i]));
+			worst = std::max(worst, error);
+			total += error;
+		}
+		CHECK(worst <= 16);
+		CHECK(total <= static_cast<int>(source.size()) * 4);
+	}
+}
+
+int main()
+{
+	testKnownBlocks();
+	testEveryPartition();
+	testRoundTrip(LS::COMPRESSION_QUALITY::FAST);
+	testRoundTrip(LS::COMPRESSION_QUALITY::QUALITY);
+	return Test::result("BlockCompressionTests");
+}
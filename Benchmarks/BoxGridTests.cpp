@@ -0,0 +1,264 @@
+// BoxGrid against a brute force scan. Boxes of every size, down to points and up to ones spread over more cells
+// than the grid registers a box in, are inserted, moved by small steps and across the region, resized and removed,
+// while a cursor wanders over them. At every step the topmost box under the cursor has to be the one a scan of all
+// boxes finds, the way LSWindow::hitTest picks it by the largest key, and the hover has to enter and leave the same
+// boxes in the same order. Box queries have to report every overlapping box exactly once. Last, NaN and huge
+// coordinates have to be handled without undefined behaviour (run it under a sanitizer to see that).
+//
+//   BoxGridTests [--seed N]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <random>
+#include "TestCheck.h"
+
+import BoxGrid;
+
+namespace
+{
+	constexpr uint32_t NO_HIT = UINT32_MAX;
+	constexpr float REGION_SIZE = 512.0f;
+	constexpr float CELL_SIZE = 16.0f;
+
+	struct Reference
+	{
+		struct Item
+		{
+			uint32_t key;
+			Data::Box bounds;
+			Data::Handle handle;
+		};
+
+		std::vector<Item> items;
+
+		uint32_t HitTest(const Data::Point& p) const
+		{
+			uint32_t top = NO_HIT;
+			for (const auto& item : items)
+			{
+				if (item.bounds.InBounds(p) && (top == NO_HIT || item.key > top))
+				{
+					top = item.key;
+				}
+			}
+			return top;
+		}
+
+		std::vector<Data::Handle> Query(const Data::Box& box) const
+		{
+			std::vector<Data::Handle> result;
+			for (const auto& item : items)
+			{
+				if (item.bounds.Intersects(box))
+				{
+					result.push_back(item.handle);
+				}
+			}
+			std::ranges::sort(result);
+			return result;
+		}
+	};
+
+	// Topmost key under p, as LSWindow::hitTest finds it
+	uint32_t hitTest(const Data::BoxGrid<uint32_t>& grid, const Data::Point& p)
+	{
+		uint32_t top = NO_HIT;
+		grid.QueryPoint(p, [&](Data::Handle h)
+			{
+				const auto key = grid.Get(h);
+				if (top == NO_HIT || key > top)
+				{
+					top = key;
+				}
+			});
+		return top;
+	}
+
+	// Enter and exit transitions of a hover, the key left and the key entered, as LSWindow::setHovered sends them
+	struct Hover
+	{
+		uint32_t hovered = NO_HIT;
+		std::vector<std::pair<uint32_t, uint32_t>> transitions;
+
+		void Set(uint32_t key)
+		{
+			if (key == hovered)
+				return;
+			transitions.emplace_back(hovered, key);
+			hovered = key;
+		}
+	};
+
+	Data::Box randomBox(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-32.0f, REGION_SIZE);
+		const auto x = position(rng);
+		const auto y = position(rng);
+		// Mostly widget sized, some points, lines on cell boundaries and a few large enough to be kept aside
+		float width;
+		float height;
+		switch (rng() % 8)
+		{
+		case 0:
+			width = height = 0.0f;
+			break;
+		case 1:
+			return Data::Box{ .minPoint = { std::floor(x / CELL_SIZE) * CELL_SIZE, y }, .maxPoint = { std::floor(x / CELL_SIZE) * CELL_SIZE + CELL_SIZE, y + 8.0f } };
+		case 2:
+			width = static_cast<float>(rng() % 400) + 160.0f;
+			height = static_cast<float>(rng() % 400) + 160.0f;
+			break;
+		default:
+			width = static_cast<float>(rng() % 64);
+			height = static_cast<float>(rng() % 48);
+		}
+		return Data::Box{ .minPoint = { x, y }, .maxPoint = { x + width, y + height } };
+	}
+
+	Data::Box nudged(const Data::Box& box, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> step(-6.0f, 6.0f);
+		const auto dx = step(rng);
+		const auto dy = step(rng);
+		return Data::Box{ .minPoint = { box.minPoint.x + dx, box.minPoint.y + dy }, .maxPoint = { box.maxPoint.x + dx, box.maxPoint.y + dy } };
+	}
+
+	void testAgainstReference(uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		Data::BoxGrid<uint32_t> grid(CELL_SIZE);
+		Reference reference;
+		Hover hover;
+		Hover expectedHover;
+		uint32_t nextKey = 0;
+		Data::Point cursor{ .x = REGION_SIZE / 2, .y = REGION_SIZE / 2 };
+		std::uniform_real_distribution<float> wander(-12.0f, 12.0f);
+		std::uniform_real_distribution<float> anywhere(-48.0f, REGION_SIZE + 48.0f);
+
+		for (uint32_t step = 0; step < 4000; ++step)
+		{
+			const auto op = rng() % 16;
+			if (op < 3 || reference.items.size() < 8)
+			{
+				// Later keys are drawn on top, like widgets added later
+				const auto bounds = randomBox(rng);
+				const auto handle = grid.Insert(nextKey, bounds);
+				reference.items.push_back(Reference::Item{ .key = nextKey++, .bounds = bounds, .handle = handle });
+			}
+			else if (op < 4)
+			{
+				const auto i = rng() % reference.items.size();
+				CHECK(grid.Remove(reference.items[i].handle));
+				reference.items[i] = reference.items.back();
+				reference.items.pop_back();
+			}
+			else if (op < 10)
+			{
+				auto& item = reference.items[rng() % reference.items.size()];
+				item.bounds = op < 8 ? nudged(item.bounds, rng) : randomBox(rng);
+				CHECK(grid.Move(item.handle, item.bounds));
+			}
+
+			// The cursor mostly drifts, sometimes jumps, and now and then sits exactly on a cell or box edge
+			if (rng() % 8 == 0)
+			{
+				cursor = Data::Point{ .x = anywhere(rng), .y = anywhere(rng) };
+			}
+			else if (rng() % 8 == 0)
+			{
+				const auto& item = reference.items[rng() % reference.items.size()];
+				cursor = rng() % 2 ? item.bounds.minPoint : item.bounds.maxPoint;
+			}
+			else
+			{
+				cursor = Data::Point{ .x = cursor.x + wander(rng), .y = cursor.y + wander(rng) };
+			}
+
+			const auto expected = reference.HitTest(cursor);
+			CHECK(hitTest(grid, cursor) == expected);
+			hover.Set(hitTest(grid, cursor));
+			expectedHover.Set(expected);
+
+			if (step % 16 == 0)
+			{
+				const auto query = Data::Box{ .minPoint = cursor, .maxPoint = { cursor.x + wander(rng) + 40.0f, cursor.y + wander(rng) + 40.0f } };
+				auto found = grid.Query(query);
+				std::ranges::sort(found);
+				CHECK(found == reference.Query(query));
+			}
+		}
+
+		CHECK(grid.Size() == reference.items.size());
+		CHECK(hover.transitions == expectedHover.transitions);
+		// The walk is long enough to hover over many boxes, so the transitions are worth comparing
+		CHECK(expectedHover.transitions.size() > 100);
+
+		// Removing everything leaves no occupied cells behind
+		for (const auto& item : reference.items)
+		{
+			CHECK(grid.Remove(item.handle));
+		}
+		CHECK(grid.Size() == 0);
+		CHECK(grid.CellCount() == 0);
+	}
+
+	void testExtremeCoordinates()
+	{
+		constexpr auto NAN_VALUE = std::numeric_limits<float>::quiet_NaN();
+		constexpr auto HUGE_VALUE = 1.0e30f;
+		Data::BoxGrid<uint32_t> grid(CELL_SIZE);
+		const auto everything = Data::Box{ .minPoint = { -HUGE_VALUE, -HUGE_VALUE }, .maxPoint = { HUGE_VALUE, HUGE_VALUE } };
+		const auto small = Data::Box{ .minPoint = { 10.0f, 10.0f }, .maxPoint = { 20.0f, 20.0f } };
+		const auto nan = Data::Box{ .minPoint = { NAN_VALUE, 10.0f }, .maxPoint = { 20.0f, NAN_VALUE } };
+
+		const auto hSmall = grid.Insert(0, small);
+		const auto hEverything = grid.Insert(1, everything);
+		const auto hNan = grid.Insert(2, nan);
+		CHECK(grid.Size() == 3);
+
+		// A NaN box overlaps nothing, a box over the whole float range overlaps everything else
+		CHECK(hitTest(grid, Data::Point{ .x = 15.0f, .y = 15.0f }) == 1);
+		CHECK(hitTest(grid, Data::Point{ .x = -1.0e29f, .y = 3.0e29f }) == 1);
+		CHECK(hitTest(grid, Data::Point{ .x = NAN_VALUE, .y = 15.0f }) == NO_HIT);
+		auto found = grid.Query(everything);
+		std::ranges::sort(found);
+		CHECK(found == (std::vector<Data::Handle>{ hSmall, hEverything }));
+		CHECK(grid.Query(nan).empty());
+
+		// Moving between finite, huge and NaN bounds, and removing from each
+		CHECK(grid.Move(hNan, everything));
+		CHECK(grid.Move(hEverything, nan));
+		CHECK(grid.Move(hSmall, Data::Box{ .minPoint = { -HUGE_VALUE, 0.0f }, .maxPoint = { 0.0f, 0.0f } }));
+		CHECK(hitTest(grid, Data::Point{ .x = -5.0f, .y = 0.0f }) == 2);
+		CHECK(grid.Remove(hEverything));
+		CHECK(grid.Remove(hNan));
+		CHECK(grid.Remove(hSmall));
+		CHECK(grid.CellCount() == 0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::string_view(argv[i]) == "--seed")
+		{
+			seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		}
+	}
+
+	for (uint32_t run = 0; run < 4; ++run)
+	{
+		testAgainstReference(seed + run);
+	}
+	testExtremeCoordinates();
+	return Test::result("BoxGridTests");
+}
@@ -0,0 +1,192 @@
+// BoxKernels at every SIMD level the CPU supports, pinned in turn with setSimdLevel, against the Box tests they
+// batch. Counts run from 0 past two AVX2 widths so every tail length is covered, arrays start at every offset from
+// an aligned address, and coordinates are drawn from a few whole values so many of them sit exactly on the query
+// box edges, which count as inside. NaN and infinite coordinates, in the arrays and in the query box, have to fail
+// and pass exactly like the scalar comparisons. Each kernel writes into a buffer of exactly count entries.
+//
+//   BoxKernelsTests [--seed N]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "TestCheck.h"
+
+import BoxKernels;
+
+namespace
+{
+	constexpr float NAN_VALUE = std::numeric_limits<float>::quiet_NaN();
+	constexpr float INF_VALUE = std::numeric_limits<float>::infinity();
+	// Longest run checked at every count, two AVX2 widths and then some
+	constexpr uint32_t MAX_COUNT = 40;
+	constexpr uint32_t MAX_OFFSET = 8;
+
+	const char* levelName(Data::SIMD_LEVEL level)
+	{
+		switch (level)
+		{
+		case Data::SIMD_LEVEL::SSE:
+			return "sse";
+		case Data::SIMD_LEVEL::AVX2:
+			return "avx2";
+		default:
+			return "scalar";
+		}
+	}
+
+	float randomCoordinate(std::mt19937& rng)
+	{
+		// Mostly on the few values the query boxes use too, now and then NaN or infinite
+		switch (rng() % 32)
+		{
+		case 0:
+			return NAN_VALUE;
+		case 1:
+			return INF_VALUE;
+		case 2:
+			return -INF_VALUE;
+		default:
+			return static_cast<float>(rng() % 9) - 4.0f;
+		}
+	}
+
+	Data::Box randomBox(std::mt19937& rng)
+	{
+		const auto a = Data::Point{ .x = randomCoordinate(rng), .y = randomCoordinate(rng) };
+		const auto b = Data::Point{ .x = randomCoordinate(rng), .y = randomCoordinate(rng) };
+		// Ordered when both are numbers, NaN stays wherever it landed
+		return Data::Box{ .minPoint = { std::min(a.x, b.x), std::min(a.y, b.y) }, .maxPoint = { std::max(a.x, b.x), std::max(a.y, b.y) } };
+	}
+
+	// Structure of arrays with room before the first element, so a run can start at any offset
+	struct Arrays
+	{
+		std::vector<float> minX = std::vector<float>(MAX_OFFSET + MAX_COUNT);
+		std::vector<float> minY = std::vector<float>(MAX_OFFSET + MAX_COUNT);
+		std::vector<float> maxX = std::vector<float>(MAX_OFFSET + MAX_COUNT);
+		std::vector<float> maxY = std::vector<float>(MAX_OFFSET + MAX_COUNT);
+
+		Data::Box Get(size_t i) const
+		{
+			return Data::Box{ .minPoint = { minX[i], minY[i] }, .maxPoint = { maxX[i], maxY[i] } };
+		}
+	};
+
+	template<class Pass>
+	std::vector<uint32_t> expected(uint32_t offset, uint32_t count, Pass&& pass)
+	{
+		std::vector<uint32_t> result;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (pass(offset + i))
+			{
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+
+	template<class Kernel>
+	std::vector<uint32_t> run(uint32_t count, Kernel&& kernel)
+	{
+		std::vector<uint32_t> out(count);
+		const auto n = kernel(out.data());
+		CHECK(n <= count);
+		out.resize(std::min(n, count));
+		return out;
+	}
+
+	void testLevel(Data::SIMD_LEVEL level, uint32_t seed)
+	{
+		const auto failuresBefore = Test::failures;
+		std::mt19937 rng(seed);
+		Arrays arrays;
+
+		for (uint32_t round = 0; round < 200; ++round)
+		{
+			for (size_t i = 0; i < arrays.minX.size(); ++i)
+			{
+				// Points reuse the min edges, boxes are random too so some are inverted or NaN
+				const auto box = randomBox(rng);
+				arrays.minX[i] = box.minPoint.x;
+				arrays.minY[i] = box.minPoint.y;
+				arrays.maxX[i] = rng() % 8 == 0 ? randomCoordinate(rng) : box.maxPoint.x;
+				arrays.maxY[i] = box.maxPoint.y;
+			}
+			const auto query = randomBox(rng);
+
+			for (uint32_t offset = 0; offset < MAX_OFFSET; ++offset)
+			{
+				for (uint32_t count = 0; count <= MAX_COUNT; ++count)
+				{
+					const auto* minX = arrays.minX.data() + offset;
+					const auto* minY = arrays.minY.data() + offset;
+					const auto* maxX = arrays.maxX.data() + offset;
+					const auto* maxY = arrays.maxY.data() + offset;
+
+					const auto points = run(count, [&](uint32_t* out) { return Data::pointsInBox(minX, minY, count, query, out); });
+					CHECK(points == expected(offset, count, [&](size_t i) { return query.InBounds(arrays.Get(i).minPoint); }));
+
+					const auto overlap = run(count, [&](uint32_t* out) { return Data::boxesOverlap(minX, minY, maxX, maxY, count, query, out); });
+					CHECK(overlap == expected(offset, count, [&](size_t i) { return arrays.Get(i).Intersects(query); }));
+
+					const auto inside = run(count, [&](uint32_t* out) { return Data::boxesInside(minX, minY, maxX, maxY, count, query, out); });
+					CHECK(inside == expected(offset, count, [&](size_t i) { return query.Contains(arrays.Get(i)); }));
+				}
+			}
+		}
+
+		// A long run through the BoxArrays overloads, and a point hit test
+		Data::BoxArrays boxes;
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			boxes.Add(randomBox(rng));
+		}
+		for (uint32_t round = 0; round < 50; ++round)
+		{
+			const auto query = randomBox(rng);
+			const auto overlap = run(boxes.Size(), [&](uint32_t* out) { return Data::boxesOverlap(boxes, query, out); });
+			CHECK(overlap == expected(0, boxes.Size(), [&](size_t i) { return boxes.Get(static_cast<uint32_t>(i)).Intersects(query); }));
+			const auto inside = run(boxes.Size(), [&](uint32_t* out) { return Data::boxesInside(boxes, query, out); });
+			CHECK(inside == expected(0, boxes.Size(), [&](size_t i) { return query.Contains(boxes.Get(static_cast<uint32_t>(i))); }));
+			const auto at = run(boxes.Size(), [&](uint32_t* out) { return Data::boxesAt(boxes, query.minPoint, out); });
+			CHECK(at == expected(0, boxes.Size(), [&](size_t i) { return boxes.Get(static_cast<uint32_t>(i)).InBounds(query.minPoint); }));
+		}
+
+		std::fprintf(stderr, "%s: %d failed checks\n", levelName(level), Test::failures - failuresBefore);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::string_view(argv[i]) == "--seed")
+		{
+			seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		}
+	}
+
+	const auto supported = Data::supportedSimdLevel();
+	for (const auto level : { Data::SIMD_LEVEL::SCALAR, Data::SIMD_LEVEL::SSE, Data::SIMD_LEVEL::AVX2 })
+	{
+		if (static_cast<int>(level) > static_cast<int>(supported))
+		{
+			std::fprintf(stderr, "%s: not supported, skipped\n", levelName(level));
+			continue;
+		}
+		CHECK(Data::setSimdLevel(level) == level);
+		CHECK(Data::simdLevel() == level);
+		testLevel(level, seed);
+	}
+
+	// Asking for more than the CPU has pins the widest it supports
+	CHECK(Data::setSimdLevel(Data::SIMD_LEVEL::AVX2) == supported);
+	return Test::result("BoxKernelsTests");
+}
@@ -0,0 +1,169 @@
+// SweepAndPrune pairs against a brute force test of every two boxes. Boxes sit on a grid of whole units so many of
+// them share edges, which do not count as overlap, and some are points or lines. Frames move boxes a little, as the
+// insertion sort expects, or far, and add and remove proxies so ids are recycled. Every FindPairs has to report each
+// strictly overlapping pair exactly once, smaller id first, on one worker and on several.
+//
+//   BroadphaseTests [--seed N]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "TestCheck.h"
+
+import Broadphase;
+
+namespace
+{
+	struct Proxy
+	{
+		uint32_t id;
+		Box2D bounds;
+	};
+
+	bool overlaps(const Box2D& a, const Box2D& b)
+	{
+		return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+	}
+
+	// Pairs as one sortable value, smaller id in the upper half
+	uint64_t pairKey(uint32_t a, uint32_t b)
+	{
+		return static_cast<uint64_t>(a) << 32 | b;
+	}
+
+	std::vector<uint64_t> bruteForce(const std::vector<Proxy>& proxies)
+	{
+		std::vector<uint64_t> pairs;
+		for (size_t i = 0; i < proxies.size(); ++i)
+		{
+			for (size_t j = i + 1; j < proxies.size(); ++j)
+			{
+				if (overlaps(proxies[i].bounds, proxies[j].bounds))
+				{
+					const auto a = std::min(proxies[i].id, proxies[j].id);
+					const auto b = std::max(proxies[i].id, proxies[j].id);
+					pairs.push_back(pairKey(a, b));
+				}
+			}
+		}
+		std::ranges::sort(pairs);
+		return pairs;
+	}
+
+	void checkPairs(Collision::SweepAndPrune& broadphase, const std::vector<Proxy>& proxies, uint32_t workers)
+	{
+		std::vector<uint64_t> found;
+		for (const auto& pair : broadphase.FindPairs(workers))
+		{
+			CHECK(pair.a < pair.b);
+			found.push_back(pairKey(pair.a, pair.b));
+		}
+		std::ranges::sort(found);
+		CHECK(std::adjacent_find(found.begin(), found.end()) == found.end());
+		CHECK(found == bruteForce(proxies));
+		CHECK(broadphase.Size() == proxies.size());
+	}
+
+	Box2D randomBox(std::mt19937& rng, int32_t extent)
+	{
+		std::uniform_int_distribution<int32_t> position(0, extent);
+		const auto left = static_cast<double>(position(rng));
+		const auto top = static_cast<double>(position(rng));
+		// Mostly small, some points and lines, a few long enough to reach across many others
+		const auto size = rng() % 16 == 0 ? 40 : 6;
+		const auto width = static_cast<double>(rng() % 4 == 0 ? 0 : rng() % size);
+		const auto height = static_cast<double>(rng() % 4 == 0 ? 0 : rng() % size);
+		return Box2D{ .left = left, .top = top, .right = left + width, .bottom = top + height };
+	}
+
+	Box2D moved(const Box2D& box, double dx, double dy)
+	{
+		return Box2D{ .left = box.left + dx, .top = box.top + dy, .right = box.right + dx, .bottom = box.bottom + dy };
+	}
+
+	void testFrames(uint32_t count, int32_t extent, uint32_t frames, uint32_t workers, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		Collision::SweepAndPrune broadphase;
+		std::vector<Proxy> proxies;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const auto bounds = randomBox(rng, extent);
+			proxies.push_back(Proxy{ .id = broadphase.Add(bounds), .bounds = bounds });
+		}
+		checkPairs(broadphase, proxies, workers);
+
+		std::uniform_int_distribution<int32_t> step(-2, 2);
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			for (auto& proxy : proxies)
+			{
+				const auto op = rng() % 32;
+				if (op < 12)
+				{
+					proxy.bounds = moved(proxy.bounds, step(rng), step(rng));
+				}
+				else if (op == 12)
+				{
+					proxy.bounds = randomBox(rng, extent);
+				}
+				else
+				{
+					continue;
+				}
+				broadphase.Update(proxy.id, proxy.bounds);
+			}
+
+			// Removed ids are only handed out again after the next FindPairs, so ids stay unique in between
+			for (uint32_t i = 0; i < count / 50 && !proxies.empty(); ++i)
+			{
+				const auto index = rng() % proxies.size();
+				broadphase.Remove(proxies[index].id);
+				proxies[index] = proxies.back();
+				proxies.pop_back();
+			}
+			for (uint32_t i = 0; i < count / 50; ++i)
+			{
+				const auto bounds = randomBox(rng, extent);
+				const auto id = broadphase.Add(bounds);
+				CHECK(std::ranges::none_of(proxies, [id](const Proxy& p) { return p.id == id; }));
+				proxies.push_back(Proxy{ .id = id, .bounds = bounds });
+			}
+			checkPairs(broadphase, proxies, workers);
+		}
+
+		// Updating or removing an id that is not alive changes nothing
+		broadphase.Update(count * 4, Box2D{ .left = 0.0, .top = 0.0, .right = 1.0e9, .bottom = 1.0e9 });
+		broadphase.Remove(count * 4);
+		if (!proxies.empty())
+		{
+			const auto id = proxies.back().id;
+			broadphase.Remove(id);
+			broadphase.Remove(id);
+			broadphase.Update(id, Box2D{ .left = 0.0, .top = 0.0, .right = 1.0e9, .bottom = 1.0e9 });
+			proxies.pop_back();
+		}
+		checkPairs(broadphase, proxies, workers);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::string_view(argv[i]) == "--seed")
+		{
+			seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		}
+	}
+
+	testFrames(600, 100, 40, 1, seed);
+	// Enough proxies for FindPairs to split the sweep over four workers
+	testFrames(17000, 1000, 1, 4, seed + 1);
+	return Test::result("BroadphaseTests");
+}
@@ -0,0 +1,165 @@
+// DescriptorAllocator persistent and transient regions. Freed persistent slots have to be handed out again before
+// the heap is exhausted, and freeing a slot twice or one that was never allocated has to throw. Transient runs have
+// to be contiguous and inside the region of the current frame slot, which BeginFrame empties again, and BeginFrame
+// has to throw while the fence value the slot was ended with has not completed.
+//
+//   DescriptorAllocatorTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include "TestCheck.h"
+
+import DescriptorAllocator;
+import FrameTimeline;
+
+namespace
+{
+	template<class Fn>
+	bool throws(Fn&& fn)
+	{
+		try
+		{
+			fn();
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void testFreeList()
+	{
+		LS::DescriptorAllocator allocator(8, 4);
+		CHECK(allocator.Capacity() == 8 + 4 * LS::MAX_FRAMES_IN_FLIGHT);
+
+		std::vector<uint32_t> slots;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			const auto slot = allocator.AllocatePersistent();
+			CHECK(slot == i);
+			slots.push_back(slot.value_or(0));
+		}
+		CHECK(!allocator.AllocatePersistent());
+		CHECK(allocator.PersistentUsed() == 8);
+
+		// The most recently freed slot comes back first, and only freed slots come back
+		allocator.FreePersistent(2);
+		allocator.FreePersistent(6);
+		CHECK(allocator.PersistentUsed() == 6);
+		CHECK(allocator.AllocatePersistent() == 6);
+		CHECK(allocator.AllocatePersistent() == 2);
+		CHECK(!allocator.AllocatePersistent());
+
+		// Freeing everything and allocating again reuses the same 8 slots
+		for (const auto slot : slots)
+		{
+			allocator.FreePersistent(slot);
+		}
+		CHECK(allocator.PersistentUsed() == 0);
+		std::vector<uint32_t> again;
+		while (const auto slot = allocator.AllocatePersistent())
+		{
+			again.push_back(*slot);
+		}
+		std::ranges::sort(again);
+		CHECK(again == slots);
+
+		CHECK(allocator.PersistentHighWaterMark() == 8);
+		const auto& stats = allocator.Stats();
+		CHECK(stats.persistentAllocations == 18);
+		CHECK(stats.persistentFrees == 10);
+		CHECK(stats.failedAllocations == 3);
+	}
+
+	void testDoubleFree()
+	{
+		LS::DescriptorAllocator allocator(4, 4);
+		const auto slot = allocator.AllocatePersistent().value_or(0);
+		allocator.FreePersistent(slot);
+		CHECK(throws([&] { allocator.FreePersistent(slot); }));
+		// Never allocated, outside the persistent region, and a transient slot
+		CHECK(throws([&] { allocator.FreePersistent(3); }));
+		CHECK(throws([&] { allocator.FreePersistent(4); }));
+		const auto transient = allocator.AllocateTransient().value_or(0);
+		CHECK(throws([&] { allocator.FreePersistent(transient); }));
+
+		// The failed frees left the free list intact
+		CHECK(allocator.PersistentUsed() == 0);
+		CHECK(allocator.Stats().persistentFrees == 1);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			CHECK(allocator.AllocatePersistent());
+		}
+		CHECK(!allocator.AllocatePersistent());
+	}
+
+	void testTransient()
+	{
+		constexpr uint32_t PERSISTENT = 5;
+		constexpr uint32_t PER_FRAME = 16;
+		LS::DescriptorAllocator allocator(PERSISTENT, PER_FRAME);
+		uint64_t fenceValue = 0;
+
+		for (uint32_t frame = 0; frame < 3 * LS::MAX_FRAMES_IN_FLIGHT; ++frame)
+		{
+			const auto slot = frame % LS::MAX_FRAMES_IN_FLIGHT;
+			// The GPU has finished everything but the last frame
+			allocator.BeginFrame(slot, fenceValue > 0 ? fenceValue - 1 : 0);
+			CHECK(allocator.TransientUsed() == 0);
+
+			const auto first = PERSISTENT + slot * PER_FRAME;
+			CHECK(allocator.AllocateTransient(3) == first);
+			CHECK(allocator.AllocateTransient(1) == first + 3);
+			CHECK(allocator.AllocateTransient(12) == first + 4);
+			CHECK(allocator.TransientUsed() == PER_FRAME);
+			CHECK(!allocator.AllocateTransient(1));
+			CHECK(!allocator.AllocateTransient(0));
+			allocator.EndFrame(++fenceValue);
+		}
+
+		// A run longer than what is left fails without using any of it
+		allocator.BeginFrame(0, fenceValue);
+		CHECK(allocator.AllocateTransient(10) == PERSISTENT);
+		CHECK(!allocator.AllocateTransient(7));
+		CHECK(allocator.AllocateTransient(6) == PERSISTENT + 10);
+		CHECK(allocator.TransientHighWaterMark() == PER_FRAME);
+		CHECK(allocator.Stats().transientAllocations == 3 * 3 * LS::MAX_FRAMES_IN_FLIGHT + 2);
+	}
+
+	void testBeginFrameFence()
+	{
+		LS::DescriptorAllocator allocator(0, 8);
+		allocator.BeginFrame(0, 0);
+		CHECK(allocator.AllocateTransient(8));
+		allocator.EndFrame(5);
+
+		// The slot's descriptors are still read by frame 5
+		CHECK(throws([&] { allocator.BeginFrame(0, 4); }));
+		// The failed BeginFrame did not drop them
+		CHECK(allocator.TransientUsed() == 8);
+
+		// Other slots were never ended and can begin
+		allocator.BeginFrame(1, 4);
+		CHECK(allocator.TransientUsed() == 0);
+		allocator.EndFrame(6);
+
+		allocator.BeginFrame(0, 5);
+		CHECK(allocator.TransientUsed() == 0);
+		CHECK(throws([&] { allocator.BeginFrame(1, 5); }));
+		CHECK(throws([&] { allocator.BeginFrame(LS::MAX_FRAMES_IN_FLIGHT, 100); }));
+	}
+}
+
+int main()
+{
+	testFreeList();
+	testDoubleFree();
+	testTransient();
+	testBeginFrameFence();
+	return Test::result("DescriptorAllocatorTests");
+}
@@ -0,0 +1,233 @@
+// CPU cost of the frame loop on the headless render backend, so it can be tracked on machines without a GPU.
+// Each case renders --frames frames after a warm up and reports the mean wall time per frame, split into the part
+// spent recording and submitting (the CPU frame cost) and the part spent in the simulated queue, plus the 50th
+// and 99th percentile frame times, how long the CPU blocked for a frame slot and how many frames were still queued
+// when a frame started. The rasterizing case runs at every frames in flight depth and in low latency mode. The draws
+// cases record growing numbers of draws on 1 to MAX_RECORDING_THREADS threads without rasterizing, for
+// --draw-frames frames each, so the CPU frame cost shows how recording scales with cores. Every case also reports
+// its time to first frame: device creation, which starts the asset loads, through the end of the first frame, which
+// waits for them.
+// Results go out as JSON lines (or CSV) on stdout or to --out; a readable table goes to stderr.
+//
+//   FrameBenchmarks [--frames N] [--warmup N] [--draw-frames N] [--width W] [--height H] [--format json|csv] [--out FILE]
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+import HeadlessDevice;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		uint32_t frames = 2000;
+		uint32_t warmup = 100;
+		uint32_t drawFrames = 100;
+		uint32_t width = 1280;
+		uint32_t height = 720;
+		std::string format = "json";
+		std::string out;
+	};
+
+	struct Result
+	{
+		std::string backend;
+		uint32_t framesInFlight = 0;
+		bool lowLatency = false;
+		uint32_t threads = 1;
+		uint32_t draws = 1;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint64_t frames = 0;
+		double firstFrameNs = 0.0;
+		double frameNs = 0.0;
+		double cpuNs = 0.0;
+		double queueNs = 0.0;
+		double p50Ns = 0.0;
+		double p99Ns = 0.0;
+		double commandsPerFrame = 0.0;
+		double stateChangesPerFrame = 0.0;// Emitted by the render queue replay, after sorting
+		double waitNs = 0.0;
+		double queueDepth = 0.0;
+		uint64_t fenceWaits = 0;
+		uint64_t checksum = 0;// Pixels written, lets runs be compared for equal work
+	};
+
+	struct Case
+	{
+		std::string_view name;
+		bool rasterize = true;
+		uint32_t framesInFlight = 3;
+		bool lowLatency = false;
+		uint32_t threads = 1;
+		uint32_t draws = 1;
+		uint32_t frames = 0;// 0 uses --frames
+	};
+
+	Result run(const Options& options, const Case& c)
+	{
+		const auto createStart = Clock::now();
+		LS::HeadlessDevice device(LS::HeadlessOptions{ .rasterize = c.rasterize });
+		device.CreateDevice(nullptr, options.width, options.height);
+		device.SetFramesInFlight(c.framesInFlight);
+		device.SetLowLatency(c.lowLatency);
+		const auto threads = device.SetRecordingThreads(c.threads);
+		device.SetDrawCount(c.draws);
+		const auto count = c.frames == 0 ? options.frames : c.frames;
+
+		// Clear color changes every frame so no frame is identical to the last
+		const auto color = [](uint32_t frame)
+			{
+				return LS::ColorRGBA{ .r = static_cast<float>(frame % 256) / 255.0f, .g = 0.2f, .b = 0.4f };
+			};
+		// The first frame always renders, as the first of the warm up
+		device.Render(color(0));
+		const auto firstFrameNs = std::chrono::duration<double, std::nano>(Clock::now() - createStart).count();
+		for (uint32_t i = 1; i < options.warmup; ++i)
+		{
+			device.Render(color(i));
+		}
+		device.ResetStats();
+		device.ResetTimelineStats();
+
+		std::vector<double> times(count);
+		const auto start = Clock::now();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const auto frameStart = Clock::now();
+			device.Render(color(i));
+			times[i] = std::chrono::duration<double, std::nano>(Clock::now() - frameStart).count();
+		}
+		const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		const auto stats = device.Stats();
+		const auto timeline = device.Timeline().Stats();
+		const auto queueStats = device.QueueStats();
+		device.OnDestroy();
+
+		std::sort(times.begin(), times.end());
+		const auto frames = static_cast<double>(count);
+		const auto queue = static_cast<double>(stats.queueNanoseconds);
+		return Result{ .backend = std::string(c.name), .framesInFlight = device.Timeline().FramesInFlight(),
+			.lowLatency = c.lowLatency, .threads = threads, .draws = c.draws, .width = options.width, .height = options.height,
+			.frames = count, .firstFrameNs = firstFrameNs, .frameNs = elapsed / frames, .cpuNs = (elapsed - queue) / frames,
+			.queueNs = queue / frames, .p50Ns = times[times.size() / 2], .p99Ns = times[times.size() * 99 / 100],
+			.commandsPerFrame = static_cast<double>(stats.commands) / frames,
+			.stateChangesPerFrame = static_cast<double>(queueStats.StateChanges()) / frames, .waitNs = timeline.AverageWaitNanoseconds(),
+			.queueDepth = timeline.AverageQueueDepth(), .fenceWaits = timeline.waits,
+			.checksum = stats.pixels };
+	}
+
+	void report(const Options& options, std::ostream& out, const Result& r)
+	{
+		if (options.format == "csv")
+		{
+			out << r.backend << ',' << r.framesInFlight << ',' << r.lowLatency << ',' << r.threads << ',' << r.draws << ',' << r.width << ',' << r.height << ','
+				<< r.frames << ',' << r.firstFrameNs << ',' << r.frameNs << ',' << r.cpuNs << ',' << r.queueNs << ',' << r.p50Ns << ',' << r.p99Ns << ','
+				<< r.commandsPerFrame << ',' << r.stateChangesPerFrame << ',' << r.waitNs << ',' << r.queueDepth << ',' << r.fenceWaits << ',' << r.checksum << '\n';
+		}
+		else
+		{
+			out << "{\"backend\":\"" << r.backend << "\",\"frames_in_flight\":" << r.framesInFlight
+				<< ",\"low_latency\":" << (r.lowLatency ? "true" : "false") << ",\"threads\":" << r.threads
+				<< ",\"draws\":" << r.draws << ",\"width\":" << r.width
+				<< ",\"height\":" << r.height << ",\"frames\":" << r.frames << ",\"first_frame_ns\":" << r.firstFrameNs << ",\"frame_ns\":" << r.frameNs << ",\"cpu_ns\":" << r.cpuNs
+				<< ",\"queue_ns\":" << r.queueNs << ",\"p50_ns\":" << r.p50Ns << ",\"p99_ns\":" << r.p99Ns
+				<< ",\"commands_per_frame\":" << r.commandsPerFrame << ",\"state_changes_per_frame\":" << r.stateChangesPerFrame
+				<< ",\"wait_ns\":" << r.waitNs
+				<< ",\"queue_depth\":" << r.queueDepth << ",\"fence_waits\":" << r.fenceWaits
+				<< ",\"checksum\":" << r.checksum << "}\n";
+		}
+		out.flush();
+
+		std::fprintf(stderr, "%-10s %6u %-3s %7u %7u %5ux%-5u %8llu %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f %6.2f\n",
+			r.backend.c_str(), r.framesInFlight, r.lowLatency ? "yes" : "no", r.threads, r.draws, r.width, r.height,
+			static_cast<unsigned long long>(r.frames), r.firstFrameNs, r.frameNs, r.cpuNs, r.queueNs, r.p50Ns, r.p99Ns, r.waitNs, r.queueDepth);
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const auto value = [&]() -> const char*
+				{
+					return i + 1 < argc ? argv[++i] : nullptr;
+				};
+			const char* v = nullptr;
+			if (arg == "--frames" && (v = value()))
+				options.frames = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--warmup" && (v = value()))
+				options.warmup = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--draw-frames" && (v = value()))
+				options.drawFrames = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--width" && (v = value()))
+				options.width = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--height" && (v = value()))
+				options.height = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--format" && (v = value()))
+				options.format = v;
+			else if (arg == "--out" && (v = value()))
+				options.out = v;
+			else
+			{
+				std::fprintf(stderr, "Unknown or incomplete option %s\n", argv[i]);
+				return false;
+			}
+		}
+		return options.frames > 0 && options.drawFrames > 0 && options.width > 0 && options.height > 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: FrameBenchmarks [--frames N] [--warmup N] [--draw-frames N] [--width W] [--height H] "
+			"[--format json|csv] [--out FILE]\n");
+		return 1;
+	}
+
+	std::ofstream file;
+	if (!options.out.empty())
+	{
+		file.open(options.out, std::ios::trunc);
+	}
+	auto& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+	if (options.format == "csv")
+	{
+		out << "backend,frames_in_flight,low_latency,threads,draws,width,height,frames,first_frame_ns,frame_ns,cpu_ns,queue_ns,p50_ns,p99_ns,"
+			"commands_per_frame,state_changes_per_frame,wait_ns,queue_depth,fence_waits,checksum\n";
+	}
+	std::fprintf(stderr, "%-10s %6s %-3s %7s %7s %11s %8s %12s %12s %12s %12s %12s %12s %12s %6s\n", "backend", "depth", "ll",
+		"threads", "draws", "size",
+		"frames", "first ns", "frame ns", "cpu ns", "queue ns", "p50 ns", "p99 ns", "wait ns", "queued");
+
+	// Recording only isolates the CPU side, rasterizing adds the simulated GPU work the CPU waits on
+	report(options, out, run(options, Case{ .name = "record", .rasterize = false }));
+	for (uint32_t framesInFlight = 1; framesInFlight <= LS::MAX_FRAMES_IN_FLIGHT; ++framesInFlight)
+	{
+		report(options, out, run(options, Case{ .name = "raster", .framesInFlight = framesInFlight }));
+	}
+	report(options, out, run(options, Case{ .name = "raster", .lowLatency = true }));
+
+	// Recording cost as the draw count grows, on every thread count
+	for (const uint32_t draws : { 1000u, 10000u, 100000u })
+	{
+		for (uint32_t threads = 1; threads <= LS::MAX_RECORDING_THREADS; threads *= 2)
+		{
+			report(options, out, run(options, Case{ .name = "draws", .rasterize = false, .threads = threads, .draws = draws,
+				.frames = options.drawFrames }));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,153 @@
+// forChunks and WorkerPool. Every element has to be visited exactly once whatever the split, chunks have to be
+// contiguous and in order, and an exception in any chunk has to come back on the calling thread only after every
+// chunk has run, the lowest chunk's one when several throw. The pool is reused for many calls in a row, is called
+// from inside its own chunks and from several threads at once, and has to keep giving the same answers.
+//
+//   ParallelTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TestCheck.h"
+
+import Parallel;
+
+namespace
+{
+	// Runs split(count, chunks, fn) and checks every element was visited once, by the chunk it belongs to
+	template <class Split>
+	void checkCoverage(Split&& split, size_t count, uint32_t chunks)
+	{
+		std::vector<std::atomic<uint32_t>> visits(count);
+		std::vector<size_t> begins(std::max(chunks, 1u), SIZE_MAX);
+		std::vector<size_t> ends(std::max(chunks, 1u), SIZE_MAX);
+		split(count, chunks, [&](size_t begin, size_t end, uint32_t chunk)
+			{
+				begins[chunk] = begin;
+				ends[chunk] = end;
+				for (auto i = begin; i < end; ++i)
+				{
+					++visits[i];
+				}
+			});
+
+		auto expected = size_t{ 0 };
+		for (size_t c = 0; c < begins.size(); ++c)
+		{
+			CHECK(begins[c] == expected);
+			CHECK(ends[c] >= begins[c] && ends[c] <= count);
+			expected = ends[c];
+		}
+		CHECK(expected == count);
+		for (const auto& v : visits)
+		{
+			CHECK(v == 1);
+		}
+	}
+
+	template <class Split>
+	void checkExceptions(Split&& split)
+	{
+		std::atomic<uint32_t> ran = 0;
+		try
+		{
+			split(100, 6, [&](size_t, size_t, uint32_t chunk)
+				{
+					++ran;
+					if (chunk == 2 || chunk == 4)
+						throw std::runtime_error(std::to_string(chunk));
+				});
+			CHECK(false);
+		}
+		catch (const std::runtime_error& error)
+		{
+			CHECK(std::string(error.what()) == "2");
+		}
+		CHECK(ran == 6);
+	}
+
+	void testForChunks()
+	{
+		const auto split = [](size_t count, uint32_t chunks, auto&& fn) { Parallel::forChunks(count, chunks, fn); };
+		for (const size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 1000 } })
+		{
+			for (const uint32_t chunks : { 0u, 1u, 3u, 8u })
+			{
+				checkCoverage(split, count, chunks);
+			}
+		}
+		checkExceptions(split);
+	}
+
+	void testWorkerPool()
+	{
+		Parallel::WorkerPool pool(3);
+		CHECK(pool.Threads() == 3);
+		const auto split = [&pool](size_t count, uint32_t chunks, auto&& fn) { pool.ForChunks(count, chunks, fn); };
+		for (const size_t count : { size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 1000 } })
+		{
+			// More chunks than threads as well, workers take several each
+			for (const uint32_t chunks : { 0u, 1u, 3u, 4u, 9u })
+			{
+				checkCoverage(split, count, chunks);
+			}
+		}
+		checkExceptions(split);
+
+		// The pool is still usable after a chunk threw, and stays correct over many calls in a row
+		for (int frame = 0; frame < 2000; ++frame)
+		{
+			std::atomic<size_t> sum = 0;
+			pool.ForChunks(64, 4, [&](size_t begin, size_t end, uint32_t)
+				{
+					for (auto i = begin; i < end; ++i)
+					{
+						sum += i;
+					}
+				});
+			CHECK(sum == 64 * 63 / 2);
+		}
+
+		// A call from inside a chunk runs on that thread instead of waiting for the busy pool
+		std::atomic<uint32_t> inner = 0;
+		pool.ForChunks(4, 4, [&](size_t, size_t, uint32_t)
+			{
+				pool.ForChunks(10, 5, [&](size_t begin, size_t end, uint32_t) { inner += static_cast<uint32_t>(end - begin); });
+			});
+		CHECK(inner == 40);
+
+		// Several threads sharing one pool
+		std::atomic<uint32_t> total = 0;
+		std::vector<std::thread> callers;
+		for (int t = 0; t < 4; ++t)
+		{
+			callers.emplace_back([&]()
+				{
+					for (int i = 0; i < 200; ++i)
+					{
+						pool.ForChunks(16, 4, [&](size_t begin, size_t end, uint32_t) { total += static_cast<uint32_t>(end - begin); });
+					}
+				});
+		}
+		for (auto& caller : callers)
+		{
+			caller.join();
+		}
+		CHECK(total == 4 * 200 * 16);
+
+		// One worker, the caller takes the chunks it does not get to
+		Parallel::WorkerPool single(1);
+		checkCoverage([&single](size_t count, uint32_t chunks, auto&& fn) { single.ForChunks(count, chunks, fn); }, 100, 5);
+	}
+}
+
+int main()
+{
+	testForChunks();
+	testWorkerPool();
+	return Test::result("ParallelTests");
+}
@@ -0,0 +1,165 @@
+// ContentHasher and PipelineCache. Hashes have to depend on how the input was split into Adds, not just on the
+// concatenated bytes, and entries have to come back exactly as stored. An entry file that is truncated, carries
+// another version or was stored under a different key has to be rejected as a miss, and the next Store has to
+// replace it.
+//
+//   PipelineCacheTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <span>
+#include "TestCheck.h"
+
+import PipelineCache;
+import MappedFile;
+
+namespace
+{
+	// Offset of the version in an entry file, after the magic and the byte order mark
+	constexpr size_t VERSION_OFFSET = 8;
+
+	std::vector<std::byte> payload(size_t size, uint32_t seed)
+	{
+		std::vector<std::byte> bytes(size);
+		for (size_t i = 0; i < size; ++i)
+		{
+			bytes[i] = static_cast<std::byte>((i * 31 + seed * 17) >> 2);
+		}
+		return bytes;
+	}
+
+	LS::CacheKey key(const char* name)
+	{
+		return LS::ContentHasher().Add(name).Finish();
+	}
+
+	std::vector<std::byte> readFile(const std::filesystem::path& path)
+	{
+		const Data::MappedFile file(path);
+		const auto bytes = file.Bytes();
+		return { bytes.begin(), bytes.end() };
+	}
+
+	bool matches(const std::optional<LS::CachedBlob>& blob, std::span<const std::byte> expected)
+	{
+		return blob && blob->Size() == expected.size() &&
+			(expected.empty() || std::memcmp(blob->Data(), expected.data(), expected.size()) == 0);
+	}
+
+	void testHasher()
+	{
+		// Every Add is length prefixed, so splitting the same bytes differently gives a different key
+		CHECK(LS::ContentHasher().Add("ab").Add("c").Finish() != LS::ContentHasher().Add("a").Add("bc").Finish());
+		CHECK(LS::ContentHasher().Add("abc").Finish() != LS::ContentHasher().Add("ab").Add("c").Finish());
+		CHECK(LS::ContentHasher().Add("").Add("a").Finish() != LS::ContentHasher().Add("a").Add("").Finish());
+		CHECK(LS::ContentHasher().Add("").Finish() != LS::ContentHasher().Finish());
+
+		// The same input always gives the same key, whatever lengths the words and tails come in
+		for (size_t size = 0; size < 40; ++size)
+		{
+			const auto bytes = payload(size, 1);
+			const auto a = LS::ContentHasher().Add(bytes).AddValue(uint32_t{ 7 }).Finish();
+			const auto b = LS::ContentHasher().Add(bytes).AddValue(uint32_t{ 7 }).Finish();
+			CHECK(a == b);
+			CHECK(a != LS::ContentHasher().Add(bytes).AddValue(uint32_t{ 8 }).Finish());
+			if (size > 0)
+			{
+				auto changed = bytes;
+				changed[size / 2] ^= std::byte{ 1 };
+				CHECK(a != LS::ContentHasher().Add(changed).AddValue(uint32_t{ 7 }).Finish());
+			}
+		}
+
+		const auto text = key("pipeline").ToString();
+		CHECK(text.size() == 32);
+		CHECK(text.find_first_not_of("0123456789abcdef") == std::string::npos);
+	}
+
+	void testRoundTrip(const std::filesystem::path& directory)
+	{
+		LS::PipelineCache cache(directory);
+		CHECK(!cache.Find(key("missing")));
+
+		for (const size_t size : { size_t{ 0 }, size_t{ 1 }, size_t{ 15 }, size_t{ 16 }, size_t{ 4099 } })
+		{
+			const auto name = "entry" + std::to_string(size);
+			const auto bytes = payload(size, static_cast<uint32_t>(size));
+			CHECK(cache.Store(key(name.c_str()), bytes));
+			CHECK(matches(cache.Find(key(name.c_str())), bytes));
+			// A second cache on the same directory finds it too, as the next run would
+			CHECK(matches(LS::PipelineCache(directory).Find(key(name.c_str())), bytes));
+		}
+
+		// Storing again replaces the entry
+		const auto replaced = payload(64, 9);
+		CHECK(cache.Store(key("entry16"), replaced));
+		CHECK(matches(cache.Find(key("entry16")), replaced));
+
+		const auto stats = cache.Stats();
+		CHECK(stats.stores == 6);
+		CHECK(stats.hits == 6);
+		CHECK(stats.misses == 1);
+		CHECK(stats.rejected == 0);
+	}
+
+	void testRejects(const std::filesystem::path& directory)
+	{
+		LS::PipelineCache cache(directory);
+		const auto bytes = payload(256, 3);
+		const auto good = key("good");
+		CHECK(cache.Store(good, bytes));
+		const auto entry = readFile(cache.Path(good));
+		CHECK(entry.size() > bytes.size());
+
+		// Cut anywhere, in the header or the payload
+		for (const auto size : { entry.size() - 1, entry.size() - bytes.size(), size_t{ 8 } })
+		{
+			CHECK(Data::writeFile(cache.Path(good), std::span(entry).first(size)));
+			CHECK(!cache.Find(good));
+		}
+
+		// Another version
+		auto other = entry;
+		other[VERSION_OFFSET] ^= std::byte{ 0xff };
+		CHECK(Data::writeFile(cache.Path(good), other));
+		CHECK(!cache.Find(good));
+
+		// A payload byte that changed on disk
+		other = entry;
+		other.back() ^= std::byte{ 1 };
+		CHECK(Data::writeFile(cache.Path(good), other));
+		CHECK(!cache.Find(good));
+
+		// The right file under the name of another key
+		const auto wrong = key("wrong");
+		CHECK(Data::writeFile(cache.Path(wrong), entry));
+		CHECK(!cache.Find(wrong));
+
+		CHECK(cache.Stats().rejected == 6);
+		CHECK(cache.Stats().hits == 0);
+
+		// The next Store replaces a rejected entry
+		CHECK(cache.Store(good, bytes));
+		CHECK(matches(cache.Find(good), bytes));
+		CHECK(cache.Store(wrong, bytes));
+		CHECK(matches(cache.Find(wrong), bytes));
+	}
+}
+
+int main()
+{
+	const auto directory = std::filesystem::temp_directory_path() / "PipelineCacheTests";
+	std::filesystem::remove_all(directory);
+
+	testHasher();
+	testRoundTrip(directory / "roundtrip");
+	testRejects(directory / "rejects");
+
+	std::filesystem::remove_all(directory);
+	return Test::result("PipelineCacheTests");
+}
@@ -0,0 +1,256 @@
+// Round trip of QuadTree snapshots. A tree is built, edited so its node, item and block free lists are in use, and
+// serialized; the snapshot is queried in place through QuadTreeView, read back with Load and mapped from a file, and
+// every Query, Nearest, Raycast, Contains, Get and Position answer has to match the original tree. The loaded tree
+// then takes the same further edits as the original and has to keep matching it. Last, every 32 bit word of the
+// snapshot is overwritten in turn with values that break links: the snapshot has to be rejected or stay safe to
+// query, load and edit (run it under a sanitizer to see the latter), and truncated, misaligned and mistyped
+// snapshots have to be rejected.
+//
+//   QuadTreeSnapshotTests [--seed N]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <span>
+#include "TestCheck.h"
+
+import QuadTree;
+import MappedFile;
+
+namespace
+{
+	constexpr float REGION_SIZE = 1000.0f;
+	const Data::Box REGION{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { REGION_SIZE, REGION_SIZE } };
+
+	Data::Point randomPoint(std::mt19937& rng)
+	{
+		// Half the points in a few tight clusters so the tree gets deep in places
+		std::uniform_real_distribution<float> any(0.0f, REGION_SIZE);
+		if (rng() % 2 == 0)
+			return Data::Point{ .x = any(rng), .y = any(rng) };
+
+		const auto cluster = static_cast<float>(rng() % 4) * 200.0f + 100.0f;
+		std::uniform_real_distribution<float> near(-4.0f, 4.0f);
+		return Data::Point{ .x = cluster + near(rng), .y = cluster + near(rng) };
+	}
+
+	Data::Box randomBox(std::mt19937& rng)
+	{
+		const auto a = randomPoint(rng);
+		const auto b = randomPoint(rng);
+		return Data::Box{ .minPoint = { std::min(a.x, b.x), std::min(a.y, b.y) }, .maxPoint = { std::max(a.x, b.x), std::max(a.y, b.y) } };
+	}
+
+	// Random inserts, removes and moves, the same on every tree given the same seed
+	void edit(Data::QuadTree<int>& tree, std::vector<Data::Handle>& handles, uint32_t steps, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		for (uint32_t step = 0; step < steps; ++step)
+		{
+			const auto op = rng() % 10;
+			if (op < 5 || handles.empty())
+			{
+				const auto handle = tree.Insert(static_cast<int>(step), randomPoint(rng));
+				if (handle != Data::INVALID_HANDLE)
+				{
+					handles.push_back(handle);
+				}
+			}
+			else if (op < 8)
+			{
+				const auto i = rng() % handles.size();
+				tree.Remove(handles[i]);
+				handles[i] = handles.back();
+				handles.pop_back();
+			}
+			else
+			{
+				tree.Move(handles[rng() % handles.size()], randomPoint(rng));
+			}
+		}
+	}
+
+	// Every answer of test has to be the one reference gives, itemCount bounds the handles to try
+	template <class Reference, class Subject>
+	void compare(const Reference& reference, const Subject& test, uint32_t itemCount, uint32_t seed)
+	{
+		CHECK(test.Size() == reference.Size());
+		CHECK(std::memcmp(&test.Region(), &reference.Region(), sizeof(Data::Box)) == 0);
+		for (Data::Handle h = 0; h < itemCount + 4; ++h)
+		{
+			CHECK(test.Contains(h) == reference.Contains(h));
+			if (reference.Contains(h) && test.Contains(h))
+			{
+				CHECK(test.Get(h) == reference.Get(h));
+				const auto position = test.Position(h);
+				const auto expected = reference.Position(h);
+				CHECK(std::memcmp(&position, &expected, sizeof(Data::Point)) == 0);
+			}
+		}
+
+		std::mt19937 rng(seed);
+		for (int i = 0; i < 200; ++i)
+		{
+			const auto box = randomBox(rng);
+			CHECK(test.Query(box) == reference.Query(box));
+
+			const auto p = randomPoint(rng);
+			const auto k = static_cast<uint32_t>(rng() % 16 + 1);
+			CHECK(test.Nearest(p, k) == reference.Nearest(p, k));
+
+			const auto to = randomPoint(rng);
+			const auto length = std::hypot(to.x - p.x, to.y - p.y);
+			if (length > 0.0f)
+			{
+				const Data::Point dir{ .x = (to.x - p.x) / length, .y = (to.y - p.y) / length };
+				const auto expected = reference.Raycast(p, dir, length, 2.0f);
+				const auto hit = test.Raycast(p, dir, length, 2.0f);
+				CHECK(hit.has_value() == expected.has_value());
+				if (hit && expected)
+				{
+					CHECK(hit->handle == expected->handle && hit->distance == expected->distance);
+				}
+			}
+		}
+	}
+
+	// A corrupt snapshot that is still accepted must be safe to use
+	void exercise(std::span<const std::byte> snapshot)
+	{
+		std::mt19937 rng(7);
+		if (const auto view = Data::QuadTreeView<int>::Open(snapshot))
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				view->Query(randomBox(rng));
+				view->Nearest(randomPoint(rng), 8);
+				view->Raycast(randomPoint(rng), Data::Point{ .x = 0.6f, .y = 0.8f }, REGION_SIZE, 2.0f);
+			}
+		}
+		if (auto tree = Data::QuadTree<int>::Load(snapshot))
+		{
+			std::vector<Data::Handle> handles;
+			for (Data::Handle h = 0; h < 64; ++h)
+			{
+				if (tree->Contains(h))
+				{
+					handles.push_back(h);
+				}
+			}
+			edit(*tree, handles, 64, 8);
+			tree->Query(REGION);
+		}
+	}
+
+	void testRoundTrip(float looseness, uint32_t seed)
+	{
+		Data::QuadTree<int> tree(REGION, 8, looseness);
+		std::vector<Data::Handle> handles;
+		edit(tree, handles, 6000, seed);
+		auto itemCount = static_cast<uint32_t>(handles.size());
+		for (const auto h : handles)
+		{
+			itemCount = std::max(itemCount, h + 1);
+		}
+
+		const auto snapshot = tree.Serialize();
+		const auto view = Data::QuadTreeView<int>::Open(snapshot);
+		CHECK(view.has_value());
+		if (view)
+		{
+			compare(tree, *view, itemCount, seed + 1);
+		}
+
+		auto loaded = Data::QuadTree<int>::Load(snapshot);
+		CHECK(loaded.has_value());
+		if (loaded)
+		{
+			compare(tree, *loaded, itemCount, seed + 2);
+			// Same edits on both, the loaded free lists have to hand out the same handles
+			auto loadedHandles = handles;
+			edit(tree, handles, 2000, seed + 3);
+			edit(*loaded, loadedHandles, 2000, seed + 3);
+			CHECK(handles == loadedHandles);
+			compare(tree, *loaded, itemCount + 2000, seed + 4);
+			CHECK(loaded->Serialize() == tree.Serialize());
+		}
+
+		const auto path = std::filesystem::temp_directory_path() / "QuadTreeSnapshotTests.bin";
+		const auto bytes = tree.Serialize();
+		CHECK(Data::writeFile(path, bytes));
+		{
+			const Data::MappedFile file(path);
+			const auto mapped = Data::QuadTreeView<int>::Open(file.Bytes());
+			CHECK(mapped.has_value());
+			if (mapped)
+			{
+				compare(tree, *mapped, itemCount + 2000, seed + 5);
+			}
+		}
+		std::filesystem::remove(path);
+	}
+
+	void testRejects(uint32_t seed)
+	{
+		Data::QuadTree<int> tree(REGION, 4, 1.25f);
+		std::vector<Data::Handle> handles;
+		edit(tree, handles, 400, seed);
+		const auto snapshot = tree.Serialize();
+		CHECK(Data::QuadTreeView<int>::Open(snapshot).has_value());
+
+		// Truncated, misaligned and the wrong payload type
+		CHECK(!Data::QuadTreeView<int>::Open(std::span(snapshot).first(snapshot.size() - 1)));
+		CHECK(!Data::QuadTree<int>::Load(std::span(snapshot).first(snapshot.size() / 2)));
+		std::vector<std::byte> shifted(snapshot.size() + 16);
+		std::memcpy(shifted.data() + 4, snapshot.data(), snapshot.size());
+		CHECK(!Data::QuadTreeView<int>::Open(std::span(shifted).subspan(4, snapshot.size())));
+		CHECK(!Data::QuadTreeView<uint64_t>::Open(snapshot));
+		CHECK(!Data::QuadTree<double>::Load(snapshot));
+
+		// Every word set to values that point outside the arrays, at the wrong element or back into a list
+		auto rejected = 0;
+		auto corrupt = snapshot;
+		for (size_t offset = 0; offset + sizeof(uint32_t) <= snapshot.size(); offset += sizeof(uint32_t))
+		{
+			uint32_t original;
+			std::memcpy(&original, snapshot.data() + offset, sizeof(original));
+			for (const uint32_t value : { 0xFFFFFFFEu, 0x7FFFFFFFu, original + 1, original - 1, 0u, 1u })
+			{
+				if (value == original)
+					continue;
+				std::memcpy(corrupt.data() + offset, &value, sizeof(value));
+				const auto accepted = Data::QuadTreeView<int>::Open(corrupt).has_value();
+				CHECK(accepted == Data::QuadTree<int>::Load(corrupt).has_value());
+				rejected += accepted ? 0 : 1;
+				exercise(corrupt);
+			}
+			std::memcpy(corrupt.data() + offset, &original, sizeof(original));
+		}
+		CHECK(rejected > 0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t seed = 1;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::string_view(argv[i]) == "--seed")
+		{
+			seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		}
+	}
+
+	testRoundTrip(1.0f, seed);
+	testRoundTrip(1.5f, seed + 10);
+	testRejects(seed + 20);
+	return Test::result("QuadTreeSnapshotTests");
+}
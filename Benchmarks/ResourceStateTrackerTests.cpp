@@ -0,0 +1,252 @@
+// ResourceStateTracker barrier output. Short streams of state requests are recorded against a command list stand-in
+// that keeps every ResourceBarrier call, and the calls have to come out as D3D12 would need them: reads requested
+// together fold into one transition to the combined read state, requests for the state a resource is already in
+// make no barrier, a resource taken through a write and back ends where it started, and each flush with anything
+// pending is exactly one ResourceBarrier with all of its transitions in request order. The test is built with
+// _DEBUG whatever the configuration, so the validation the tracker only does in debug builds is checked too.
+//
+//   ResourceStateTrackerTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <span>
+#include <stdexcept>
+#include "TestCheck.h"
+
+import ResourceStateTracker;
+
+namespace
+{
+	// The D3D12_RESOURCE_STATES values the streams use
+	constexpr uint32_t COMMON = 0;
+	constexpr uint32_t VERTEX_AND_CONSTANT_BUFFER = 0x1;
+	constexpr uint32_t RENDER_TARGET = 0x4;
+	constexpr uint32_t UNORDERED_ACCESS = 0x8;
+	constexpr uint32_t NON_PIXEL_SHADER_RESOURCE = 0x40;
+	constexpr uint32_t PIXEL_SHADER_RESOURCE = 0x80;
+	constexpr uint32_t COPY_DEST = 0x400;
+	constexpr uint32_t COPY_SOURCE = 0x800;
+	constexpr uint32_t WRITE_STATES = RENDER_TARGET | UNORDERED_ACCESS | COPY_DEST;
+
+	// Keeps the transitions of every ResourceBarrier call
+	struct CommandList
+	{
+		std::vector<std::vector<LS::ResourceTransition>> barriers;
+
+		uint32_t Flush(LS::ResourceStateTracker& tracker)
+		{
+			return tracker.Flush([&](std::span<const LS::ResourceTransition> transitions)
+			{
+				barriers.emplace_back(transitions.begin(), transitions.end());
+			});
+		}
+	};
+
+	bool is(const LS::ResourceTransition& transition, uint32_t resource, uint32_t before, uint32_t after)
+	{
+		return transition.resource == resource && transition.before == before && transition.after == after;
+	}
+
+	template<class Fn>
+	bool throws(Fn&& fn)
+	{
+		try
+		{
+			fn();
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void testCombinedReads()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		tracker.Track(0, COPY_DEST);
+
+		// A texture read by both shader stages after its upload
+		tracker.Require(0, PIXEL_SHADER_RESOURCE);
+		tracker.Require(0, NON_PIXEL_SHADER_RESOURCE);
+		tracker.Require(0, PIXEL_SHADER_RESOURCE);
+		CHECK(tracker.State(0) == (PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE));
+		CHECK(list.Flush(tracker) == 1);
+		CHECK(list.barriers.size() == 1);
+		CHECK(list.barriers[0].size() == 1);
+		CHECK(is(list.barriers[0][0], 0, COPY_DEST, PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE));
+
+		// Either read alone is covered by the combined state
+		tracker.Require(0, NON_PIXEL_SHADER_RESOURCE);
+		tracker.Require(0, PIXEL_SHADER_RESOURCE);
+		CHECK(tracker.Pending().empty());
+		CHECK(list.Flush(tracker) == 0);
+
+		// A read outside it needs one more transition, from the combined state
+		tracker.Require(0, COPY_SOURCE);
+		CHECK(list.Flush(tracker) == 1);
+		CHECK(list.barriers.size() == 2);
+		CHECK(is(list.barriers[1][0], 0, PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE, COPY_SOURCE));
+
+		const auto& stats = tracker.Stats();
+		CHECK(stats.requests == 6);
+		CHECK(stats.elided == 4);
+		CHECK(stats.transitions == 2);
+		CHECK(stats.flushes == 2);
+	}
+
+	void testSameState()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		tracker.Track(0, RENDER_TARGET);
+		tracker.Track(1, VERTEX_AND_CONSTANT_BUFFER);
+		tracker.Track(2, COMMON);
+
+		tracker.Require(0, RENDER_TARGET);
+		tracker.Require(1, VERTEX_AND_CONSTANT_BUFFER);
+		tracker.Require(2, COMMON);
+		tracker.Require(0, RENDER_TARGET);
+		CHECK(tracker.Pending().empty());
+		CHECK(list.Flush(tracker) == 0);
+		CHECK(list.barriers.empty());
+		CHECK(tracker.Stats().requests == 4);
+		CHECK(tracker.Stats().elided == 4);
+		CHECK(tracker.Stats().flushes == 0);
+
+		tracker.ResetStats();
+		CHECK(tracker.Stats().requests == 0);
+	}
+
+	void testRoundTrip()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		tracker.Track(0, PIXEL_SHADER_RESOURCE);
+
+		// Rendered to, then sampled again: two barriers that undo each other
+		tracker.Require(0, RENDER_TARGET);
+		CHECK(list.Flush(tracker) == 1);
+		tracker.Require(0, RENDER_TARGET);
+		tracker.Require(0, PIXEL_SHADER_RESOURCE);
+		CHECK(list.Flush(tracker) == 1);
+		CHECK(tracker.State(0) == PIXEL_SHADER_RESOURCE);
+		CHECK(list.barriers.size() == 2);
+		CHECK(is(list.barriers[0][0], 0, PIXEL_SHADER_RESOURCE, RENDER_TARGET));
+		CHECK(is(list.barriers[1][0], 0, RENDER_TARGET, PIXEL_SHADER_RESOURCE));
+
+#ifdef _DEBUG
+		// Without a flush in between the draw would be recorded with the resource in the wrong state
+		tracker.Require(0, RENDER_TARGET);
+		CHECK(throws([&] { tracker.Require(0, PIXEL_SHADER_RESOURCE); }));
+		CHECK(list.Flush(tracker) == 1);
+		CHECK(tracker.State(0) == RENDER_TARGET);
+#else
+		// Release builds fold the two into a transition back to where it started, which needs no barrier
+		tracker.Require(0, RENDER_TARGET);
+		tracker.Require(0, PIXEL_SHADER_RESOURCE);
+		CHECK(tracker.Pending().size() == 1);
+		CHECK(list.Flush(tracker) == 0);
+		CHECK(tracker.State(0) == PIXEL_SHADER_RESOURCE);
+#endif
+	}
+
+	void testOneBarrierPerFlush()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		for (uint32_t resource = 0; resource < 6; ++resource)
+		{
+			tracker.Track(resource, COMMON);
+		}
+
+		// Resources requested out of order, one of them already in its state and one asked twice
+		tracker.Require(4, COPY_DEST);
+		tracker.Require(1, PIXEL_SHADER_RESOURCE);
+		tracker.Require(5, COMMON);
+		tracker.Require(0, UNORDERED_ACCESS);
+		tracker.Require(1, NON_PIXEL_SHADER_RESOURCE);
+		CHECK(tracker.Pending().size() == 3);
+		CHECK(list.Flush(tracker) == 3);
+		CHECK(list.barriers.size() == 1);
+		CHECK(list.barriers[0].size() == 3);
+		CHECK(is(list.barriers[0][0], 4, COMMON, COPY_DEST));
+		CHECK(is(list.barriers[0][1], 1, COMMON, PIXEL_SHADER_RESOURCE | NON_PIXEL_SHADER_RESOURCE));
+		CHECK(is(list.barriers[0][2], 0, COMMON, UNORDERED_ACCESS));
+
+		tracker.Require(4, COPY_SOURCE);
+		tracker.Require(0, COMMON);
+		CHECK(list.Flush(tracker) == 2);
+		CHECK(list.barriers.size() == 2);
+		CHECK(list.barriers[1].size() == 2);
+		CHECK(is(list.barriers[1][0], 4, COPY_DEST, COPY_SOURCE));
+		CHECK(is(list.barriers[1][1], 0, UNORDERED_ACCESS, COMMON));
+		CHECK(tracker.Pending().empty());
+
+		CHECK(tracker.Stats().flushes == 2);
+		CHECK(tracker.Stats().transitions == 5);
+	}
+
+	void testTracking()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		CHECK(!tracker.IsTracked(0));
+		tracker.Track(3, COPY_SOURCE);
+		CHECK(tracker.IsTracked(3));
+		CHECK(!tracker.IsTracked(2));
+		CHECK(tracker.State(3) == COPY_SOURCE);
+		tracker.Untrack(3);
+		CHECK(!tracker.IsTracked(3));
+
+		// Tracking again starts from the state given, whatever the resource was in before
+		tracker.Track(3, RENDER_TARGET);
+		tracker.Require(3, RENDER_TARGET);
+		CHECK(list.Flush(tracker) == 0);
+	}
+
+#ifdef _DEBUG
+	void testValidation()
+	{
+		LS::ResourceStateTracker tracker(WRITE_STATES);
+		CommandList list;
+		tracker.Track(0, COMMON);
+		tracker.Track(2, COMMON);
+
+		CHECK(throws([&] { tracker.Require(1, COPY_SOURCE); }));
+		CHECK(throws([&] { tracker.Require(7, COPY_SOURCE); }));
+		CHECK(throws([&] { tracker.State(1); }));
+
+		// Write states cannot be combined, with reads or with each other
+		CHECK(throws([&] { tracker.Require(0, RENDER_TARGET | PIXEL_SHADER_RESOURCE); }));
+		CHECK(throws([&] { tracker.Require(0, RENDER_TARGET | COPY_DEST); }));
+		CHECK(!throws([&] { tracker.Require(0, COPY_SOURCE | PIXEL_SHADER_RESOURCE); }));
+
+		// A read over a pending write and a write over a pending read
+		tracker.Require(2, COPY_DEST);
+		CHECK(throws([&] { tracker.Require(2, COPY_SOURCE); }));
+		CHECK(throws([&] { tracker.Require(0, UNORDERED_ACCESS); }));
+
+		// Untracking a resource whose transition was not flushed loses the barrier
+		CHECK(throws([&] { tracker.Untrack(2); }));
+		CHECK(list.Flush(tracker) == 2);
+		CHECK(!throws([&] { tracker.Untrack(2); }));
+		CHECK(throws([&] { tracker.Require(2, COMMON); }));
+	}
+#endif
+}
+
+int main()
+{
+	testCombinedReads();
+	testSameState();
+	testRoundTrip();
+	testOneBarrierPerFlush();
+	testTracking();
+#ifdef _DEBUG
+	testValidation();
+#endif
+	return Test::result("ResourceStateTrackerTests");
+}
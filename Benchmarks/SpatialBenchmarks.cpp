@@ -0,0 +1,517 @@
+// Benchmarks for the platform neutral spatial structures: QuadTree, SpatialHashGrid and the SweepAndPrune broadphase.
+// Every case reports ns/op, heap allocations made during the operation, the peak of live heap bytes and the
+// process peak RSS. Results go out as JSON lines (or CSV) on stdout or to --out; a readable table goes to stderr.
+//
+//   SpatialBenchmarks [--min N] [--max N] [--queries Q] [--adversarial-max N] [--broadphase-max N] [--filter TEXT]
+//                     [--format json|csv] [--out FILE] [--seed S]
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
+import SpatialIndex;
+import Broadphase;
+
+// Heap accounting. Every allocation carries its size in a small header so frees can keep the live byte count.
+namespace
+{
+	constexpr size_t ALLOC_HEADER = alignof(std::max_align_t);
+
+	std::atomic<uint64_t> g_allocations{ 0 };
+	std::atomic<uint64_t> g_allocatedBytes{ 0 };
+	std::atomic<int64_t> g_liveBytes{ 0 };
+	std::atomic<int64_t> g_peakLiveBytes{ 0 };
+
+	void* countedAlloc(size_t size)
+	{
+		auto* block = static_cast<unsigned char*>(std::malloc(size + ALLOC_HEADER));
+		if (!block)
+			throw std::bad_alloc();
+
+		std::memcpy(block, &size, sizeof(size));
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		const auto live = g_liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) + static_cast<int64_t>(size);
+		auto peak = g_peakLiveBytes.load(std::memory_order_relaxed);
+		while (live > peak && !g_peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		{
+		}
+		return block + ALLOC_HEADER;
+	}
+
+	void countedFree(void* p)
+	{
+		if (!p)
+			return;
+
+		auto* block = static_cast<unsigned char*>(p) - ALLOC_HEADER;
+		size_t size;
+		std::memcpy(&size, block, sizeof(size));
+		g_liveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+		std::free(block);
+	}
+}
+
+void* operator new(size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	countedFree(p);
+}
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr float WORLD_SIZE = 10000.0f;
+	const Data::Box WORLD = Data::Box{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { WORLD_SIZE, WORLD_SIZE } };
+
+	enum class DISTRIBUTION
+	{
+		UNIFORM,
+		CLUSTERED,
+		ADVERSARIAL
+	};
+
+	const char* distributionName(DISTRIBUTION distribution)
+	{
+		switch (distribution)
+		{
+		case DISTRIBUTION::CLUSTERED:
+			return "clustered";
+		case DISTRIBUTION::ADVERSARIAL:
+			return "adversarial";
+		case DISTRIBUTION::UNIFORM:
+		default:
+			return "uniform";
+		}
+	}
+
+	struct Options
+	{
+		uint64_t minSize = 1000;
+		uint64_t maxSize = 10000000;
+		// Adversarial inputs pile most points into a few max depth leaves or cells, where the structures degrade
+		// on purpose; past this size a run would take minutes rather than seconds
+		uint64_t adversarialMax = 100000;
+		// The sweep and prune broadphase keeps every proxy in one sorted array and reports every pair
+		uint64_t broadphaseMax = 1000000;
+		uint32_t queries = 10000;
+		uint32_t seed = 1234;
+		std::string filter;
+		std::string format = "json";
+		std::string out;
+	};
+
+	struct Result
+	{
+		std::string structure;
+		std::string distribution;
+		uint64_t size = 0;
+		std::string op;
+		uint64_t ops = 0;
+		double nsPerOp = 0.0;
+		uint64_t allocations = 0;
+		uint64_t allocatedBytes = 0;
+		int64_t peakHeapBytes = 0;
+		uint64_t peakRssKb = 0;
+		uint64_t checksum = 0;// Keeps results observable and lets runs be compared for equal work
+	};
+
+	uint64_t peakRssKb()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters{};
+		GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+		return counters.PeakWorkingSetSize / 1024;
+#else
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+		return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+#else
+		return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+	}
+
+	std::vector<Data::Point> makePoints(DISTRIBUTION distribution, uint64_t count, uint32_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		std::uniform_real_distribution<float> uniform(0.0f, WORLD_SIZE);
+		std::vector<Data::Point> points(count);
+
+		switch (distribution)
+		{
+		case DISTRIBUTION::UNIFORM:
+			for (auto& p : points)
+			{
+				p = Data::Point{ uniform(rng), uniform(rng) };
+			}
+			break;
+		case DISTRIBUTION::CLUSTERED:
+		{
+			// Gaussian blobs around 64 random centres
+			std::vector<Data::Point> centres(64);
+			for (auto& c : centres)
+			{
+				c = Data::Point{ uniform(rng), uniform(rng) };
+			}
+			std::normal_distribution<float> spread(0.0f, WORLD_SIZE / 200.0f);
+			for (auto& p : points)
+			{
+				const auto& c = centres[rng() % centres.size()];
+				p = Data::Point{ std::clamp(c.x + spread(rng), 0.0f, WORLD_SIZE), std::clamp(c.y + spread(rng), 0.0f, WORLD_SIZE) };
+			}
+			break;
+		}
+		case DISTRIBUTION::ADVERSARIAL:
+		{
+			// Nine tenths are duplicates of 16 spots that lie on quadrant split lines, the rest sit on the centre line:
+			// leaves bottom out at max depth and hold long block chains, hash cells overflow
+			std::vector<Data::Point> spots;
+			for (int i = 1; i <= 4; ++i)
+			{
+				for (int j = 1; j <= 4; ++j)
+				{
+					spots.emplace_back(Data::Point{ WORLD_SIZE * i / 8.0f, WORLD_SIZE * j / 8.0f });
+				}
+			}
+			for (auto& p : points)
+			{
+				if (rng() % 10 != 0)
+				{
+					p = spots[rng() % spots.size()];
+				}
+				else
+				{
+					p = Data::Point{ WORLD_SIZE * 0.5f, uniform(rng) };
+				}
+			}
+			break;
+		}
+		}
+		return points;
+	}
+
+	// Query boxes sized to hold about 16 points of a uniform distribution, centred on random points of the input
+	std::vector<Data::Box> makeQueries(const std::vector<Data::Point>& points, uint32_t count, uint32_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		const auto half = 0.5f * WORLD_SIZE * std::sqrt(16.0f / static_cast<float>(points.size()));
+		std::vector<Data::Box> boxes(count);
+		for (auto& box : boxes)
+		{
+			const auto& c = points[rng() % points.size()];
+			box = Data::Box{ .minPoint = { c.x - half, c.y - half }, .maxPoint = { c.x + half, c.y + half } };
+		}
+		return boxes;
+	}
+
+	class Reporter
+	{
+	public:
+		explicit Reporter(const Options& options) : m_options(options)
+		{
+			if (!options.out.empty())
+			{
+				m_file.open(options.out, std::ios::trunc);
+			}
+			if (m_options.format == "csv")
+			{
+				stream() << "structure,distribution,size,op,ops,ns_per_op,allocations,allocated_bytes,peak_heap_bytes,peak_rss_kb,checksum\n";
+			}
+			std::fprintf(stderr, "%-12s %-12s %10s %-8s %12s %12s %14s %12s\n",
+				"structure", "distribution", "size", "op", "ns/op", "allocs", "peak heap", "peak rss kb");
+		}
+
+		void Report(const Result& r)
+		{
+			auto& out = stream();
+			if (m_options.format == "csv")
+			{
+				out << r.structure << ',' << r.distribution << ',' << r.size << ',' << r.op << ',' << r.ops << ','
+					<< r.nsPerOp << ',' << r.allocations << ',' << r.allocatedBytes << ',' << r.peakHeapBytes << ','
+					<< r.peakRssKb << ',' << r.checksum << '\n';
+			}
+			else
+			{
+				out << "{\"structure\":\"" << r.structure << "\",\"distribution\":\"" << r.distribution
+					<< "\",\"size\":" << r.size << ",\"op\":\"" << r.op << "\",\"ops\":" << r.ops
+					<< ",\"ns_per_op\":" << r.nsPerOp << ",\"allocations\":" << r.allocations
+					<< ",\"allocated_bytes\":" << r.allocatedBytes << ",\"peak_heap_bytes\":" << r.peakHeapBytes
+					<< ",\"peak_rss_kb\":" << r.peakRssKb << ",\"checksum\":" << r.checksum << "}\n";
+			}
+			out.flush();
+
+			std::fprintf(stderr, "%-12s %-12s %10llu %-8s %12.1f %12llu %14lld %12llu\n",
+				r.structure.c_str(), r.distribution.c_str(), static_cast<unsigned long long>(r.size), r.op.c_str(),
+				r.nsPerOp, static_cast<unsigned long long>(r.allocations), static_cast<long long>(r.peakHeapBytes),
+				static_cast<unsigned long long>(r.peakRssKb));
+		}
+
+	private:
+		const Options& m_options;
+		std::ofstream m_file;
+
+		std::ostream& stream()
+		{
+			return m_file.is_open() ? static_cast<std::ostream&>(m_file) : std::cout;
+		}
+	};
+
+	// Times one operation and gathers its allocation counters. fn returns a checksum of the work done.
+	Result measure(std::string_view structure, DISTRIBUTION distribution, uint64_t size, std::string_view op, uint64_t ops,
+		const std::function<uint64_t()>& fn)
+	{
+		const auto allocations = g_allocations.load();
+		const auto allocatedBytes = g_allocatedBytes.load();
+		const auto liveBefore = g_liveBytes.load();
+		g_peakLiveBytes.store(liveBefore);
+
+		const auto start = Clock::now();
+		const auto checksum = fn();
+		const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		return Result{ .structure = std::string(structure), .distribution = distributionName(distribution), .size = size,
+			.op = std::string(op), .ops = ops, .nsPerOp = ops ? elapsed / static_cast<double>(ops) : 0.0,
+			.allocations = g_allocations.load() - allocations, .allocatedBytes = g_allocatedBytes.load() - allocatedBytes,
+			.peakHeapBytes = g_peakLiveBytes.load() - liveBefore, .peakRssKb = peakRssKb(), .checksum = checksum };
+	}
+
+	// Insert, query, nearest and remove on any SpatialIndex. prepare returns an empty structure sized for the run.
+	template <class S>
+	void benchIndex(Reporter& reporter, const Options& options, std::string_view name, DISTRIBUTION distribution,
+		const std::vector<Data::Point>& points, const std::function<S()>& prepare) requires Data::SpatialIndex<S, uint32_t>
+	{
+		const auto size = static_cast<uint64_t>(points.size());
+		const auto queries = makeQueries(points, options.queries, options.seed + 1);
+		auto index = prepare();
+		std::vector<Data::Handle> handles(points.size());
+
+		reporter.Report(measure(name, distribution, size, "insert", size, [&]()
+			{
+				uint64_t sum = 0;
+				for (size_t i = 0; i < points.size(); ++i)
+				{
+					handles[i] = index.Insert(static_cast<uint32_t>(i), points[i]);
+					sum += handles[i];
+				}
+				return sum;
+			}));
+
+		reporter.Report(measure(name, distribution, size, "query", queries.size(), [&]()
+			{
+				uint64_t hits = 0;
+				for (const auto& box : queries)
+				{
+					index.Query(box, [&hits](Data::Handle) { ++hits; });
+				}
+				return hits;
+			}));
+
+		reporter.Report(measure(name, distribution, size, "nearest", queries.size(), [&]()
+			{
+				uint64_t sum = 0;
+				for (const auto& box : queries)
+				{
+					for (auto h : index.Nearest(box.Center(), 8))
+					{
+						sum += h;
+					}
+				}
+				return sum;
+			}));
+
+		std::mt19937_64 rng(options.seed + 2);
+		std::shuffle(handles.begin(), handles.end(), rng);
+		reporter.Report(measure(name, distribution, size, "remove", size, [&]()
+			{
+				uint64_t removed = 0;
+				for (auto h : handles)
+				{
+					removed += index.Remove(h) ? 1 : 0;
+				}
+				return removed;
+			}));
+	}
+
+	void benchBuild(Reporter& reporter, DISTRIBUTION distribution, const std::vector<Data::Point>& points)
+	{
+		const auto size = static_cast<uint64_t>(points.size());
+		std::vector<uint32_t> data(points.size());
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			data[i] = static_cast<uint32_t>(i);
+		}
+
+		Data::QuadTree<uint32_t> tree(WORLD, 16);
+		reporter.Report(measure("quadtree", distribution, size, "build", size, [&]()
+			{
+				return static_cast<uint64_t>(tree.Build(points, data));
+			}));
+	}
+
+	// Boxes of a few units around each point; the second pass jitters every box a little like a frame of motion
+	void benchBroadphase(Reporter& reporter, const Options& options, DISTRIBUTION distribution, const std::vector<Data::Point>& points)
+	{
+		const auto size = static_cast<uint64_t>(points.size());
+		const auto half = 0.5 * WORLD_SIZE * std::sqrt(2.0 / static_cast<double>(points.size()));
+		const auto boxAt = [half](double x, double y) { return Box2D{ x - half, y - half, x + half, y + half }; };
+
+		Collision::SweepAndPrune broadphase;
+		std::vector<uint32_t> proxies(points.size());
+		reporter.Report(measure("sap", distribution, size, "add", size, [&]()
+			{
+				for (size_t i = 0; i < points.size(); ++i)
+				{
+					proxies[i] = broadphase.Add(boxAt(points[i].x, points[i].y));
+				}
+				return static_cast<uint64_t>(broadphase.FindPairs().size());
+			}));
+
+		std::mt19937_64 rng(options.seed + 3);
+		std::uniform_real_distribution<double> jitter(-half * 0.25, half * 0.25);
+		reporter.Report(measure("sap", distribution, size, "update", size, [&]()
+			{
+				for (size_t i = 0; i < points.size(); ++i)
+				{
+					broadphase.Update(proxies[i], boxAt(points[i].x + jitter(rng), points[i].y + jitter(rng)));
+				}
+				return static_cast<uint64_t>(broadphase.FindPairs().size());
+			}));
+	}
+
+	bool selected(const Options& options, std::string_view structure, DISTRIBUTION distribution)
+	{
+		if (options.filter.empty())
+			return true;
+		const auto name = std::string(structure) + "/" + distributionName(distribution);
+		return name.find(options.filter) != std::string::npos;
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const auto value = [&]() -> const char*
+				{
+					return i + 1 < argc ? argv[++i] : nullptr;
+				};
+			const char* v = nullptr;
+			if (arg == "--min" && (v = value()))
+				options.minSize = std::strtoull(v, nullptr, 10);
+			else if (arg == "--max" && (v = value()))
+				options.maxSize = std::strtoull(v, nullptr, 10);
+			else if (arg == "--adversarial-max" && (v = value()))
+				options.adversarialMax = std::strtoull(v, nullptr, 10);
+			else if (arg == "--broadphase-max" && (v = value()))
+				options.broadphaseMax = std::strtoull(v, nullptr, 10);
+			else if (arg == "--queries" && (v = value()))
+				options.queries = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--seed" && (v = value()))
+				options.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--filter" && (v = value()))
+				options.filter = v;
+			else if (arg == "--format" && (v = value()))
+				options.format = v;
+			else if (arg == "--out" && (v = value()))
+				options.out = v;
+			else
+			{
+				std::fprintf(stderr, "Unknown or incomplete option %s\n", argv[i]);
+				return false;
+			}
+		}
+		return options.minSize > 0 && options.minSize <= options.maxSize && options.queries > 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: SpatialBenchmarks [--min N] [--max N] [--queries Q] [--adversarial-max N] "
+			"[--broadphase-max N] [--filter TEXT] [--format json|csv] [--out FILE] [--seed S]\n");
+		return 1;
+	}
+
+	Reporter reporter(options);
+	for (auto distribution : { DISTRIBUTION::UNIFORM, DISTRIBUTION::CLUSTERED, DISTRIBUTION::ADVERSARIAL })
+	{
+		for (auto size = options.minSize; size <= options.maxSize; size *= 10)
+		{
+			if (distribution == DISTRIBUTION::ADVERSARIAL && size > options.adversarialMax)
+				break;
+
+			const auto points = makePoints(distribution, size, options.seed);
+			if (selected(options, "quadtree", distribution))
+			{
+				benchIndex<Data::QuadTree<uint32_t>>(reporter, options, "quadtree", distribution, points,
+					[]() { return Data::QuadTree<uint32_t>(WORLD, 16); });
+				benchBuild(reporter, distribution, points);
+			}
+			if (selected(options, "hashgrid", distribution))
+			{
+				// Cells sized for about four points each under a uniform spread
+				const auto cell = WORLD_SIZE * std::sqrt(4.0f / static_cast<float>(size));
+				benchIndex<Data::SpatialHashGrid<uint32_t>>(reporter, options, "hashgrid", distribution, points,
+					[cell]() { return Data::SpatialHashGrid<uint32_t>(WORLD, cell); });
+			}
+			// Duplicated points give boxes that all overlap each other, so adversarial pairs grow quadratically
+			const auto broadphaseMax = distribution == DISTRIBUTION::ADVERSARIAL
+				? std::min<uint64_t>(options.broadphaseMax, 10000) : options.broadphaseMax;
+			if (selected(options, "sap", distribution) && size <= broadphaseMax)
+			{
+				benchBroadphase(reporter, options, distribution, points);
+			}
+		}
+	}
+	return 0;
+}
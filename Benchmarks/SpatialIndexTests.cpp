@@ -0,0 +1,387 @@
+// Correctness of every SpatialIndex structure against a brute force reference. The same randomized sequence of
+// Insert, Remove and Move runs on each structure, and after every step a batch of Query boxes, Nearest searches and,
+// on the structures that have it, Raycast picks is compared with a linear scan of the reference. Positions are
+// snapped to a grid of whole units so many of them repeat and land exactly on the quad tree's split lines, the hash
+// grid's cell edges and the region border, and query boxes are snapped the same way so their edges sit on those
+// lines too. A QuadTree filled by Build, on one worker and on several, is checked against the same reference.
+//
+//   SpatialIndexTests [--steps N] [--seed N]
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <iterator>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include "TestCheck.h"
+
+import SpatialIndex;
+
+namespace
+{
+	constexpr float REGION_SIZE = 64.0f;
+	// Positions are multiples of this, the quad tree splits and the hash grid cells are multiples of it too
+	constexpr float SNAP = 2.0f;
+	constexpr uint32_t QUAD_TREE_CAPACITY = 4;
+	constexpr float GRID_CELL_SIZE = 8.0f;
+
+	struct Options
+	{
+		uint32_t steps = 2000;
+		uint32_t seed = 1;
+	};
+
+	struct Reference
+	{
+		struct Element
+		{
+			int data;
+			Data::Point position;
+		};
+
+		std::unordered_map<Data::Handle, Element> elements;
+
+		std::vector<Data::Handle> Query(const Data::Box& box) const
+		{
+			std::vector<Data::Handle> result;
+			for (const auto& [handle, element] : elements)
+			{
+				if (box.InBounds(element.position))
+				{
+					result.push_back(handle);
+				}
+			}
+			std::sort(result.begin(), result.end());
+			return result;
+		}
+
+		// Squared distances of the k closest elements, closest first. Handles are not compared, ties may go
+		// either way.
+		std::vector<float> Nearest(const Data::Point& p, uint32_t k) const
+		{
+			std::vector<float> result;
+			for (const auto& [handle, element] : elements)
+			{
+				result.push_back(distanceSquared(element.position, p));
+			}
+			std::sort(result.begin(), result.end());
+			result.resize(std::min<size_t>(result.size(), k));
+			return result;
+		}
+
+		// Distance along the ray to the first element within pickRadius of it, measured the way QuadTree::Raycast
+		// does, or a negative value when there is none
+		float Raycast(const Data::Point& origin, const Data::Point& dir, float maxDist, float pickRadius) const
+		{
+			auto best = -1.0f;
+			for (const auto& [handle, element] : elements)
+			{
+				const auto along = distanceAlong(element.position, origin, dir);
+				if (along >= 0.0f && along <= maxDist && (best < 0.0f || along < best)
+					&& distanceSquared(element.position, origin) - along * along <= pickRadius * pickRadius)
+				{
+					best = along;
+				}
+			}
+			return best;
+		}
+
+		static float distanceAlong(const Data::Point& p, const Data::Point& origin, const Data::Point& dir)
+		{
+			const auto length = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+			return (p.x - origin.x) * (dir.x / length) + (p.y - origin.y) * (dir.y / length);
+		}
+
+		static float distanceSquared(const Data::Point& a, const Data::Point& b)
+		{
+			const auto dx = a.x - b.x;
+			const auto dy = a.y - b.y;
+			return dx * dx + dy * dy;
+		}
+	};
+
+	Data::Point randomPoint(std::mt19937& rng, float margin = 0.0f)
+	{
+		// margin reaches past the region so some positions are rejected
+		const auto steps = static_cast<int>((REGION_SIZE + 2.0f * margin) / SNAP);
+		std::uniform_int_distribution<int> step(0, steps);
+		return Data::Point{ .x = step(rng) * SNAP - margin, .y = step(rng) * SNAP - margin };
+	}
+
+	Data::Box randomBox(std::mt19937& rng)
+	{
+		const auto a = randomPoint(rng, 8.0f);
+		const auto b = randomPoint(rng, 8.0f);
+		return Data::Box{ .minPoint = { std::min(a.x, b.x), std::min(a.y, b.y) }, .maxPoint = { std::max(a.x, b.x), std::max(a.y, b.y) } };
+	}
+
+	template <class Index>
+		requires Data::SpatialIndex<Index, int>
+	void checkAgainst(const Index& index, const Reference& reference, std::mt19937& rng)
+	{
+		CHECK(index.Size() == reference.elements.size());
+		for (const auto& [handle, element] : reference.elements)
+		{
+			CHECK(index.Contains(handle));
+			CHECK(index.Position(handle).x == element.position.x && index.Position(handle).y == element.position.y);
+		}
+
+		for (int i = 0; i < 4; ++i)
+		{
+			const auto box = randomBox(rng);
+			auto found = index.Query(box);
+			std::sort(found.begin(), found.end());
+			CHECK(found == reference.Query(box));
+		}
+
+		for (int i = 0; i < 4; ++i)
+		{
+			const auto p = randomPoint(rng, 4.0f);
+			const auto k = std::uniform_int_distribution<uint32_t>(1, 12)(rng);
+			const auto found = index.Nearest(p, k);
+			const auto expected = reference.Nearest(p, k);
+			CHECK(found.size() == expected.size());
+			std::vector<float> distances;
+			for (const auto handle : found)
+			{
+				const auto it = reference.elements.find(handle);
+				CHECK(it != reference.elements.end());
+				if (it != reference.elements.end())
+				{
+					distances.push_back(Reference::distanceSquared(it->second.position, p));
+				}
+			}
+			// Closest first, and the same distances as the scan: any element tied with the k-th may be returned
+			CHECK(std::is_sorted(distances.begin(), distances.end()));
+			CHECK(distances == expected);
+			auto unique = found;
+			std::sort(unique.begin(), unique.end());
+			CHECK(std::adjacent_find(unique.begin(), unique.end()) == unique.end());
+		}
+
+		// Picking, for the structures that have it: the first element within the pick radius of the segment
+		if constexpr (requires { index.Raycast(Data::Point{}, Data::Point{}, 0.0f, 0.0f); })
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				const auto origin = randomPoint(rng, 8.0f);
+				// Whole steps, so rays run along the split lines and diagonals through the snapped positions
+				std::uniform_int_distribution<int> step(-4, 4);
+				auto dir = Data::Point{ .x = static_cast<float>(step(rng)), .y = static_cast<float>(step(rng)) };
+				if (dir.x == 0.0f && dir.y == 0.0f)
+				{
+					dir.x = 1.0f;
+				}
+				const auto maxDist = std::uniform_real_distribution<float>(4.0f, 2.0f * REGION_SIZE)(rng);
+				const auto pickRadius = std::uniform_int_distribution<int>(1, 6)(rng) * 0.5f;
+				const auto hit = index.Raycast(origin, dir, maxDist, pickRadius);
+				const auto expected = reference.Raycast(origin, dir, maxDist, pickRadius);
+				CHECK(hit.has_value() == (expected >= 0.0f));
+				if (!hit)
+					continue;
+
+				// Any element tied for the first hit may be returned, but it has to be one at that distance
+				CHECK(hit->distance == expected);
+				const auto it = reference.elements.find(hit->handle);
+				CHECK(it != reference.elements.end());
+				if (it != reference.elements.end())
+				{
+					const auto along = Reference::distanceAlong(it->second.position, origin, dir);
+					CHECK(along == hit->distance);
+					CHECK(Reference::distanceSquared(it->second.position, origin) - along * along <= pickRadius * pickRadius);
+				}
+			}
+		}
+	}
+
+	template <class Index>
+		requires Data::SpatialIndex<Index, int>
+	void run(std::string_view name, Index index, const Options& options)
+	{
+		const auto failuresBefore = Test::failures;
+		std::mt19937 rng(options.seed);
+		Reference reference;
+		std::vector<Data::Handle> handles;
+		int next = 0;
+
+		// Outside the region is rejected, the border itself is inside
+		CHECK(index.Insert(-1, Data::Point{ .x = -SNAP, .y = 0.0f }) == Data::INVALID_HANDLE);
+		CHECK(index.Insert(-1, Data::Point{ .x = 0.0f, .y = REGION_SIZE + SNAP }) == Data::INVALID_HANDLE);
+
+		// More duplicates of one point than a quad tree leaf holds, on the centre where the first split goes
+		const Data::Point centre{ .x = REGION_SIZE / 2.0f, .y = REGION_SIZE / 2.0f };
+		for (uint32_t i = 0; i < 3 * QUAD_TREE_CAPACITY; ++i)
+		{
+			const auto handle = index.Insert(next, centre);
+			CHECK(handle != Data::INVALID_HANDLE);
+			reference.elements[handle] = { next++, centre };
+			handles.push_back(handle);
+		}
+		checkAgainst(index, reference, rng);
+
+		for (uint32_t step = 0; step < options.steps; ++step)
+		{
+			const auto op = std::uniform_int_distribution<int>(0, 9)(rng);
+			if (op < 5 || handles.empty())
+			{
+				const auto p = randomPoint(rng, SNAP);
+				const auto handle = index.Insert(next, p);
+				if (Data::Box{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { REGION_SIZE, REGION_SIZE } }.InBounds(p))
+				{
+					CHECK(handle != Data::INVALID_HANDLE);
+					CHECK(!reference.elements.contains(handle));
+					reference.elements[handle] = { next, p };
+					handles.push_back(handle);
+				}
+				else
+				{
+					CHECK(handle == Data::INVALID_HANDLE);
+				}
+				++next;
+			}
+			else if (op < 7)
+			{
+				const auto i = std::uniform_int_distribution<size_t>(0, handles.size() - 1)(rng);
+				const auto handle = handles[i];
+				CHECK(index.Remove(handle));
+				CHECK(!index.Contains(handle));
+				CHECK(!index.Remove(handle));
+				reference.elements.erase(handle);
+				handles[i] = handles.back();
+				handles.pop_back();
+			}
+			else
+			{
+				const auto handle = handles[std::uniform_int_distribution<size_t>(0, handles.size() - 1)(rng)];
+				const auto p = randomPoint(rng, SNAP);
+				const auto inside = Data::Box{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { REGION_SIZE, REGION_SIZE } }.InBounds(p);
+				// A rejected move leaves the element where it was
+				CHECK(index.Move(handle, p) == inside);
+				if (inside)
+				{
+					reference.elements[handle].position = p;
+				}
+			}
+
+			for (const auto& [handle, element] : reference.elements)
+			{
+				CHECK(index.Get(handle) == element.data);
+			}
+			checkAgainst(index, reference, rng);
+		}
+
+		index.Clear();
+		CHECK(index.Size() == 0);
+		CHECK(index.Query(index.Region()).empty());
+		CHECK(index.Nearest(centre, 4).empty());
+
+		std::fprintf(stderr, "%s: %d failed checks\n", name.data(), Test::failures - failuresBefore);
+	}
+	// QuadTree::Build against the same reference: points snapped to the grid so most repeat many times over, and
+	// continuous ones, some outside the region, enough of them for Build to sort and place them on several workers
+	void testBuild(float looseness, uint32_t workers, const Options& options)
+	{
+		const auto failuresBefore = Test::failures;
+		std::mt19937 rng(options.seed + workers);
+		const Data::Box region{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { REGION_SIZE, REGION_SIZE } };
+		std::uniform_real_distribution<float> anywhere(-SNAP, REGION_SIZE + SNAP);
+		std::vector<Data::Point> points(70000);
+		std::vector<int> data(points.size());
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			points[i] = i % 2 == 0 ? randomPoint(rng, SNAP) : Data::Point{ .x = anywhere(rng), .y = anywhere(rng) };
+			data[i] = static_cast<int>(i);
+		}
+
+		Data::QuadTree<int> tree(region, QUAD_TREE_CAPACITY, looseness);
+		// Whatever the tree held before is replaced
+		tree.Insert(-1, Data::Point{ .x = 1.0f, .y = 1.0f });
+		std::vector<Data::Handle> handles(points.size());
+		const auto inserted = tree.Build(points, data, handles, workers);
+
+		Reference reference;
+		uint32_t expected = 0;
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			if (!region.InBounds(points[i]))
+			{
+				CHECK(handles[i] == Data::INVALID_HANDLE);
+				continue;
+			}
+			++expected;
+			CHECK(handles[i] != Data::INVALID_HANDLE);
+			CHECK(!reference.elements.contains(handles[i]));
+			CHECK(tree.Get(handles[i]) == data[i]);
+			reference.elements[handles[i]] = { data[i], points[i] };
+		}
+		CHECK(inserted == expected);
+		for (int i = 0; i < 8; ++i)
+		{
+			checkAgainst(tree, reference, rng);
+		}
+
+		// The built tree takes edits like one filled by Insert
+		for (uint32_t step = 0; step < 200; ++step)
+		{
+			auto it = reference.elements.begin();
+			std::advance(it, rng() % reference.elements.size());
+			const auto handle = it->first;
+			if (step % 2 == 0)
+			{
+				CHECK(tree.Remove(handle));
+				reference.elements.erase(handle);
+			}
+			else
+			{
+				const auto p = randomPoint(rng);
+				CHECK(tree.Move(handle, p));
+				reference.elements[handle].position = p;
+			}
+		}
+		checkAgainst(tree, reference, rng);
+
+		// A handle span too short for the points throws and leaves the tree as it was
+		std::vector<Data::Handle> shortHandles(points.size() - 1);
+		bool threw = false;
+		try
+		{
+			tree.Build(points, data, shortHandles, workers);
+		}
+		catch (const std::runtime_error&)
+		{
+			threw = true;
+		}
+		CHECK(threw);
+		checkAgainst(tree, reference, rng);
+
+		std::fprintf(stderr, "build %.1f x%u: %d failed checks\n", looseness, workers, Test::failures - failuresBefore);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string_view arg = argv[i];
+		if (arg == "--steps")
+			options.steps = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+		else if (arg == "--seed")
+			options.seed = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+	}
+
+	const Data::Box region{ .minPoint = { 0.0f, 0.0f }, .maxPoint = { REGION_SIZE, REGION_SIZE } };
+	run("quadtree", Data::QuadTree<int>(region, QUAD_TREE_CAPACITY), options);
+	run("quadtree_loose", Data::QuadTree<int>(region, QUAD_TREE_CAPACITY, 1.5f), options);
+	run("hashgrid", Data::SpatialHashGrid<int>(region, GRID_CELL_SIZE), options);
+	// Fewer buckets than cells, so cells share buckets
+	run("hashgrid_shared", Data::SpatialHashGrid<int>(region, GRID_CELL_SIZE, 8), options);
+	testBuild(1.0f, 1, options);
+	testBuild(1.0f, 4, options);
+	testBuild(1.5f, 4, options);
+	return Test::result("SpatialIndexTests");
+}
@@ -0,0 +1,27 @@
+#pragma once
+// The few checks the test executables need, kept dependency free so they build wherever the benchmarks do. CHECK
+// reports a failed condition with its location and carries on, so one run lists every failure; main returns
+// Test::result() and ctest sees a non-zero exit when anything failed.
+#include <cstdio>
+
+namespace Test
+{
+	inline int failures = 0;
+
+	inline void check(bool passed, const char* expression, const char* file, int line)
+	{
+		if (!passed)
+		{
+			std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+			++failures;
+		}
+	}
+
+	inline int result(const char* name)
+	{
+		std::fprintf(stderr, "%s: %s (%d failed checks)\n", name, failures == 0 ? "passed" : "FAILED", failures);
+		return failures == 0 ? 0 : 1;
+	}
+}
+
+#define CHECK(expression) Test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
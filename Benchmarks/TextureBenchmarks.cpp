@@ -0,0 +1,633 @@
+// CPU cost of generating procedural textures and their mip chains into upload memory. Each case writes a square
+// texture at a 256 byte aligned row pitch, like a D3D12 upload footprint, --reps times after one warm up and reports
+// the best and mean time per texture, texels and bytes per second written, and a checksum of the texels. Every case
+// runs on each SIMD level on one thread and on the widest level on all threads, and reports whether it wrote the
+// same texels as the scalar single threaded run; the program exits with 1 if any did not. The legacy case is the
+// per byte checkerboard loop the DX12 backend used before the ProceduralTexture module, as the baseline;
+// checkerboard cases report whether their texels match it. The mips cases filter a full chain below a noise texture.
+// The bc cases block compress a noise texture, opaque for BC1 and with alpha for BC3 and BC7, count source texels
+// and the blocks written, and report the PSNR of the decoded texels against the source (RGB only for BC1, 100 dB
+// when lossless).
+// The stream cases write the noise chain to a DDS file, as RGBA8 and as BC7, and copy every level into staging at a
+// 256 byte aligned pitch: stream_first only the coarsest levels that fit one 2 MiB step, what the renderer can sample
+// after its first frame; stream_mapped the whole chain through TextureFile's mapping; stream_read the whole chain
+// read into memory with a stream first, as the baseline. The file is in the page cache after the first run.
+// Results go out as JSON lines (or CSV) on stdout or to --out; a readable table goes to stderr.
+//
+//   TextureBenchmarks [--reps N] [--max-size N] [--threads N] [--format json|csv] [--out FILE]
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <span>
+#include <iostream>
+#include <thread>
+
+import BoxKernels;
+import TextureFormat;
+import ProceduralTexture;
+import MipChain;
+import BlockCompression;
+import TextureContainer;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr size_t PITCH_ALIGNMENT = 256;
+	constexpr size_t STREAM_BUDGET = 2 * 1024 * 1024;
+	// DXGI_FORMAT values of the stream cases
+	constexpr uint32_t DXGI_R8G8B8A8_UNORM = 28;
+	constexpr uint32_t DXGI_BC7_UNORM = 98;
+
+	struct Options
+	{
+		uint32_t reps = 10;
+		uint32_t maxSize = 4096;
+		uint32_t threads = 0;// 0 uses every hardware thread for the threaded cases
+		std::string format = "json";
+		std::string out;
+	};
+
+	struct Result
+	{
+		std::string pattern;
+		std::string texelFormat;
+		std::string simd;
+		uint32_t threads = 1;
+		uint32_t size = 0;
+		double bestNs = 0.0;
+		double meanNs = 0.0;
+		double mtexelsPerSecond = 0.0;
+		double gbPerSecond = 0.0;
+		bool matchesScalar = true;
+		bool matchesLegacy = false;
+		uint64_t checksum = 0;
+		double psnr = 0.0;// Compression cases only
+	};
+
+	struct Texture
+	{
+		std::vector<std::byte> bytes;
+		LS::TextureData data;
+
+		Texture(uint32_t size, LS::TEXEL_FORMAT format)
+		{
+			const auto rowBytes = static_cast<size_t>(size) * LS::texelSize(format);
+			const auto pitch = (rowBytes + PITCH_ALIGNMENT - 1) / PITCH_ALIGNMENT * PITCH_ALIGNMENT;
+			bytes.assign(pitch * size, std::byte{ 0 });
+			data = LS::TextureData{ .data = bytes.data(), .rowPitch = pitch, .width = size, .height = size, .format = format };
+		}
+
+		// FNV-1a over the texels, padding excluded
+		uint64_t Checksum() const
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			const auto rowBytes = static_cast<size_t>(data.width) * LS::texelSize(data.format);
+			for (uint32_t y = 0; y < data.height; ++y)
+			{
+				const auto* row = data.Row(y);
+				for (size_t i = 0; i < rowBytes; ++i)
+				{
+					hash = (hash ^ static_cast<uint8_t>(row[i])) * 0x100000001b3ull;
+				}
+			}
+			return hash;
+		}
+	};
+
+	// The DX12 backend's GenerateTextureData as it was, a byte at a time
+	void legacyCheckerboard(uint8_t* destination, size_t rowPitch, uint32_t textureWidth, uint32_t textureHeight, uint32_t pixelSize)
+	{
+		const uint32_t cellWidth = textureWidth >> 3;
+		const uint32_t cellHeight = textureHeight >> 3;
+		for (uint32_t y = 0; y < textureHeight; ++y)
+		{
+			uint8_t* pData = destination + y * rowPitch;
+			for (uint32_t x = 0; x < textureWidth; ++x, pData += pixelSize)
+			{
+				const uint8_t value = (x / cellWidth) % 2 == (y / cellHeight) % 2 ? 0x00 : 0xff;
+				pData[0] = value;
+				pData[1] = value;
+				pData[2] = value;
+				pData[3] = 0xff;
+			}
+		}
+	}
+
+	std::string_view patternName(LS::PATTERN pattern)
+	{
+		switch (pattern)
+		{
+		case LS::PATTERN::SOLID:
+			return "solid";
+		case LS::PATTERN::CHECKERBOARD:
+			return "checker";
+		case LS::PATTERN::GRADIENT:
+			return "gradient";
+		case LS::PATTERN::NOISE:
+			return "noise";
+		}
+		return "?";
+	}
+
+	std::string_view formatName(LS::TEXEL_FORMAT format)
+	{
+		switch (format)
+		{
+		case LS::TEXEL_FORMAT::R8_UNORM:
+			return "r8";
+		case LS::TEXEL_FORMAT::R8G8_UNORM:
+			return "rg8";
+		case LS::TEXEL_FORMAT::R8G8B8A8_UNORM:
+			return "rgba8";
+		case LS::TEXEL_FORMAT::R8G8B8A8_UNORM_SRGB:
+			return "rgba8_srgb";
+		case LS::TEXEL_FORMAT::B8G8R8A8_UNORM:
+			return "bgra8";
+		case LS::TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB:
+			return "bgra8_srgb";
+		case LS::TEXEL_FORMAT::R16G16B16A16_FLOAT:
+			return "rgba16f";
+		case LS::TEXEL_FORMAT::R32_FLOAT:
+			return "r32f";
+		case LS::TEXEL_FORMAT::R32G32B32A32_FLOAT:
+			return "rgba32f";
+		}
+		return "?";
+	}
+
+	std::string_view simdName(Data::SIMD_LEVEL level)
+	{
+		return level == Data::SIMD_LEVEL::AVX2 ? "avx2" : level == Data::SIMD_LEVEL::SSE ? "sse" : "scalar";
+	}
+
+	// Levels of a full mip chain, level 0 first
+	struct Chain
+	{
+		std::vector<Texture> textures;
+		std::vector<LS::TextureData> levels;
+
+		Chain(uint32_t size, LS::TEXEL_FORMAT format)
+		{
+			const auto count = LS::mipLevelCount(size, size);
+			textures.reserve(count);
+			for (uint32_t level = 0; level < count; ++level)
+			{
+				levels.emplace_back(textures.emplace_back(LS::mipSize(size, level), format).data);
+			}
+		}
+
+		uint64_t Checksum() const
+		{
+			uint64_t hash = 0;
+			for (const auto& texture : textures)
+			{
+				hash = hash * 31 + texture.Checksum();
+			}
+			return hash;
+		}
+	};
+
+	// A block compressed texture, rows of blocks at a 256 byte aligned pitch
+	struct Blocks
+	{
+		std::vector<std::byte> bytes;
+		LS::BlockData data;
+
+		Blocks(uint32_t size, LS::BLOCK_FORMAT format)
+		{
+			const auto rowBytes = static_cast<size_t>(LS::blockCount(size)) * LS::blockSize(format);
+			const auto pitch = (rowBytes + PITCH_ALIGNMENT - 1) / PITCH_ALIGNMENT * PITCH_ALIGNMENT;
+			bytes.assign(pitch * LS::blockCount(size), std::byte{ 0 });
+			data = LS::BlockData{ .data = bytes.data(), .rowPitch = pitch, .width = size, .height = size, .format = format };
+		}
+
+		uint64_t Checksum() const
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			const auto rowBytes = static_cast<size_t>(LS::blockCount(data.width)) * LS::blockSize(data.format);
+			for (uint32_t y = 0; y < LS::blockCount(data.height); ++y)
+			{
+				const auto* row = data.Row(y);
+				for (size_t i = 0; i < rowBytes; ++i)
+				{
+					hash = (hash ^ static_cast<uint8_t>(row[i])) * 0x100000001b3ull;
+				}
+			}
+			return hash;
+		}
+	};
+
+	std::string_view compressionName(LS::BLOCK_FORMAT format, LS::COMPRESSION_QUALITY quality)
+	{
+		const auto fast = quality == LS::COMPRESSION_QUALITY::FAST;
+		switch (format)
+		{
+		case LS::BLOCK_FORMAT::BC1_UNORM:
+			return fast ? "bc1_fast" : "bc1_quality";
+		case LS::BLOCK_FORMAT::BC3_UNORM:
+			return fast ? "bc3_fast" : "bc3_quality";
+		case LS::BLOCK_FORMAT::BC7_UNORM:
+			return fast ? "bc7_fast" : "bc7_quality";
+		}
+		return "?";
+	}
+
+	// Staging for every level of a texture file, each at a pitch aligned footprint
+	struct Staging
+	{
+		std::vector<std::byte> bytes;
+		std::vector<size_t> offsets;
+		std::vector<size_t> pitches;
+
+		explicit Staging(const LS::TextureHeader& header)
+		{
+			size_t size = 0;
+			for (const auto& level : header.levels)
+			{
+				offsets.push_back(size);
+				pitches.push_back((level.rowBytes + PITCH_ALIGNMENT - 1) / PITCH_ALIGNMENT * PITCH_ALIGNMENT);
+				size += pitches.back() * level.rows;
+			}
+			bytes.assign(size, std::byte{ 0 });
+		}
+
+		uint64_t Checksum() const
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			for (const auto byte : bytes)
+			{
+				hash = (hash ^ static_cast<uint8_t>(byte)) * 0x100000001b3ull;
+			}
+			return hash;
+		}
+	};
+
+	// Copies what stream hands out, budget bytes at a time, until it has handed out everything or one step when
+	// firstStep is set
+	void streamLevels(const LS::TextureFile& file, Staging& staging, bool firstStep)
+	{
+		LS::MipStream stream(file.Header(), PITCH_ALIGNMENT);
+		do
+		{
+			for (const auto& copy : stream.Take(STREAM_BUDGET))
+			{
+				const auto pitch = staging.pitches[copy.level];
+				file.CopyRows(copy.level, copy.firstRow, copy.rows, staging.bytes.data() + staging.offsets[copy.level] + copy.firstRow * pitch, pitch);
+				stream.Complete(copy);
+			}
+		} while (!firstStep && !stream.AllTaken());
+	}
+
+	std::vector<std::byte> readFile(const std::filesystem::path& path)
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::vector<std::byte> bytes(std::filesystem::file_size(path));
+		in.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		return bytes;
+	}
+
+	std::string_view filterName(LS::MIP_FILTER filter)
+	{
+		switch (filter)
+		{
+		case LS::MIP_FILTER::BOX:
+			return "mips_box";
+		case LS::MIP_FILTER::TENT:
+			return "mips_tent";
+		case LS::MIP_FILTER::LANCZOS3:
+			return "mips_lanczos3";
+		}
+		return "?";
+	}
+
+	// texels and bytes are what one run writes
+	template<class Fn, class Checksum>
+	Result measure(const Options& options, uint32_t size, double texels, double bytes, Fn&& generate, Checksum&& checksum)
+	{
+		generate();
+		double best = 0.0;
+		double total = 0.0;
+		for (uint32_t i = 0; i < options.reps; ++i)
+		{
+			const auto start = Clock::now();
+			generate();
+			const auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			best = i == 0 ? ns : std::min(best, ns);
+			total += ns;
+		}
+		return Result{ .size = size, .bestNs = best, .meanNs = total / options.reps,
+			.mtexelsPerSecond = texels * 1e3 / best, .gbPerSecond = bytes / best, .checksum = checksum() };
+	}
+
+	template<class Fn>
+	Result measure(const Options& options, const Texture& texture, Fn&& generate)
+	{
+		const auto texels = static_cast<double>(texture.data.width) * texture.data.height;
+		return measure(options, texture.data.width, texels, texels * LS::texelSize(texture.data.format), generate,
+			[&]() { return texture.Checksum(); });
+	}
+
+	// Runs a case on every SIMD level on one thread and on the widest level on all of them, and checks each run
+	// against the scalar single threaded one. run(threads) measures one.
+	template<class Run>
+	bool sweep(const Options& options, std::ostream& out, uint32_t allThreads, std::string_view name, LS::TEXEL_FORMAT format,
+		uint64_t legacyChecksum, Run&& run)
+	{
+		const auto supported = Data::supportedSimdLevel();
+		uint64_t scalarChecksum = 0;
+		auto matched = true;
+		for (const auto threads : { 1u, allThreads })
+		{
+			for (auto level = Data::SIMD_LEVEL::SCALAR; level <= supported; level = static_cast<Data::SIMD_LEVEL>(static_cast<int>(level) + 1))
+			{
+				if (threads != 1 && level != supported)
+					continue;
+
+				Data::setSimdLevel(level);
+				auto result = run(threads);
+				if (threads == 1 && level == Data::SIMD_LEVEL::SCALAR)
+				{
+					scalarChecksum = result.checksum;
+				}
+				result.pattern = name;
+				result.texelFormat = formatName(format);
+				result.simd = simdName(level);
+				result.threads = threads;
+				result.matchesScalar = result.checksum == scalarChecksum;
+				result.matchesLegacy = result.checksum == legacyChecksum;
+				matched = matched && result.matchesScalar;
+				report(options, out, result);
+			}
+			if (allThreads == 1)
+				break;
+		}
+		Data::setSimdLevel(supported);
+		return matched;
+	}
+
+	void report(const Options& options, std::ostream& out, const Result& r)
+	{
+		if (options.format == "csv")
+		{
+			out << r.pattern << ',' << r.texelFormat << ',' << r.simd << ',' << r.threads << ',' << r.size << ',' << r.bestNs << ',' << r.meanNs << ','
+				<< r.mtexelsPerSecond << ',' << r.gbPerSecond << ',' << r.matchesScalar << ',' << r.matchesLegacy << ',' << r.checksum << ',' << r.psnr << '\n';
+		}
+		else
+		{
+			out << "{\"pattern\":\"" << r.pattern << "\",\"texel_format\":\"" << r.texelFormat << "\",\"simd\":\"" << r.simd
+				<< "\",\"threads\":" << r.threads << ",\"size\":" << r.size << ",\"best_ns\":" << r.bestNs << ",\"mean_ns\":" << r.meanNs
+				<< ",\"mtexels_per_s\":" << r.mtexelsPerSecond << ",\"gb_per_s\":" << r.gbPerSecond
+				<< ",\"matches_scalar\":" << (r.matchesScalar ? "true" : "false") << ",\"matches_legacy\":" << (r.matchesLegacy ? "true" : "false") << ",\"checksum\":" << r.checksum
+				<< ",\"psnr_db\":" << r.psnr << "}\n";
+		}
+		out.flush();
+
+		std::fprintf(stderr, "%-13s %-11s %-6s %7u %6u %14.1f %14.1f %10.1f %8.2f %-6s %-6s %6.2f\n", r.pattern.c_str(), r.texelFormat.c_str(),
+			r.simd.c_str(), r.threads, r.size, r.bestNs, r.meanNs, r.mtexelsPerSecond, r.gbPerSecond, r.matchesScalar ? "yes" : "NO",
+			r.matchesLegacy ? "yes" : "no", r.psnr);
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string_view arg = argv[i];
+			const auto value = [&]() -> const char*
+				{
+					return i + 1 < argc ? argv[++i] : nullptr;
+				};
+			const char* v = nullptr;
+			if (arg == "--reps" && (v = value()))
+				options.reps = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--max-size" && (v = value()))
+				options.maxSize = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--threads" && (v = value()))
+				options.threads = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+			else if (arg == "--format" && (v = value()))
+				options.format = v;
+			else if (arg == "--out" && (v = value()))
+				options.out = v;
+			else
+			{
+				std::fprintf(stderr, "Unknown or incomplete option %s\n", argv[i]);
+				return false;
+			}
+		}
+		return options.reps > 0 && options.maxSize >= 256;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: TextureBenchmarks [--reps N] [--max-size N] [--threads N] [--format json|csv] [--out FILE]\n");
+		return 1;
+	}
+
+	std::ofstream file;
+	if (!options.out.empty())
+	{
+		file.open(options.out, std::ios::trunc);
+	}
+	auto& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+	if (options.format == "csv")
+	{
+		out << "pattern,texel_format,simd,threads,size,best_ns,mean_ns,mtexels_per_s,gb_per_s,matches_scalar,matches_legacy,checksum,psnr_db\n";
+	}
+	std::fprintf(stderr, "%-13s %-11s %-6s %7s %6s %14s %14s %10s %8s %-6s %-6s %6s\n", "pattern", "format", "simd", "threads", "size",
+		"best ns", "mean ns", "Mtexel/s", "GB/s", "scalar", "legacy", "psnr");
+
+	const auto allThreads = options.threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.threads;
+	const auto formats = { LS::TEXEL_FORMAT::R8G8B8A8_UNORM, LS::TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB, LS::TEXEL_FORMAT::R16G16B16A16_FLOAT };
+	auto matched = true;
+	for (uint32_t size = 256; size <= options.maxSize; size *= 2)
+	{
+		Texture legacy(size, LS::TEXEL_FORMAT::R8G8B8A8_UNORM);
+		auto baseline = measure(options, legacy, [&]()
+			{
+				legacyCheckerboard(reinterpret_cast<uint8_t*>(legacy.data.data), legacy.data.rowPitch, size, size, 4);
+			});
+		baseline.pattern = "legacy";
+		baseline.texelFormat = "rgba8";
+		baseline.simd = "scalar";
+		baseline.matchesLegacy = true;
+		report(options, out, baseline);
+
+		for (const auto pattern : { LS::PATTERN::SOLID, LS::PATTERN::CHECKERBOARD, LS::PATTERN::GRADIENT, LS::PATTERN::NOISE })
+		{
+			// The gradient runs diagonally so every row is generated rather than copied
+			const LS::TexturePattern description{ .pattern = pattern, .directionX = 1.0f,
+				.directionY = pattern == LS::PATTERN::GRADIENT ? 1.0f : 0.0f };
+			for (const auto format : formats)
+			{
+				Texture texture(size, format);
+				matched &= sweep(options, out, allThreads, patternName(pattern), format, baseline.checksum, [&](uint32_t threads)
+					{
+						return measure(options, texture, [&]()
+							{
+								LS::generateTexture(description, texture.data, threads);
+							});
+					});
+			}
+		}
+
+		for (const auto filter : { LS::MIP_FILTER::BOX, LS::MIP_FILTER::TENT, LS::MIP_FILTER::LANCZOS3 })
+		{
+			for (const auto format : formats)
+			{
+				Chain chain(size, format);
+				LS::generateTexture(LS::TexturePattern{ .pattern = LS::PATTERN::NOISE }, chain.levels[0]);
+				// Everything below level 0, about a third of its texels
+				auto texels = 0.0;
+				for (size_t level = 1; level < chain.levels.size(); ++level)
+				{
+					texels += static_cast<double>(chain.levels[level].width) * chain.levels[level].height;
+				}
+				matched &= sweep(options, out, allThreads, filterName(filter), format, baseline.checksum, [&](uint32_t threads)
+					{
+						return measure(options, size, texels, texels * LS::texelSize(format), [&]()
+							{
+								LS::generateMipChain(chain.levels, filter, threads);
+							},
+							[&]() { return chain.Checksum(); });
+					});
+			}
+		}
+
+		for (const auto format : { LS::BLOCK_FORMAT::BC1_UNORM, LS::BLOCK_FORMAT::BC3_UNORM, LS::BLOCK_FORMAT::BC7_UNORM })
+		{
+			// BC1 alpha is a single bit, so its source is opaque
+			const auto alpha = format == LS::BLOCK_FORMAT::BC1_UNORM ? 1.0f : 0.25f;
+			Texture source(size, LS::TEXEL_FORMAT::R8G8B8A8_UNORM);
+			LS::generateTexture(LS::TexturePattern{ .pattern = LS::PATTERN::NOISE, .color0 = { .r = 0.1f, .g = 0.2f, .b = 0.6f, .a = alpha },
+				.color1 = { .r = 0.9f, .g = 0.8f, .b = 0.2f, .a = 1.0f } }, source.data);
+			Texture decoded(size, LS::TEXEL_FORMAT::R8G8B8A8_UNORM);
+			for (const auto quality : { LS::COMPRESSION_QUALITY::FAST, LS::COMPRESSION_QUALITY::QUALITY })
+			{
+				Blocks blocks(size, format);
+				const auto texels = static_cast<double>(size) * size;
+				const auto bytes = static_cast<double>(LS::blockCount(size)) * LS::blockCount(size) * LS::blockSize(format);
+				matched &= sweep(options, out, allThreads, compressionName(format, quality), source.data.format, baseline.checksum,
+					[&](uint32_t threads)
+					{
+						auto result = measure(options, size, texels, bytes, [&]()
+							{
+								LS::compressTexture(source.data, blocks.data, quality, threads);
+							},
+							[&]() { return blocks.Checksum(); });
+						LS::decompressTexture(blocks.data, decoded.data);
+						result.psnr = std::min(LS::psnr(source.data, decoded.data, format == LS::BLOCK_FORMAT::BC1_UNORM ? 3 : 4), 100.0);
+						return result;
+					});
+			}
+		}
+
+		for (const auto compressed : { false, true })
+		{
+			// The chain as the file stores it, tightly packed levels
+			Chain chain(size, LS::TEXEL_FORMAT::R8G8B8A8_UNORM);
+			LS::generateTexture(LS::TexturePattern{ .pattern = LS::PATTERN::NOISE }, chain.levels[0]);
+			LS::generateMipChain(chain.levels, LS::MIP_FILTER::BOX);
+			std::vector<std::vector<std::byte>> levels;
+			for (const auto& level : chain.levels)
+			{
+				if (compressed)
+				{
+					auto& blocks = levels.emplace_back(static_cast<size_t>(LS::blockCount(level.width)) * LS::blockCount(level.height) * LS::blockSize(LS::BLOCK_FORMAT::BC7_UNORM));
+					LS::compressTexture(level, LS::BlockData{ .data = blocks.data(), .rowPitch = LS::blockCount(level.width) * size_t{ 16 },
+						.width = level.width, .height = level.height, .format = LS::BLOCK_FORMAT::BC7_UNORM });
+				}
+				else
+				{
+					auto& texels = levels.emplace_back(static_cast<size_t>(level.width) * level.height * 4);
+					for (uint32_t y = 0; y < level.height; ++y)
+					{
+						std::memcpy(texels.data() + static_cast<size_t>(y) * level.width * 4, level.Row(y), level.width * size_t{ 4 });
+					}
+				}
+			}
+			const std::vector<std::span<const std::byte>> spans(levels.begin(), levels.end());
+			const auto path = std::filesystem::temp_directory_path() / "TextureBenchmarks.dds";
+			if (!LS::writeDds(path, compressed ? DXGI_BC7_UNORM : DXGI_R8G8B8A8_UNORM, size, size, spans))
+			{
+				std::fprintf(stderr, "Cannot write %s\n", path.string().c_str());
+				return 1;
+			}
+
+			// Texels and bytes of the whole chain, and of the first step alone
+			const LS::TextureFile probe(path);
+			double texels[2] = {};
+			double bytes[2] = {};
+			for (const auto& mip : probe.Header().levels)
+			{
+				texels[0] += static_cast<double>(mip.width) * mip.height;
+				bytes[0] += static_cast<double>(mip.size);
+			}
+			const auto first = LS::MipStream(probe.Header(), PITCH_ALIGNMENT).Take(STREAM_BUDGET);
+			for (const auto& copy : first)
+			{
+				const auto& mip = probe.Level(copy.level);
+				texels[1] += static_cast<double>(mip.width) * mip.height * copy.rows / mip.rows;
+				bytes[1] += static_cast<double>(copy.rows) * mip.rowBytes;
+			}
+
+			Staging reference(probe.Header());
+			for (uint32_t level = 0; level < probe.LevelCount(); ++level)
+			{
+				probe.CopyLevel(level, reference.bytes.data() + reference.offsets[level], reference.pitches[level]);
+			}
+			Staging staging(probe.Header());
+			const auto run = [&](std::string_view name, auto&& copy)
+				{
+					const auto step = name == "stream_first" ? 1 : 0;
+					std::fill(staging.bytes.begin(), staging.bytes.end(), std::byte{ 0 });
+					auto result = measure(options, size, texels[step], bytes[step], copy, [&]() { return staging.Checksum(); });
+					result.pattern = name;
+					result.texelFormat = compressed ? "bc7" : "rgba8";
+					result.simd = "scalar";
+					// The first step only completes the coarsest levels, which sit at the end
+					const auto finest = first.back().last ? first.back().level : first.back().level + 1;
+					const auto from = step == 1 ? reference.offsets[finest] : 0;
+					result.matchesScalar = std::equal(staging.bytes.begin() + from, staging.bytes.end(), reference.bytes.begin() + from);
+					matched &= result.matchesScalar;
+					report(options, out, result);
+				};
+			run("stream_read", [&]()
+				{
+					const auto file = readFile(path);
+					const auto header = LS::parseTextureHeader(file);
+					for (uint32_t level = 0; level < header.levels.size(); ++level)
+					{
+						LS::copyLevel(file, header.levels[level], staging.bytes.data() + staging.offsets[level], staging.pitches[level]);
+					}
+				});
+			run("stream_mapped", [&]()
+				{
+					streamLevels(LS::TextureFile(path), staging, false);
+				});
+			run("stream_first", [&]()
+				{
+					streamLevels(LS::TextureFile(path), staging, true);
+				});
+			std::filesystem::remove(path);
+		}
+	}
+	if (!matched)
+	{
+		std::fprintf(stderr, "Some runs wrote different texels than the scalar single threaded run\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,308 @@
+// DDS and KTX2 header parsing against damaged files. A valid DDS from writeDds and a valid KTX2 built here are
+// parsed and their levels copied, then mutated: cut at every length through the headers and the level index and
+// short of the last level, given a wrong magic or identifier, an unsupported format or dimension, a mip count past
+// the full chain, dimensions the data does not cover, or level sizes and offsets outside the file. Each has to be
+// rejected with a runtime_error. Every buffer is parsed from an allocation of exactly its size, so reads past the
+// end show up under a sanitizer.
+//
+//   TextureContainerTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include "TestCheck.h"
+
+import TextureContainer;
+import MappedFile;
+
+namespace
+{
+	constexpr uint32_t DXGI_R32G32B32A32_FLOAT = 2;
+	constexpr uint32_t DXGI_R8G8B8A8_UNORM = 28;
+	constexpr uint32_t DXGI_BC1_TYPELESS = 70;
+	constexpr uint32_t DXGI_BC1_UNORM = 71;
+	constexpr uint32_t VK_FORMAT_R8G8B8A8_UNORM = 37;
+	constexpr uint32_t WIDTH = 8;
+	constexpr uint32_t HEIGHT = 4;
+	constexpr uint32_t LEVELS = 4;// The full chain of 8 x 4
+
+	// Byte offsets in a DDS file with the DX10 header
+	constexpr size_t DDS_FLAGS = 8;
+	constexpr size_t DDS_HEIGHT = 12;
+	constexpr size_t DDS_WIDTH = 16;
+	constexpr size_t DDS_MIP_COUNT = 28;
+	constexpr size_t DDS_FORMAT_FLAGS = 80;
+	constexpr size_t DDS_FOURCC = 84;
+	constexpr size_t DDS_CAPS2 = 112;
+	constexpr size_t DDS_DXGI_FORMAT = 128;
+	constexpr size_t DDS_DIMENSION = 132;
+	constexpr size_t DDS_MISC_FLAG = 136;
+	constexpr size_t DDS_ARRAY_SIZE = 140;
+	constexpr size_t DDS_DATA = 148;
+
+	// Byte offsets in a KTX2 file
+	constexpr size_t KTX2_FORMAT = 12;
+	constexpr size_t KTX2_WIDTH = 20;
+	constexpr size_t KTX2_HEIGHT = 24;
+	constexpr size_t KTX2_DEPTH = 28;
+	constexpr size_t KTX2_FACES = 36;
+	constexpr size_t KTX2_LEVEL_COUNT = 40;
+	constexpr size_t KTX2_SUPERCOMPRESSION = 44;
+	constexpr size_t KTX2_LEVEL_INDEX = 80;
+	constexpr size_t KTX2_LEVEL_ENTRY = 24;// byteOffset, byteLength and uncompressedByteLength
+	constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	template<class T>
+	void put(std::vector<std::byte>& bytes, size_t offset, T value)
+	{
+		std::memcpy(bytes.data() + offset, &value, sizeof(T));
+	}
+
+	template<class T>
+	T get(const std::vector<std::byte>& bytes, size_t offset)
+	{
+		T value;
+		std::memcpy(&value, bytes.data() + offset, sizeof(T));
+		return value;
+	}
+
+	size_t levelBytes(uint32_t level)
+	{
+		return static_cast<size_t>(std::max(1u, WIDTH >> level)) * std::max(1u, HEIGHT >> level) * 4;
+	}
+
+	std::vector<std::byte> levelData(uint32_t level)
+	{
+		std::vector<std::byte> bytes(levelBytes(level));
+		for (size_t i = 0; i < bytes.size(); ++i)
+		{
+			bytes[i] = static_cast<std::byte>(i * 7 + level * 61);
+		}
+		return bytes;
+	}
+
+	std::vector<std::byte> validDds(const std::filesystem::path& directory)
+	{
+		std::vector<std::vector<std::byte>> data;
+		std::vector<std::span<const std::byte>> levels;
+		for (uint32_t level = 0; level < LEVELS; ++level)
+		{
+			data.push_back(levelData(level));
+		}
+		for (const auto& level : data)
+		{
+			levels.emplace_back(level);
+		}
+		const auto path = directory / "valid.dds";
+		CHECK(LS::writeDds(path, DXGI_R8G8B8A8_UNORM, WIDTH, HEIGHT, levels));
+		const Data::MappedFile file(path);
+		const auto bytes = file.Bytes();
+		return { bytes.begin(), bytes.end() };
+	}
+
+	// Level index first, then the levels smallest first as KTX2 stores them
+	std::vector<std::byte> validKtx2()
+	{
+		auto offset = KTX2_LEVEL_INDEX + LEVELS * KTX2_LEVEL_ENTRY;
+		size_t size = offset;
+		for (uint32_t level = 0; level < LEVELS; ++level)
+		{
+			size += levelBytes(level);
+		}
+
+		std::vector<std::byte> bytes(size);
+		std::memcpy(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		put(bytes, KTX2_FORMAT, VK_FORMAT_R8G8B8A8_UNORM);
+		put(bytes, KTX2_FORMAT + 4, uint32_t{ 1 });// typeSize
+		put(bytes, KTX2_WIDTH, WIDTH);
+		put(bytes, KTX2_HEIGHT, HEIGHT);
+		put(bytes, KTX2_FACES, uint32_t{ 1 });
+		put(bytes, KTX2_LEVEL_COUNT, LEVELS);
+		for (uint32_t level = LEVELS; level-- > 0;)
+		{
+			const auto data = levelData(level);
+			const auto entry = KTX2_LEVEL_INDEX + level * KTX2_LEVEL_ENTRY;
+			put(bytes, entry, uint64_t{ offset });
+			put(bytes, entry + 8, uint64_t{ data.size() });
+			put(bytes, entry + 16, uint64_t{ data.size() });
+			std::memcpy(bytes.data() + offset, data.data(), data.size());
+			offset += data.size();
+		}
+		return bytes;
+	}
+
+	// Parses a copy of bytes that is exactly their size and copies out every level. False when it is rejected.
+	bool parses(std::span<const std::byte> bytes)
+	{
+		const std::vector<std::byte> copy(bytes.begin(), bytes.end());
+		LS::TextureHeader header;
+		try
+		{
+			header = LS::parseTextureHeader(copy);
+		}
+		catch (const std::runtime_error&)
+		{
+			return false;
+		}
+
+		for (const auto& level : header.levels)
+		{
+			CHECK(level.offset <= copy.size() && level.size <= copy.size() - level.offset);
+			CHECK(level.size == level.rowBytes * level.rows);
+			std::vector<std::byte> destination(level.size);
+			LS::copyLevel(copy, level, destination.data(), level.rowBytes);
+		}
+		return true;
+	}
+
+	// The levels come back where the file has them, with the data written
+	void checkValid(const std::vector<std::byte>& bytes, LS::CONTAINER container)
+	{
+		const auto header = LS::parseTextureHeader(bytes);
+		CHECK(header.container == container);
+		CHECK(header.format.dxgiFormat == DXGI_R8G8B8A8_UNORM);
+		CHECK(header.width == WIDTH);
+		CHECK(header.height == HEIGHT);
+		CHECK(header.levels.size() == LEVELS);
+		for (uint32_t level = 0; level < header.levels.size() && level < LEVELS; ++level)
+		{
+			const auto& mip = header.levels[level];
+			const auto expected = levelData(level);
+			std::vector<std::byte> copied(mip.size);
+			LS::copyLevel(bytes, mip, copied.data(), mip.rowBytes);
+			CHECK(copied == expected);
+		}
+	}
+
+	// Every cut short of the whole file, through the headers and into the levels
+	void checkTruncations(const std::vector<std::byte>& bytes)
+	{
+		for (size_t size = 0; size < bytes.size(); ++size)
+		{
+			CHECK(!parses(std::span(bytes).first(size)));
+		}
+		CHECK(parses(bytes));
+	}
+
+	void testDds(const std::filesystem::path& directory)
+	{
+		const auto valid = validDds(directory);
+		CHECK(valid.size() == DDS_DATA + levelBytes(0) + levelBytes(1) + levelBytes(2) + levelBytes(3));
+		checkValid(valid, LS::CONTAINER::DDS);
+		checkTruncations(valid);
+
+		const auto mutated = [&](size_t offset, uint32_t value)
+		{
+			auto bytes = valid;
+			put(bytes, offset, value);
+			return bytes;
+		};
+
+		// Magic
+		CHECK(!parses(mutated(0, 0x20534443)));
+		// Header size
+		CHECK(!parses(mutated(4, 128)));
+		// More levels than the chain has, and more than the file holds
+		CHECK(!parses(mutated(DDS_MIP_COUNT, LEVELS + 1)));
+		CHECK(!parses(mutated(DDS_MIP_COUNT, 0xffffffff)));
+		CHECK(parses(mutated(DDS_MIP_COUNT, 2)));
+		// Dimensions the data does not cover, zero or past the D3D12 limit
+		CHECK(!parses(mutated(DDS_WIDTH, WIDTH * 2)));
+		CHECK(!parses(mutated(DDS_HEIGHT, 16384)));
+		CHECK(!parses(mutated(DDS_WIDTH, 0)));
+		CHECK(!parses(mutated(DDS_HEIGHT, 0x80000000)));
+		// Formats the loader does not know, and one whose levels need more than the file has
+		CHECK(!parses(mutated(DDS_DXGI_FORMAT, 0)));
+		CHECK(!parses(mutated(DDS_DXGI_FORMAT, 1000)));
+		CHECK(!parses(mutated(DDS_DXGI_FORMAT, DXGI_BC1_TYPELESS)));
+		CHECK(!parses(mutated(DDS_DXGI_FORMAT, DXGI_R32G32B32A32_FLOAT)));
+		CHECK(parses(mutated(DDS_DXGI_FORMAT, DXGI_BC1_UNORM)));
+		// Not 2D
+		CHECK(!parses(mutated(DDS_CAPS2, 0x200)));
+		CHECK(!parses(mutated(DDS_CAPS2, 0x200000)));
+		CHECK(!parses(mutated(DDS_DIMENSION, 4)));
+		CHECK(!parses(mutated(DDS_MISC_FLAG, 0x4)));
+		CHECK(!parses(mutated(DDS_ARRAY_SIZE, 6)));
+		// Legacy pixel formats without the DX10 header
+		const auto dxt3 = static_cast<uint32_t>('D') | 'X' << 8 | 'T' << 16 | '3' << 24;
+		CHECK(!parses(mutated(DDS_FOURCC, dxt3)));
+		CHECK(!parses(mutated(DDS_FORMAT_FLAGS, 0x40)));
+
+		// Without the mip count flag only the top level is read, whatever the count says
+		auto single = mutated(DDS_FLAGS, get<uint32_t>(valid, DDS_FLAGS) & ~0x20000u);
+		put(single, DDS_MIP_COUNT, uint32_t{ 0xffffffff });
+		CHECK(parses(single));
+		CHECK(LS::parseTextureHeader(single).levels.size() == 1);
+	}
+
+	void testKtx2()
+	{
+		const auto valid = validKtx2();
+		checkValid(valid, LS::CONTAINER::KTX2);
+		checkTruncations(valid);
+
+		const auto mutated = [&](size_t offset, auto value)
+		{
+			auto bytes = valid;
+			put(bytes, offset, value);
+			return bytes;
+		};
+		const auto entry = [](uint32_t level) { return KTX2_LEVEL_INDEX + level * KTX2_LEVEL_ENTRY; };
+
+		// Identifier, which leaves a file that is neither container
+		auto bytes = valid;
+		bytes[11] = std::byte{ 0 };
+		CHECK(!parses(bytes));
+		bytes = valid;
+		bytes[1] = std::byte{ 'L' };
+		CHECK(!parses(bytes));
+		// Formats, unknown to Vulkan or to the loader
+		CHECK(!parses(mutated(KTX2_FORMAT, uint32_t{ 0 })));
+		CHECK(!parses(mutated(KTX2_FORMAT, uint32_t{ 1000 })));
+		CHECK(!parses(mutated(KTX2_FORMAT, uint32_t{ 38 })));
+		// More levels than the chain has, or than the index holds
+		CHECK(!parses(mutated(KTX2_LEVEL_COUNT, LEVELS + 1)));
+		CHECK(!parses(mutated(KTX2_LEVEL_COUNT, uint32_t{ 0xffffffff })));
+		CHECK(parses(mutated(KTX2_LEVEL_COUNT, uint32_t{ 0 })));
+		// Dimensions the level sizes do not match
+		CHECK(!parses(mutated(KTX2_WIDTH, WIDTH * 2)));
+		CHECK(!parses(mutated(KTX2_HEIGHT, uint32_t{ 0 })));
+		CHECK(!parses(mutated(KTX2_WIDTH, uint32_t{ 0x80000000 })));
+		// Not 2D, or supercompressed
+		CHECK(!parses(mutated(KTX2_DEPTH, uint32_t{ 1 })));
+		CHECK(!parses(mutated(KTX2_FACES, uint32_t{ 6 })));
+		CHECK(!parses(mutated(KTX2_SUPERCOMPRESSION, uint32_t{ 1 })));
+
+		// Level sizes and offsets that do not fit the level or the file
+		for (uint32_t level = 0; level < LEVELS; ++level)
+		{
+			const auto offset = get<uint64_t>(valid, entry(level));
+			const auto length = get<uint64_t>(valid, entry(level) + 8);
+			CHECK(!parses(mutated(entry(level) + 8, length + 1)));
+			CHECK(!parses(mutated(entry(level) + 8, length - 1)));
+			CHECK(!parses(mutated(entry(level) + 8, uint64_t{ 0xffffffffffffffff })));
+			CHECK(!parses(mutated(entry(level), uint64_t{ valid.size() - length + 1 })));
+			CHECK(!parses(mutated(entry(level), uint64_t{ valid.size() + 1 })));
+			CHECK(!parses(mutated(entry(level), uint64_t{ 0xffffffffffffffff } - length + 1)));
+			CHECK(parses(mutated(entry(level), offset - 1)));
+		}
+	}
+}
+
+int main()
+{
+	const auto directory = std::filesystem::temp_directory_path() / "TextureContainerTests";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	testDds(directory);
+	testKtx2();
+
+	std::filesystem::remove_all(directory);
+	return Test::result("TextureContainerTests");
+}
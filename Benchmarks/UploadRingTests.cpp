@@ -0,0 +1,224 @@
+// UploadRing allocation and reclaim. Allocations have to come back aligned, inside the ring and clear of every
+// allocation not reclaimed yet, wrapping to the front when the end of the ring is too short for the aligned size.
+// Reclaim has to release exactly the batches whose fence value was reached, a full ring has to fail the allocation
+// and count it, and the high water mark has to be the most bytes ever in use. A random run of allocations, closes
+// and reclaims checks the same against a list of the live allocations.
+//
+//   UploadRingTests
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <random>
+#include "TestCheck.h"
+
+import UploadRing;
+
+namespace
+{
+	struct Allocation
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fenceValue;// 0 until the batch it belongs to is closed
+	};
+
+	void testWrap()
+	{
+		LS::UploadRing ring(256);
+		CHECK(ring.Allocate(100) == 0);
+		ring.Close(1);
+		CHECK(ring.Allocate(100) == 100);
+		ring.Close(2);
+		ring.Reclaim(1);
+		CHECK(ring.Used() == 100);
+
+		// 56 bytes are left at the end but aligned to 64 the allocation starts at 256, so it goes to the front
+		CHECK(ring.Allocate(48, 64) == 0);
+		CHECK(ring.Stats().wraps == 1);
+		// The skipped end counts as used until the batch is reclaimed
+		CHECK(ring.Used() == 100 + 56 + 48);
+		ring.Close(3);
+
+		// Only [48, 100) is free now, an aligned allocation that fits after alignment goes there
+		CHECK(ring.Allocate(32, 64) == 64);
+		CHECK(!ring.Allocate(16, 64));
+		ring.Close(4);
+
+		ring.Reclaim(4);
+		CHECK(ring.Used() == 0);
+		CHECK(ring.PendingBatches() == 0);
+		// An empty ring starts over from the front
+		CHECK(ring.Allocate(256) == 0);
+	}
+
+	void testAlignment()
+	{
+		LS::UploadRing ring(4096);
+		for (uint64_t size = 1; size < 40; ++size)
+		{
+			for (const uint64_t alignment : { 1, 2, 4, 16, 256 })
+			{
+				const auto offset = ring.Allocate(size, alignment);
+				if (!offset)
+				{
+					ring.Close(1);
+					ring.Reclaim(1);
+					continue;
+				}
+				CHECK(*offset % alignment == 0);
+				CHECK(*offset + size <= ring.Capacity());
+			}
+		}
+	}
+
+	void testReclaim()
+	{
+		LS::UploadRing ring(1024);
+		for (uint64_t fenceValue = 1; fenceValue <= 4; ++fenceValue)
+		{
+			CHECK(ring.Allocate(100));
+			ring.Close(fenceValue);
+		}
+		// A close with nothing allocated makes no batch
+		ring.Close(5);
+		CHECK(ring.PendingBatches() == 4);
+
+		ring.Reclaim(0);
+		CHECK(ring.PendingBatches() == 4);
+		CHECK(ring.OldestFenceValue() == 1);
+		ring.Reclaim(2);
+		CHECK(ring.PendingBatches() == 2);
+		CHECK(ring.OldestFenceValue() == 3);
+		CHECK(ring.Used() == 200);
+
+		// Allocations made since the last Close are not released by any fence value
+		CHECK(ring.Allocate(50));
+		ring.Reclaim(100);
+		CHECK(ring.PendingBatches() == 0);
+		CHECK(!ring.OldestFenceValue());
+		CHECK(ring.Used() == 50);
+	}
+
+	void testFull()
+	{
+		LS::UploadRing ring(256);
+		CHECK(!ring.Allocate(0));
+		CHECK(!ring.Allocate(257));
+		CHECK(ring.Stats().failedAllocations == 2);
+
+		CHECK(ring.Allocate(200) == 0);
+		CHECK(ring.Allocate(56) == 200);
+		CHECK(ring.Used() == 256);
+		CHECK(!ring.Allocate(1));
+		ring.Close(1);
+		CHECK(!ring.Allocate(1));
+		CHECK(ring.Stats().failedAllocations == 4);
+		CHECK(ring.Stats().allocations == 2);
+		CHECK(ring.Stats().allocatedBytes == 256);
+
+		ring.Reclaim(1);
+		CHECK(ring.Allocate(1) == 0);
+	}
+
+	void testHighWaterMark()
+	{
+		LS::UploadRing ring(1000);
+		CHECK(ring.HighWaterMark() == 0);
+		CHECK(ring.Allocate(300));
+		CHECK(ring.Allocate(200));
+		ring.Close(1);
+		CHECK(ring.HighWaterMark() == 500);
+		ring.Reclaim(1);
+		CHECK(ring.Allocate(100));
+		// Reclaiming lowers Used, not the mark
+		CHECK(ring.Used() == 100);
+		CHECK(ring.HighWaterMark() == 500);
+		CHECK(ring.Allocate(450));
+		CHECK(ring.HighWaterMark() == 550);
+	}
+
+	// Random allocations, closes and reclaims against the list of allocations still live
+	void testRandom(uint32_t seed)
+	{
+		constexpr uint64_t CAPACITY = 1 << 14;
+		LS::UploadRing ring(CAPACITY);
+		std::vector<Allocation> live;
+		std::mt19937 rng(seed);
+		uint64_t fenceValue = 0;
+		uint64_t completedValue = 0;
+		uint64_t highWaterMark = 0;
+
+		for (uint32_t step = 0; step < 20000; ++step)
+		{
+			const auto op = rng() % 10;
+			if (op < 7)
+			{
+				const uint64_t size = 1 + rng() % (CAPACITY / 4);
+				const uint64_t alignment = uint64_t{ 1 } << (rng() % 9);
+				const auto offset = ring.Allocate(size, alignment);
+				if (!offset)
+				{
+					// A ring with nothing live always fits what its capacity does
+					CHECK(!live.empty());
+					continue;
+				}
+				CHECK(*offset % alignment == 0);
+				CHECK(*offset + size <= CAPACITY);
+				for (const auto& other : live)
+				{
+					CHECK(*offset + size <= other.offset || other.offset + other.size <= *offset);
+				}
+				live.push_back(Allocation{ .offset = *offset, .size = size, .fenceValue = 0 });
+			}
+			else if (op < 9)
+			{
+				++fenceValue;
+				for (auto& allocation : live)
+				{
+					if (allocation.fenceValue == 0)
+					{
+						allocation.fenceValue = fenceValue;
+					}
+				}
+				ring.Close(fenceValue);
+			}
+			else
+			{
+				// The GPU is up to two batches behind
+				const auto behind = std::min<uint64_t>(rng() % 3, fenceValue);
+				completedValue = std::max(completedValue, fenceValue - behind);
+				ring.Reclaim(completedValue);
+				std::erase_if(live, [&](const Allocation& a) { return a.fenceValue != 0 && a.fenceValue <= completedValue; });
+			}
+
+			uint64_t liveBytes = 0;
+			for (const auto& allocation : live)
+			{
+				liveBytes += allocation.size;
+			}
+			// Used includes alignment and wrap padding on top of the sizes
+			CHECK(ring.Used() >= liveBytes);
+			CHECK(ring.Used() <= CAPACITY);
+			CHECK(live.empty() == (ring.Used() == 0));
+			highWaterMark = std::max(highWaterMark, ring.Used());
+			CHECK(ring.HighWaterMark() == highWaterMark);
+		}
+	}
+}
+
+int main()
+{
+	testWrap();
+	testAlignment();
+	testReclaim();
+	testFull();
+	testHighWaterMark();
+	for (uint32_t seed = 1; seed <= 4; ++seed)
+	{
+		testRandom(seed);
+	}
+	return Test::result("UploadRingTests");
+}
@@ -3,6 +3,7 @@ module;
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <variant>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -12,7 +13,7 @@ export module Application;
 
 import Window;
 import Shapes;
-import QuadTree;
+import SpatialIndex;
 
 namespace Application
 {
@@ -25,11 +26,19 @@ namespace Application
 		D
 	};
 
+	export enum class SPATIAL_INDEX
+	{
+		QUAD_TREE,
+		HASH_GRID
+	};
+
+	using SpatialIndexVariant = std::variant<Data::QuadTree<int>, Data::SpatialHashGrid<int>>;
+
 	export class App
 	{
 	public:
-		App(Application::LSWindow&& window) : m_quadTree(Data::Box{ .minPoint = Data::Point{.x = 0.0f, .y = 0.0f},
-			.maxPoint = Data::Point{.x = static_cast<float>(window.Width()), .y = static_cast<float>(window.Height())}}, 10)
+		App(Application::LSWindow&& window, SPATIAL_INDEX index = SPATIAL_INDEX::QUAD_TREE) :
+			m_spatialIndex(CreateSpatialIndex(index, window.Width(), window.Height()))
 		{
 			using namespace std::placeholders;
 			window.RegisterLMBDown([=]([[maybe_unused]] float x, [[maybe_unused]] float y, [[maybe_unused]] DWORD flags)
@@ -50,8 +59,8 @@ namespace Application
 			m_window = std::move(window);
 		}
 		
-		App(uint32_t x, uint32_t y, std::wstring_view title) : m_window(), m_quadTree(Data::Box{ .minPoint = Data::Point{.x = 0.0f, .y = 0.0f},
-			.maxPoint = Data::Point{.x = static_cast<float>(x), .y = static_cast<float>(y)}}, 10)
+		App(uint32_t x, uint32_t y, std::wstring_view title, SPATIAL_INDEX index = SPATIAL_INDEX::QUAD_TREE) : m_window(),
+			m_spatialIndex(CreateSpatialIndex(index, x, y))
 		{
 			using namespace std::placeholders;
 			m_window.initWindow(x, y, title);
@@ -120,7 +129,21 @@ namespace Application
 		Shape::IShape* pCurrShape;
 		Data::Point m_mouseClickDown;
 		Data::Point m_mouseClickUp;
-		Data::QuadTree<int> m_quadTree;
+		SpatialIndexVariant m_spatialIndex;
+
+		static SpatialIndexVariant CreateSpatialIndex(SPATIAL_INDEX index, uint32_t x, uint32_t y)
+		{
+			const auto region = Data::Box{ .minPoint = Data::Point{.x = 0.0f, .y = 0.0f},
+				.maxPoint = Data::Point{.x = static_cast<float>(x), .y = static_cast<float>(y)} };
+			switch (index)
+			{
+			case SPATIAL_INDEX::HASH_GRID:
+				return Data::SpatialHashGrid<int>(region, 32.0f);
+			case SPATIAL_INDEX::QUAD_TREE:
+			default:
+				return Data::QuadTree<int>(region, 10);
+			}
+		}
 
 		void Cleanup()
 		{
@@ -141,14 +164,13 @@ namespace Application
 			pCurrShape = pCircle;
 			m_widgets.emplace_back(pCircle);
 			m_window.addWidget(dynamic_cast<UI::Widget*>(pCircle));
-			auto node = Data::Node<int>{ 
-				.data = std::make_shared<int>(counter++), 
-				.region = {}, 
-				.position = {.x = static_cast<float>(dist.x),
-					.y = static_cast<float>(dist.y) } 
-			};
-			auto pInt = std::make_shared<Data::Node<int>>(node);
-			m_quadTree.Insert(pInt, { static_cast<float>(dist.x), static_cast<float>(dist.y) });
+			// The index stores the circle's centre, where the drag started, under the circle's id so picks map back to
+			// the widget; dist is the radius and is not a position
+			pCircle->m_id = counter;
+			std::visit([&](Data::SpatialIndex<int> auto& index)
+				{
+					index.Insert(counter++, m_mouseClickDown);
+				}, m_spatialIndex);
 		}
 
 		void OnLMBDown([[maybe_unused]] float dipPixelX, [[maybe_unused]] float dipPixelY, [[maybe_unused]] DWORD flags)
@@ -181,6 +203,7 @@ namespace Application
 				auto dist = Position{ abs(cast->Radius().x - dipPixelX), abs(cast->Radius().y - dipPixelY)};
 
 				cast->SetLength(dist.x, dist.y);
+				m_window.updateWidget(cast);
 			}
 		}
 	};
@@ -0,0 +1,1343 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#if defined(_M_X64) || defined(__x86_64__)
+#define LS_BLOCK_X86 1
+#include <immintrin.h>
+#endif
+// MSVC emits any intrinsic on request, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define LS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LS_TARGET_AVX2
+#endif
+export module BlockCompression;
+
+import BoxKernels;
+import Parallel;
+import TextureFormat;
+
+// Block compression of 8 bit RGBA textures into BC1, BC3 and BC7, and decoding back for checks. Every 4x4 block is
+// fitted on its own: endpoints along the block's principal axis, then each texel picks the nearest palette entry.
+// The nearest entry search is the inner loop of every fit and runs with SSE or AVX2 over the 16 texels at once,
+// picked through the BoxKernels SIMD level; every level picks the same indices. The quality preset refines the
+// endpoints by least squares against the picked indices and tries more encodings per block. BC7 is written in the
+// single subset modes 5 and 6; the decoder reads all eight modes, so blocks from other encoders can be checked too.
+namespace LS
+{
+	// Named like their DXGI_FORMAT counterparts, the _SRGB variants store the same blocks
+	export enum class BLOCK_FORMAT : uint32_t
+	{
+		BC1_UNORM,// RGB and 1 bit alpha, 8 bytes a block
+		BC3_UNORM,// RGB and interpolated alpha, 16 bytes a block
+		BC7_UNORM// RGBA, 16 bytes a block
+	};
+
+	export enum class COMPRESSION_QUALITY : uint32_t
+	{
+		FAST,// One fit along the principal axis, mode 6 only for BC7
+		QUALITY// Least squares refinement, and every alpha mode and BC7 mode and rotation the encoder knows
+	};
+
+	export uint32_t blockSize(BLOCK_FORMAT format)
+	{
+		return format == BLOCK_FORMAT::BC1_UNORM ? 8 : 16;
+	}
+
+	// Blocks across a size texels wide dimension, mips smaller than a block still take a whole one
+	export uint32_t blockCount(uint32_t size)
+	{
+		return std::max(1u, (size + 3) / 4);
+	}
+
+	// Where a block compressed texture goes, or comes from: width x height texels in rows of blocks rowPitch bytes
+	// apart, like the footprint of a block compressed subresource
+	export struct BlockData
+	{
+		std::byte* data = nullptr;
+		size_t rowPitch = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		BLOCK_FORMAT format = BLOCK_FORMAT::BC1_UNORM;
+
+		std::byte* Row(uint32_t blockY) const
+		{
+			return data + blockY * rowPitch;
+		}
+	};
+
+	namespace
+	{
+		constexpr uint32_t MIN_BLOCKS_PER_WORKER = 512;
+		constexpr uint32_t CHANNELS = 4;
+
+		// A block's texels as floats in [0, 255], one array per channel in R G B A order
+		struct Block
+		{
+			alignas(32) float c[CHANNELS][16];
+		};
+
+		// Up to 16 palette entries, each with a value per channel
+		using Palette = std::array<std::array<float, CHANNELS>, 16>;
+
+		struct Fit
+		{
+			float error = std::numeric_limits<float>::max();
+			uint8_t indices[16] = {};
+		};
+
+		// Weights of the second endpoint for 2, 3 and 4 bit BC7 indices, out of 64
+		constexpr uint32_t BC7_WEIGHTS2[4] = { 0, 21, 43, 64 };
+		constexpr uint32_t BC7_WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+		constexpr uint32_t BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		bool isBgra(TEXEL_FORMAT format)
+		{
+			return format == TEXEL_FORMAT::B8G8R8A8_UNORM || format == TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB;
+		}
+
+		void checkTexels(const TextureData& texels)
+		{
+			if (texelSize(texels.format) != 4 || texels.format == TEXEL_FORMAT::R32_FLOAT)
+				throw std::runtime_error("Block compression works on 8 bit RGBA or BGRA texels");
+		}
+
+		// Sums the errors in texel order, so the total does not depend on how the per texel errors were found
+		float total(const float* errors)
+		{
+			auto sum = 0.0f;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				sum += errors[i];
+			}
+			return sum;
+		}
+
+		// Nearest of entries palette entries for every texel, over channels [first, first + count). Ties go to the
+		// lower index.
+		void nearestScalar(const Block& block, uint32_t first, uint32_t count, const Palette& palette, uint32_t entries,
+			Fit& fit)
+		{
+			float errors[16];
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				auto best = std::numeric_limits<float>::max();
+				uint8_t index = 0;
+				for (uint32_t e = 0; e < entries; ++e)
+				{
+					auto distance = 0.0f;
+					for (auto c = first; c < first + count; ++c)
+					{
+						const auto d = block.c[c][i] - palette[e][c];
+						distance += d * d;
+					}
+					if (distance < best)
+					{
+						best = distance;
+						index = static_cast<uint8_t>(e);
+					}
+				}
+				errors[i] = best;
+				fit.indices[i] = index;
+			}
+			fit.error = total(errors);
+		}
+
+#if LS_BLOCK_X86
+		void nearestSse(const Block& block, uint32_t first, uint32_t count, const Palette& palette, uint32_t entries, Fit& fit)
+		{
+			alignas(16) float errors[16];
+			alignas(16) int32_t indices[16];
+			for (uint32_t group = 0; group < 16; group += 4)
+			{
+				auto best = _mm_set1_ps(std::numeric_limits<float>::max());
+				auto bestIndex = _mm_setzero_si128();
+				for (uint32_t e = 0; e < entries; ++e)
+				{
+					auto distance = _mm_setzero_ps();
+					for (auto c = first; c < first + count; ++c)
+					{
+						const auto d = _mm_sub_ps(_mm_load_ps(block.c[c] + group), _mm_set1_ps(palette[e][c]));
+						distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+					}
+					const auto closer = _mm_cmplt_ps(distance, best);
+					best = _mm_or_ps(_mm_and_ps(closer, distance), _mm_andnot_ps(closer, best));
+					const auto mask = _mm_castps_si128(closer);
+					bestIndex = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(static_cast<int>(e))), _mm_andnot_si128(mask, bestIndex));
+				}
+				_mm_store_ps(errors + group, best);
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices + group), bestIndex);
+			}
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				fit.indices[i] = static_cast<uint8_t>(indices[i]);
+			}
+			fit.error = total(errors);
+		}
+
+		LS_TARGET_AVX2 void nearestAvx2(const Block& block, uint32_t first, uint32_t count, const Palette& palette, uint32_t entries,
+			Fit& fit)
+		{
+			alignas(32) float errors[16];
+			alignas(32) int32_t indices[16];
+			for (uint32_t group = 0; group < 16; group += 8)
+			{
+				auto best = _mm256_set1_ps(std::numeric_limits<float>::max());
+				auto bestIndex = _mm256_setzero_si256();
+				for (uint32_t e = 0; e < entries; ++e)
+				{
+					auto distance = _mm256_setzero_ps();
+					for (auto c = first; c < first + count; ++c)
+					{
+						const auto d = _mm256_sub_ps(_mm256_load_ps(block.c[c] + group), _mm256_set1_ps(palette[e][c]));
+						distance = _mm256_add_ps(distance, _mm256_mul_ps(d, d));
+					}
+					const auto closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+					best = _mm256_blendv_ps(best, distance, closer);
+					bestIndex = _mm256_blendv_epi8(bestIndex, _mm256_set1_epi32(static_cast<int>(e)), _mm256_castps_si256(closer));
+				}
+				_mm256_store_ps(errors + group, best);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(indices + group), bestIndex);
+			}
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				fit.indices[i] = static_cast<uint8_t>(indices[i]);
+			}
+			fit.error = total(errors);
+		}
+#endif
+
+		Fit nearest(const Block& block, uint32_t first, uint32_t count, const Palette& palette, uint32_t entries)
+		{
+			Fit fit;
+#if LS_BLOCK_X86
+			const auto level = Data::simdLevel();
+			if (level == Data::SIMD_LEVEL::AVX2)
+			{
+				nearestAvx2(block, first, count, palette, entries, fit);
+				return fit;
+			}
+			if (level == Data::SIMD_LEVEL::SSE)
+			{
+				nearestSse(block, first, count, palette, entries, fit);
+				return fit;
+			}
+#endif
+			nearestScalar(block, first, count, palette, entries, fit);
+			return fit;
+		}
+
+		// Endpoints of a line through the texels of mask, over channels [first, first + count): the mean plus and
+		// minus the extent along the principal axis, found by power iteration on the covariance
+		void principalEndpoints(const Block& block, uint32_t first, uint32_t count, uint32_t mask, float (&low)[CHANNELS],
+			float (&high)[CHANNELS])
+		{
+			float mean[CHANNELS] = {};
+			float minimum[CHANNELS];
+			float maximum[CHANNELS];
+			uint32_t texels = 0;
+			for (auto c = first; c < first + count; ++c)
+			{
+				minimum[c] = 255.0f;
+				maximum[c] = 0.0f;
+			}
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if ((mask >> i & 1) == 0)
+					continue;
+				++texels;
+				for (auto c = first; c < first + count; ++c)
+				{
+					mean[c] += block.c[c][i];
+					minimum[c] = std::min(minimum[c], block.c[c][i]);
+					maximum[c] = std::max(maximum[c], block.c[c][i]);
+				}
+			}
+			if (texels == 0)
+			{
+				for (auto c = first; c < first + count; ++c)
+				{
+					low[c] = 0.0f;
+					high[c] = 0.0f;
+				}
+				return;
+			}
+			for (auto c = first; c < first + count; ++c)
+			{
+				mean[c] /= static_cast<float>(texels);
+			}
+
+			float covariance[CHANNELS][CHANNELS] = {};
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if ((mask >> i & 1) == 0)
+					continue;
+				for (auto a = first; a < first + count; ++a)
+				{
+					for (auto b = first; b < first + count; ++b)
+					{
+						covariance[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+					}
+				}
+			}
+
+			// The bounding box diagonal is a good first guess, and already right for blocks on a straight gradient
+			float axis[CHANNELS] = {};
+			for (auto c = first; c < first + count; ++c)
+			{
+				axis[c] = maximum[c] - minimum[c];
+			}
+			for (uint32_t iteration = 0; iteration < 4; ++iteration)
+			{
+				float next[CHANNELS] = {};
+				auto length = 0.0f;
+				for (auto a = first; a < first + count; ++a)
+				{
+					for (auto b = first; b < first + count; ++b)
+					{
+						next[a] += covariance[a][b] * axis[b];
+					}
+					length = std::max(length, std::abs(next[a]));
+				}
+				if (length == 0.0f)
+					break;
+				for (auto c = first; c < first + count; ++c)
+				{
+					axis[c] = next[c] / length;
+				}
+			}
+			auto lengthSquared = 0.0f;
+			for (auto c = first; c < first + count; ++c)
+			{
+				lengthSquared += axis[c] * axis[c];
+			}
+			if (lengthSquared == 0.0f)
+			{
+				for (auto c = first; c < first + count; ++c)
+				{
+					low[c] = mean[c];
+					high[c] = mean[c];
+				}
+				return;
+			}
+
+			auto lowest = std::numeric_limits<float>::max();
+			auto highest = -std::numeric_limits<float>::max();
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if ((mask >> i & 1) == 0)
+					continue;
+				auto t = 0.0f;
+				for (auto c = first; c < first + count; ++c)
+				{
+					t += (block.c[c][i] - mean[c]) * axis[c];
+				}
+				lowest = std::min(lowest, t);
+				highest = std::max(highest, t);
+			}
+			lowest /= lengthSquared;
+			highest /= lengthSquared;
+			for (auto c = first; c < first + count; ++c)
+			{
+				low[c] = std::clamp(mean[c] + lowest * axis[c], 0.0f, 255.0f);
+				high[c] = std::clamp(mean[c] + highest * axis[c], 0.0f, 255.0f);
+			}
+		}
+
+		// Least squares endpoints for the indices of fit, where weights[index] is how much of the second endpoint a
+		// texel with that index gets. Returns false when every texel of mask has the same weight.
+		bool refineEndpoints(const Block& block, uint32_t first, uint32_t count, uint32_t mask, const Fit& fit, const float* weights,
+			float (&low)[CHANNELS], float (&high)[CHANNELS])
+		{
+			auto aa = 0.0f;
+			auto ab = 0.0f;
+			auto bb = 0.0f;
+			float ax[CHANNELS] = {};
+			float bx[CHANNELS] = {};
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if ((mask >> i & 1) == 0)
+					continue;
+				const auto b = weights[fit.indices[i]];
+				const auto a = 1.0f - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (auto c = first; c < first + count; ++c)
+				{
+					ax[c] += a * block.c[c][i];
+					bx[c] += b * block.c[c][i];
+				}
+			}
+			const auto determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f)
+				return false;
+			for (auto c = first; c < first + count; ++c)
+			{
+				low[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+				high[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+			}
+			return true;
+		}
+
+		void loadBlock(const TextureData& source, uint32_t blockX, uint32_t blockY, Block& block)
+		{
+			const auto bgra = isBgra(source.format);
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				// Blocks past the edge repeat the last row and column
+				const auto* row = reinterpret_cast<const uint8_t*>(source.Row(std::min(blockY * 4 + y, source.height - 1)));
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					const auto* texel = row + std::min(blockX * 4 + x, source.width - 1) * 4;
+					const auto i = y * 4 + x;
+					block.c[0][i] = texel[bgra ? 2 : 0];
+					block.c[1][i] = texel[1];
+					block.c[2][i] = texel[bgra ? 0 : 2];
+					block.c[3][i] = texel[3];
+				}
+			}
+		}
+
+		// BC1 and BC3 color
+
+		uint32_t expand(uint32_t value, uint32_t bits)
+		{
+			return (value << (8 - bits)) | (value >> (2 * bits - 8));
+		}
+
+		uint16_t to565(const float (&color)[CHANNELS])
+		{
+			const auto r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+			const auto g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+			const auto b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+			return static_cast<uint16_t>(r << 11 | g << 5 | b);
+		}
+
+		std::array<uint32_t, 3> from565(uint16_t color)
+		{
+			return { expand(color >> 11 & 31, 5), expand(color >> 5 & 63, 6), expand(color & 31, 5) };
+		}
+
+		// Entries of a BC1 color block in index order. Four entries when c0 > c1 or when fourColors is forced, like
+		// BC3 does, otherwise three and transparent black.
+		std::array<std::array<uint32_t, 4>, 4> colorPalette(uint16_t c0, uint16_t c1, bool fourColors)
+		{
+			const auto a = from565(c0);
+			const auto b = from565(c1);
+			std::array<std::array<uint32_t, 4>, 4> palette = {};
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				palette[0][c] = a[c];
+				palette[1][c] = b[c];
+				if (fourColors || c0 > c1)
+				{
+					palette[2][c] = (2 * a[c] + b[c] + 1) / 3;
+					palette[3][c] = (a[c] + 2 * b[c] + 1) / 3;
+				}
+				else
+				{
+					palette[2][c] = (a[c] + b[c] + 1) / 2;
+					palette[3][c] = 0;
+				}
+			}
+			palette[0][3] = palette[1][3] = palette[2][3] = 255;
+			palette[3][3] = fourColors || c0 > c1 ? 255 : 0;
+			return palette;
+		}
+
+		struct ColorFit
+		{
+			uint16_t c0 = 0;
+			uint16_t c1 = 0;
+			Fit fit = {};
+		};
+
+		// Fits the RGB of the texels in mask with the palette c0 and c1 make, texels outside it take index 3
+		ColorFit fitColor(const Block& block, uint16_t c0, uint16_t c1, bool fourColors, uint32_t mask)
+		{
+			const auto entries = colorPalette(c0, c1, fourColors);
+			Palette palette = {};
+			for (uint32_t e = 0; e < 4; ++e)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					palette[e][c] = static_cast<float>(entries[e][c]);
+				}
+			}
+			ColorFit result{ .c0 = c0, .c1 = c1 };
+			result.fit = nearest(block, 0, 3, palette, fourColors ? 4 : 3);
+			if (mask != 0xffff)
+			{
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					if ((mask >> i & 1) == 0)
+					{
+						result.fit.indices[i] = 3;
+					}
+				}
+				// Transparent texels are exact, only the others count
+				float errors[16] = {};
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					if ((mask >> i & 1) == 0)
+						continue;
+					const auto& entry = palette[result.fit.indices[i]];
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						const auto d = block.c[c][i] - entry[c];
+						errors[i] += d * d;
+					}
+				}
+				result.fit.error = total(errors);
+			}
+			return result;
+		}
+
+		// A BC1 (transparent texels allowed) or BC3 (always four colors) color block
+		void encodeColor(const Block& block, COMPRESSION_QUALITY quality, bool bc1, uint8_t* out)
+		{
+			uint32_t opaque = 0;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if (!bc1 || block.c[3][i] >= 128.0f)
+				{
+					opaque |= 1u << i;
+				}
+			}
+			const auto fourColors = opaque == 0xffff;
+
+			float low[CHANNELS];
+			float high[CHANNELS];
+			principalEndpoints(block, 0, 3, opaque, low, high);
+			// Four color blocks need c0 > c1, three color blocks c0 <= c1
+			const auto order = [&](uint16_t a, uint16_t b)
+				{
+					return fourColors ? std::pair{ std::max(a, b), std::min(a, b) } : std::pair{ std::min(a, b), std::max(a, b) };
+				};
+			auto [c0, c1] = order(to565(high), to565(low));
+			auto best = fitColor(block, c0, c1, fourColors || !bc1, opaque);
+
+			if (quality == COMPRESSION_QUALITY::QUALITY && opaque != 0)
+			{
+				// Weight of c1 for each index
+				constexpr float FOUR[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				constexpr float THREE[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+				for (uint32_t iteration = 0; iteration < 2; ++iteration)
+				{
+					const auto fourEntries = fourColors || !bc1 || best.c0 > best.c1;
+					if (!refineEndpoints(block, 0, 3, opaque, best.fit, fourEntries ? FOUR : THREE, low, high))
+						break;
+					std::tie(c0, c1) = order(to565(low), to565(high));
+					const auto candidate = fitColor(block, c0, c1, fourColors || !bc1, opaque);
+					if (candidate.fit.error >= best.fit.error)
+						break;
+					best = candidate;
+				}
+			}
+
+			if (fourColors && best.c0 == best.c1)
+			{
+				// Equal endpoints read as three colors in BC1, index 0 is the color either way
+				std::fill(std::begin(best.fit.indices), std::end(best.fit.indices), uint8_t{ 0 });
+			}
+
+			std::memcpy(out, &best.c0, 2);
+			std::memcpy(out + 2, &best.c1, 2);
+			uint32_t indices = 0;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				indices |= static_cast<uint32_t>(best.fit.indices[i]) << (i * 2);
+			}
+			std::memcpy(out + 4, &indices, 4);
+		}
+
+		// BC3 alpha
+
+		// Eight interpolated values when a0 > a1, otherwise six and then 0 and 255
+		std::array<uint32_t, 8> alphaPalette(uint32_t a0, uint32_t a1)
+		{
+			std::array<uint32_t, 8> palette = { a0, a1 };
+			if (a0 > a1)
+			{
+				for (uint32_t i = 1; i < 7; ++i)
+				{
+					palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+				}
+			}
+			else
+			{
+				for (uint32_t i = 1; i < 5; ++i)
+				{
+					palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+			return palette;
+		}
+
+		struct AlphaFit
+		{
+			uint32_t a0 = 0;
+			uint32_t a1 = 0;
+			Fit fit;
+		};
+
+		AlphaFit fitAlpha(const Block& block, uint32_t a0, uint32_t a1)
+		{
+			const auto entries = alphaPalette(a0, a1);
+			Palette palette = {};
+			for (uint32_t e = 0; e < 8; ++e)
+			{
+				palette[e][3] = static_cast<float>(entries[e]);
+			}
+			return AlphaFit{ .a0 = a0, .a1 = a1, .fit = nearest(block, 3, 1, palette, 8) };
+		}
+
+		void encodeAlpha(const Block& block, COMPRESSION_QUALITY quality, uint8_t* out)
+		{
+			uint32_t lowest = 255;
+			uint32_t highest = 0;
+			// The six value mode has 0 and 255 for free, so its endpoints only need to span the values in between
+			uint32_t innerLowest = 255;
+			uint32_t innerHighest = 0;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const auto a = static_cast<uint32_t>(block.c[3][i]);
+				lowest = std::min(lowest, a);
+				highest = std::max(highest, a);
+				if (a != 0 && a != 255)
+				{
+					innerLowest = std::min(innerLowest, a);
+					innerHighest = std::max(innerHighest, a);
+				}
+			}
+
+			auto best = fitAlpha(block, highest, lowest);
+			if (quality == COMPRESSION_QUALITY::QUALITY && best.fit.error > 0.0f)
+			{
+				// Pulling the endpoints in trades the extremes for finer steps in between
+				for (uint32_t inHigh = 0; inHigh <= 2; ++inHigh)
+				{
+					for (uint32_t inLow = 0; inLow <= 2; ++inLow)
+					{
+						if (highest < lowest + inHigh + inLow + 1)
+							continue;
+						const auto candidate = fitAlpha(block, highest - inHigh, lowest + inLow);
+						if (candidate.fit.error < best.fit.error)
+						{
+							best = candidate;
+						}
+					}
+				}
+				if (innerLowest <= innerHighest)
+				{
+					const auto candidate = fitAlpha(block, innerLowest, innerHighest);
+					if (candidate.fit.error < best.fit.error)
+					{
+						best = candidate;
+					}
+				}
+			}
+
+			out[0] = static_cast<uint8_t>(best.a0);
+			out[1] = static_cast<uint8_t>(best.a1);
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				indices |= static_cast<uint64_t>(best.fit.indices[i]) << (i * 3);
+			}
+			for (uint32_t b = 0; b < 6; ++b)
+			{
+				out[2 + b] = static_cast<uint8_t>(indices >> (b * 8));
+			}
+		}
+
+		// BC7
+
+		// 128 bits written and read from the lowest bit up
+		struct Bits
+		{
+			uint64_t low = 0;
+			uint64_t high = 0;
+			uint32_t position = 0;
+
+			void Write(uint64_t value, uint32_t count)
+			{
+				if (position < 64)
+				{
+					low |= value << position;
+					if (position + count > 64 && position > 0)
+					{
+						high |= value >> (64 - position);
+					}
+				}
+				else
+				{
+					high |= value << (position - 64);
+				}
+				position += count;
+			}
+
+			uint32_t Read(uint32_t count)
+			{
+				uint64_t value;
+				if (position >= 64)
+				{
+					value = high >> (position - 64);
+				}
+				else
+				{
+					value = low >> position;
+					if (position + count > 64 && position > 0)
+					{
+						value |= high << (64 - position);
+					}
+				}
+				position += count;
+				return static_cast<uint32_t>(value & ((uint64_t{ 1 } << count) - 1));
+			}
+		};
+
+		struct Bc7Block
+		{
+			float error = std::numeric_limits<float>::max();
+			Bits bits = {};
+		};
+
+		uint32_t bc7Interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+		{
+			return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+		}
+
+		// Mode 6: RGBA endpoints of 7 bits and a p bit each, 4 bit indices
+		Bc7Block encodeMode6(const Block& block, COMPRESSION_QUALITY quality)
+		{
+			float low[CHANNELS];
+			float high[CHANNELS];
+			principalEndpoints(block, 0, 4, 0xffff, low, high);
+
+			struct Candidate
+			{
+				uint32_t q[2][CHANNELS];
+				uint32_t p[2];
+				Fit fit;
+			};
+			const auto fit = [&](const float (&e0)[CHANNELS], const float (&e1)[CHANNELS])
+				{
+					Candidate candidate;
+					const float* endpoints[2] = { e0, e1 };
+					for (uint32_t k = 0; k < 2; ++k)
+					{
+						// The p bit is the lowest bit of every channel, pick the one that lands closer
+						auto bestError = std::numeric_limits<float>::max();
+						for (uint32_t p = 0; p < 2; ++p)
+						{
+							uint32_t q[CHANNELS];
+							auto error = 0.0f;
+							for (uint32_t c = 0; c < CHANNELS; ++c)
+							{
+								q[c] = static_cast<uint32_t>(std::clamp(std::lround((endpoints[k][c] - static_cast<float>(p)) / 2.0f), 0l, 127l));
+								const auto d = static_cast<float>(q[c] * 2 + p) - endpoints[k][c];
+								error += d * d;
+							}
+							if (error < bestError)
+							{
+								bestError = error;
+								candidate.p[k] = p;
+								std::copy(std::begin(q), std::end(q), candidate.q[k]);
+							}
+						}
+					}
+					Palette palette = {};
+					for (uint32_t e = 0; e < 16; ++e)
+					{
+						for (uint32_t c = 0; c < CHANNELS; ++c)
+						{
+							palette[e][c] = static_cast<float>(bc7Interpolate(candidate.q[0][c] * 2 + candidate.p[0],
+								candidate.q[1][c] * 2 + candidate.p[1], BC7_WEIGHTS4[e]));
+						}
+					}
+					candidate.fit = nearest(block, 0, 4, palette, 16);
+					return candidate;
+				};
+
+			auto best = fit(low, high);
+			if (quality == COMPRESSION_QUALITY::QUALITY)
+			{
+				float weights[16];
+				for (uint32_t e = 0; e < 16; ++e)
+				{
+					weights[e] = static_cast<float>(BC7_WEIGHTS4[e]) / 64.0f;
+				}
+				for (uint32_t iteration = 0; iteration < 2; ++iteration)
+				{
+					if (!refineEndpoints(block, 0, 4, 0xffff, best.fit, weights, low, high))
+						break;
+					const auto candidate = fit(low, high);
+					if (candidate.fit.error >= best.fit.error)
+						break;
+					best = candidate;
+				}
+			}
+
+			// The first texel's index has an implied 0 top bit, swapping the endpoints makes it so
+			if (best.fit.indices[0] >= 8)
+			{
+				std::swap(best.q[0], best.q[1]);
+				std::swap(best.p[0], best.p[1]);
+				for (auto& index : best.fit.indices)
+				{
+					index = static_cast<uint8_t>(15 - index);
+				}
+			}
+
+			Bc7Block result{ .error = best.fit.error };
+			result.bits.Write(1u << 6, 7);
+			for (uint32_t c = 0; c < CHANNELS; ++c)
+			{
+				result.bits.Write(best.q[0][c], 7);
+				result.bits.Write(best.q[1][c], 7);
+			}
+			result.bits.Write(best.p[0], 1);
+			result.bits.Write(best.p[1], 1);
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				result.bits.Write(best.fit.indices[i], i == 0 ? 3 : 4);
+			}
+			return result;
+		}
+
+		// Mode 5: RGB endpoints of 7 bits and alpha endpoints of 8 bits with their own 2 bit indices. rotation swaps
+		// alpha with red, green or blue first, so the channel that varies on its own gets the separate indices.
+		Bc7Block encodeMode5(const Block& source, uint32_t rotation, COMPRESSION_QUALITY quality)
+		{
+			auto block = source;
+			if (rotation != 0)
+			{
+				std::swap(block.c[3], block.c[rotation - 1]);
+			}
+
+			float weights[4];
+			for (uint32_t e = 0; e < 4; ++e)
+			{
+				weights[e] = static_cast<float>(BC7_WEIGHTS2[e]) / 64.0f;
+			}
+
+			float low[CHANNELS];
+			float high[CHANNELS];
+			principalEndpoints(block, 0, 3, 0xffff, low, high);
+			uint32_t color[2][3];
+			const auto fitColor = [&]()
+				{
+					Palette palette = {};
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						color[0][c] = static_cast<uint32_t>(std::lround(low[c] * 127.0f / 255.0f));
+						color[1][c] = static_cast<uint32_t>(std::lround(high[c] * 127.0f / 255.0f));
+						for (uint32_t e = 0; e < 4; ++e)
+						{
+							palette[e][c] = static_cast<float>(bc7Interpolate(expand(color[0][c], 7), expand(color[1][c], 7), BC7_WEIGHTS2[e]));
+						}
+					}
+					return nearest(block, 0, 3, palette, 4);
+				};
+			auto colorFit = fitColor();
+
+			float alphaLow = 255.0f;
+			float alphaHigh = 0.0f;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				alphaLow = std::min(alphaLow, block.c[3][i]);
+				alphaHigh = std::max(alphaHigh, block.c[3][i]);
+			}
+			uint32_t alpha[2];
+			const auto fitAlpha = [&]()
+				{
+					Palette palette = {};
+					alpha[0] = static_cast<uint32_t>(std::lround(alphaLow));
+					alpha[1] = static_cast<uint32_t>(std::lround(alphaHigh));
+					for (uint32_t e = 0; e < 4; ++e)
+					{
+						palette[e][3] = static_cast<float>(bc7Interpolate(alpha[0], alpha[1], BC7_WEIGHTS2[e]));
+					}
+					return nearest(block, 3, 1, palette, 4);
+				};
+			auto alphaFit = fitAlpha();
+
+			if (quality == COMPRESSION_QUALITY::QUALITY)
+			{
+				const uint32_t savedColor[2][3] = { { color[0][0], color[0][1], color[0][2] }, { color[1][0], color[1][1], color[1][2] } };
+				if (refineEndpoints(block, 0, 3, 0xffff, colorFit, weights, low, high))
+				{
+					const auto candidate = fitColor();
+					if (candidate.error < colorFit.error)
+					{
+						colorFit = candidate;
+					}
+					else
+					{
+						std::memcpy(color, savedColor, sizeof(color));
+					}
+				}
+				float alphaEndpoints[2][CHANNELS] = {};
+				const uint32_t savedAlpha[2] = { alpha[0], alpha[1] };
+				if (refineEndpoints(block, 3, 1, 0xffff, alphaFit, weights, alphaEndpoints[0], alphaEndpoints[1]))
+				{
+					alphaLow = alphaEndpoints[0][3];
+					alphaHigh = alphaEndpoints[1][3];
+					const auto candidate = fitAlpha();
+					if (candidate.error < alphaFit.error)
+					{
+						alphaFit = candidate;
+					}
+					else
+					{
+						alpha[0] = savedAlpha[0];
+						alpha[1] = savedAlpha[1];
+					}
+				}
+			}
+
+			if (colorFit.indices[0] >= 2)
+			{
+				std::swap(color[0], color[1]);
+				for (auto& index : colorFit.indices)
+				{
+					index = static_cast<uint8_t>(3 - index);
+				}
+			}
+			if (alphaFit.indices[0] >= 2)
+			{
+				std::swap(alpha[0], alpha[1]);
+				for (auto& index : alphaFit.indices)
+				{
+					index = static_cast<uint8_t>(3 - index);
+				}
+			}
+
+			Bc7Block result{ .error = colorFit.error + alphaFit.error };
+			result.bits.Write(1u << 5, 6);
+			result.bits.Write(rotation, 2);
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				result.bits.Write(color[0][c], 7);
+				result.bits.Write(color[1][c], 7);
+			}
+			result.bits.Write(alpha[0], 8);
+			result.bits.Write(alpha[1], 8);
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				result.bits.Write(colorFit.indices[i], i == 0 ? 1 : 2);
+			}
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				result.bits.Write(alphaFit.indices[i], i == 0 ? 1 : 2);
+			}
+			return result;
+		}
+
+		void encodeBc7(const Block& block, COMPRESSION_QUALITY quality, uint8_t* out)
+		{
+			auto best = encodeMode6(block, quality);
+			if (quality == COMPRESSION_QUALITY::QUALITY)
+			{
+				for (uint32_t rotation = 0; rotation < 4; ++rotation)
+				{
+					const auto candidate = encodeMode5(block, rotation, quality);
+					if (candidate.error < best.error)
+					{
+						best = candidate;
+					}
+				}
+			}
+			std::memcpy(out, &best.bits.low, 8);
+			std::memcpy(out + 8, &best.bits.high, 8);
+		}
+
+		void encodeBlock(const Block& block, BLOCK_FORMAT format, COMPRESSION_QUALITY quality, uint8_t* out)
+		{
+			switch (format)
+			{
+			case BLOCK_FORMAT::BC1_UNORM:
+				encodeColor(block, quality, true, out);
+				break;
+			case BLOCK_FORMAT::BC3_UNORM:
+				encodeAlpha(block, quality, out);
+				encodeColor(block, quality, false, out + 8);
+				break;
+			case BLOCK_FORMAT::BC7_UNORM:
+				encodeBc7(block, quality, out);
+				break;
+			}
+		}
+
+		// Decoding, texels in R G B A order
+
+		using Texels = std::array<std::array<uint8_t, 4>, 16>;
+
+		void decodeColor(const uint8_t* in, bool fourColors, Texels& texels)
+		{
+			uint16_t c0;
+			uint16_t c1;
+			uint32_t indices;
+			std::memcpy(&c0, in, 2);
+			std::memcpy(&c1, in + 2, 2);
+			std::memcpy(&indices, in + 4, 4);
+			const auto palette = colorPalette(c0, c1, fourColors);
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const auto& entry = palette[indices >> (i * 2) & 3];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					texels[i][c] = static_cast<uint8_t>(entry[c]);
+				}
+			}
+		}
+
+		void decodeAlpha(const uint8_t* in, Texels& texels)
+		{
+			const auto palette = alphaPalette(in[0], in[1]);
+			uint64_t indices = 0;
+			for (uint32_t b = 0; b < 6; ++b)
+			{
+				indices |= static_cast<uint64_t>(in[2 + b]) << (b * 8);
+			}
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				texels[i][3] = static_cast<uint8_t>(palette[indices >> (i * 3) & 7]);
+			}
+		}
+
+		// Reads 16 indices of bits each, the first with its top bit implied
+		void readIndices(Bits& bits, uint32_t count, uint32_t (&indices)[16])
+		{
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				indices[i] = bits.Read(i == 0 ? count - 1 : count);
+			}
+		}
+
+		const uint32_t* bc7Weights(uint32_t bits)
+		{
+			return bits == 2 ? BC7_WEIGHTS2 : bits == 3 ? BC7_WEIGHTS3 : BC7_WEIGHTS4;
+		}
+
+		// Layout of each BC7 mode, from the format specification
+		struct Bc7Mode
+		{
+			uint32_t subsets = 0;
+			uint32_t partitionBits = 0;
+			uint32_t rotationBits = 0;
+			uint32_t indexModeBits = 0;
+			uint32_t colorBits = 0;// Per endpoint component, before the p-bit
+			uint32_t alphaBits = 0;// 0 for modes without alpha, which decode it as 255
+			uint32_t endpointPBits = 0;// 1 when every endpoint has its own p-bit
+			uint32_t sharedPBits = 0;// 1 when both endpoints of a subset share one
+			uint32_t indexBits = 0;
+			uint32_t secondaryIndexBits = 0;// Separate alpha indices, for modes 4 and 5
+		};
+
+		constexpr Bc7Mode BC7_MODES[8] =
+		{
+			{ .subsets = 3, .partitionBits = 4, .colorBits = 4, .endpointPBits = 1, .indexBits = 3 },
+			{ .subsets = 2, .partitionBits = 6, .colorBits = 6, .sharedPBits = 1, .indexBits = 3 },
+			{ .subsets = 3, .partitionBits = 6, .colorBits = 5, .indexBits = 2 },
+			{ .subsets = 2, .partitionBits = 6, .colorBits = 7, .endpointPBits = 1, .indexBits = 2 },
+			{ .subsets = 1, .rotationBits = 2, .indexModeBits = 1, .colorBits = 5, .alphaBits = 6, .indexBits = 2, .secondaryIndexBits = 3 },
+			{ .subsets = 1, .rotationBits = 2, .colorBits = 7, .alphaBits = 8, .indexBits = 2, .secondaryIndexBits = 2 },
+			{ .subsets = 1, .colorBits = 7, .alphaBits = 7, .endpointPBits = 1, .indexBits = 4 },
+			{ .subsets = 2, .partitionBits = 6, .colorBits = 5, .alphaBits = 5, .endpointPBits = 1, .indexBits = 2 }
+		};
+
+		// Two subset partitions, bit i is the subset of texel i
+		constexpr uint16_t BC7_PARTITIONS2[64] =
+		{
+			0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+			0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+			0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+			0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+			0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+			0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+			0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+			0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+		};
+
+		// Three subset partitions, bits 2i and 2i + 1 are the subset of texel i
+		constexpr uint32_t BC7_PARTITIONS3[64] =
+		{
+			0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+			0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+			0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+			0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+			0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+			0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+			0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+			0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+		};
+
+		// Texel whose index drops its top bit in the second subset of a two subset partition. Texel 0 is the anchor of
+		// the first subset in every partition.
+		constexpr uint8_t BC7_ANCHORS2[64] =
+		{
+			15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+			15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+			15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+			6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+		};
+
+		// Anchors of the second and third subsets of a three subset partition
+		constexpr uint8_t BC7_ANCHORS3[2][64] =
+		{
+			{
+				3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+				3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+				8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+				3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3
+			},
+			{
+				15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+				15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+				15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+				15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8
+			}
+		};
+
+		// Every mode, returns false for reserved blocks, which decode as zero
+		bool decodeBc7(const uint8_t* in, Texels& texels)
+		{
+			Bits bits;
+			std::memcpy(&bits.low, in, 8);
+			std::memcpy(&bits.high, in + 8, 8);
+			uint32_t mode = 0;
+			while (mode < 8 && bits.Read(1) == 0)
+			{
+				++mode;
+			}
+			if (mode == 8)
+			{
+				for (auto& texel : texels)
+				{
+					texel.fill(0);
+				}
+				return false;
+			}
+
+			const auto& layout = BC7_MODES[mode];
+			const auto partition = bits.Read(layout.partitionBits);
+			const auto rotation = bits.Read(layout.rotationBits);
+			const auto indexMode = bits.Read(layout.indexModeBits);
+
+			// Components in order, each with both endpoints of every subset, then the p-bits
+			uint32_t endpoints[3][2][4];
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const auto precision = c < 3 ? layout.colorBits : layout.alphaBits;
+				for (uint32_t s = 0; s < layout.subsets; ++s)
+				{
+					endpoints[s][0][c] = precision > 0 ? bits.Read(precision) : 255;
+					endpoints[s][1][c] = precision > 0 ? bits.Read(precision) : 255;
+				}
+			}
+			const auto pBits = layout.endpointPBits + layout.sharedPBits;
+			if (pBits > 0)
+			{
+				for (uint32_t s = 0; s < layout.subsets; ++s)
+				{
+					const auto p0 = bits.Read(1);
+					const auto p1 = layout.endpointPBits ? bits.Read(1) : p0;
+					for (uint32_t c = 0; c < 4; ++c)
+					{
+						if (c == 3 && layout.alphaBits == 0)
+							continue;
+						endpoints[s][0][c] = endpoints[s][0][c] << 1 | p0;
+						endpoints[s][1][c] = endpoints[s][1][c] << 1 | p1;
+					}
+				}
+			}
+			for (uint32_t s = 0; s < layout.subsets; ++s)
+			{
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					const auto precision = (c < 3 ? layout.colorBits : layout.alphaBits) + pBits;
+					if (precision > pBits)
+					{
+						endpoints[s][0][c] = expand(endpoints[s][0][c], precision);
+						endpoints[s][1][c] = expand(endpoints[s][1][c], precision);
+					}
+				}
+			}
+
+			uint32_t subset[16];
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				subset[i] = layout.subsets == 3 ? BC7_PARTITIONS3[partition] >> (i * 2) & 3 :
+					layout.subsets == 2 ? BC7_PARTITIONS2[partition] >> i & 1 : 0;
+			}
+
+			// The anchor texel of each subset stores its index with the top bit implied
+			uint32_t colorIndices[16];
+			uint32_t alphaIndices[16];
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const auto anchor = i == 0 ||
+					(layout.subsets == 2 && i == BC7_ANCHORS2[partition]) ||
+					(layout.subsets == 3 && (i == BC7_ANCHORS3[0][partition] || i == BC7_ANCHORS3[1][partition]));
+				colorIndices[i] = bits.Read(layout.indexBits - (anchor ? 1 : 0));
+			}
+			auto colorBits = layout.indexBits;
+			auto alphaBits = layout.indexBits;
+			if (layout.secondaryIndexBits > 0)
+			{
+				readIndices(bits, layout.secondaryIndexBits, alphaIndices);
+				alphaBits = layout.secondaryIndexBits;
+				// Mode 4's index mode bit gives the color the 3 bit indices and the alpha the 2 bit ones
+				if (indexMode)
+				{
+					std::swap(colorIndices, alphaIndices);
+					std::swap(colorBits, alphaBits);
+				}
+			}
+			else
+			{
+				std::copy(std::begin(colorIndices), std::end(colorIndices), alphaIndices);
+			}
+
+			const auto* colorWeights = bc7Weights(colorBits);
+			const auto* alphaWeights = bc7Weights(alphaBits);
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const auto& e = endpoints[subset[i]];
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					texels[i][c] = static_cast<uint8_t>(bc7Interpolate(e[0][c], e[1][c], colorWeights[colorIndices[i]]));
+				}
+				texels[i][3] = static_cast<uint8_t>(bc7Interpolate(e[0][3], e[1][3], alphaWeights[alphaIndices[i]]));
+				if (rotation != 0)
+				{
+					std::swap(texels[i][3], texels[i][rotation - 1]);
+				}
+			}
+			return true;
+		}
+	}
+
+	// Compresses source, 8 bit RGBA or BGRA texels, into destination, which has to be as large. Blocks that reach
+	// past the edge repeat the last row and column. Rows of blocks are split between up to threads workers, 0 uses
+	// every hardware thread, and the output does not depend on how many there are.
+	export void compressTexture(const TextureData& source, const BlockData& destination,
+		COMPRESSION_QUALITY quality = COMPRESSION_QUALITY::FAST, uint32_t threads = 0)
+	{
+		checkTexels(source);
+		if (source.width != destination.width || source.height != destination.height)
+			throw std::runtime_error("Compressed texture is not the size of its source");
+		if (source.width == 0 || source.height == 0)
+			return;
+
+		const auto blocksWide = blockCount(destination.width);
+		const auto blocksHigh = blockCount(destination.height);
+		const auto size = blockSize(destination.format);
+		const auto minRows = std::max<size_t>(1, MIN_BLOCKS_PER_WORKER / blocksWide);
+		Parallel::forChunks(blocksHigh, Parallel::workerCount(blocksHigh, minRows, threads), [&](size_t begin, size_t end, uint32_t)
+			{
+				Block block;
+				for (auto by = static_cast<uint32_t>(begin); by < end; ++by)
+				{
+					auto* out = reinterpret_cast<uint8_t*>(destination.Row(by));
+					for (uint32_t bx = 0; bx < blocksWide; ++bx)
+					{
+						loadBlock(source, bx, by, block);
+						encodeBlock(block, destination.format, quality, out + bx * size);
+					}
+				}
+			});
+	}
+
+	// Decodes source into destination, 8 bit RGBA or BGRA texels of the same size. Returns false when a BC7 block is
+	// reserved (no mode bit set), those texels are zero.
+	export bool decompressTexture(const BlockData& source, const TextureData& destination)
+	{
+		checkTexels(destination);
+		if (source.width != destination.width || source.height != destination.height)
+			throw std::runtime_error("Decompressed texture is not the size of its source");
+
+		const auto bgra = isBgra(destination.format);
+		const auto size = blockSize(source.format);
+		auto decoded = true;
+		Texels texels;
+		for (uint32_t by = 0; by * 4 < source.height; ++by)
+		{
+			const auto* row = reinterpret_cast<const uint8_t*>(source.Row(by));
+			for (uint32_t bx = 0; bx * 4 < source.width; ++bx)
+			{
+				const auto* in = row + bx * size;
+				switch (source.format)
+				{
+				case BLOCK_FORMAT::BC1_UNORM:
+					decodeColor(in, false, texels);
+					break;
+				case BLOCK_FORMAT::BC3_UNORM:
+					decodeColor(in + 8, true, texels);
+					decodeAlpha(in, texels);
+					break;
+				case BLOCK_FORMAT::BC7_UNORM:
+					decoded = decodeBc7(in, texels) && decoded;
+					break;
+				}
+
+				for (uint32_t y = 0; y < 4 && by * 4 + y < source.height; ++y)
+				{
+					auto* out = reinterpret_cast<uint8_t*>(destination.Row(by * 4 + y));
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < source.width; ++x)
+					{
+						const auto& texel = texels[y * 4 + x];
+						auto* o = out + (bx * 4 + x) * 4;
+						o[0] = texel[bgra ? 2 : 0];
+						o[1] = texel[1];
+						o[2] = texel[bgra ? 0 : 2];
+						o[3] = texel[3];
+					}
+				}
+			}
+		}
+		return decoded;
+	}
+
+	// Peak signal to noise ratio in dB between two 8 bit textures of the same size and layout, over the first channels
+	// channels of each texel, 3 leaves out alpha. Infinite when they are the same.
+	export double psnr(const TextureData& reference, const TextureData& test, uint32_t channels = 4)
+	{
+		checkTexels(reference);
+		checkTexels(test);
+		if (reference.width != test.width || reference.height != test.height || reference.format != test.format)
+			throw std::runtime_error("PSNR needs two textures of the same size and format");
+
+		channels = std::clamp(channels, 1u, 4u);
+
+		uint64_t sum = 0;
+		for (uint32_t y = 0; y < reference.height; ++y)
+		{
+			const auto* a = reinterpret_cast<const uint8_t*>(reference.Row(y));
+			const auto* b = reinterpret_cast<const uint8_t*>(test.Row(y));
+			for (uint32_t x = 0; x < reference.width * 4; x += 4)
+			{
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					const auto d = static_cast<int32_t>(a[x + c]) - static_cast<int32_t>(b[x + c]);
+					sum += static_cast<uint64_t>(d * d);
+				}
+			}
+		}
+		if (sum == 0)
+			return std::numeric_limits<double>::infinity();
+		const auto mse = static_cast<double>(sum) / (static_cast<double>(reference.width) * reference.height * channels);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+}
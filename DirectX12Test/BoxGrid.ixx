@@ -0,0 +1,365 @@
+module;
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+export module BoxGrid;
+
+export import QuadTree;
+import BoxKernels;
+
+namespace Data
+{
+	// Unbounded uniform grid of boxes. Every box is registered in each cell it overlaps, and only cells that hold
+	// something are kept (in a hash map keyed by cell coordinates), so the grid can cover a canvas of any size.
+	// Each cell keeps the bounds of its boxes as structure of arrays and is scanned with the batch kernels.
+	// Boxes spanning more than MAX_ENTRY_CELLS cells go to a separate list that every lookup scans, so one huge
+	// box does not flood the grid.
+	export
+	template <class T>
+		struct BoxGrid
+	{
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint64_t MAX_ENTRY_CELLS = 64;
+		// Boxes handed to the batch kernels per call, bounds the result buffer
+		static constexpr uint32_t SCAN_BATCH = 64;
+
+		struct Cell
+		{
+			BoxArrays bounds;
+			std::vector<uint32_t> entries;
+		};
+
+		struct Entry
+		{
+			T data;
+			Box bounds;
+			uint32_t next;// Next free entry when released
+			bool alive;
+			bool oversized;
+		};
+
+		struct CellRange
+		{
+			int32_t x0, y0, x1, y1;
+
+			// Widened first, a range over the whole clamped coordinate span is wider than int32_t holds
+			uint64_t Count() const
+			{
+				const auto width = int64_t{ x1 } - x0 + 1;
+				const auto height = int64_t{ y1 } - y0 + 1;
+				if (width <= 0 || height <= 0)
+					return 0;
+				return static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+			}
+
+			bool operator==(const CellRange&) const = default;
+		};
+
+		float cellSize;
+		float invCellSize;
+		std::unordered_map<uint64_t, Cell> cells;
+		Cell oversized;
+		std::vector<Entry> entries;
+		uint32_t freeEntries = NONE;
+		uint32_t size = 0;
+
+	public:
+		BoxGrid(float cell) : cellSize(cell),
+			invCellSize(1.0f / cell)
+		{
+		}
+
+		Handle Insert(const T& data, const Box& bounds)
+		{
+			uint32_t handle = freeEntries;
+			if (handle != NONE)
+			{
+				freeEntries = entries[handle].next;
+				entries[handle] = Entry{ .data = data, .bounds = bounds, .next = NONE, .alive = true, .oversized = false };
+			}
+			else
+			{
+				handle = static_cast<uint32_t>(entries.size());
+				entries.emplace_back(Entry{ .data = data, .bounds = bounds, .next = NONE, .alive = true, .oversized = false });
+			}
+
+			link(handle);
+			++size;
+			return handle;
+		}
+
+		bool Remove(Handle h)
+		{
+			if (!Contains(h))
+				return false;
+
+			unlink(h);
+			entries[h].alive = false;
+			entries[h].next = freeEntries;
+			freeEntries = h;
+			--size;
+			return true;
+		}
+
+		// Boxes that still cover the same cells are updated in place, the rest are re-registered
+		bool Move(Handle h, const Box& bounds)
+		{
+			if (!Contains(h))
+				return false;
+
+			auto& entry = entries[h];
+			const auto before = cellRange(entry.bounds);
+			const auto after = cellRange(bounds);
+			if (before == after || (entry.oversized && after.Count() > MAX_ENTRY_CELLS))
+			{
+				entry.bounds = bounds;
+				forEachCellOf(h, [&](Cell& cell)
+					{
+						cell.bounds.Set(find(cell, h), bounds);
+					});
+				return true;
+			}
+
+			unlink(h);
+			entry.bounds = bounds;
+			link(h);
+			return true;
+		}
+
+		// Calls fn(handle) once for every box overlapping the query box
+		template <class Fn>
+		void Query(const Box& box, Fn&& fn) const
+		{
+			scan(oversized, box, [&](uint32_t h) { fn(static_cast<Handle>(h)); });
+
+			const auto range = cellRange(box);
+			// A box covering more cells than are occupied is cheaper to answer with one pass over the occupied ones
+			if (range.Count() > cells.size())
+			{
+				for (const auto& [key, cell] : cells)
+				{
+					const auto x = static_cast<int32_t>(static_cast<uint32_t>(key));
+					const auto y = static_cast<int32_t>(static_cast<uint32_t>(key >> 32));
+					if (x >= range.x0 && x <= range.x1 && y >= range.y0 && y <= range.y1)
+					{
+						scanCell(cell, x, y, box, fn);
+					}
+				}
+				return;
+			}
+
+			for (auto y = range.y0; y <= range.y1; ++y)
+			{
+				for (auto x = range.x0; x <= range.x1; ++x)
+				{
+					const auto it = cells.find(cellKey(x, y));
+					if (it != cells.end())
+					{
+						scanCell(it->second, x, y, box, fn);
+					}
+				}
+			}
+		}
+
+		std::vector<Handle> Query(const Box& box) const
+		{
+			std::vector<Handle> result;
+			Query(box, [&result](Handle h) { result.emplace_back(h); });
+			return result;
+		}
+
+		// Calls fn(handle) for every box containing p. Only the cell under p and the oversized list are scanned.
+		template <class Fn>
+		void QueryPoint(const Point& p, Fn&& fn) const
+		{
+			const auto box = Box{ .minPoint = p, .maxPoint = p };
+			scan(oversized, box, [&](uint32_t h) { fn(static_cast<Handle>(h)); });
+
+			const auto it = cells.find(cellKey(cellCoord(p.x), cellCoord(p.y)));
+			if (it != cells.end())
+			{
+				scan(it->second, box, [&](uint32_t h) { fn(static_cast<Handle>(h)); });
+			}
+		}
+
+		bool Contains(Handle h) const
+		{
+			return h < entries.size() && entries[h].alive;
+		}
+
+		T& Get(Handle h)
+		{
+			return entries[h].data;
+		}
+
+		const T& Get(Handle h) const
+		{
+			return entries[h].data;
+		}
+
+		const Box& Bounds(Handle h) const
+		{
+			return entries[h].bounds;
+		}
+
+		uint32_t Size() const
+		{
+			return size;
+		}
+
+		float CellSize() const
+		{
+			return cellSize;
+		}
+
+		// Number of occupied cells
+		uint32_t CellCount() const
+		{
+			return static_cast<uint32_t>(cells.size());
+		}
+
+		void Clear()
+		{
+			cells.clear();
+			oversized.bounds.Clear();
+			oversized.entries.clear();
+			entries.clear();
+			freeEntries = NONE;
+			size = 0;
+		}
+
+	private:
+		int32_t cellCoord(float v) const
+		{
+			const auto c = std::floor(v * invCellSize);
+			// NaN overlaps nothing, so any cell does, but converting it to an integer is undefined
+			if (std::isnan(c))
+				return 0;
+			return static_cast<int32_t>(std::clamp(c, -2147483648.0f, 2147483520.0f));
+		}
+
+		CellRange cellRange(const Box& box) const
+		{
+			return CellRange{ .x0 = cellCoord(box.minPoint.x), .y0 = cellCoord(box.minPoint.y),
+				.x1 = cellCoord(box.maxPoint.x), .y1 = cellCoord(box.maxPoint.y) };
+		}
+
+		static uint64_t cellKey(int32_t x, int32_t y)
+		{
+			return (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x);
+		}
+
+		// Position of h within the cell's arrays; cells are small so a scan is enough
+		static uint32_t find(const Cell& cell, uint32_t h)
+		{
+			return static_cast<uint32_t>(std::find(cell.entries.begin(), cell.entries.end(), h) - cell.entries.begin());
+		}
+
+		template <class Fn>
+		void forEachCellOf(uint32_t h, Fn&& fn)
+		{
+			if (entries[h].oversized)
+			{
+				fn(oversized);
+				return;
+			}
+
+			const auto range = cellRange(entries[h].bounds);
+			for (auto y = range.y0; y <= range.y1; ++y)
+			{
+				for (auto x = range.x0; x <= range.x1; ++x)
+				{
+					fn(cells[cellKey(x, y)]);
+				}
+			}
+		}
+
+		void link(uint32_t h)
+		{
+			auto& entry = entries[h];
+			entry.oversized = cellRange(entry.bounds).Count() > MAX_ENTRY_CELLS;
+			forEachCellOf(h, [&](Cell& cell)
+				{
+					cell.bounds.Add(entry.bounds);
+					cell.entries.emplace_back(h);
+				});
+		}
+
+		// Swap-removes h from every cell it is registered in and drops cells that become empty
+		void unlink(uint32_t h)
+		{
+			const auto release = [h](Cell& cell)
+				{
+					const auto index = find(cell, h);
+					const auto last = static_cast<uint32_t>(cell.entries.size() - 1);
+					if (index != last)
+					{
+						cell.entries[index] = cell.entries[last];
+						cell.bounds.Set(index, cell.bounds.Get(last));
+					}
+					cell.entries.pop_back();
+					cell.bounds.minX.pop_back();
+					cell.bounds.minY.pop_back();
+					cell.bounds.maxX.pop_back();
+					cell.bounds.maxY.pop_back();
+				};
+
+			if (entries[h].oversized)
+			{
+				release(oversized);
+				return;
+			}
+
+			const auto range = cellRange(entries[h].bounds);
+			for (auto y = range.y0; y <= range.y1; ++y)
+			{
+				for (auto x = range.x0; x <= range.x1; ++x)
+				{
+					const auto it = cells.find(cellKey(x, y));
+					release(it->second);
+					if (it->second.entries.empty())
+					{
+						cells.erase(it);
+					}
+				}
+			}
+		}
+
+		// Calls fn(entry) for every box of the cell overlapping the query box
+		template <class Fn>
+		void scan(const Cell& cell, const Box& box, Fn&& fn) const
+		{
+			std::array<uint32_t, SCAN_BATCH> hits;
+			const auto count = cell.bounds.Size();
+			for (uint32_t first = 0; first < count; first += SCAN_BATCH)
+			{
+				const auto n = boxesOverlap(&cell.bounds.minX[first], &cell.bounds.minY[first], &cell.bounds.maxX[first],
+					&cell.bounds.maxY[first], std::min(count - first, SCAN_BATCH), box, hits.data());
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					fn(cell.entries[first + hits[i]]);
+				}
+			}
+		}
+
+		// A box registered in several cells is reported only by the cell holding the top left corner of its
+		// intersection with the query box, so every box comes out once without tracking what was already seen
+		template <class Fn>
+		void scanCell(const Cell& cell, int32_t x, int32_t y, const Box& box, Fn& fn) const
+		{
+			scan(cell, box, [&](uint32_t h)
+				{
+					const auto& bounds = entries[h].bounds;
+					if (cellCoord(std::max(bounds.minPoint.x, box.minPoint.x)) == x
+						&& cellCoord(std::max(bounds.minPoint.y, box.minPoint.y)) == y)
+					{
+						fn(static_cast<Handle>(h));
+					}
+				});
+		}
+	};
+}
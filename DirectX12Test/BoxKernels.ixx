@@ -0,0 +1,417 @@
+module;
+#include <cstdint>
+#include <bit>
+#include <atomic>
+#include <vector>
+#if defined(_M_X64) || defined(__x86_64__)
+#define LS_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+// MSVC emits any intrinsic on request, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define LS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LS_TARGET_AVX2
+#endif
+export module BoxKernels;
+
+import Geometry;
+
+// Batch containment and overlap tests over structure of arrays float coordinates. Every kernel writes the indices
+// of the elements that pass into out (which must hold count entries) in ascending order and returns how many did.
+// The comparisons are inclusive like Box::InBounds, Box::Intersects and Box::Contains. The widest instruction set
+// the CPU supports is picked on first use; setSimdLevel can pin a narrower one to compare against.
+namespace Data
+{
+	export enum class SIMD_LEVEL
+	{
+		SCALAR,
+		SSE,
+		AVX2
+	};
+
+	// Bounds of many boxes, one array per edge
+	export struct BoxArrays
+	{
+		std::vector<float> minX;
+		std::vector<float> minY;
+		std::vector<float> maxX;
+		std::vector<float> maxY;
+
+		uint32_t Add(const Box& box)
+		{
+			const auto index = Size();
+			minX.emplace_back(box.minPoint.x);
+			minY.emplace_back(box.minPoint.y);
+			maxX.emplace_back(box.maxPoint.x);
+			maxY.emplace_back(box.maxPoint.y);
+			return index;
+		}
+
+		void Set(uint32_t index, const Box& box)
+		{
+			minX[index] = box.minPoint.x;
+			minY[index] = box.minPoint.y;
+			maxX[index] = box.maxPoint.x;
+			maxY[index] = box.maxPoint.y;
+		}
+
+		Box Get(uint32_t index) const
+		{
+			return Box{ .minPoint = { minX[index], minY[index] }, .maxPoint = { maxX[index], maxY[index] } };
+		}
+
+		uint32_t Size() const
+		{
+			return static_cast<uint32_t>(minX.size());
+		}
+
+		void Clear()
+		{
+			minX.clear();
+			minY.clear();
+			maxX.clear();
+			maxY.clear();
+		}
+	};
+
+	namespace
+	{
+		using PointsKernel = uint32_t(*)(const float*, const float*, uint32_t, const Box&, uint32_t*);
+		using BoxesKernel = uint32_t(*)(const float*, const float*, const float*, const float*, uint32_t, const Box&, uint32_t*);
+
+		struct KernelTable
+		{
+			PointsKernel pointsInBox;
+			BoxesKernel boxesOverlap;
+			BoxesKernel boxesInside;
+		};
+
+		// Appends base + the index of every set bit of mask
+		uint32_t emitMask(uint32_t mask, uint32_t base, uint32_t* out, uint32_t n)
+		{
+			while (mask != 0)
+			{
+				out[n++] = base + static_cast<uint32_t>(std::countr_zero(mask));
+				mask &= mask - 1;
+			}
+			return n;
+		}
+
+		uint32_t pointsInBoxScalar(const float* xs, const float* ys, uint32_t count, const Box& box, uint32_t* out, uint32_t begin, uint32_t n)
+		{
+			for (auto i = begin; i < count; ++i)
+			{
+				if (xs[i] >= box.minPoint.x && ys[i] >= box.minPoint.y && xs[i] <= box.maxPoint.x && ys[i] <= box.maxPoint.y)
+				{
+					out[n++] = i;
+				}
+			}
+			return n;
+		}
+
+		uint32_t boxesOverlapScalar(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out, uint32_t begin, uint32_t n)
+		{
+			for (auto i = begin; i < count; ++i)
+			{
+				if (minX[i] <= box.maxPoint.x && maxX[i] >= box.minPoint.x && minY[i] <= box.maxPoint.y && maxY[i] >= box.minPoint.y)
+				{
+					out[n++] = i;
+				}
+			}
+			return n;
+		}
+
+		uint32_t boxesInsideScalar(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out, uint32_t begin, uint32_t n)
+		{
+			for (auto i = begin; i < count; ++i)
+			{
+				if (minX[i] >= box.minPoint.x && minY[i] >= box.minPoint.y && maxX[i] <= box.maxPoint.x && maxY[i] <= box.maxPoint.y)
+				{
+					out[n++] = i;
+				}
+			}
+			return n;
+		}
+
+		uint32_t pointsInBoxScalar(const float* xs, const float* ys, uint32_t count, const Box& box, uint32_t* out)
+		{
+			return pointsInBoxScalar(xs, ys, count, box, out, 0, 0);
+		}
+
+		uint32_t boxesOverlapScalar(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out)
+		{
+			return boxesOverlapScalar(minX, minY, maxX, maxY, count, box, out, 0, 0);
+		}
+
+		uint32_t boxesInsideScalar(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out)
+		{
+			return boxesInsideScalar(minX, minY, maxX, maxY, count, box, out, 0, 0);
+		}
+
+#if LS_KERNELS_X86
+		// SSE2 is part of x64, so these need no detection
+		uint32_t pointsInBoxSse(const float* xs, const float* ys, uint32_t count, const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm_set1_ps(box.minPoint.x);
+			const auto y0 = _mm_set1_ps(box.minPoint.y);
+			const auto x1 = _mm_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const auto x = _mm_loadu_ps(xs + i);
+				const auto y = _mm_loadu_ps(ys + i);
+				const auto in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, x0), _mm_cmple_ps(x, x1)),
+					_mm_and_ps(_mm_cmpge_ps(y, y0), _mm_cmple_ps(y, y1)));
+				n = emitMask(static_cast<uint32_t>(_mm_movemask_ps(in)), i, out, n);
+			}
+			return pointsInBoxScalar(xs, ys, count, box, out, i, n);
+		}
+
+		uint32_t boxesOverlapSse(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm_set1_ps(box.minPoint.x);
+			const auto y0 = _mm_set1_ps(box.minPoint.y);
+			const auto x1 = _mm_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const auto in = _mm_and_ps(
+					_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minX + i), x1), _mm_cmpge_ps(_mm_loadu_ps(maxX + i), x0)),
+					_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(minY + i), y1), _mm_cmpge_ps(_mm_loadu_ps(maxY + i), y0)));
+				n = emitMask(static_cast<uint32_t>(_mm_movemask_ps(in)), i, out, n);
+			}
+			return boxesOverlapScalar(minX, minY, maxX, maxY, count, box, out, i, n);
+		}
+
+		uint32_t boxesInsideSse(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+			const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm_set1_ps(box.minPoint.x);
+			const auto y0 = _mm_set1_ps(box.minPoint.y);
+			const auto x1 = _mm_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const auto in = _mm_and_ps(
+					_mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(minX + i), x0), _mm_cmple_ps(_mm_loadu_ps(maxX + i), x1)),
+					_mm_and_ps(_mm_cmpge_ps(_mm_loadu_ps(minY + i), y0), _mm_cmple_ps(_mm_loadu_ps(maxY + i), y1)));
+				n = emitMask(static_cast<uint32_t>(_mm_movemask_ps(in)), i, out, n);
+			}
+			return boxesInsideScalar(minX, minY, maxX, maxY, count, box, out, i, n);
+		}
+
+		// Ordered, non signalling compares: NaN coordinates never pass, matching the scalar code
+		LS_TARGET_AVX2 uint32_t pointsInBoxAvx2(const float* xs, const float* ys, uint32_t count, const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm256_set1_ps(box.minPoint.x);
+			const auto y0 = _mm256_set1_ps(box.minPoint.y);
+			const auto x1 = _mm256_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm256_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const auto x = _mm256_loadu_ps(xs + i);
+				const auto y = _mm256_loadu_ps(ys + i);
+				const auto in = _mm256_and_ps(
+					_mm256_and_ps(_mm256_cmp_ps(x, x0, _CMP_GE_OQ), _mm256_cmp_ps(x, x1, _CMP_LE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(y, y0, _CMP_GE_OQ), _mm256_cmp_ps(y, y1, _CMP_LE_OQ)));
+				n = emitMask(static_cast<uint32_t>(_mm256_movemask_ps(in)), i, out, n);
+			}
+			return pointsInBoxScalar(xs, ys, count, box, out, i, n);
+		}
+
+		LS_TARGET_AVX2 uint32_t boxesOverlapAvx2(const float* minX, const float* minY, const float* maxX, const float* maxY,
+			uint32_t count, const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm256_set1_ps(box.minPoint.x);
+			const auto y0 = _mm256_set1_ps(box.minPoint.y);
+			const auto x1 = _mm256_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm256_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const auto in = _mm256_and_ps(
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minX + i), x1, _CMP_LE_OQ),
+						_mm256_cmp_ps(_mm256_loadu_ps(maxX + i), x0, _CMP_GE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minY + i), y1, _CMP_LE_OQ),
+						_mm256_cmp_ps(_mm256_loadu_ps(maxY + i), y0, _CMP_GE_OQ)));
+				n = emitMask(static_cast<uint32_t>(_mm256_movemask_ps(in)), i, out, n);
+			}
+			return boxesOverlapScalar(minX, minY, maxX, maxY, count, box, out, i, n);
+		}
+
+		LS_TARGET_AVX2 uint32_t boxesInsideAvx2(const float* minX, const float* minY, const float* maxX, const float* maxY,
+			uint32_t count, const Box& box, uint32_t* out)
+		{
+			const auto x0 = _mm256_set1_ps(box.minPoint.x);
+			const auto y0 = _mm256_set1_ps(box.minPoint.y);
+			const auto x1 = _mm256_set1_ps(box.maxPoint.x);
+			const auto y1 = _mm256_set1_ps(box.maxPoint.y);
+			uint32_t n = 0;
+			uint32_t i = 0;
+			for (; i + 8 <= count; i += 8)
+			{
+				const auto in = _mm256_and_ps(
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minX + i), x0, _CMP_GE_OQ),
+						_mm256_cmp_ps(_mm256_loadu_ps(maxX + i), x1, _CMP_LE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(minY + i), y0, _CMP_GE_OQ),
+						_mm256_cmp_ps(_mm256_loadu_ps(maxY + i), y1, _CMP_LE_OQ)));
+				n = emitMask(static_cast<uint32_t>(_mm256_movemask_ps(in)), i, out, n);
+			}
+			return boxesInsideScalar(minX, minY, maxX, maxY, count, box, out, i, n);
+		}
+
+		// AVX2 needs the CPU flag and the OS saving the YMM registers on context switches
+		bool cpuHasAvx2()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			const bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+				return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			unsigned int a = 0, b = 0, c = 0, d = 0;
+			if (__get_cpuid_max(0, nullptr) < 7)
+				return false;
+			__get_cpuid(1, &a, &b, &c, &d);
+			const bool osxsave = (c & (1u << 27)) != 0;
+			const bool avx = (c & (1u << 28)) != 0;
+			if (!osxsave || !avx)
+				return false;
+			unsigned int xcr0Low, xcr0High;
+			__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+			if ((xcr0Low & 0x6) != 0x6)
+				return false;
+			__get_cpuid_count(7, 0, &a, &b, &c, &d);
+			return (b & (1u << 5)) != 0;
+#endif
+		}
+#endif
+
+		SIMD_LEVEL detectSimdLevel()
+		{
+#if LS_KERNELS_X86
+			return cpuHasAvx2() ? SIMD_LEVEL::AVX2 : SIMD_LEVEL::SSE;
+#else
+			return SIMD_LEVEL::SCALAR;
+#endif
+		}
+
+		KernelTable tableFor(SIMD_LEVEL level)
+		{
+#if LS_KERNELS_X86
+			if (level == SIMD_LEVEL::AVX2)
+				return KernelTable{ pointsInBoxAvx2, boxesOverlapAvx2, boxesInsideAvx2 };
+			if (level == SIMD_LEVEL::SSE)
+				return KernelTable{ pointsInBoxSse, boxesOverlapSse, boxesInsideSse };
+#endif
+			return KernelTable{ pointsInBoxScalar, boxesOverlapScalar, boxesInsideScalar };
+		}
+
+		struct Dispatch
+		{
+			SIMD_LEVEL supported;
+			std::atomic<SIMD_LEVEL> level;
+			KernelTable tables[3];
+
+			Dispatch() : supported(detectSimdLevel()),
+				level(supported),
+				tables{ tableFor(SIMD_LEVEL::SCALAR), tableFor(SIMD_LEVEL::SSE), tableFor(SIMD_LEVEL::AVX2) }
+			{
+			}
+
+			const KernelTable& active() const
+			{
+				return tables[static_cast<int>(level.load(std::memory_order_relaxed))];
+			}
+		};
+
+		Dispatch& dispatch()
+		{
+			static Dispatch instance;
+			return instance;
+		}
+	}
+
+	// Widest instruction set the CPU and OS support
+	export SIMD_LEVEL supportedSimdLevel()
+	{
+		return dispatch().supported;
+	}
+
+	export SIMD_LEVEL simdLevel()
+	{
+		return dispatch().level.load(std::memory_order_relaxed);
+	}
+
+	// Pins the kernels to level, clamped to what is supported. Returns the level in use afterwards.
+	export SIMD_LEVEL setSimdLevel(SIMD_LEVEL level)
+	{
+		auto& d = dispatch();
+		const auto clamped = static_cast<int>(level) < static_cast<int>(d.supported) ? level : d.supported;
+		d.level.store(clamped, std::memory_order_relaxed);
+		return clamped;
+	}
+
+	// Indices of the points (xs[i], ys[i]) inside box
+	export uint32_t pointsInBox(const float* xs, const float* ys, uint32_t count, const Box& box, uint32_t* out)
+	{
+		return dispatch().active().pointsInBox(xs, ys, count, box, out);
+	}
+
+	// Indices of the boxes that overlap box
+	export uint32_t boxesOverlap(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+		const Box& box, uint32_t* out)
+	{
+		return dispatch().active().boxesOverlap(minX, minY, maxX, maxY, count, box, out);
+	}
+
+	// Indices of the boxes that lie completely within box
+	export uint32_t boxesInside(const float* minX, const float* minY, const float* maxX, const float* maxY, uint32_t count,
+		const Box& box, uint32_t* out)
+	{
+		return dispatch().active().boxesInside(minX, minY, maxX, maxY, count, box, out);
+	}
+
+	export uint32_t boxesOverlap(const BoxArrays& boxes, const Box& box, uint32_t* out)
+	{
+		return boxesOverlap(boxes.minX.data(), boxes.minY.data(), boxes.maxX.data(), boxes.maxY.data(), boxes.Size(), box, out);
+	}
+
+	export uint32_t boxesInside(const BoxArrays& boxes, const Box& box, uint32_t* out)
+	{
+		return boxesInside(boxes.minX.data(), boxes.minY.data(), boxes.maxX.data(), boxes.maxY.data(), boxes.Size(), box, out);
+	}
+
+	// Hit test: indices of the boxes containing p (edges included)
+	export uint32_t boxesAt(const BoxArrays& boxes, const Point& p, uint32_t* out)
+	{
+		return boxesOverlap(boxes, Box{ .minPoint = p, .maxPoint = p }, out);
+	}
+}
@@ -0,0 +1,210 @@
+module;
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+export module Broadphase;
+
+export import Object;
+import Parallel;
+
+namespace Collision
+{
+	// Two overlapping proxies, a < b
+	export struct ProxyPair
+	{
+		uint32_t a;
+		uint32_t b;
+	};
+
+	// Sort and sweep broadphase over Box2D bounds. Proxies are kept sorted by their left edge from one call to the
+	// next, so when objects only move a little per frame the order is repaired with an insertion sort in close to
+	// linear time. The sweep runs over the bounds gathered into sorted structure of arrays and is split across
+	// workers by cutting the sorted x axis into chunks; each worker reports the pairs whose left box is in its chunk.
+	// Overlap is strict like checkCollision, boxes that only touch do not overlap.
+	export class SweepAndPrune
+	{
+	public:
+		uint32_t Add(const Box2D& bounds)
+		{
+			uint32_t proxy;
+			if (!m_free.empty())
+			{
+				proxy = m_free.back();
+				m_free.pop_back();
+				m_alive[proxy] = 1;
+			}
+			else
+			{
+				proxy = static_cast<uint32_t>(m_left.size());
+				m_left.emplace_back();
+				m_top.emplace_back();
+				m_right.emplace_back();
+				m_bottom.emplace_back();
+				m_alive.emplace_back(uint8_t{ 1 });
+			}
+
+			setBounds(proxy, bounds);
+			m_order.emplace_back(proxy);
+			++m_added;
+			return proxy;
+		}
+
+		void Update(uint32_t proxy, const Box2D& bounds)
+		{
+			if (proxy < m_alive.size() && m_alive[proxy])
+			{
+				setBounds(proxy, bounds);
+			}
+		}
+
+		void Remove(uint32_t proxy)
+		{
+			if (proxy >= m_alive.size() || !m_alive[proxy])
+				return;
+
+			// The id is recycled once the next FindPairs has dropped it from the sweep order
+			m_alive[proxy] = 0;
+			m_released.emplace_back(proxy);
+		}
+
+		// Returns every overlapping pair, grouped by the proxy with the smaller left edge in sweep order.
+		// The result stays valid until the next call.
+		const std::vector<ProxyPair>& FindPairs(uint32_t workers = 0)
+		{
+			sortProxies();
+
+			const auto count = m_order.size();
+			m_sortedLeft.resize(count);
+			m_sortedTop.resize(count);
+			m_sortedRight.resize(count);
+			m_sortedBottom.resize(count);
+
+			workers = Parallel::workerCount(count, 4096, workers);
+			Parallel::forChunks(count, workers, [this](size_t begin, size_t end, uint32_t)
+				{
+					for (auto i = begin; i < end; ++i)
+					{
+						const auto proxy = m_order[i];
+						m_sortedLeft[i] = m_left[proxy];
+						m_sortedTop[i] = m_top[proxy];
+						m_sortedRight[i] = m_right[proxy];
+						m_sortedBottom[i] = m_bottom[proxy];
+					}
+				});
+
+			m_workerPairs.resize(workers);
+			Parallel::forChunks(count, workers, [this, count](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& pairs = m_workerPairs[chunk];
+					pairs.clear();
+					for (auto i = begin; i < end; ++i)
+					{
+						const auto left = m_sortedLeft[i];
+						const auto right = m_sortedRight[i];
+						const auto top = m_sortedTop[i];
+						const auto bottom = m_sortedBottom[i];
+						for (auto j = i + 1; j < count && m_sortedLeft[j] < right; ++j)
+						{
+							if (left < m_sortedRight[j] && top < m_sortedBottom[j] && m_sortedTop[j] < bottom)
+							{
+								const auto a = m_order[i];
+								const auto b = m_order[j];
+								pairs.emplace_back(a < b ? ProxyPair{ a, b } : ProxyPair{ b, a });
+							}
+						}
+					}
+				});
+
+			m_pairs.clear();
+			for (uint32_t c = 0; c < workers; ++c)
+			{
+				m_pairs.insert(m_pairs.end(), m_workerPairs[c].begin(), m_workerPairs[c].end());
+			}
+			return m_pairs;
+		}
+
+		uint32_t Size() const
+		{
+			return static_cast<uint32_t>(m_left.size() - m_free.size() - m_released.size());
+		}
+
+		// Element moves the insertion sort of the last FindPairs needed to restore the sweep order
+		uint64_t LastSortSwaps() const
+		{
+			return m_lastSortSwaps;
+		}
+
+	private:
+		// Proxy bounds indexed by proxy id (structure of arrays)
+		std::vector<double> m_left;
+		std::vector<double> m_top;
+		std::vector<double> m_right;
+		std::vector<double> m_bottom;
+		std::vector<uint8_t> m_alive;
+		std::vector<uint32_t> m_free;
+		std::vector<uint32_t> m_released;
+		// Proxy ids sorted by left edge, carried over between calls
+		std::vector<uint32_t> m_order;
+		// Bounds gathered in sweep order
+		std::vector<double> m_sortedLeft;
+		std::vector<double> m_sortedTop;
+		std::vector<double> m_sortedRight;
+		std::vector<double> m_sortedBottom;
+		std::vector<std::vector<ProxyPair>> m_workerPairs;
+		std::vector<ProxyPair> m_pairs;
+		size_t m_added = 0;
+		uint64_t m_lastSortSwaps = 0;
+
+		void setBounds(uint32_t proxy, const Box2D& bounds)
+		{
+			m_left[proxy] = bounds.left;
+			m_top[proxy] = bounds.top;
+			m_right[proxy] = bounds.right;
+			m_bottom[proxy] = bounds.bottom;
+		}
+
+		// Proxies added since the last call sit unsorted at the tail of m_order. The coherent head is repaired with an
+		// insertion sort, the tail is sorted on its own and merged in, so a batch of new proxies costs O(n) extra
+		// instead of one shift across the whole order each.
+		void sortProxies()
+		{
+			const auto byLeft = [this](uint32_t a, uint32_t b) { return m_left[a] < m_left[b]; };
+			auto head = m_order.size() - m_added;
+			m_added = 0;
+
+			if (!m_released.empty())
+			{
+				const auto dead = [this](uint32_t proxy) { return !m_alive[proxy]; };
+				const auto headEnd = std::remove_if(m_order.begin(), m_order.begin() + head, dead);
+				const auto tailEnd = std::remove_if(m_order.begin() + head, m_order.end(), dead);
+				const auto newEnd = std::move(m_order.begin() + head, tailEnd, headEnd);
+				head = headEnd - m_order.begin();
+				m_order.erase(newEnd, m_order.end());
+				m_free.insert(m_free.end(), m_released.begin(), m_released.end());
+				m_released.clear();
+			}
+
+			uint64_t swaps = 0;
+			for (size_t i = 1; i < head; ++i)
+			{
+				const auto proxy = m_order[i];
+				const auto key = m_left[proxy];
+				auto j = i;
+				while (j > 0 && m_left[m_order[j - 1]] > key)
+				{
+					m_order[j] = m_order[j - 1];
+					--j;
+				}
+				m_order[j] = proxy;
+				swaps += i - j;
+			}
+			m_lastSortSwaps = swaps;
+
+			if (head < m_order.size())
+			{
+				std::sort(m_order.begin() + head, m_order.end(), byLeft);
+				std::inplace_merge(m_order.begin(), m_order.begin() + head, m_order.end(), byLeft);
+			}
+		}
+	};
+}
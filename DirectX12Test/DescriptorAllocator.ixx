@@ -0,0 +1,172 @@
+module;
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+export module DescriptorAllocator;
+
+import FrameTimeline;
+
+namespace LS
+{
+	export struct DescriptorAllocatorStats
+	{
+		uint64_t persistentAllocations = 0;
+		uint64_t persistentFrees = 0;
+		uint64_t transientAllocations = 0;
+		uint64_t failedAllocations = 0;
+	};
+
+	// Hands out slots of one descriptor heap, the heap is created once at its full size and never grows. The front
+	// persistentCount slots are for long lived views (textures, render targets) and are allocated and freed one at a
+	// time through a free list. After them every frame slot of the FrameTimeline owns transientPerFrame slots that are
+	// allocated linearly, in contiguous runs so they can back a descriptor table, and dropped all at once when the
+	// frame slot comes around again. Only indices are handed out, turning them into handles is up to the backend.
+	export class DescriptorAllocator
+	{
+	public:
+		explicit DescriptorAllocator(uint32_t persistentCount = 0, uint32_t transientPerFrame = 0) :
+			m_persistentCount(persistentCount),
+			m_transientPerFrame(transientPerFrame),
+			m_next(persistentCount),
+			m_freeHead(0)
+		{
+			for (uint32_t i = 0; i < persistentCount; ++i)
+			{
+				m_next[i] = i + 1;
+			}
+		}
+
+		// Slot for a view that lives until FreePersistent, or nothing when the persistent region is full
+		std::optional<uint32_t> AllocatePersistent()
+		{
+			if (m_freeHead == m_persistentCount)
+			{
+				++m_stats.failedAllocations;
+				return std::nullopt;
+			}
+
+			const auto index = m_freeHead;
+			m_freeHead = m_next[index];
+			m_next[index] = ALLOCATED;
+			++m_persistentUsed;
+			m_persistentHighWaterMark = std::max(m_persistentHighWaterMark, m_persistentUsed);
+			++m_stats.persistentAllocations;
+			return index;
+		}
+
+		// The caller has to make sure no submitted work still reads the slot
+		void FreePersistent(uint32_t index)
+		{
+			if (index >= m_persistentCount || m_next[index] != ALLOCATED)
+				throw std::runtime_error("Freeing a descriptor that is not an allocated persistent descriptor");
+
+			m_next[index] = m_freeHead;
+			m_freeHead = index;
+			--m_persistentUsed;
+			++m_stats.persistentFrees;
+		}
+
+		// First of count contiguous slots that are valid until the current frame slot is begun again, or nothing
+		// when the frame has used up its region
+		std::optional<uint32_t> AllocateTransient(uint32_t count = 1)
+		{
+			auto& frame = m_frames[m_slot];
+			if (count == 0 || count > m_transientPerFrame - frame.used)
+			{
+				++m_stats.failedAllocations;
+				return std::nullopt;
+			}
+
+			const auto index = m_persistentCount + m_slot * m_transientPerFrame + frame.used;
+			frame.used += count;
+			m_transientHighWaterMark = std::max(m_transientHighWaterMark, frame.used);
+			++m_stats.transientAllocations;
+			return index;
+		}
+
+		// Makes slot the frame transient allocations come from and drops what it held. completedValue is the fence
+		// value the GPU has reached, it has to cover the value the slot was ended with
+		void BeginFrame(uint32_t slot, uint64_t completedValue)
+		{
+			if (slot >= MAX_FRAMES_IN_FLIGHT)
+				throw std::runtime_error("Descriptor frame slot out of range");
+			if (m_frames[slot].fenceValue > completedValue)
+				throw std::runtime_error("Transient descriptors reset before the frame that used them completed");
+
+			m_slot = slot;
+			m_frames[slot].used = 0;
+		}
+
+		// The transient descriptors of the current frame are in use until the fence reaches fenceValue
+		void EndFrame(uint64_t fenceValue)
+		{
+			m_frames[m_slot].fenceValue = fenceValue;
+		}
+
+		// Slots in the heap the allocator expects, persistent and all frame regions
+		uint32_t Capacity() const
+		{
+			return m_persistentCount + m_transientPerFrame * MAX_FRAMES_IN_FLIGHT;
+		}
+
+		uint32_t PersistentCount() const
+		{
+			return m_persistentCount;
+		}
+
+		uint32_t TransientPerFrame() const
+		{
+			return m_transientPerFrame;
+		}
+
+		uint32_t PersistentUsed() const
+		{
+			return m_persistentUsed;
+		}
+
+		uint32_t PersistentHighWaterMark() const
+		{
+			return m_persistentHighWaterMark;
+		}
+
+		// Transient slots used by the current frame so far
+		uint32_t TransientUsed() const
+		{
+			return m_frames[m_slot].used;
+		}
+
+		// Most transient slots a single frame has used
+		uint32_t TransientHighWaterMark() const
+		{
+			return m_transientHighWaterMark;
+		}
+
+		const DescriptorAllocatorStats& Stats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		static constexpr uint32_t ALLOCATED = UINT32_MAX;// Free list link of a slot that is handed out
+
+		struct FrameRegion
+		{
+			uint32_t used = 0;
+			uint64_t fenceValue = 0;
+		};
+
+		uint32_t m_persistentCount;
+		uint32_t m_transientPerFrame;
+		std::vector<uint32_t> m_next;// Next free persistent slot, m_persistentCount ends the list
+		uint32_t m_freeHead;
+		uint32_t m_persistentUsed = 0;
+		uint32_t m_persistentHighWaterMark = 0;
+		std::array<FrameRegion, MAX_FRAMES_IN_FLIGHT> m_frames = {};
+		uint32_t m_slot = 0;
+		uint32_t m_transientHighWaterMark = 0;
+		DescriptorAllocatorStats m_stats;
+	};
+}
@@ -0,0 +1,208 @@
+module;
+#include <cstdint>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <concepts>
+export module FrameTimeline;
+
+namespace LS
+{
+	export constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+	// What the timeline needs from a queue and its fence. WaitForLatency blocks until the swap chain is ready to
+	// take another frame, for backends without a swap chain it can wait on the last frame submitted.
+	export
+	template <class Q>
+	concept FrameQueue = requires(Q& q, const Q& cq, uint64_t value)
+	{
+		q.Signal(value);
+		{ cq.CompletedValue() } -> std::convertible_to<uint64_t>;
+		q.WaitForValue(value);
+		q.WaitForLatency();
+	};
+
+	export struct FrameSample
+	{
+		uint64_t frame = 0;
+		uint64_t waitNanoseconds = 0;// Blocked on the fence for the frame slot
+		uint64_t latencyWaitNanoseconds = 0;// Blocked on the swap chain in low latency mode
+		uint32_t queueDepth = 0;// Frames submitted and not yet complete once the frame could start
+	};
+
+	export struct FrameTimelineStats
+	{
+		uint64_t frames = 0;
+		uint64_t waits = 0;// Frames that found their slot still in flight
+		uint64_t waitNanoseconds = 0;
+		uint64_t maxWaitNanoseconds = 0;
+		uint64_t latencyWaitNanoseconds = 0;
+		uint64_t queueDepthSum = 0;
+		uint32_t maxQueueDepth = 0;
+
+		double AverageWaitNanoseconds() const
+		{
+			return frames ? static_cast<double>(waitNanoseconds + latencyWaitNanoseconds) / static_cast<double>(frames) : 0.0;
+		}
+
+		double AverageQueueDepth() const
+		{
+			return frames ? static_cast<double>(queueDepthSum) / static_cast<double>(frames) : 0.0;
+		}
+	};
+
+	// Fence bookkeeping for a ring of frames in flight. Every frame signals the next value of one fence when it is
+	// submitted, and before frame n starts the CPU waits for frame n - depth. Per frame resources are indexed by
+	// FrameSlot(), which cycles over MAX_FRAMES_IN_FLIGHT slots whatever the depth, so the depth can change between
+	// any two frames: a slot is reused four frames later, and waiting for n - depth covers that for any depth.
+	export class FrameTimeline
+	{
+	public:
+		static constexpr uint32_t HISTORY_SIZE = 128;
+
+		explicit FrameTimeline(uint32_t framesInFlight = 3)
+		{
+			SetFramesInFlight(framesInFlight);
+		}
+
+		// Clamped to [1, MAX_FRAMES_IN_FLIGHT], applies from the next BeginFrame
+		uint32_t SetFramesInFlight(uint32_t count)
+		{
+			m_framesInFlight = std::clamp(count, 1u, MAX_FRAMES_IN_FLIGHT);
+			return m_framesInFlight;
+		}
+
+		uint32_t FramesInFlight() const
+		{
+			return m_framesInFlight;
+		}
+
+		// Waits on the swap chain before each frame so input is sampled as late as possible
+		void SetLowLatency(bool enabled)
+		{
+			m_lowLatency = enabled;
+		}
+
+		bool LowLatency() const
+		{
+			return m_lowLatency;
+		}
+
+		// Waits until the frame slot can be reused and returns it
+		template <FrameQueue Q>
+		uint32_t BeginFrame(Q& queue)
+		{
+			FrameSample sample{ .frame = m_frame };
+			if (m_lowLatency)
+			{
+				sample.latencyWaitNanoseconds = timed([&]() { queue.WaitForLatency(); });
+			}
+
+			if (m_frame >= m_framesInFlight)
+			{
+				const auto value = m_signalled[(m_frame - m_framesInFlight) % MAX_FRAMES_IN_FLIGHT];
+				if (queue.CompletedValue() < value)
+				{
+					sample.waitNanoseconds = timed([&]() { queue.WaitForValue(value); });
+					++m_stats.waits;
+				}
+			}
+
+			const uint64_t completed = queue.CompletedValue();
+			const auto oldest = m_frame - std::min<uint64_t>(m_frame, MAX_FRAMES_IN_FLIGHT);
+			for (auto f = oldest; f < m_frame; ++f)
+			{
+				sample.queueDepth += m_signalled[f % MAX_FRAMES_IN_FLIGHT] > completed ? 1 : 0;
+			}
+
+			++m_stats.frames;
+			m_stats.waitNanoseconds += sample.waitNanoseconds;
+			m_stats.maxWaitNanoseconds = std::max(m_stats.maxWaitNanoseconds, sample.waitNanoseconds);
+			m_stats.latencyWaitNanoseconds += sample.latencyWaitNanoseconds;
+			m_stats.queueDepthSum += sample.queueDepth;
+			m_stats.maxQueueDepth = std::max(m_stats.maxQueueDepth, sample.queueDepth);
+			m_latest = static_cast<uint32_t>(m_frame % HISTORY_SIZE);
+			m_history[m_latest] = sample;
+			return FrameSlot();
+		}
+
+		// Signals the end of the frame's work on the queue and moves to the next frame
+		template <FrameQueue Q>
+		void EndFrame(Q& queue)
+		{
+			queue.Signal(++m_lastValue);
+			m_signalled[m_frame % MAX_FRAMES_IN_FLIGHT] = m_lastValue;
+			++m_frame;
+		}
+
+		// Signals a new value after work submitted outside a frame and returns it, without waiting
+		template <FrameQueue Q>
+		uint64_t Signal(Q& queue)
+		{
+			queue.Signal(++m_lastValue);
+			return m_lastValue;
+		}
+
+		// Waits for everything submitted so far, frames and any work queued outside them
+		template <FrameQueue Q>
+		void Flush(Q& queue)
+		{
+			const auto value = Signal(queue);
+			if (queue.CompletedValue() < value)
+			{
+				queue.WaitForValue(value);
+			}
+		}
+
+		uint32_t FrameSlot() const
+		{
+			return static_cast<uint32_t>(m_frame % MAX_FRAMES_IN_FLIGHT);
+		}
+
+		uint64_t Frame() const
+		{
+			return m_frame;
+		}
+
+		// Value the queue signals once the current frame is done, valid after EndFrame
+		uint64_t LastSignalledValue() const
+		{
+			return m_lastValue;
+		}
+
+		const FrameTimelineStats& Stats() const
+		{
+			return m_stats;
+		}
+
+		void ResetStats()
+		{
+			m_stats = {};
+		}
+
+		// Sample of one of the last HISTORY_SIZE frames started, 0 is the most recent
+		const FrameSample& History(uint32_t age) const
+		{
+			return m_history[(m_latest + HISTORY_SIZE - std::min(age, HISTORY_SIZE - 1)) % HISTORY_SIZE];
+		}
+
+	private:
+		uint32_t m_framesInFlight = 3;
+		bool m_lowLatency = false;
+		uint64_t m_frame = 0;
+		uint64_t m_lastValue = 0;
+		std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> m_signalled = {};
+		std::array<FrameSample, HISTORY_SIZE> m_history = {};
+		uint32_t m_latest = 0;
+		FrameTimelineStats m_stats;
+
+		template <class Fn>
+		static uint64_t timed(Fn&& fn)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			fn();
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count());
+		}
+	};
+}
@@ -0,0 +1,106 @@
+module;
+#include <algorithm>
+#include <utility>
+export module Geometry;
+
+import Object;
+
+namespace Data
+{
+	export struct Point
+	{
+		float x, y;
+	};
+
+	export struct Box
+	{
+		Point minPoint;
+		Point maxPoint;
+
+		bool InBounds(const Point& p) const
+		{
+			return p.x >= minPoint.x && p.y >= minPoint.y
+				&& p.x <= maxPoint.x && p.y <= maxPoint.y;
+		}
+
+		bool Intersects(const Box& other) const
+		{
+			return minPoint.x <= other.maxPoint.x && maxPoint.x >= other.minPoint.x
+				&& minPoint.y <= other.maxPoint.y && maxPoint.y >= other.minPoint.y;
+		}
+
+		bool Contains(const Box& other) const
+		{
+			return other.minPoint.x >= minPoint.x && other.minPoint.y >= minPoint.y
+				&& other.maxPoint.x <= maxPoint.x && other.maxPoint.y <= maxPoint.y;
+		}
+
+		Point Center() const
+		{
+			return Point{ .x = (minPoint.x + maxPoint.x) * 0.5f, .y = (minPoint.y + maxPoint.y) * 0.5f };
+		}
+
+		Box Expanded(float amount) const
+		{
+			return Box{ .minPoint = { minPoint.x - amount, minPoint.y - amount },
+				.maxPoint = { maxPoint.x + amount, maxPoint.y + amount } };
+		}
+
+		// Squared distance from p to the closest point of the box, 0 when p is inside
+		float DistanceSquared(const Point& p) const
+		{
+			const auto dx = std::max({ minPoint.x - p.x, 0.0f, p.x - maxPoint.x });
+			const auto dy = std::max({ minPoint.y - p.y, 0.0f, p.y - maxPoint.y });
+			return dx * dx + dy * dy;
+		}
+
+		// Slab test of the segment origin + t * dir for t in [0, maxDist]. On a hit t is set to where the
+		// segment enters the box (0 when the origin is already inside).
+		bool Raycast(const Point& origin, const Point& dir, float maxDist, float& t) const
+		{
+			const float o[2] = { origin.x, origin.y };
+			const float d[2] = { dir.x, dir.y };
+			const float lo[2] = { minPoint.x, minPoint.y };
+			const float hi[2] = { maxPoint.x, maxPoint.y };
+			float tMin = 0.0f;
+			float tMax = maxDist;
+
+			for (int axis = 0; axis < 2; ++axis)
+			{
+				if (d[axis] == 0.0f)
+				{
+					if (o[axis] < lo[axis] || o[axis] > hi[axis])
+						return false;
+					continue;
+				}
+
+				const auto inv = 1.0f / d[axis];
+				auto t0 = (lo[axis] - o[axis]) * inv;
+				auto t1 = (hi[axis] - o[axis]) * inv;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+				}
+				tMin = std::max(tMin, t0);
+				tMax = std::min(tMax, t1);
+				if (tMin > tMax)
+					return false;
+			}
+
+			t = tMin;
+			return true;
+		}
+	};
+
+	// Converts window space Box2D bounds (top above bottom) to a float Box
+	export Box toBox(const Box2D& bounds)
+	{
+		return Box{ .minPoint = { static_cast<float>(bounds.left), static_cast<float>(bounds.top) },
+			.maxPoint = { static_cast<float>(bounds.right), static_cast<float>(bounds.bottom) } };
+	}
+
+	export Point toPoint(const Position& position)
+	{
+		return Point{ .x = static_cast<float>(position.x), .y = static_cast<float>(position.y) };
+	}
+}
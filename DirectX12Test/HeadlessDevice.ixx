@@ -0,0 +1,935 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <array>
+#include <deque>
+#include <string>
+#include <span>
+#include <chrono>
+#include <future>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+export module HeadlessDevice;
+
+import Parallel;
+import TextureFormat;
+import ProceduralTexture;
+
+export import RenderBackend;
+export import DescriptorAllocator;
+export import ResourceStateTracker;
+export import RenderQueue;
+
+namespace LS
+{
+	export enum class COMMAND_TYPE : uint32_t
+	{
+		RESOURCE_BARRIER,// One barrier call, value0 is the number of TRANSITION commands that follow it
+		TRANSITION,
+		SET_VIEWPORT,
+		SET_RENDER_TARGET,
+		CLEAR_RENDER_TARGET,
+		SET_PIPELINE_STATE,
+		SET_ROOT_SIGNATURE,
+		SET_DESCRIPTOR_HEAPS,
+		SET_DESCRIPTOR_TABLE,
+		SET_VERTEX_BUFFER,
+		DRAW,
+		EXECUTE_BUNDLE
+	};
+
+	// Bit masks like D3D12_RESOURCE_STATES, so they go through a ResourceStateTracker the same way
+	export enum class RESOURCE_STATE : uint32_t
+	{
+		PRESENT = 0,
+		RENDER_TARGET = 0x4,
+		PIXEL_SHADER_RESOURCE = 0x80
+	};
+
+	// One recorded command. object is the id of the resource, pipeline, root signature, vertex buffer or bundle used.
+	export struct Command
+	{
+		COMMAND_TYPE type;
+		uint32_t object = 0;
+		uint32_t value0 = 0;// Vertex count of a draw, transitions in a barrier, state before a transition
+		uint32_t value1 = 0;// Instance count of a draw, state after a transition
+		ColorRGBA color = {};// Clear color
+	};
+
+	// Fence completed by the simulated queue as it reaches each signal, never by the CPU
+	export class SimulatedFence
+	{
+	public:
+		uint64_t GetCompletedValue() const
+		{
+			return m_completedValue;
+		}
+
+		void Complete(uint64_t value)
+		{
+			m_completedValue = std::max(m_completedValue, value);
+		}
+
+	private:
+		uint64_t m_completedValue = 0;
+	};
+
+	export struct HeadlessOptions
+	{
+		// Executes submitted work with the software rasterizer. Without it commands are still validated, which
+		// leaves only the CPU side of the frame to measure.
+		bool rasterize = true;
+	};
+
+	export struct HeadlessStats
+	{
+		uint64_t frames = 0;
+		uint64_t commands = 0;// Recorded, bundle commands count once when the bundle is recorded
+		uint64_t draws = 0;// Executed, including the ones inside bundles
+		uint64_t pixels = 0;// Written by clears and draws
+		uint64_t queueNanoseconds = 0;// Spent executing submitted work, the simulated GPU time
+	};
+
+	// Render backend without a GPU. Commands are recorded into per frame allocators and submitted to a simulated
+	// queue that runs them (clearing and rasterizing into CPU back buffers) only when the CPU waits on its fence,
+	// so the CPU gets as far ahead as the frame ring allows, like it would against a busy GPU. Misuse the debug
+	// layer would catch (resetting an allocator in flight, wrong barrier states, drawing without state) throws.
+	export class HeadlessDevice : public RenderBackend
+	{
+	private:
+		static constexpr uint32_t BACK_BUFFER_COUNT = 3;
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint32_t DEFAULT_WIDTH = 1280;
+		static constexpr uint32_t DEFAULT_HEIGHT = 720;
+		static constexpr uint32_t TEXTURE_SIZE = 256;
+		// Same split of the view heap as the DX12 backend
+		static constexpr uint32_t PERSISTENT_DESCRIPTORS = 4096;
+		static constexpr uint32_t TRANSIENT_DESCRIPTORS = 1024;
+		static constexpr uint32_t MIN_DRAWS_PER_LIST = 256;// Same as the DX12 backend
+
+		// Object ids, back buffers are resources 0 to BACK_BUFFER_COUNT - 1
+		static constexpr uint32_t TEXTURE = BACK_BUFFER_COUNT;
+		static constexpr uint32_t PIPELINE_COLOR = 0;
+		static constexpr uint32_t PIPELINE_TEXTURED = 1;
+		static constexpr uint32_t ROOT_SIGNATURE_EMPTY = 0;
+		static constexpr uint32_t ROOT_SIGNATURE_TEXTURED = 1;
+		static constexpr uint32_t VERTEX_BUFFER_COLOR = 0;
+		static constexpr uint32_t VERTEX_BUFFER_TEXTURED = 1;
+		static constexpr uint32_t BUNDLE = 0;
+		static constexpr uint32_t LAYER_BACKGROUND = 0;
+		static constexpr uint32_t LAYER_SCENE = 1;
+
+		struct FrameContext
+		{
+			std::vector<Command> CommandAllocator;// Storage of everything recorded for the frame
+			std::array<std::vector<Command>, MAX_RECORDING_THREADS + 1> ListAllocators;// One per recording thread plus the closing list
+			uint64_t RetireValue = 0;// Fence value reached once the allocator's commands have executed
+		};
+
+		struct CommandList
+		{
+			std::vector<Command>* allocator = nullptr;
+			uint32_t first = 0;// Where this recording starts in the allocator
+			bool open = false;
+		};
+
+		// Either a command list or a fence signal
+		struct Submission
+		{
+			const std::vector<Command>* commands = nullptr;
+			uint32_t first = 0;
+			uint32_t count = 0;
+			uint64_t signal = 0;
+		};
+
+		// Records a replayed render queue into a command list, the queue's ids are the object ids
+		struct CommandSink
+		{
+			CommandList& list;
+
+			void SetPipeline(uint32_t id)
+			{
+				append(list, Command{ .type = COMMAND_TYPE::SET_PIPELINE_STATE, .object = id });
+			}
+
+			void SetRootSignature(uint32_t id)
+			{
+				append(list, Command{ .type = COMMAND_TYPE::SET_ROOT_SIGNATURE, .object = id });
+			}
+
+			void SetDescriptorTable(uint32_t index)
+			{
+				append(list, Command{ .type = COMMAND_TYPE::SET_DESCRIPTOR_TABLE, .value0 = index });
+			}
+
+			void SetVertexBuffer(uint32_t id)
+			{
+				append(list, Command{ .type = COMMAND_TYPE::SET_VERTEX_BUFFER, .object = id });
+			}
+
+			void Draw(const DrawItem& item)
+			{
+				append(list, Command{ .type = COMMAND_TYPE::DRAW, .value0 = item.vertexCount, .value1 = item.instanceCount });
+			}
+		};
+
+		// Connects the frame timeline to the simulated queue
+		struct TimelineQueue
+		{
+			HeadlessDevice& device;
+
+			void Signal(uint64_t value)
+			{
+				device.signal(value);
+			}
+
+			uint64_t CompletedValue() const
+			{
+				return device.m_fence.GetCompletedValue();
+			}
+
+			void WaitForValue(uint64_t value)
+			{
+				device.waitForFence(value);
+			}
+
+			// There is no swap chain, a present is done once the queue has executed the frame before it
+			void WaitForLatency()
+			{
+				device.waitForFence(device.m_timeline.LastSignalledValue());
+			}
+		};
+
+		// State the queue tracks while executing one command list
+		struct QueueState
+		{
+			uint32_t renderTarget = NONE;
+			uint32_t pipeline = NONE;
+			uint32_t rootSignature = NONE;
+			uint32_t vertexBuffer = NONE;
+			bool viewport = false;
+			uint32_t transitions = 0;// Still to come for the current barrier call
+			bool descriptorHeaps = false;
+			uint32_t descriptorTable = NONE;
+		};
+
+		HeadlessOptions											m_options;
+		std::array<FrameContext, MAX_FRAMES_IN_FLIGHT>			m_frameContext = {};
+		FrameTimeline											m_timeline;
+		uint32_t												m_recordingThreads = 1;
+		Parallel::WorkerPool									m_recordingPool{ MAX_RECORDING_THREADS - 1 };// Records beside the render thread, started once
+		uint32_t												m_drawCount = 1;
+		RenderQueue												m_renderQueue;
+		RenderQueueStats										m_queueStats;
+		uint32_t												m_backBufferIndex = 0;
+		uint32_t												m_width = 0;
+		uint32_t												m_height = 0;
+		float													m_aspectRatio = 1.0f;
+
+		CommandList												m_commandList;
+		std::vector<Command>									m_bundle;
+		std::deque<Submission>									m_queue;
+		SimulatedFence											m_fence;
+		std::array<RESOURCE_STATE, BACK_BUFFER_COUNT + 1>		m_resourceStates = {};
+		DescriptorAllocator										m_descriptors{ PERSISTENT_DESCRIPTORS, TRANSIENT_DESCRIPTORS };
+		ResourceStateTracker									m_stateTracker{ static_cast<uint32_t>(RESOURCE_STATE::RENDER_TARGET) };
+
+		// App resources
+		std::array<std::vector<uint32_t>, BACK_BUFFER_COUNT>	m_backBuffers = {};
+		std::vector<uint32_t>									m_texture;
+		std::future<void>										m_textureReady;// m_texture being generated on a worker, see waitForAssets
+		uint32_t												m_textureSrv = 0;// Descriptor index of the texture's view
+		std::vector<Vertex>										m_vertices;
+		std::vector<VertexPT>									m_verticesPT;
+		HeadlessStats											m_stats;
+
+	public:
+		explicit HeadlessDevice(HeadlessOptions options = {}) : m_options(options)
+		{
+		}
+
+		// The handle is ignored, a zero size falls back to 1280x720
+		bool CreateDevice([[maybe_unused]] void* handle, uint32_t x, uint32_t y) override
+		{
+			m_width = x == 0 ? DEFAULT_WIDTH : x;
+			m_height = y == 0 ? DEFAULT_HEIGHT : y;
+			m_aspectRatio = static_cast<float>(m_width) / static_cast<float>(m_height);
+
+			m_resourceStates.fill(RESOURCE_STATE::PRESENT);
+			m_resourceStates[TEXTURE] = RESOURCE_STATE::PIXEL_SHADER_RESOURCE;
+			// Resource ids double as tracker ids
+			for (uint32_t i = 0; i < m_resourceStates.size(); ++i)
+			{
+				m_stateTracker.Track(i, static_cast<uint32_t>(m_resourceStates[i]));
+			}
+			if (m_options.rasterize)
+			{
+				for (auto& buffer : m_backBuffers)
+				{
+					buffer.assign(static_cast<size_t>(m_width) * m_height, 0u);
+				}
+			}
+
+			return LoadAssets();
+		}
+
+		bool LoadAssets()
+		{
+			m_vertices =
+			{
+				{ { -1.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+				{ { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+				{ { -1.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
+			};
+
+			m_verticesPT =
+			{
+				{ { 0.0f, 0.25f * m_aspectRatio, 0.0f }, { 0.5f, 0.0f } },
+				{ { 0.25f, -0.25f * m_aspectRatio, 0.0f }, { 1.0f, 1.0f } },
+				{ { -0.25f, -0.25f * m_aspectRatio, 0.0f }, { 0.0f, 1.0f } }
+			};
+
+			// Black and white checkerboard, eight cells across, generated on a worker like the DX12 backend's texture
+			// while the rest of the device is set up. Only executed draws read it, the first frame waits for it.
+			m_texture.resize(static_cast<size_t>(TEXTURE_SIZE) * TEXTURE_SIZE);
+			m_textureReady = std::async(std::launch::async, [this]()
+				{
+					generateTexture(TexturePattern{}, TextureData{ .data = reinterpret_cast<std::byte*>(m_texture.data()),
+						.rowPitch = TEXTURE_SIZE * sizeof(uint32_t), .width = TEXTURE_SIZE, .height = TEXTURE_SIZE,
+						.format = TEXEL_FORMAT::R8G8B8A8_UNORM });
+				});
+
+			m_textureSrv = m_descriptors.AllocatePersistent().value();
+
+			// Bundle with the gradient triangle, replayed every frame
+			m_bundle =
+			{
+				Command{ .type = COMMAND_TYPE::SET_ROOT_SIGNATURE, .object = ROOT_SIGNATURE_EMPTY },
+				Command{ .type = COMMAND_TYPE::SET_VERTEX_BUFFER, .object = VERTEX_BUFFER_COLOR },
+				Command{ .type = COMMAND_TYPE::DRAW, .value0 = 3, .value1 = 1 }
+			};
+			m_stats.commands += m_bundle.size();
+			return true;
+		}
+
+		void CheckFeatures(std::string& s) override
+		{
+			s += "Headless device " + std::to_string(m_width) + "x" + std::to_string(m_height)
+				+ (m_options.rasterize ? ", software rasterizer\n" : ", record only\n");
+		}
+
+		void Render(const ColorRGBA& clearColor) override
+		{
+			auto frameCon = BeginRender();
+			// Basic setup for drawing - Reset command list, set viewport to draw to, and clear the frame buffer
+			ResetCommandList(frameCon, PIPELINE_COLOR);
+			SetViewport();
+			ClearRTV(clearColor);
+			// Draws the gradient triangle
+			SetPipelineState(PIPELINE_COLOR);
+			ExecuteBundle();
+			// The textured triangle and the rest of the scene go through the render queue
+			BuildRenderQueue();
+			m_stateTracker.Require(TEXTURE, static_cast<uint32_t>(RESOURCE_STATE::PIXEL_SHADER_RESOURCE));
+			const auto workers = Parallel::workerCount(m_renderQueue.Size(), MIN_DRAWS_PER_LIST, m_recordingThreads);
+			if (workers > 1)
+			{
+				RecordParallel(frameCon, workers);
+			}
+			else
+			{
+				FlushBarriers();
+				SetDescriptorHeaps();
+				auto sink = CommandSink{ m_commandList };
+				const auto first = m_commandList.allocator->size();
+				m_queueStats += m_renderQueue.Replay(sink, 0, m_renderQueue.Size());
+				m_stats.commands += m_commandList.allocator->size() - first;
+				// Prepare to render to the render target
+				PresentRTV();
+				CloseCommandList();
+				ExecuteCommandList();
+			}
+			Present();
+			// Wait for next frame
+			MoveToNextFrame();
+		}
+
+		// Mirrors the DX12 backend: the sorted render queue is split into contiguous slices recorded by workers into their
+		// own allocators, a closing list takes the present barrier, and all lists are submitted together in draw order
+		void RecordParallel(FrameContext* frameCon, uint32_t workers)
+		{
+			FlushBarriers();
+			CloseCommandList();
+
+			std::array<CommandList, MAX_RECORDING_THREADS + 2> lists = { m_commandList };
+			std::array<RenderQueueStats, MAX_RECORDING_THREADS> sliceStats = {};
+			m_recordingPool.ForChunks(m_renderQueue.Size(), workers, [&](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& allocator = frameCon->ListAllocators[chunk];
+					auto list = CommandList{ .allocator = &allocator, .first = static_cast<uint32_t>(allocator.size()), .open = true };
+					// Lists do not inherit state from the one before them, every slice sets up all its draws need
+					append(list, Command{ .type = COMMAND_TYPE::SET_VIEWPORT });
+					append(list, Command{ .type = COMMAND_TYPE::SET_RENDER_TARGET, .object = m_backBufferIndex });
+					append(list, Command{ .type = COMMAND_TYPE::SET_DESCRIPTOR_HEAPS, .object = TEXTURE });
+					auto sink = CommandSink{ list };
+					sliceStats[chunk] = m_renderQueue.Replay(sink, begin, end);
+					list.open = false;
+					lists[chunk + 1] = list;
+				});
+			for (uint32_t i = 0; i < workers; ++i)
+			{
+				m_queueStats += sliceStats[i];
+			}
+
+			auto& closing = frameCon->ListAllocators[workers];
+			m_commandList = CommandList{ .allocator = &closing, .first = static_cast<uint32_t>(closing.size()), .open = true };
+			PresentRTV();
+			CloseCommandList();
+			lists[workers + 1] = m_commandList;
+
+			for (uint32_t i = 1; i <= workers; ++i)
+			{
+				m_stats.commands += lists[i].allocator->size() - lists[i].first;
+			}
+			ExecuteCommandLists(std::span(lists.data(), workers + 2));
+		}
+
+		uint32_t SetFramesInFlight(uint32_t count) override
+		{
+			return m_timeline.SetFramesInFlight(count);
+		}
+
+		void SetLowLatency(bool enabled) override
+		{
+			m_timeline.SetLowLatency(enabled);
+		}
+
+		uint32_t SetRecordingThreads(uint32_t count) override
+		{
+			m_recordingThreads = std::clamp(count, 1u, MAX_RECORDING_THREADS);
+			return m_recordingThreads;
+		}
+
+		void SetDrawCount(uint32_t count) override
+		{
+			m_drawCount = count;
+		}
+
+		const FrameTimeline& Timeline() const override
+		{
+			return m_timeline;
+		}
+
+		bool AssetsReady() const override
+		{
+			return !m_textureReady.valid() || m_textureReady.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		// The first frame needs the texture from the worker
+		void waitForAssets()
+		{
+			if (m_textureReady.valid())
+			{
+				m_textureReady.get();
+			}
+		}
+
+		FrameContext* BeginRender()
+		{
+			waitForAssets();
+			// Wait until the slot we are about to reuse has finished executing
+			auto queue = TimelineQueue{ *this };
+			const auto slot = m_timeline.BeginFrame(queue);
+			FrameContext* frameCon = &m_frameContext[slot];
+			if (m_fence.GetCompletedValue() < frameCon->RetireValue)
+			{
+				throw std::runtime_error("Command allocator reset while its commands are still executing");
+			}
+			m_descriptors.BeginFrame(slot, m_fence.GetCompletedValue());
+			// Reclaims the memory allocated by this allocator for our next usage
+			frameCon->CommandAllocator.clear();
+			for (auto& allocator : frameCon->ListAllocators)
+			{
+				allocator.clear();
+			}
+			return frameCon;
+		}
+
+		void ResetCommandList(FrameContext* frameCon, uint32_t pipelineState)
+		{
+			if (m_commandList.open)
+			{
+				throw std::runtime_error("Command list reset while recording");
+			}
+			m_commandList = CommandList{ .allocator = &frameCon->CommandAllocator,
+				.first = static_cast<uint32_t>(frameCon->CommandAllocator.size()), .open = true };
+			SetPipelineState(pipelineState);
+		}
+
+		void SetPipelineState(uint32_t pipelineState)
+		{
+			record(Command{ .type = COMMAND_TYPE::SET_PIPELINE_STATE, .object = pipelineState });
+		}
+
+		void SetRootSignature(uint32_t rootSignature)
+		{
+			record(Command{ .type = COMMAND_TYPE::SET_ROOT_SIGNATURE, .object = rootSignature });
+		}
+
+		void SetDescriptorHeaps()
+		{
+			record(Command{ .type = COMMAND_TYPE::SET_DESCRIPTOR_HEAPS, .object = TEXTURE });
+		}
+
+		// Draw i is the textured triangle when i is even and the gradient triangle behind it when i is odd,
+		// submitted interleaved so the sort has something to group
+		void BuildRenderQueue()
+		{
+			m_renderQueue.Clear();
+			for (uint32_t i = 0; i < m_drawCount; ++i)
+			{
+				const auto textured = i % 2 == 0;
+				const auto key = textured ?
+					DrawKey{ .layer = LAYER_SCENE, .pipeline = PIPELINE_TEXTURED, .rootSignature = ROOT_SIGNATURE_TEXTURED,
+						.descriptorTable = m_textureSrv, .vertexBuffer = VERTEX_BUFFER_TEXTURED } :
+					DrawKey{ .layer = LAYER_BACKGROUND, .pipeline = PIPELINE_COLOR, .rootSignature = ROOT_SIGNATURE_EMPTY,
+						.vertexBuffer = VERTEX_BUFFER_COLOR };
+				m_renderQueue.Submit(key, DrawItem{ .vertexCount = 3 });
+			}
+			m_renderQueue.Sort();
+		}
+
+		void SetViewport()
+		{
+			record(Command{ .type = COMMAND_TYPE::SET_VIEWPORT });
+		}
+
+		void ClearRTV(const ColorRGBA& clearColor)
+		{
+			// This will prep the back buffer as our render target and prepare it for transition
+			m_stateTracker.Require(m_backBufferIndex, static_cast<uint32_t>(RESOURCE_STATE::RENDER_TARGET));
+			FlushBarriers();
+			record(Command{ .type = COMMAND_TYPE::SET_RENDER_TARGET, .object = m_backBufferIndex });
+			record(Command{ .type = COMMAND_TYPE::CLEAR_RENDER_TARGET, .object = m_backBufferIndex, .color = clearColor });
+		}
+
+		void ExecuteBundle()
+		{
+			record(Command{ .type = COMMAND_TYPE::EXECUTE_BUNDLE, .object = BUNDLE });
+		}
+
+		void Draw(uint32_t vertexBuffer, uint32_t vertices, uint32_t instances = 1u)
+		{
+			FlushBarriers();
+			record(Command{ .type = COMMAND_TYPE::SET_VERTEX_BUFFER, .object = vertexBuffer });
+			record(Command{ .type = COMMAND_TYPE::DRAW, .value0 = vertices, .value1 = instances });
+		}
+
+		void PresentRTV()
+		{
+			// Indicate that the back buffer will now be used to present.
+			m_stateTracker.Require(m_backBufferIndex, static_cast<uint32_t>(RESOURCE_STATE::PRESENT));
+			FlushBarriers();
+		}
+
+		// Records the transitions the tracker has queued as one barrier call
+		void FlushBarriers()
+		{
+			m_stateTracker.Flush([&](std::span<const ResourceTransition> transitions)
+				{
+					record(Command{ .type = COMMAND_TYPE::RESOURCE_BARRIER, .value0 = static_cast<uint32_t>(transitions.size()) });
+					for (const auto& t : transitions)
+					{
+						record(Command{ .type = COMMAND_TYPE::TRANSITION, .object = t.resource, .value0 = t.before, .value1 = t.after });
+					}
+				});
+		}
+
+		void CloseCommandList()
+		{
+			m_commandList.open = false;
+		}
+
+		void ExecuteCommandList()
+		{
+			ExecuteCommandLists(std::span(&m_commandList, 1));
+		}
+
+		// Queues the lists to run one after the other in the order given
+		void ExecuteCommandLists(std::span<const CommandList> lists)
+		{
+			for (const auto& list : lists)
+			{
+				if (list.open)
+				{
+					throw std::runtime_error("Executing a command list that is still recording");
+				}
+				m_queue.emplace_back(Submission{ .commands = list.allocator, .first = list.first,
+					.count = static_cast<uint32_t>(list.allocator->size()) - list.first });
+			}
+		}
+
+		// Flips to the next back buffer, the swap chain has BACK_BUFFER_COUNT of them
+		void Present()
+		{
+			m_backBufferIndex = (m_backBufferIndex + 1) % BACK_BUFFER_COUNT;
+			++m_stats.frames;
+		}
+
+		// Sends the frame's fence value to the queue, BeginRender waits for it once the slot comes around again
+		void MoveToNextFrame()
+		{
+			auto frameCon = &m_frameContext[m_timeline.FrameSlot()];
+			auto queue = TimelineQueue{ *this };
+			m_timeline.EndFrame(queue);
+			frameCon->RetireValue = m_timeline.LastSignalledValue();
+			m_descriptors.EndFrame(frameCon->RetireValue);
+		}
+
+		// Waits for work on the queue to finish before moving on
+		void WaitForGpu()
+		{
+			auto queue = TimelineQueue{ *this };
+			m_timeline.Flush(queue);
+		}
+
+		void OnDestroy() override
+		{
+			waitForAssets();
+			WaitForGpu();
+		}
+
+		uint32_t Width() const
+		{
+			return m_width;
+		}
+
+		uint32_t Height() const
+		{
+			return m_height;
+		}
+
+		uint32_t CurrentBackBufferIndex() const
+		{
+			return m_backBufferIndex;
+		}
+
+		// RGBA8 pixels of a back buffer, empty when not rasterizing. Only complete once its frame has executed.
+		std::span<const uint32_t> BackBuffer(uint32_t index) const
+		{
+			return m_backBuffers[index];
+		}
+
+		const SimulatedFence& Fence() const
+		{
+			return m_fence;
+		}
+
+		// Frames submitted whose fence the queue has not reached yet
+		uint32_t QueuedFrames() const
+		{
+			return static_cast<uint32_t>(std::count_if(m_queue.begin(), m_queue.end(),
+				[](const Submission& s) { return s.commands == nullptr; }));
+		}
+
+		// Draws and state changes replayed from the render queue since the last ResetStats
+		const RenderQueueStats& QueueStats() const
+		{
+			return m_queueStats;
+		}
+
+		const ResourceStateTracker& StateTracker() const
+		{
+			return m_stateTracker;
+		}
+
+		const DescriptorAllocator& Descriptors() const
+		{
+			return m_descriptors;
+		}
+
+		const HeadlessStats& Stats() const
+		{
+			return m_stats;
+		}
+
+		void ResetStats()
+		{
+			m_stats = {};
+			m_queueStats = {};
+		}
+
+		void ResetTimelineStats()
+		{
+			m_timeline.ResetStats();
+		}
+
+	private:
+		void record(const Command& command)
+		{
+			append(m_commandList, command);
+			++m_stats.commands;
+		}
+
+		// Records into any list, safe from several threads as long as each has its own list and allocator
+		static void append(CommandList& list, const Command& command)
+		{
+			if (!list.open)
+			{
+				throw std::runtime_error("Recording into a closed command list");
+			}
+			list.allocator->emplace_back(command);
+		}
+
+		void signal(uint64_t value)
+		{
+			m_queue.emplace_back(Submission{ .signal = value });
+		}
+
+		// Runs the queue until the fence reaches value
+		void waitForFence(uint64_t value)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			while (m_fence.GetCompletedValue() < value)
+			{
+				if (m_queue.empty())
+				{
+					throw std::runtime_error("Waiting on a fence value that was never signalled");
+				}
+
+				const auto submission = m_queue.front();
+				m_queue.pop_front();
+				if (submission.commands)
+				{
+					QueueState state;
+					execute(std::span(submission.commands->data() + submission.first, submission.count), state);
+				}
+				else
+				{
+					m_fence.Complete(submission.signal);
+				}
+			}
+			m_stats.queueNanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count());
+		}
+
+		void execute(std::span<const Command> commands, QueueState& state)
+		{
+			for (const auto& command : commands)
+			{
+				switch (command.type)
+				{
+				case COMMAND_TYPE::RESOURCE_BARRIER:
+					if (state.transitions != 0 || command.value0 == 0)
+					{
+						throw std::runtime_error("Resource barrier call without transitions");
+					}
+					state.transitions = command.value0;
+					break;
+				case COMMAND_TYPE::TRANSITION:
+					if (state.transitions == 0)
+					{
+						throw std::runtime_error("Transition outside a resource barrier call");
+					}
+					if (m_resourceStates[command.object] != static_cast<RESOURCE_STATE>(command.value0) || command.value0 == command.value1)
+					{
+						throw std::runtime_error("Resource barrier does not start from the resource's current state or does not change it");
+					}
+					m_resourceStates[command.object] = static_cast<RESOURCE_STATE>(command.value1);
+					--state.transitions;
+					break;
+				case COMMAND_TYPE::SET_VIEWPORT:
+					state.viewport = true;
+					break;
+				case COMMAND_TYPE::SET_RENDER_TARGET:
+					requireRenderTarget(command.object);
+					state.renderTarget = command.object;
+					break;
+				case COMMAND_TYPE::CLEAR_RENDER_TARGET:
+					requireRenderTarget(command.object);
+					if (m_options.rasterize)
+					{
+						std::fill(m_backBuffers[command.object].begin(), m_backBuffers[command.object].end(), pack(command.color));
+						m_stats.pixels += m_backBuffers[command.object].size();
+					}
+					break;
+				case COMMAND_TYPE::SET_PIPELINE_STATE:
+					state.pipeline = command.object;
+					break;
+				case COMMAND_TYPE::SET_ROOT_SIGNATURE:
+					state.rootSignature = command.object;
+					// Root arguments do not survive a root signature change
+					state.descriptorTable = NONE;
+					break;
+				case COMMAND_TYPE::SET_DESCRIPTOR_HEAPS:
+					state.descriptorHeaps = true;
+					break;
+				case COMMAND_TYPE::SET_DESCRIPTOR_TABLE:
+					if (!state.descriptorHeaps || state.rootSignature == NONE)
+					{
+						throw std::runtime_error("Descriptor table set without a descriptor heap or root signature");
+					}
+					state.descriptorTable = command.value0;
+					break;
+				case COMMAND_TYPE::SET_VERTEX_BUFFER:
+					state.vertexBuffer = command.object;
+					break;
+				case COMMAND_TYPE::DRAW:
+					draw(state, command.value0, command.value1);
+					break;
+				case COMMAND_TYPE::EXECUTE_BUNDLE:
+					execute(m_bundle, state);
+					break;
+				}
+			}
+		}
+
+		void requireRenderTarget(uint32_t resource) const
+		{
+			if (m_resourceStates[resource] != RESOURCE_STATE::RENDER_TARGET)
+			{
+				throw std::runtime_error("Render target used outside the render target state");
+			}
+		}
+
+		void draw(const QueueState& state, uint32_t vertices, uint32_t instances)
+		{
+			if (state.renderTarget == NONE || state.pipeline == NONE || state.vertexBuffer == NONE || !state.viewport)
+			{
+				throw std::runtime_error("Draw without a render target, pipeline, vertex buffer or viewport");
+			}
+			const auto textured = state.pipeline == PIPELINE_TEXTURED;
+			if (state.rootSignature != (textured ? ROOT_SIGNATURE_TEXTURED : ROOT_SIGNATURE_EMPTY) || (textured && state.descriptorTable != m_textureSrv))
+			{
+				throw std::runtime_error("Draw with a root signature or descriptor heap the pipeline does not expect");
+			}
+			if (state.vertexBuffer != (textured ? VERTEX_BUFFER_TEXTURED : VERTEX_BUFFER_COLOR))
+			{
+				throw std::runtime_error("Draw with a vertex buffer that does not match the pipeline's input layout");
+			}
+
+			++m_stats.draws;
+			if (!m_options.rasterize)
+				return;
+
+			auto& target = m_backBuffers[state.renderTarget];
+			// Every instance lands on the same pixels without per instance data, so drawing more than one changes nothing
+			static_cast<void>(instances);
+			if (textured)
+			{
+				const auto count = std::min<size_t>(vertices, m_verticesPT.size());
+				for (size_t v = 0; v + 2 < count; v += 3)
+				{
+					const auto& a = m_verticesPT[v];
+					const auto& b = m_verticesPT[v + 1];
+					const auto& c = m_verticesPT[v + 2];
+					fillTriangle(target, a.position.Vec.data(), b.position.Vec.data(), c.position.Vec.data(),
+						[&](float w0, float w1, float w2)
+						{
+							const auto u = w0 * a.uv.Vec[0] + w1 * b.uv.Vec[0] + w2 * c.uv.Vec[0];
+							const auto t = w0 * a.uv.Vec[1] + w1 * b.uv.Vec[1] + w2 * c.uv.Vec[1];
+							return sample(u, t);
+						});
+				}
+			}
+			else
+			{
+				const auto count = std::min<size_t>(vertices, m_vertices.size());
+				for (size_t v = 0; v + 2 < count; v += 3)
+				{
+					const auto& a = m_vertices[v];
+					const auto& b = m_vertices[v + 1];
+					const auto& c = m_vertices[v + 2];
+					fillTriangle(target, a.position.Vec.data(), b.position.Vec.data(), c.position.Vec.data(),
+						[&](float w0, float w1, float w2)
+						{
+							ColorRGBA color;
+							color.r = w0 * a.color.Vec[0] + w1 * b.color.Vec[0] + w2 * c.color.Vec[0];
+							color.g = w0 * a.color.Vec[1] + w1 * b.color.Vec[1] + w2 * c.color.Vec[1];
+							color.b = w0 * a.color.Vec[2] + w1 * b.color.Vec[2] + w2 * c.color.Vec[2];
+							color.a = w0 * a.color.Vec[3] + w1 * b.color.Vec[3] + w2 * c.color.Vec[3];
+							return pack(color);
+						});
+				}
+			}
+		}
+
+		// Half space rasterizer over the whole back buffer viewport. Positions are in clip space with w = 1, shade
+		// gets the barycentric weights of each covered pixel centre. Counter clockwise triangles are culled like
+		// with the default rasterizer state.
+		template <class Shade>
+		void fillTriangle(std::vector<uint32_t>& target, const float* p0, const float* p1, const float* p2, Shade&& shade)
+		{
+			const auto w = static_cast<float>(m_width);
+			const auto h = static_cast<float>(m_height);
+			const float x0 = (p0[0] + 1.0f) * 0.5f * w, y0 = (1.0f - p0[1]) * 0.5f * h;
+			const float x1 = (p1[0] + 1.0f) * 0.5f * w, y1 = (1.0f - p1[1]) * 0.5f * h;
+			const float x2 = (p2[0] + 1.0f) * 0.5f * w, y2 = (1.0f - p2[1]) * 0.5f * h;
+
+			const auto area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+			if (!(area > 0.0f))
+				return;
+
+			const auto minX = static_cast<int32_t>(std::max(0.0f, std::floor(std::min({ x0, x1, x2 }))));
+			const auto minY = static_cast<int32_t>(std::max(0.0f, std::floor(std::min({ y0, y1, y2 }))));
+			const auto maxX = static_cast<int32_t>(std::min(w - 1.0f, std::ceil(std::max({ x0, x1, x2 }))));
+			const auto maxY = static_cast<int32_t>(std::min(h - 1.0f, std::ceil(std::max({ y0, y1, y2 }))));
+			if (minX > maxX || minY > maxY)
+				return;
+
+			// Edge functions, e0 is the weight of vertex 0 and so on, stepped per pixel along x
+			const auto edge = [](float ax, float ay, float bx, float by, float px, float py)
+				{
+					return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+				};
+			const auto invArea = 1.0f / area;
+			const auto step0 = -(y2 - y1), step1 = -(y0 - y2), step2 = -(y1 - y0);
+			uint64_t written = 0;
+			for (auto y = minY; y <= maxY; ++y)
+			{
+				const auto py = static_cast<float>(y) + 0.5f;
+				const auto px = static_cast<float>(minX) + 0.5f;
+				auto e0 = edge(x1, y1, x2, y2, px, py);
+				auto e1 = edge(x2, y2, x0, y0, px, py);
+				auto e2 = edge(x0, y0, x1, y1, px, py);
+				auto* row = target.data() + static_cast<size_t>(y) * m_width;
+				for (auto x = minX; x <= maxX; ++x)
+				{
+					if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+					{
+						row[x] = shade(e0 * invArea, e1 * invArea, e2 * invArea);
+						++written;
+					}
+					e0 += step0;
+					e1 += step1;
+					e2 += step2;
+				}
+			}
+			m_stats.pixels += written;
+		}
+
+		// Point sampling of the top level with a transparent black border, like the static sampler of texture_effect.hlsl
+		// samples the magnified texture
+		uint32_t sample(float u, float v) const
+		{
+			if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+				return 0u;
+
+			const auto x = std::min(static_cast<uint32_t>(u * TEXTURE_SIZE), TEXTURE_SIZE - 1);
+			const auto y = std::min(static_cast<uint32_t>(v * TEXTURE_SIZE), TEXTURE_SIZE - 1);
+			return m_texture[y * TEXTURE_SIZE + x];
+		}
+
+		// R8G8B8A8_UNORM, red in the lowest byte
+		static uint32_t pack(const ColorRGBA& color)
+		{
+			const auto unorm = [](float c)
+				{
+					return static_cast<uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+				};
+			return unorm(color.r) | (unorm(color.g) << 8) | (unorm(color.b) << 16) | (unorm(color.a) << 24);
+		}
+	};
+}
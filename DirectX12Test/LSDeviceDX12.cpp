@@ -1,4 +1,17 @@
 import DX12Device;
+import HeadlessDevice;
+import UploadRing;
+import DescriptorAllocator;
+import ResourceStateTracker;
+import Parallel;
+import RenderQueue;
+import PipelineCache;
+import MappedFile;
+import ProceduralTexture;
+import MipChain;
+import TextureFormat;
+import BlockCompression;
+import TextureContainer;
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <iostream>
@@ -11,9 +24,15 @@ import DX12Device;
 //#include <string>
 #include <algorithm>
 #include <ranges>
+#include <span>
 #include <wrl/client.h>
 #include <d3dcompiler.h>
 #include <optional>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <chrono>
+#include <deque>
 #include "DirectX-Headers/include/directx/d3dx12.h"
 
 #pragma comment(lib, "dxguid.lib")
@@ -36,6 +55,21 @@ private:
 
 #define SAFE_RELEASE(p) if (p) (p)->Release()
 
+// Staging memory shared by every upload, sized for the largest batch of copies submitted at once
+constexpr uint64_t UPLOAD_RING_SIZE = 8ull * 1024 * 1024;
+// Buffer copies have no alignment rule, this keeps the memcpy destinations vector aligned
+constexpr uint64_t UPLOAD_BUFFER_ALIGNMENT = 16;
+// Shader visible CBV/SRV/UAV heap, created once: long lived views plus a transient region for every frame slot
+constexpr uint32_t SRV_PERSISTENT_DESCRIPTORS = 4096;
+constexpr uint32_t SRV_TRANSIENT_DESCRIPTORS = 1024;
+// Compiled shaders and pipeline blobs, relative to the working directory like the shader sources
+constexpr wchar_t PIPELINE_CACHE_DIRECTORY[] = L"PipelineCache";
+// Streamed in over the first frames in place of the generated sample texture when it is there, relative to the
+// working directory as well
+constexpr wchar_t SAMPLE_TEXTURE_FILE[] = L"sample.dds";
+// Bytes of texture rows streamed in a frame, out of the upload ring the frame's uploads share
+constexpr size_t TEXTURE_STREAM_BUDGET = 2ull * 1024 * 1024;
+
 inline void ThrowIfFailed(HRESULT hr)
 {
 	if (FAILED(hr))
@@ -44,81 +78,502 @@ inline void ThrowIfFailed(HRESULT hr)
 	}
 }
 
-inline Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
-	ID3D12Device* device,
-	ID3D12GraphicsCommandList* cmdList,
-	const void* initData,
-	uint64_t byteSize,
-	Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
-	D3D12_RESOURCE_STATES finalState,
-	std::optional<std::wstring_view> defaultName = std::nullopt,
-	std::optional<std::wstring_view> uploadName = std::nullopt)
+// A persistently mapped UPLOAD buffer sub-allocated with an UploadRing. Every upload copies its data into a region of
+// it, and the region is reclaimed once the fence value of its batch is reached. Staging memory is never created per
+// upload, and the CPU only waits when the ring is full of batches the GPU has not finished with yet.
+class UploadHeap
 {
-	Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
+public:
+	struct Allocation
+	{
+		ID3D12Resource* Resource;
+		uint64_t Offset;
+		uint8_t* CpuAddress;
+	};
 
-	// Creat Default Buffer
-	auto heapDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heapDefault,
-		D3D12_HEAP_FLAG_NONE,
-		&resourceDesc,
-		D3D12_RESOURCE_STATE_COMMON,
-		nullptr,
-		IID_PPV_ARGS(defaultBuffer.GetAddressOf())
-	));
+	void Create(ID3D12Device* device, uint64_t capacity, ID3D12Fence* fence, HANDLE fenceEvent)
+	{
+		auto heapUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+		auto resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heapUpload,
+			D3D12_HEAP_FLAG_NONE,
+			&resourceDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_buffer.ReleaseAndGetAddressOf())
+		));
+		m_buffer->SetName(L"upload ring");
+
+		// Upload heaps can stay mapped for as long as they live, the CPU never reads from it
+		CD3DX12_RANGE readRange(0, 0);
+		ThrowIfFailed(m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_cpuAddress)));
+		m_ring = LS::UploadRing(capacity);
+		m_fence = fence;
+		m_fenceEvent = fenceEvent;
+	}
 
-	// Upload type is needed to get the data onto the GPU
-	auto heapUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heapUpload,
-		D3D12_HEAP_FLAG_NONE,
-		&resourceDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(uploadBuffer.GetAddressOf())
-	));
+	Allocation Allocate(uint64_t size, uint64_t alignment)
+	{
+		auto offset = m_ring.Allocate(size, alignment);
+		while (!offset)
+		{
+			// Only batches already submitted can be waited for, an upload that does not fit next to the open batch
+			// means the ring is too small
+			const auto oldest = m_ring.OldestFenceValue();
+			if (!oldest)
+			{
+				throw std::runtime_error("Upload does not fit in the upload ring");
+			}
+			if (m_fence->GetCompletedValue() < *oldest)
+			{
+				ThrowIfFailed(m_fence->SetEventOnCompletion(*oldest, m_fenceEvent));
+				WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+			}
+			m_ring.Reclaim(*oldest);
+			offset = m_ring.Allocate(size, alignment);
+		}
+		return Allocation{ m_buffer.Get(), *offset, m_cpuAddress + *offset };
+	}
 
-	// Create subresource data to copy into the default barrier
-	D3D12_SUBRESOURCE_DATA subresourceData = {};
-	subresourceData.pData = initData;
-	subresourceData.RowPitch = byteSize;
-	subresourceData.SlicePitch = subresourceData.RowPitch;
+	// Everything allocated since the last call is released once the fence reaches fenceValue
+	void Close(uint64_t fenceValue)
+	{
+		m_ring.Close(fenceValue);
+	}
 
-	auto defaultBarrier = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-	cmdList->ResourceBarrier(1,
-		&defaultBarrier);
+	void Reclaim(uint64_t completedValue)
+	{
+		m_ring.Reclaim(completedValue);
+	}
 
-	UpdateSubresources<1>(cmdList, defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subresourceData);
+	const LS::UploadRing& Ring() const
+	{
+		return m_ring;
+	}
 
-	auto defaultBarrier2 = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, finalState);
-	cmdList->ResourceBarrier(1,
-		&defaultBarrier2);
+private:
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_buffer;
+	uint8_t* m_cpuAddress = nullptr;
+	LS::UploadRing m_ring;
+	ID3D12Fence* m_fence = nullptr;
+	HANDLE m_fenceEvent = nullptr;
+};
 
-	if (defaultName)
+// A copy queue with its own fence and staging ring, so loading runs beside the frames on the direct queue instead of
+// in front of them. Batches record into one command list, each on an allocator that is reused once its batch has
+// executed. The direct queue waits for the copies on the GPU (QueueWait), the CPU only waits when staging runs out.
+class CopyQueue
+{
+public:
+	void Create(ID3D12Device* device, uint64_t stagingSize)
 	{
-		defaultBuffer->SetName(defaultName.value().data());
+		m_device = device;
+		D3D12_COMMAND_QUEUE_DESC desc = {};
+		desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+		ThrowIfFailed(device->CreateCommandQueue(&desc, IID_PPV_ARGS(&m_queue)));
+		m_queue->SetName(L"Copy Queue");
+		ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (m_fenceEvent == nullptr)
+		{
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+		// Created closed, Begin resets it onto an allocator
+		ThrowIfFailed(device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_COPY, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&m_list)));
+		m_list->SetName(L"Copy List");
+		m_staging.Create(device, stagingSize, m_fence.Get(), m_fenceEvent);
 	}
 
-	if (uploadName)
+	// Starts recording a batch
+	ID3D12GraphicsCommandList* Begin()
 	{
-		uploadBuffer->SetName(uploadName.value().data());
+		const auto completed = m_fence->GetCompletedValue();
+		m_staging.Reclaim(completed);
+		if (!m_batches.empty() && m_batches.front().FenceValue <= completed)
+		{
+			m_recording = std::move(m_batches.front().Allocator);
+			m_batches.pop_front();
+			ThrowIfFailed(m_recording->Reset());
+		}
+		else
+		{
+			ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_recording)));
+		}
+		ThrowIfFailed(m_list->Reset(m_recording.Get(), nullptr));
+		return m_list.Get();
 	}
 
-	return defaultBuffer;
-}
+	// Staging memory for the batch being recorded
+	UploadHeap& Staging()
+	{
+		return m_staging;
+	}
+
+	// Submits the batch, its copies have executed once the fence reaches the value returned
+	uint64_t Submit()
+	{
+		ThrowIfFailed(m_list->Close());
+		ID3D12CommandList* ppCommandLists[] = { m_list.Get() };
+		m_queue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+		ThrowIfFailed(m_queue->Signal(m_fence.Get(), ++m_lastSignalledValue));
+		m_staging.Close(m_lastSignalledValue);
+		m_batches.emplace_back(Batch{ std::move(m_recording), m_lastSignalledValue });
+		return m_lastSignalledValue;
+	}
+
+	// Makes queue wait on the GPU for every batch submitted so far, work it is given afterwards sees their copies
+	void QueueWait(ID3D12CommandQueue* queue)
+	{
+		if (m_waitedValue < m_lastSignalledValue)
+		{
+			ThrowIfFailed(queue->Wait(m_fence.Get(), m_lastSignalledValue));
+			m_waitedValue = m_lastSignalledValue;
+		}
+	}
+
+	bool IsIdle() const
+	{
+		return m_fence->GetCompletedValue() >= m_lastSignalledValue;
+	}
+
+	// Blocks until every batch has executed
+	void Flush()
+	{
+		if (!IsIdle())
+		{
+			ThrowIfFailed(m_fence->SetEventOnCompletion(m_lastSignalledValue, m_fenceEvent));
+			WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+		}
+	}
+
+	void Destroy()
+	{
+		if (m_fence)
+		{
+			Flush();
+		}
+		if (m_fenceEvent)
+		{
+			CloseHandle(m_fenceEvent);
+			m_fenceEvent = nullptr;
+		}
+	}
+
+private:
+	struct Batch
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> Allocator;
+		uint64_t FenceValue;
+	};
+
+	ID3D12Device* m_device = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_list;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_recording;
+	std::deque<Batch> m_batches;// Submitted, oldest first
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_fenceEvent = nullptr;
+	uint64_t m_lastSignalledValue = 0;
+	uint64_t m_waitedValue = 0;// Last value QueueWait had the direct queue wait for
+	UploadHeap m_staging;
+};
+
+// A descriptor heap sized once for everything it will ever hold, with its slots handed out by a DescriptorAllocator.
+// Indices become CPU and GPU handles here, so nothing else does handle increment math.
+class DescriptorHeap
+{
+public:
+	bool Create(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t persistentCount, uint32_t transientPerFrame,
+		bool shaderVisible)
+	{
+		m_allocator = LS::DescriptorAllocator(persistentCount, transientPerFrame);
+		D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+		desc.Type = type;
+		desc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		desc.NumDescriptors = m_allocator.Capacity();
+		if (device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_heap.ReleaseAndGetAddressOf())) != S_OK)
+			return false;
+
+		// Handles have a size that varies by GPU, so we have to ask for the Handle size on the GPU before processing
+		m_descriptorSize = device->GetDescriptorHandleIncrementSize(type);
+		m_cpuStart = m_heap->GetCPUDescriptorHandleForHeapStart();
+		if (shaderVisible)
+		{
+			m_gpuStart = m_heap->GetGPUDescriptorHandleForHeapStart();
+		}
+		return true;
+	}
+
+	uint32_t AllocatePersistent()
+	{
+		const auto index = m_allocator.AllocatePersistent();
+		if (!index)
+		{
+			throw std::runtime_error("Descriptor heap has no persistent descriptors left");
+		}
+		return *index;
+	}
+
+	void FreePersistent(uint32_t index)
+	{
+		m_allocator.FreePersistent(index);
+	}
+
+	// First of count contiguous descriptors that stay valid for the frame being recorded
+	uint32_t AllocateTransient(uint32_t count = 1)
+	{
+		const auto index = m_allocator.AllocateTransient(count);
+		if (!index)
+		{
+			throw std::runtime_error("Descriptor heap has no transient descriptors left this frame");
+		}
+		return *index;
+	}
+
+	void BeginFrame(uint32_t slot, uint64_t completedValue)
+	{
+		m_allocator.BeginFrame(slot, completedValue);
+	}
+
+	void EndFrame(uint64_t fenceValue)
+	{
+		m_allocator.EndFrame(fenceValue);
+	}
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(uint32_t index) const
+	{
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_cpuStart, static_cast<INT>(index), m_descriptorSize);
+	}
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(uint32_t index) const
+	{
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_gpuStart, static_cast<INT>(index), m_descriptorSize);
+	}
+
+	ID3D12DescriptorHeap* Heap() const
+	{
+		return m_heap.Get();
+	}
+
+	const LS::DescriptorAllocator& Allocator() const
+	{
+		return m_allocator;
+	}
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap;
+	LS::DescriptorAllocator m_allocator;
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuStart = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpuStart = {};
+	UINT m_descriptorSize = 0;
+};
+
+// Resource states of everything the command lists touch, kept by a ResourceStateTracker. Uses ask for the state
+// they need and Flush turns whatever transitions that takes into a single ResourceBarrier call.
+class ResourceStates
+{
+public:
+	// States that cannot be combined with any other, the rest are reads that can be
+	static constexpr uint32_t WRITE_STATES = D3D12_RESOURCE_STATE_RENDER_TARGET | D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+		D3D12_RESOURCE_STATE_DEPTH_WRITE | D3D12_RESOURCE_STATE_STREAM_OUT | D3D12_RESOURCE_STATE_COPY_DEST |
+		D3D12_RESOURCE_STATE_RESOLVE_DEST;
+
+	ResourceStates() : m_tracker(WRITE_STATES)
+	{
+	}
+
+	// Id to pass to Require, resource has to stay alive for as long as it is used
+	uint32_t Track(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
+	{
+		const auto id = static_cast<uint32_t>(m_resources.size());
+		m_resources.emplace_back(resource);
+		m_tracker.Track(id, state);
+		return id;
+	}
+
+	void Require(uint32_t id, D3D12_RESOURCE_STATES state)
+	{
+		m_tracker.Require(id, state);
+	}
 
-// The difference with this one is we don't start at the common state and transition to copy destination state
-// instead we start in the resource state copy destination and transition to final state for our buffer. 
-// This seems to work just fine, removing one resource barrier transition, but I still need to learn more about resource barriers
-// and states before knowinng what, if any, impacts this has. Test it out!
-inline Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer2(
+	// Records the queued transitions, has to be called before the command that needs them
+	void Flush(ID3D12GraphicsCommandList* cmdList)
+	{
+		m_tracker.Flush([&](std::span<const LS::ResourceTransition> transitions)
+			{
+				m_barriers.clear();
+				for (const auto& t : transitions)
+				{
+					m_barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(m_resources[t.resource],
+						static_cast<D3D12_RESOURCE_STATES>(t.before), static_cast<D3D12_RESOURCE_STATES>(t.after)));
+				}
+				cmdList->ResourceBarrier(static_cast<UINT>(m_barriers.size()), m_barriers.data());
+			});
+	}
+
+	const LS::ResourceStateTracker& Tracker() const
+	{
+		return m_tracker;
+	}
+
+private:
+	LS::ResourceStateTracker m_tracker;
+	std::vector<ID3D12Resource*> m_resources;// Indexed by id
+	std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+};
+
+// Shader bytecode and pipeline state objects kept in a PipelineCache on disk, so only the first run pays for
+// compiling. Shaders are keyed on their source and compile settings, pipelines on everything in their description
+// plus the adapter and driver, since a driver only takes back the pipeline blobs it wrote itself. Once opened,
+// shaders and pipelines can be loaded from several threads at once.
+class PipelineStore
+{
+public:
+	// Bytecode of one entry point, either mapped from the cache or freshly compiled
+	struct Shader
+	{
+		LS::CacheKey Key;
+		std::optional<LS::CachedBlob> Cached;
+		Microsoft::WRL::ComPtr<ID3DBlob> Compiled;
+
+		D3D12_SHADER_BYTECODE Bytecode() const
+		{
+			if (Cached)
+				return { Cached->Data(), Cached->Size() };
+			return { Compiled->GetBufferPointer(), Compiled->GetBufferSize() };
+		}
+	};
+
+	void Open(const std::filesystem::path& directory, IDXGIAdapter1* adapter)
+	{
+		m_cache.Open(directory);
+
+		LS::ContentHasher hasher;
+		DXGI_ADAPTER_DESC1 desc = {};
+		LARGE_INTEGER driverVersion = {};
+		if (adapter && SUCCEEDED(adapter->GetDesc1(&desc)))
+		{
+			adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+			hasher.AddValue(desc.VendorId).AddValue(desc.DeviceId).AddValue(desc.SubSysId).AddValue(desc.Revision);
+		}
+		m_adapterKey = hasher.AddValue(driverVersion.QuadPart).Finish();
+	}
+
+	// Compiles entryPoint of file unless the cache holds the bytecode for the same source and settings. Shaders
+	// are compiled without an include handler, so the source file is all there is to hash.
+	Shader LoadShader(const std::filesystem::path& file, const char* entryPoint, const char* target, UINT flags,
+		const D3D_SHADER_MACRO* defines = nullptr)
+	{
+		Data::MappedFile source(file);
+		if (!source.IsOpen())
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+
+		LS::ContentHasher hasher;
+		hasher.AddValue(D3D_COMPILER_VERSION).Add(source.Bytes()).Add(entryPoint).Add(target).AddValue(flags);
+		for (auto* define = defines; define && define->Name; ++define)
+		{
+			hasher.Add(define->Name).Add(define->Definition);
+		}
+
+		Shader shader;
+		shader.Key = hasher.Finish();
+		shader.Cached = m_cache.Find(shader.Key);
+		if (shader.Cached)
+			return shader;
+
+		Microsoft::WRL::ComPtr<ID3DBlob> errors;
+		const auto name = file.string();
+		const auto hr = D3DCompile(source.Bytes().data(), source.Size(), name.c_str(), defines, nullptr, entryPoint, target,
+			flags, 0, &shader.Compiled, &errors);
+		if (errors)
+		{
+			OutputDebugStringA(static_cast<const char*>(errors->GetBufferPointer()));
+		}
+		ThrowIfFailed(hr);
+
+		m_cache.Store(shader.Key, { static_cast<const std::byte*>(shader.Compiled->GetBufferPointer()), shader.Compiled->GetBufferSize() });
+		return shader;
+	}
+
+	// Key for a serialized root signature, which is what the pipeline sees of it
+	static LS::CacheKey HashRootSignature(ID3DBlob* signature)
+	{
+		return LS::ContentHasher().Add({ static_cast<const std::byte*>(signature->GetBufferPointer()), signature->GetBufferSize() }).Finish();
+	}
+
+	// Creates the pipeline for desc with vs and ps, from the driver's blob of an earlier run when there is one. A blob
+	// the driver no longer accepts (new driver, other adapter) is replaced by the one of the pipeline built instead.
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> CreateGraphicsPipeline(ID3D12Device* device, D3D12_GRAPHICS_PIPELINE_STATE_DESC desc,
+		const LS::CacheKey& rootSignature, const Shader& vs, const Shader& ps)
+	{
+		if (desc.DS.pShaderBytecode || desc.HS.pShaderBytecode || desc.GS.pShaderBytecode || desc.StreamOutput.NumEntries > 0)
+			throw std::runtime_error("Pipeline cache keys only cover vertex and pixel shader pipelines");
+
+		desc.VS = vs.Bytecode();
+		desc.PS = ps.Bytecode();
+		desc.CachedPSO = {};
+
+		LS::ContentHasher hasher;
+		hasher.Add(m_adapterKey).Add(rootSignature).Add(vs.Key).Add(ps.Key);
+		// Pointers in the description change every run, what they point to is hashed instead
+		for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+		{
+			const auto& element = desc.InputLayout.pInputElementDescs[i];
+			hasher.Add(element.SemanticName).AddValue(element.SemanticIndex).AddValue(element.Format).AddValue(element.InputSlot)
+				.AddValue(element.AlignedByteOffset).AddValue(element.InputSlotClass).AddValue(element.InstanceDataStepRate);
+		}
+		// The blend and depth stencil descriptions have padding after their 8 bit masks, so they go field by field
+		hasher.AddValue(desc.BlendState.AlphaToCoverageEnable).AddValue(desc.BlendState.IndependentBlendEnable);
+		for (const auto& target : desc.BlendState.RenderTarget)
+		{
+			hasher.AddValue(target.BlendEnable).AddValue(target.LogicOpEnable).AddValue(target.SrcBlend).AddValue(target.DestBlend)
+				.AddValue(target.BlendOp).AddValue(target.SrcBlendAlpha).AddValue(target.DestBlendAlpha).AddValue(target.BlendOpAlpha)
+				.AddValue(target.LogicOp).AddValue(target.RenderTargetWriteMask);
+		}
+		const auto& depthStencil = desc.DepthStencilState;
+		hasher.AddValue(depthStencil.DepthEnable).AddValue(depthStencil.DepthWriteMask).AddValue(depthStencil.DepthFunc)
+			.AddValue(depthStencil.StencilEnable).AddValue(depthStencil.StencilReadMask).AddValue(depthStencil.StencilWriteMask)
+			.AddValue(depthStencil.FrontFace).AddValue(depthStencil.BackFace);
+		hasher.AddValue(desc.SampleMask).AddValue(desc.RasterizerState).AddValue(desc.IBStripCutValue).AddValue(desc.PrimitiveTopologyType).AddValue(desc.NumRenderTargets)
+			.AddValue(desc.RTVFormats).AddValue(desc.DSVFormat).AddValue(desc.SampleDesc).AddValue(desc.NodeMask).AddValue(desc.Flags);
+		const auto key = hasher.Finish();
+
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline;
+		if (auto cached = m_cache.Find(key))
+		{
+			desc.CachedPSO = { cached->Data(), cached->Size() };
+			if (SUCCEEDED(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline))))
+				return pipeline;
+			desc.CachedPSO = {};
+		}
+
+		ThrowIfFailed(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline)));
+		Microsoft::WRL::ComPtr<ID3DBlob> blob;
+		if (SUCCEEDED(pipeline->GetCachedBlob(&blob)))
+		{
+			m_cache.Store(key, { static_cast<const std::byte*>(blob->GetBufferPointer()), blob->GetBufferSize() });
+		}
+		return pipeline;
+	}
+
+	const LS::PipelineCache& Cache() const
+	{
+		return m_cache;
+	}
+
+private:
+	LS::PipelineCache m_cache;
+	LS::CacheKey m_adapterKey;
+};
+
+inline Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
 	ID3D12Device* device,
 	ID3D12GraphicsCommandList* cmdList,
 	const void* initData,
 	uint64_t byteSize,
-	Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
-	D3D12_RESOURCE_STATES finalState)
+	UploadHeap& uploadHeap,
+	std::optional<std::wstring_view> defaultName = std::nullopt)
 {
 	Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
 
@@ -129,88 +584,83 @@ inline Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer2(
 		&heapDefault,
 		D3D12_HEAP_FLAG_NONE,
 		&resourceDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
+		D3D12_RESOURCE_STATE_COMMON,
 		nullptr,
 		IID_PPV_ARGS(defaultBuffer.GetAddressOf())
 	));
 
-	// Upload type is needed to get the data onto the GPU
-	auto heapUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heapUpload,
-		D3D12_HEAP_FLAG_NONE,
-		&resourceDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(uploadBuffer.GetAddressOf())
-	));
-
-	// Create subresource data to copy into the default barrier
-	D3D12_SUBRESOURCE_DATA subresourceData = {};
-	subresourceData.pData = initData;
-	subresourceData.RowPitch = byteSize;
-	subresourceData.SlicePitch = subresourceData.RowPitch;
+	// The upload ring is needed to get the data onto the GPU
+	const auto staging = uploadHeap.Allocate(byteSize, UPLOAD_BUFFER_ALIGNMENT);
+	std::memcpy(staging.CpuAddress, initData, byteSize);
 
-	UpdateSubresources<1>(cmdList, defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subresourceData);
+	// Buffers are always created in the common state (an initial state asked for is ignored) and are promoted from
+	// it to whatever a command needs on their own, so the copy needs no barrier. On a copy queue the buffer decays
+	// back to COMMON once the batch has executed, which is the state the caller tracks it in.
+	cmdList->CopyBufferRegion(defaultBuffer.Get(), 0, staging.Resource, staging.Offset, byteSize);
 
-	auto defaultBarrier2 = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, finalState);
-	cmdList->ResourceBarrier(1,
-		&defaultBarrier2);
+	if (defaultName)
+	{
+		defaultBuffer->SetName(defaultName.value().data());
+	}
 
 	return defaultBuffer;
 }
 
-// Generate a simple black and white checkerboard texture.
-std::vector<UINT8> GenerateTextureData(uint32_t textureWidth, uint32_t textureHeight, uint32_t pixelSize)
+// A texture whose data a worker is writing into its staging memory. The copies can be recorded right away, the batch
+// holding them can only be submitted once Ready is.
+struct TextureUpload
 {
-	const UINT rowPitch = textureWidth * pixelSize;
-	const UINT cellPitch = rowPitch >> 3;        // The width of a cell in the checkboard texture.
-	const UINT cellHeight = textureWidth >> 3;    // The height of a cell in the checkerboard texture.
-	const UINT textureSize = rowPitch * textureHeight;
-
-	std::vector<UINT8> data(textureSize);
-	UINT8* pData = &data[0];
+	Microsoft::WRL::ComPtr<ID3D12Resource> Texture;
+	ID3D12Resource* Staging = nullptr;
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Footprints;// One per mip level, placed in Staging
+	std::future<void> Ready;
 
-	for (UINT n = 0; n < textureSize; n += pixelSize)
+	void RecordCopy(ID3D12GraphicsCommandList* cmdList) const
 	{
-		UINT x = n % rowPitch;
-		UINT y = n / rowPitch;
-		UINT i = x / cellPitch;
-		UINT j = y / cellHeight;
-
-		if (i % 2 == j % 2)
-		{
-			pData[n] = 0x00;        // R
-			pData[n + 1] = 0x00;    // G
-			pData[n + 2] = 0x00;    // B
-			pData[n + 3] = 0xff;    // A
-		}
-		else
+		for (UINT subresource = 0; subresource < Footprints.size(); ++subresource)
 		{
-			pData[n] = 0xff;        // R
-			pData[n + 1] = 0xff;    // G
-			pData[n + 2] = 0xff;    // B
-			pData[n + 3] = 0xff;    // A
+			CD3DX12_TEXTURE_COPY_LOCATION destination(Texture.Get(), subresource);
+			CD3DX12_TEXTURE_COPY_LOCATION source(Staging, Footprints[subresource]);
+			cmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
 		}
 	}
+};
 
-	return data;
+DXGI_FORMAT BlockFormat(LS::BLOCK_FORMAT format)
+{
+	switch (format)
+	{
+	case LS::BLOCK_FORMAT::BC1_UNORM:
+		return DXGI_FORMAT_BC1_UNORM;
+	case LS::BLOCK_FORMAT::BC3_UNORM:
+		return DXGI_FORMAT_BC3_UNORM;
+	case LS::BLOCK_FORMAT::BC7_UNORM:
+		return DXGI_FORMAT_BC7_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
 }
 
-void CreateTileSampleTexture(
+// Creates the texture with a full mip chain and its view, and starts generating pattern and the chain below it into
+// staging memory from uploadHeap. With a compression format every level is block compressed on its way into staging,
+// which takes a quarter (BC3, BC7) or an eighth (BC1) of the memory and copy bandwidth. The texture is created in the
+// common state, a copy queue promotes it to COPY_DEST for the copies.
+TextureUpload CreateTileSampleTexture(
 	ID3D12Device* device,
-	Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
 	uint32_t textureWidth,
 	uint32_t textureHeight,
-	uint32_t pixelSize,
-	Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap,
-	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>& commandList,
-	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>& srvHeap)
+	const LS::TexturePattern& pattern,
+	std::optional<LS::BLOCK_FORMAT> compression,
+	UploadHeap& uploadHeap,
+	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle)
 {
+	if (compression && (textureWidth % 4 != 0 || textureHeight % 4 != 0))
+		throw std::runtime_error("Block compressed textures have to be a multiple of 4 texels each way");
+
 	// Describe and create a Texture2D.
 	D3D12_RESOURCE_DESC textureDesc = {};
-	textureDesc.MipLevels = 1;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	const auto mipLevels = LS::mipLevelCount(textureWidth, textureHeight);
+	textureDesc.MipLevels = static_cast<UINT16>(mipLevels);
+	textureDesc.Format = compression ? BlockFormat(*compression) : DXGI_FORMAT_R8G8B8A8_UNORM;
 	textureDesc.Width = textureWidth;
 	textureDesc.Height = textureHeight;
 	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
@@ -219,51 +669,192 @@ void CreateTileSampleTexture(
 	textureDesc.SampleDesc.Quality = 0;
 	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 
+	TextureUpload upload;
 	CD3DX12_HEAP_PROPERTIES heapDefault(D3D12_HEAP_TYPE_DEFAULT);
 	ThrowIfFailed(device->CreateCommittedResource(
 		&heapDefault,
 		D3D12_HEAP_FLAG_NONE,
 		&textureDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&texture)));
-
-	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, 1);
-
-	CD3DX12_HEAP_PROPERTIES heapUpload(D3D12_HEAP_TYPE_UPLOAD);
-	auto buffer = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
-	// Create the GPU upload buffer.
-	ThrowIfFailed(device->CreateCommittedResource(
-		&heapUpload,
-		D3D12_HEAP_FLAG_NONE,
-		&buffer,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_STATE_COMMON,
 		nullptr,
-		IID_PPV_ARGS(&textureUploadHeap)));
-
-	// Copy data to the intermediate upload heap and then schedule a copy 
-	// from the upload heap to the Texture2D.
-	std::vector<UINT8> textureData = GenerateTextureData(textureWidth, textureHeight, pixelSize);
-
-	D3D12_SUBRESOURCE_DATA textureSubresourceData = {};
-	textureSubresourceData.pData = &textureData[0];
-	textureSubresourceData.RowPitch = textureWidth * pixelSize;
-	textureSubresourceData.SlicePitch = textureSubresourceData.RowPitch * textureHeight;
+		IID_PPV_ARGS(&upload.Texture)));
+	upload.Texture->SetName(L"texture");
+
+	// The footprints give the row pitch the copies expect, rows are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT. For
+	// block formats a row is a row of blocks and the sizes are rounded up to whole blocks.
+	UINT64 uploadBufferSize = 0;
+	upload.Footprints.resize(mipLevels);
+	device->GetCopyableFootprints(&textureDesc, 0, mipLevels, 0, upload.Footprints.data(), nullptr, nullptr, &uploadBufferSize);
+	const auto staging = uploadHeap.Allocate(uploadBufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	upload.Staging = staging.Resource;
+
+	if (!compression)
+	{
+		// The texels are generated straight into the upload ring at the footprints' pitch, and every level is filtered
+		// from the one above it in place, there is no copy in between
+		std::vector<LS::TextureData> levels;
+		levels.reserve(mipLevels);
+		for (auto& footprint : upload.Footprints)
+		{
+			levels.emplace_back(LS::TextureData{ .data = reinterpret_cast<std::byte*>(staging.CpuAddress + footprint.Offset),
+				.rowPitch = footprint.Footprint.RowPitch, .width = footprint.Footprint.Width, .height = footprint.Footprint.Height,
+				.format = LS::TEXEL_FORMAT::R8G8B8A8_UNORM });
+			footprint.Offset += staging.Offset;
+		}
+		upload.Ready = std::async(std::launch::async, [=, levels = std::move(levels)]()
+			{
+				LS::generateTexture(pattern, levels[0]);
+				LS::generateMipChain(levels, LS::MIP_FILTER::BOX);
+			});
+	}
+	else
+	{
+		// The chain is made in scratch memory on the worker and only its blocks go into the upload ring
+		std::vector<LS::BlockData> blocks;
+		blocks.reserve(mipLevels);
+		for (uint32_t level = 0; level < mipLevels; ++level)
+		{
+			auto& footprint = upload.Footprints[level];
+			blocks.emplace_back(LS::BlockData{ .data = reinterpret_cast<std::byte*>(staging.CpuAddress + footprint.Offset),
+				.rowPitch = footprint.Footprint.RowPitch, .width = LS::mipSize(textureWidth, level),
+				.height = LS::mipSize(textureHeight, level), .format = *compression });
+			footprint.Offset += staging.Offset;
+		}
+		upload.Ready = std::async(std::launch::async, [=, blocks = std::move(blocks)]()
+			{
+				std::vector<std::byte> texels;
+				std::vector<LS::TextureData> levels;
+				size_t offset = 0;
+				for (const auto& level : blocks)
+				{
+					levels.emplace_back(LS::TextureData{ .data = nullptr, .rowPitch = level.width * 4ull, .width = level.width,
+						.height = level.height, .format = LS::TEXEL_FORMAT::R8G8B8A8_UNORM });
+					offset += levels.back().rowPitch * level.height;
+				}
+				texels.resize(offset);
+				offset = 0;
+				for (auto& level : levels)
+				{
+					level.data = texels.data() + offset;
+					offset += level.rowPitch * level.height;
+				}
 
-	UpdateSubresources(commandList.Get(), texture.Get(), textureUploadHeap.Get(), 0, 0, 1, &textureSubresourceData);
-	auto transition = CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-	commandList->ResourceBarrier(1, &transition);
+				LS::generateTexture(pattern, levels[0]);
+				LS::generateMipChain(levels, LS::MIP_FILTER::BOX);
+				for (uint32_t level = 0; level < levels.size(); ++level)
+				{
+					LS::compressTexture(levels[level], blocks[level]);
+				}
+			});
+	}
 
 	// Describe and create a SRV for the texture.
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	srvDesc.Format = textureDesc.Format;
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	device->CreateShaderResourceView(texture.Get(), &srvDesc, srvHeap->GetCPUDescriptorHandleForHeapStart());
-	texture->SetName(L"texture");
+	srvDesc.Texture2D.MipLevels = mipLevels;
+	device->CreateShaderResourceView(upload.Texture.Get(), &srvDesc, srvHandle);
+	return upload;
 }
 
+// A DDS or KTX2 file streamed into a texture a budget of rows a frame, the coarsest levels first. The copies are
+// recorded at the top of the frame's command list, so what a frame streams in its draws can already sample, and the
+// view only reaches down to the finest level that is complete. The rows go from the file's mapping straight into the
+// frame's staging memory at the footprint's pitch, nothing is read into memory in between.
+class StreamedTexture
+{
+public:
+	// Maps path, checks its header and creates the texture for its whole chain. Throws when the file cannot be used.
+	void Open(ID3D12Device* device, const std::filesystem::path& path)
+	{
+		m_file.emplace(path);
+		const auto& header = m_file->Header();
+		if (header.format.blockDimension > 1 && (header.width % header.format.blockDimension != 0 || header.height % header.format.blockDimension != 0))
+			throw std::runtime_error("Block compressed textures have to be a multiple of 4 texels each way");
+
+		D3D12_RESOURCE_DESC textureDesc = {};
+		textureDesc.MipLevels = static_cast<UINT16>(m_file->LevelCount());
+		textureDesc.Format = static_cast<DXGI_FORMAT>(header.format.dxgiFormat);
+		textureDesc.Width = header.width;
+		textureDesc.Height = header.height;
+		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+		textureDesc.DepthOrArraySize = 1;
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.SampleDesc.Quality = 0;
+		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+		CD3DX12_HEAP_PROPERTIES heapDefault(D3D12_HEAP_TYPE_DEFAULT);
+		ThrowIfFailed(device->CreateCommittedResource(
+			&heapDefault,
+			D3D12_HEAP_FLAG_NONE,
+			&textureDesc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(m_texture.ReleaseAndGetAddressOf())));
+		m_texture->SetName(path.c_str());
+
+		// Only the pitch and sizes are used, every band of rows is placed where its staging lands
+		m_footprints.resize(m_file->LevelCount());
+		device->GetCopyableFootprints(&textureDesc, 0, m_file->LevelCount(), 0, m_footprints.data(), nullptr, nullptr, nullptr);
+		m_stream = LS::MipStream(header, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	}
+
+	bool IsOpen() const
+	{
+		return m_file.has_value();
+	}
+
+	bool IsStreaming() const
+	{
+		return IsOpen() && !m_stream.AllResident();
+	}
+
+	ID3D12Resource* Resource() const
+	{
+		return m_texture.Get();
+	}
+
+	// Records the copies of the next rows that fit in budget bytes into cmdList, which has the texture in COPY_DEST
+	void Stream(ID3D12GraphicsCommandList* cmdList, UploadHeap& uploadHeap, size_t budget)
+	{
+		for (const auto& copy : m_stream.Take(budget))
+		{
+			auto placed = m_footprints[copy.level];
+			const auto blockDimension = m_file->Header().format.blockDimension;
+			const auto staging = uploadHeap.Allocate(static_cast<uint64_t>(placed.Footprint.RowPitch) * copy.rows,
+				D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			m_file->CopyRows(copy.level, copy.firstRow, copy.rows, reinterpret_cast<std::byte*>(staging.CpuAddress), placed.Footprint.RowPitch);
+
+			// Block compressed footprints are whole blocks high, so a band's last rows may run past the level's height
+			placed.Offset = staging.Offset;
+			placed.Footprint.Height = std::min(copy.rows * blockDimension, placed.Footprint.Height - copy.firstRow * blockDimension);
+			CD3DX12_TEXTURE_COPY_LOCATION destination(m_texture.Get(), copy.level);
+			CD3DX12_TEXTURE_COPY_LOCATION source(staging.Resource, placed);
+			cmdList->CopyTextureRegion(&destination, 0, copy.firstRow * blockDimension, 0, &source, nullptr);
+			m_stream.Complete(copy);
+		}
+	}
+
+	// A view of the levels that are complete, nothing can be sampled before the first Stream
+	void CreateView(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE handle) const
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = static_cast<DXGI_FORMAT>(m_file->Header().format.dxgiFormat);
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = m_stream.MostDetailedMip();
+		srvDesc.Texture2D.MipLevels = m_stream.LevelCount() - m_stream.MostDetailedMip();
+		device->CreateShaderResourceView(m_texture.Get(), &srvDesc, handle);
+	}
+
+private:
+	std::optional<LS::TextureFile> m_file;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_texture;
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> m_footprints;// One per mip level
+	LS::MipStream m_stream;
+};
+
 namespace LS
 {
 	using namespace Microsoft::WRL;
@@ -273,7 +864,39 @@ namespace LS
 		ComPtr<ID3D12CommandAllocator> CommandAllocator;// Manages a heap for the command lists. This cannot be reset while the CommandList is still in flight on the GPU
 		ComPtr<ID3D12CommandAllocator> BundleAllocator;// Use with the bundle list, this allocator performs the same operations as a command list, but is associated with the bundle
 		ComPtr<ID3D12GraphicsCommandList> BundleList;// Bundle up calls you would want repeated constantly, like setting up a draw for a vertex buffer. 
-		UINT64                         FenceValue;// Singal value between the GPU and CPU to perform synchronization. 
+		std::array<ComPtr<ID3D12CommandAllocator>, MAX_RECORDING_THREADS + 1> ListAllocators;// One per recording thread plus the closing list, see RecordParallel
+		uint32_t UsedListAllocators = 0;// Ones with commands that BeginRender has to reset
+	};
+
+	// Connects the frame timeline to the direct queue, its fence and the swap chain's waitable object
+	struct FenceQueue
+	{
+		ID3D12CommandQueue* Queue;
+		ID3D12Fence* Fence;
+		HANDLE FenceEvent;
+		HANDLE SwapChainWaitableObject;
+
+		void Signal(uint64_t value)
+		{
+			ThrowIfFailed(Queue->Signal(Fence, value));
+		}
+
+		uint64_t CompletedValue() const
+		{
+			return Fence->GetCompletedValue();
+		}
+
+		void WaitForValue(uint64_t value)
+		{
+			ThrowIfFailed(Fence->SetEventOnCompletion(value, FenceEvent));
+			WaitForSingleObjectEx(FenceEvent, INFINITE, FALSE);
+		}
+
+		// Signalled by DXGI once the swap chain holds fewer queued frames than its maximum frame latency
+		void WaitForLatency()
+		{
+			WaitForSingleObjectEx(SwapChainWaitableObject, 1000, TRUE);
+		}
 	};
 
 	struct FrameResource
@@ -282,30 +905,46 @@ namespace LS
 		ComPtr<ID3D12CommandList>      CommandList;
 	};
 
-	class LSDeviceDX12
+	class LSDeviceDX12 : public RenderBackend
 	{
 	private:
-		static constexpr uint32_t								FRAME_COUNT = 3;
-		std::array<FrameContext, FRAME_COUNT>					m_frameContext = {};
-		uint32_t												m_frameIndex;
+		static constexpr uint32_t								BACK_BUFFER_COUNT = 3;
+		static constexpr uint32_t								MIN_DRAWS_PER_LIST = 256;// Fewer are cheaper to record than a worker is to wake
+		// Render queue ids
+		static constexpr uint32_t								PIPELINE_COLOR = 0;
+		static constexpr uint32_t								PIPELINE_TEXTURED = 1;
+		static constexpr uint32_t								ROOT_SIGNATURE_EMPTY = 0;
+		static constexpr uint32_t								ROOT_SIGNATURE_TEXTURED = 1;
+		static constexpr uint32_t								VERTEX_BUFFER_COLOR = 0;
+		static constexpr uint32_t								VERTEX_BUFFER_TEXTURED = 1;
+		static constexpr uint32_t								LAYER_BACKGROUND = 0;
+		static constexpr uint32_t								LAYER_SCENE = 1;
+		std::array<FrameContext, MAX_FRAMES_IN_FLIGHT>			m_frameContext = {};
+		FrameTimeline											m_timeline;
 		float													m_aspectRatio;
 
 		// pipeline objects
 		ComPtr<ID3D12Device4>									m_pDevice;
-		ComPtr<ID3D12DescriptorHeap>							m_pRtvDescHeap;
-		ComPtr<ID3D12DescriptorHeap>							m_pSrvDescHeap;
+		DescriptorHeap											m_rtvHeap;
+		DescriptorHeap											m_srvHeap;
 		ComPtr<ID3D12CommandQueue>								m_pCommandQueue;
 		ComPtr<IDXGISwapChain4>									m_pSwapChain = nullptr;
 		ComPtr<ID3D12GraphicsCommandList>						m_pCommandList; // Records drawing or state chaning calls for execution later by the GPU - Set states, draw calls - think the D3D11::ImmediateContext 
 		ComPtr<ID3D12CommandAllocator>							m_pBundleAllocator;
 		ComPtr<ID3D12GraphicsCommandList>						m_pBundleList;
+		std::array<ComPtr<ID3D12GraphicsCommandList>, MAX_RECORDING_THREADS + 1>	m_recordingLists;// Reset onto the frame's ListAllocators each frame
+		uint32_t												m_recordingThreads = 1;
+		Parallel::WorkerPool									m_recordingPool{ MAX_RECORDING_THREADS - 1 };// Records beside the render thread, started once
+		uint32_t												m_drawCount = 1;
+		RenderQueue												m_renderQueue;
 		ComPtr<ID3D12RootSignature>								m_pRootSignature; // Used with shaders to determine input and variables
 		ComPtr<ID3D12RootSignature>								m_pRootSignature2; // Used with shaders to determine input and variables - texture_effect.hlsl
 		ComPtr<ID3D12PipelineState>								m_pPipelineState; // Defines our pipeline's state - primitive topology, render targets, shaders, etc. 
 		ComPtr<ID3D12PipelineState>								m_pPipelineStatePT; // Defines our pipeline's state - primitive topology, render targets, shaders, etc. 
 		HANDLE													m_hSwapChainWaitableObject = nullptr;
-		std::array<ComPtr<ID3D12Resource>, FRAME_COUNT>			m_mainRenderTargetResource = {};// Our Render Target resources
-		D3D12_CPU_DESCRIPTOR_HANDLE								m_mainRenderTargetDescriptor[FRAME_COUNT] = {};
+		std::array<ComPtr<ID3D12Resource>, BACK_BUFFER_COUNT>	m_mainRenderTargetResource = {};// Our Render Target resources
+		std::array<uint32_t, BACK_BUFFER_COUNT>					m_mainRenderTargetDescriptor = {};// RTV heap index of each back buffer
+		std::array<uint32_t, BACK_BUFFER_COUNT>					m_mainRenderTargetState = {};// Id of each back buffer in m_resourceStates
 		CD3DX12_VIEWPORT										m_viewport;
 		CD3DX12_RECT											m_scissorRect;
 
@@ -316,16 +955,26 @@ namespace LS
 		ComPtr<ID3D12Resource>									m_texture = nullptr;
 		D3D12_VERTEX_BUFFER_VIEW								m_vertexBufferView;
 		D3D12_VERTEX_BUFFER_VIEW								m_vertexBufferViewPT;
+		uint32_t												m_textureSrv = 0;// SRV heap index of m_texture
+		uint32_t												m_textureView = 0;// What the frame's draws use, a transient view while m_streamedTexture streams in
+		StreamedTexture											m_streamedTexture;
+		uint32_t												m_textureState = 0;// Id of m_texture in m_resourceStates
+		ResourceStates											m_resourceStates;
+		PipelineStore											m_pipelines;
 		// Synchronization Objects
 		ComPtr<ID3D12Fence>										m_fence;// Helps us sync between the GPU and CPU
 		HANDLE													m_fenceEvent = nullptr;
 		uint64_t												m_fenceLastSignaledValue = 0;
-		UINT													m_rtvDescriptorSize = 0;
+		UploadHeap												m_uploadHeap;
+		CopyQueue												m_copyQueue;// Loads assets beside the frames
+		std::future<void>										m_pipelinesReady;// Shaders and pipelines being built on workers, see waitForAssets
+		std::future<void>										m_textureReady;// Texels of the copy batch left open by LoadVertexDataToGpu
 	public:
 
 		// Creates the device and pipeline 
-		bool CreateDevice(HWND hwnd, uint32_t x, uint32_t y)
+		bool CreateDevice(void* handle, uint32_t x, uint32_t y) override
 		{
+			const auto hwnd = static_cast<HWND>(handle);
 			// [DEBUG] Enable debug interface
 #ifdef _DEBUG
 			ComPtr<ID3D12Debug> pdx12Debug = nullptr;
@@ -343,6 +992,7 @@ namespace LS
 			// Create device
 			D3D_FEATURE_LEVEL featureLevel = D3D_FEATURE_LEVEL_11_0;
 			ThrowIfFailed(D3D12CreateDevice(hardwareAdapter.Get(), featureLevel, IID_PPV_ARGS(&m_pDevice)));
+			m_pipelines.Open(PIPELINE_CACHE_DIRECTORY, hardwareAdapter.Get());
 
 			// [DEBUG] Setup debug interface to break on any warnings/errors
 #ifdef _DEBUG
@@ -376,7 +1026,7 @@ namespace LS
 			}
 			// Setup swap chain
 			DXGI_SWAP_CHAIN_DESC1 swapchainDesc1{};
-			swapchainDesc1.BufferCount = FRAME_COUNT;
+			swapchainDesc1.BufferCount = BACK_BUFFER_COUNT;
 			swapchainDesc1.Width = useRect ? static_cast<UINT>(width) : x;
 			swapchainDesc1.Height = useRect ? static_cast<UINT>(height) : y;
 			swapchainDesc1.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -407,37 +1057,21 @@ namespace LS
 				// Don't allot ALT+ENTER fullscreen
 				factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER);
 
-				m_pSwapChain->SetMaximumFrameLatency(FRAME_COUNT);
-				m_frameIndex = m_pSwapChain->GetCurrentBackBufferIndex();
+				m_pSwapChain->SetMaximumFrameLatency(m_timeline.FramesInFlight());
 				m_hSwapChainWaitableObject = m_pSwapChain->GetFrameLatencyWaitableObject();
 			}
 
 			// Descriptor - a block of data that describes an object to the GPU (SRV, UAVs, CBVs, RTVs, DSVs)
 			// Descriptor Heap - A collection of contiguous allocations of descriptors
-			// This is the RTV descriptor heap (render target view)
-			{
-				D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-				desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-				desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-				desc.NumDescriptors = FRAME_COUNT;
-				//desc.NodeMask = 1;
-
-				if (m_pDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_pRtvDescHeap)) != S_OK)
-					return false;
-				// Handles have a size that varies by GPU, so we have to ask for the Handle size on the GPU before processing
-				m_rtvDescriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-			}
+			// This is the RTV descriptor heap (render target view), the back buffers are all it holds
+			if (!m_rtvHeap.Create(m_pDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_RTV, BACK_BUFFER_COUNT, 0, false))
+				return false;
 
-			// a descriptor heap for the Constant Buffer View/Shader Resource View/Unordered Access View types (this one is just the SRV)
-			{
-				D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-				desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-				desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-				desc.NumDescriptors = 1;
-
-				if (m_pDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&m_pSrvDescHeap)) != S_OK)
-					return false;
-			}
+			// a descriptor heap for the Constant Buffer View/Shader Resource View/Unordered Access View types, sized
+			// up front so views never need a new heap (or a SetDescriptorHeaps flush) at runtime
+			if (!m_srvHeap.Create(m_pDevice.Get(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, SRV_PERSISTENT_DESCRIPTORS,
+				SRV_TRANSIENT_DESCRIPTORS, true))
+				return false;
 
 			CreateRenderTarget();
 
@@ -452,6 +1086,10 @@ namespace LS
 
 		bool LoadAssets()
 		{
+			// Pipelines are cached by what their root signatures serialize to
+			LS::CacheKey rootSignatureKey;
+			LS::CacheKey rootSignatureKey2;
+
 			// Create an empty root signature for shader.hlsl
 			{
 				CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
@@ -461,6 +1099,7 @@ namespace LS
 				ComPtr<ID3DBlob> error;
 				ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
 				ThrowIfFailed(m_pDevice->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature)));
+				rootSignatureKey = PipelineStore::HashRootSignature(signature.Get());
 			}
 
 			// Create a root signature for our texture_effect.hlsl
@@ -483,7 +1122,8 @@ namespace LS
 				rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
 
 				D3D12_STATIC_SAMPLER_DESC sampler = {};
-				sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+				// Magnified texels stay sharp, minified ones blend between the mips instead of aliasing
+				sampler.Filter = D3D12_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
 				sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 				sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
 				sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -504,6 +1144,7 @@ namespace LS
 				ComPtr<ID3DBlob> error;
 				ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error));
 				ThrowIfFailed(m_pDevice->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_pRootSignature2)));
+				rootSignatureKey2 = PipelineStore::HashRootSignature(signature.Get());
 			}
 
 			// Create pipeline states and associate to command allocators since we have an array of them
@@ -519,67 +1160,19 @@ namespace LS
 
 			m_pCommandList->SetName(L"Command List");
 
-			// Create the pipeline state, which includes compiling and loading shaders.
+			// Shaders compile and pipelines build on workers while the rest of the device is set up and the uploads run,
+			// the first frame waits for them
 			{
-				ComPtr<ID3DBlob> vertexShader;
-				ComPtr<ID3DBlob> pixelShader;
-				ComPtr<ID3DBlob> vertexShader2;
-				ComPtr<ID3DBlob> pixelShader2;
-
 #if defined(_DEBUG)
 				// Enable better shader debugging with the graphics debugging tools.
 				UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #else
 				UINT compileFlags = 0;
 #endif
-
-				ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-				ThrowIfFailed(D3DCompileFromFile(L"shaders.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
-				// Define the vertex input layout.
-				D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-				{
-					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-					{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-				};
-
-				//TODO: Create another PSO that uses the root signature and input element descriptions for our second textured triangle
-				// then see if we can display both on the scene at once. 
-				// Describe and create the graphics pipeline state object (PSO).
-				D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-				psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-				psoDesc.pRootSignature = m_pRootSignature.Get();
-				psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-				psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-				psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-				psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-				psoDesc.DepthStencilState.DepthEnable = FALSE;
-				psoDesc.DepthStencilState.StencilEnable = FALSE;
-				psoDesc.SampleMask = UINT_MAX;
-				psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-				psoDesc.NumRenderTargets = 1;
-				psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-				psoDesc.SampleDesc.Count = 1;
-				ThrowIfFailed(m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pPipelineState)));
-				// Bundle Test // 
-				{
-					ThrowIfFailed(m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&m_pBundleAllocator)));
-					ThrowIfFailed(m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, m_pBundleAllocator.Get(), m_pPipelineState.Get(), IID_PPV_ARGS(&m_pBundleList)));
-				}
-
-				// Create root signature for texture_effect.hlsl
-				ThrowIfFailed(D3DCompileFromFile(L"texture_effect.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader2, nullptr));
-				ThrowIfFailed(D3DCompileFromFile(L"texture_effect.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader2, nullptr));
-				D3D12_INPUT_ELEMENT_DESC inputElementDescs2[] =
-				{
-					{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-					{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-				};
-
-				psoDesc.InputLayout = { inputElementDescs2, _countof(inputElementDescs2) };
-				psoDesc.pRootSignature = m_pRootSignature2.Get();
-				psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader2.Get());
-				psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader2.Get());
-				ThrowIfFailed(m_pDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pPipelineStatePT)));
+				m_pipelinesReady = std::async(std::launch::async, [this, compileFlags, rootSignatureKey, rootSignatureKey2]()
+					{
+						CreatePipelines(compileFlags, rootSignatureKey, rootSignatureKey2);
+					});
 			}
 
 			ThrowIfFailed(m_pDevice->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&m_pCommandList)));
@@ -588,9 +1181,6 @@ namespace LS
 				if (m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)) != S_OK)
 					return false;
 
-				// Update the fence value, from startup, this should be 0, and thus the next frame we'll be creating will be the first frame (back buffer, as 0 is currently in front)
-				m_frameContext[FrameIndex()].FenceValue++;
-
 				m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 				if (m_fenceEvent == nullptr)
 				{
@@ -598,17 +1188,75 @@ namespace LS
 				}
 			}
 
+			m_uploadHeap.Create(m_pDevice.Get(), UPLOAD_RING_SIZE, m_fence.Get(), m_fenceEvent);
+			m_copyQueue.Create(m_pDevice.Get(), UPLOAD_RING_SIZE);
+
 			return true;
 		}
 
-		void LoadVertexDataToGpu()
+		// Runs on a worker. The four shaders are loaded at once, then both pipelines are built at once, each compile
+		// or pipeline on a thread of its own. Both come from the pipeline cache when an earlier run built them from
+		// the same sources and descriptions.
+		void CreatePipelines(UINT compileFlags, LS::CacheKey rootSignatureKey, LS::CacheKey rootSignatureKey2)
 		{
-			FrameContext* frameCon = &m_frameContext[FrameIndex()];
-			// Reclaims the memory allocated by this allocator for our next usage
-			ThrowIfFailed(frameCon->CommandAllocator->Reset());
+			const auto loadShader = [this, compileFlags](const wchar_t* file, const char* entryPoint, const char* target)
+				{
+					return std::async(std::launch::async, [=, this]()
+						{
+							return m_pipelines.LoadShader(file, entryPoint, target, compileFlags);
+						});
+				};
+			auto vertexShader = loadShader(L"shaders.hlsl", "VSMain", "vs_5_0");
+			auto pixelShader = loadShader(L"shaders.hlsl", "PSMain", "ps_5_0");
+			auto vertexShader2 = loadShader(L"texture_effect.hlsl", "VSMain", "vs_5_0");
+			auto pixelShader2 = loadShader(L"texture_effect.hlsl", "PSMain", "ps_5_0");
 
-			// Resets a command list to its initial state 
-			ThrowIfFailed(m_pCommandList->Reset(frameCon->CommandAllocator.Get(), m_pPipelineState.Get()));
+			// Define the vertex input layout.
+			D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+			{
+				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+				{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+			};
+
+			// Describe and create the graphics pipeline state object (PSO).
+			D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+			psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+			psoDesc.pRootSignature = m_pRootSignature.Get();
+			psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+			psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+			psoDesc.DepthStencilState.DepthEnable = FALSE;
+			psoDesc.DepthStencilState.StencilEnable = FALSE;
+			psoDesc.SampleMask = UINT_MAX;
+			psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+			psoDesc.NumRenderTargets = 1;
+			psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+			psoDesc.SampleDesc.Count = 1;
+
+			// The textured pipeline for texture_effect.hlsl differs in its input layout and root signature
+			D3D12_INPUT_ELEMENT_DESC inputElementDescs2[] =
+			{
+				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+			};
+			auto psoDesc2 = psoDesc;
+			psoDesc2.InputLayout = { inputElementDescs2, _countof(inputElementDescs2) };
+			psoDesc2.pRootSignature = m_pRootSignature2.Get();
+
+			auto texturedPipeline = std::async(std::launch::async, [&]()
+				{
+					return m_pipelines.CreateGraphicsPipeline(m_pDevice.Get(), psoDesc2, rootSignatureKey2, vertexShader2.get(), pixelShader2.get());
+				});
+			m_pPipelineState = m_pipelines.CreateGraphicsPipeline(m_pDevice.Get(), psoDesc, rootSignatureKey, vertexShader.get(), pixelShader.get());
+			m_pPipelineStatePT = texturedPipeline.get();
+		}
+
+		// Uploads the triangles and the texture on the copy queue without waiting for any of it. The buffers go in a
+		// batch of their own, then the texture is generated on a worker while their copies execute. Its copies are
+		// recorded into a second batch that waitForAssets submits once the worker is done, and has the direct queue
+		// wait for both before the first frame.
+		void LoadVertexDataToGpu()
+		{
+			auto* copyList = m_copyQueue.Begin();
 
 			// Create the vertex buffer.
 			{
@@ -621,28 +1269,16 @@ namespace LS
 				};
 				const UINT vertexBufferSize = sizeof(triangleVertices);
 
-				// We create a default and upload buffer. Using the upload buffer, we transfer the data from the CPU to the GPU (hence the name) but we do not use the buffer as reference.
-				// We copy the data from our upload buffer to the default buffer, and the only differenc between the two is the staging - Upload vs Default.
+				// We create a default buffer and stage the data in the upload ring. Using the upload ring, we transfer the data from the CPU to the GPU (hence the name) but we do not use it as reference.
+				// We copy the data from the ring to the default buffer, and the only differenc between the two is the staging - Upload vs Default.
 				// Default types are best for static data that isn't changing.
-				ComPtr<ID3D12Resource> uploadBuffer;
-				m_vertexBuffer = CreateDefaultBuffer(m_pDevice.Get(), m_pCommandList.Get(), triangleVertices, sizeof(Vertex) * 3, uploadBuffer, D3D12_RESOURCE_STATE_GENERIC_READ, L"default vb");
-
-				// We must wait and insure the data has been copied before moving on 
-				// After we execute the command list, we need to sync with the GPU and wait to create our buffer view
-				m_pCommandList->Close();
-				ExecuteCommandList();
-				WaitForGpu();
+				m_vertexBuffer = CreateDefaultBuffer(m_pDevice.Get(), copyList, triangleVertices, sizeof(Vertex) * 3, m_copyQueue.Staging(), L"default vb");
 
-				// Initialize the vertex buffer view.
+				// The view only needs the GPU address, the copy runs on the queue ahead of any draw that reads it
 				m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
 				m_vertexBufferView.StrideInBytes = sizeof(Vertex);
 				m_vertexBufferView.SizeInBytes = vertexBufferSize;
 
-				ThrowIfFailed(frameCon->CommandAllocator->Reset());
-
-				// Resets a command list to its initial state 
-				ThrowIfFailed(m_pCommandList->Reset(frameCon->CommandAllocator.Get(), m_pPipelineStatePT.Get()));
-
 				// Textured Triangle
 				VertexPT triangleVerticesPT[] =
 				{
@@ -652,50 +1288,90 @@ namespace LS
 				};
 				const UINT vertexBufferSize2 = sizeof(triangleVerticesPT);
 
-				ComPtr<ID3D12Resource> textureUploadBuffer;
-				m_vertexBufferPT = CreateDefaultBuffer(m_pDevice.Get(), m_pCommandList.Get(), triangleVerticesPT, sizeof(VertexPT) * 3, textureUploadBuffer, D3D12_RESOURCE_STATE_GENERIC_READ, L"pt default vb");
-				ComPtr<ID3D12Resource> textureUploadHeap;
-				{
-					CreateTileSampleTexture(m_pDevice.Get(), m_texture, 256u, 256u, 4u, textureUploadHeap, m_pCommandList, m_pSrvDescHeap);
-				}
-				m_pCommandList->Close();
-				ExecuteCommandList();
-				WaitForGpu();
+				m_vertexBufferPT = CreateDefaultBuffer(m_pDevice.Get(), copyList, triangleVerticesPT, sizeof(VertexPT) * 3, m_copyQueue.Staging(), L"pt default vb");
 
 				// Initialize the vertex buffer view.
 				m_vertexBufferViewPT.BufferLocation = m_vertexBufferPT->GetGPUVirtualAddress();
 				m_vertexBufferViewPT.StrideInBytes = sizeof(VertexPT);
 				m_vertexBufferViewPT.SizeInBytes = vertexBufferSize2;
-				// Bundle Test - The vertex buffer isn't iniitialized until here, and we are still in recording state from LoadAssets() call
-				// So now we can just fulfill our commands and close it. 
-				{
-					m_pBundleList->SetGraphicsRootSignature(m_pRootSignature.Get());
-					m_pBundleList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-					m_pBundleList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-					m_pBundleList->DrawInstanced(3, 1, 0, 0);
-					ThrowIfFailed(m_pBundleList->Close());
-				}
 			}
+			m_copyQueue.Submit();
+
+			// A copy queue leaves what it used in the common state. The moves out of it are queued here and recorded
+			// with the first frame's barriers, after the direct queue has waited for the copies.
+			m_resourceStates.Require(m_resourceStates.Track(m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COMMON), D3D12_RESOURCE_STATE_GENERIC_READ);
+			m_resourceStates.Require(m_resourceStates.Track(m_vertexBufferPT.Get(), D3D12_RESOURCE_STATE_COMMON), D3D12_RESOURCE_STATE_GENERIC_READ);
+			m_textureSrv = m_srvHeap.AllocatePersistent();
+			m_textureView = m_textureSrv;
+
+			if (std::filesystem::exists(SAMPLE_TEXTURE_FILE))
+			{
+				// Nothing to copy up front, the frames stream it in, see streamTexture
+				m_streamedTexture.Open(m_pDevice.Get(), SAMPLE_TEXTURE_FILE);
+				m_texture = m_streamedTexture.Resource();
+				m_textureState = m_resourceStates.Track(m_texture.Get(), D3D12_RESOURCE_STATE_COMMON);
+				return;
+			}
+
+			// The texture's staging memory belongs to the second batch, so it is only allocated once the first is closed
+			auto texture = CreateTileSampleTexture(m_pDevice.Get(), 256u, 256u, LS::TexturePattern{}, LS::BLOCK_FORMAT::BC1_UNORM,
+				m_copyQueue.Staging(), m_srvHeap.CpuHandle(m_textureSrv));
+			m_texture = texture.Texture;
+			copyList = m_copyQueue.Begin();
+			texture.RecordCopy(copyList);
+			m_textureState = m_resourceStates.Track(m_texture.Get(), D3D12_RESOURCE_STATE_COMMON);
+			m_resourceStates.Require(m_textureState, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			m_textureReady = std::move(texture.Ready);
 		}
 
-		constexpr UINT FrameIndex()
+		// The first frame needs the pipelines and the texture from the workers and the copies from the copy queue. The
+		// CPU only blocks for the workers, and only when they are not done yet, the direct queue waits for the copies on
+		// the GPU.
+		void waitForAssets()
 		{
-			return m_frameIndex == 0 ? 0 : m_frameIndex % FRAME_COUNT;
+			if (m_textureReady.valid())
+			{
+				// The copy reads the staging memory when it executes, so the texels have to be written by then
+				m_textureReady.get();
+				m_copyQueue.Submit();
+			}
+			if (m_pipelinesReady.valid())
+			{
+				// Rethrows whatever failed on the workers
+				m_pipelinesReady.get();
+				recordBundle();
+#ifdef _DEBUG
+				const auto cacheStats = m_pipelines.Cache().Stats();
+				const auto text = "Pipeline cache: " + std::to_string(cacheStats.hits) + " hits, " + std::to_string(cacheStats.misses) + " misses\n";
+				OutputDebugStringA(text.c_str());
+#endif
+			}
+			m_copyQueue.QueueWait(m_pCommandQueue.Get());
 		}
 
-		// Waits for work on the GPU to finish before moving on to the next frame
-		void WaitForGpu()
+		// Bundle Test - the bundle starts out with the gradient triangle's pipeline, so it can only be recorded once
+		// the pipeline is built
+		void recordBundle()
 		{
-			FrameContext* frameCon = &m_frameContext[FrameIndex()];
+			ThrowIfFailed(m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&m_pBundleAllocator)));
+			ThrowIfFailed(m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, m_pBundleAllocator.Get(), m_pPipelineState.Get(), IID_PPV_ARGS(&m_pBundleList)));
+			m_pBundleList->SetGraphicsRootSignature(m_pRootSignature.Get());
+			m_pBundleList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			m_pBundleList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
+			m_pBundleList->DrawInstanced(3, 1, 0, 0);
+			ThrowIfFailed(m_pBundleList->Close());
+		}
 
-			// Signals the GPU the next upcoming fence value
-			ThrowIfFailed(m_pCommandQueue->Signal(m_fence.Get(), frameCon->FenceValue));
+		FenceQueue Queue()
+		{
+			return FenceQueue{ m_pCommandQueue.Get(), m_fence.Get(), m_fenceEvent, m_hSwapChainWaitableObject };
+		}
 
-			// Wait for the fence to be processes
-			ThrowIfFailed(m_fence->SetEventOnCompletion(frameCon->FenceValue, m_fenceEvent));
-			WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
-			// Increment value to the next frame
-			frameCon->FenceValue++;
+		// Waits for work on the GPU to finish before moving on to the next frame
+		void WaitForGpu()
+		{
+			auto queue = Queue();
+			m_timeline.Flush(queue);
 		}
 
 		void GetHardwareAdapter(
@@ -766,18 +1442,31 @@ namespace LS
 		void CreateRenderTarget()
 		{
 			// The handle can now be used to help use build our RTVs - one RTV per frame/back buffer
-			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_pRtvDescHeap->GetCPUDescriptorHandleForHeapStart());
-			for (UINT i = 0; i < FRAME_COUNT; i++)
+			for (UINT i = 0; i < BACK_BUFFER_COUNT; i++)
 			{
 				ThrowIfFailed(m_pSwapChain->GetBuffer(i, IID_PPV_ARGS(&m_mainRenderTargetResource[i])));
-				m_pDevice->CreateRenderTargetView(m_mainRenderTargetResource[i].Get(), nullptr, rtvHandle);
-				rtvHandle.Offset(1, m_rtvDescriptorSize);
-				m_mainRenderTargetDescriptor[i] = rtvHandle;
-				ThrowIfFailed(m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_frameContext[i].CommandAllocator)));
+				m_mainRenderTargetDescriptor[i] = m_rtvHeap.AllocatePersistent();
+				m_pDevice->CreateRenderTargetView(m_mainRenderTargetResource[i].Get(), nullptr, m_rtvHeap.CpuHandle(m_mainRenderTargetDescriptor[i]));
+				m_mainRenderTargetState[i] = m_resourceStates.Track(m_mainRenderTargetResource[i].Get(), D3D12_RESOURCE_STATE_PRESENT);
+			}
+
+			// One allocator per frame slot, however many frames are in flight
+			for (auto& fc : m_frameContext)
+			{
+				ThrowIfFailed(m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&fc.CommandAllocator)));
+				for (auto& allocator : fc.ListAllocators)
+				{
+					ThrowIfFailed(m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)));
+				}
+			}
+			// Created closed, a list can be reset onto another allocator as soon as it has been submitted
+			for (auto& list : m_recordingLists)
+			{
+				ThrowIfFailed(m_pDevice->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&list)));
 			}
 		}
 
-		void CheckFeatures([[maybe_unused]] std::string& s)
+		void CheckFeatures([[maybe_unused]] std::string& s) override
 		{
 			std::cout << "Checking features ... \n";
 		}
@@ -866,7 +1555,7 @@ namespace LS
 			m_pCommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 		}
 
-		void Render(const ColorRGBA& clearColor)
+		void Render(const ColorRGBA& clearColor) override
 		{
 			// Reset command allocator to claim memory used by it
 			// Then reset the command list to its default state
@@ -884,16 +1573,28 @@ namespace LS
 			m_pCommandList->ExecuteBundle(m_pBundleList.Get());
 			/*SetRootSignature(m_pRootSignature);
 			Draw(m_vertexBufferView, 3);*/
-			// set the state of the pipeline for the textured triangle
-			SetPipelineState(m_pPipelineStatePT);
-			SetRootSignature(m_pRootSignature2);
-			SetDescriptorHeaps();
-			Draw(m_vertexBufferViewPT, 3);
-			// Prepare to render to the render target
-			PresentRTV();
-			CloseCommandList();
-			// Throw command list onto the command queue and prepare to send it off
-			ExecuteCommandList();
+			// The textured triangle and the rest of the scene go through the render queue
+			streamTexture();
+			BuildRenderQueue();
+			m_resourceStates.Require(m_textureState, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			const auto workers = Parallel::workerCount(m_renderQueue.Size(), MIN_DRAWS_PER_LIST, m_recordingThreads);
+			if (workers > 1)
+			{
+				RecordParallel(frameCon, workers);
+			}
+			else
+			{
+				m_resourceStates.Flush(m_pCommandList.Get());
+				SetDescriptorHeaps();
+				m_pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+				auto sink = CommandListSink{ *this, m_pCommandList.Get() };
+				m_renderQueue.Replay(sink, 0, m_renderQueue.Size());
+				// Prepare to render to the render target
+				PresentRTV();
+				CloseCommandList();
+				// Throw command list onto the command queue and prepare to send it off
+				ExecuteCommandList();
+			}
 			ThrowIfFailed(m_pSwapChain->Present(1, 0));
 			// Wait for next frame
 			MoveToNextFrame();
@@ -901,11 +1602,168 @@ namespace LS
 
 
 
+		// Copies the next rows of a streaming texture ahead of the draws, which sample the levels that are complete
+		void streamTexture()
+		{
+			if (!m_streamedTexture.IsStreaming())
+				return;
+
+			m_resourceStates.Require(m_textureState, D3D12_RESOURCE_STATE_COPY_DEST);
+			m_resourceStates.Flush(m_pCommandList.Get());
+			m_streamedTexture.Stream(m_pCommandList.Get(), m_uploadHeap, TEXTURE_STREAM_BUDGET);
+			// Frames in flight still read the views from before, so each frame gets a transient one until the chain is
+			// complete. No frame has read the persistent view yet by then.
+			m_textureView = m_streamedTexture.IsStreaming() ? m_srvHeap.AllocateTransient() : m_textureSrv;
+			m_streamedTexture.CreateView(m_pDevice.Get(), m_srvHeap.CpuHandle(m_textureView));
+		}
+
+		// Turns render queue ids back into the objects they stand for
+		struct CommandListSink
+		{
+			LSDeviceDX12& device;
+			ID3D12GraphicsCommandList* list;
+
+			void SetPipeline(uint32_t id)
+			{
+				list->SetPipelineState(id == PIPELINE_TEXTURED ? device.m_pPipelineStatePT.Get() : device.m_pPipelineState.Get());
+			}
+
+			void SetRootSignature(uint32_t id)
+			{
+				list->SetGraphicsRootSignature(id == ROOT_SIGNATURE_TEXTURED ? device.m_pRootSignature2.Get() : device.m_pRootSignature.Get());
+			}
+
+			void SetDescriptorTable(uint32_t index)
+			{
+				list->SetGraphicsRootDescriptorTable(0, device.m_srvHeap.GpuHandle(index));
+			}
+
+			void SetVertexBuffer(uint32_t id)
+			{
+				list->IASetVertexBuffers(0, 1, id == VERTEX_BUFFER_TEXTURED ? &device.m_vertexBufferViewPT : &device.m_vertexBufferView);
+			}
+
+			void Draw(const DrawItem& item)
+			{
+				list->DrawInstanced(item.vertexCount, item.instanceCount, item.startVertex, 0);
+			}
+		};
+
+		// Draw i is the textured triangle when i is even and the gradient triangle behind it when i is odd, submitted
+		// interleaved, the sort groups them by layer and state
+		void BuildRenderQueue()
+		{
+			m_renderQueue.Clear();
+			for (uint32_t i = 0; i < m_drawCount; ++i)
+			{
+				const auto textured = i % 2 == 0;
+				const auto key = textured ?
+					DrawKey{ .layer = LAYER_SCENE, .pipeline = PIPELINE_TEXTURED, .rootSignature = ROOT_SIGNATURE_TEXTURED,
+						.descriptorTable = m_textureView, .vertexBuffer = VERTEX_BUFFER_TEXTURED } :
+					DrawKey{ .layer = LAYER_BACKGROUND, .pipeline = PIPELINE_COLOR, .rootSignature = ROOT_SIGNATURE_EMPTY,
+						.vertexBuffer = VERTEX_BUFFER_COLOR };
+				m_renderQueue.Submit(key, DrawItem{ .vertexCount = 3 });
+			}
+			m_renderQueue.Sort();
+		}
+
+		// The clear and the bundle stay in m_pCommandList. The sorted render queue is split into contiguous slices, and
+		// each worker records its slice into its own list and allocator from the frame's pool. One more list takes
+		// the present barrier, since the resource state tracker is only used from this thread. Every list goes to the
+		// queue in one ExecuteCommandLists call, in draw order, so the frame comes out the same for any worker count.
+		void RecordParallel(FrameContext* frameCon, uint32_t workers)
+		{
+			m_resourceStates.Flush(m_pCommandList.Get());
+			CloseCommandList();
+
+			const auto rtvHandle = m_rtvHeap.CpuHandle(m_mainRenderTargetDescriptor[m_pSwapChain->GetCurrentBackBufferIndex()]);
+			m_recordingPool.ForChunks(m_renderQueue.Size(), workers, [&](size_t begin, size_t end, uint32_t chunk)
+				{
+					// A failure throws HrException, ForChunks rethrows it here once every slice has returned
+					auto list = m_recordingLists[chunk].Get();
+					ThrowIfFailed(list->Reset(frameCon->ListAllocators[chunk].Get(), nullptr));
+					// Lists do not inherit state from the one before them, every slice sets up all its draws need
+					list->RSSetViewports(1, &m_viewport);
+					list->RSSetScissorRects(1, &m_scissorRect);
+					list->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+					ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Heap() };
+					list->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+					list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					auto sink = CommandListSink{ *this, list };
+					m_renderQueue.Replay(sink, begin, end);
+					ThrowIfFailed(list->Close());
+				});
+
+			auto closing = m_recordingLists[workers].Get();
+			ThrowIfFailed(closing->Reset(frameCon->ListAllocators[workers].Get(), nullptr));
+			m_resourceStates.Require(m_mainRenderTargetState[m_pSwapChain->GetCurrentBackBufferIndex()], D3D12_RESOURCE_STATE_PRESENT);
+			m_resourceStates.Flush(closing);
+			ThrowIfFailed(closing->Close());
+			frameCon->UsedListAllocators = workers + 1;
+
+			std::array<ID3D12CommandList*, MAX_RECORDING_THREADS + 2> ppCommandLists = { m_pCommandList.Get() };
+			for (uint32_t i = 0; i <= workers; ++i)
+			{
+				ppCommandLists[i + 1] = m_recordingLists[i].Get();
+			}
+			m_pCommandQueue->ExecuteCommandLists(workers + 2, ppCommandLists.data());
+		}
+
+		uint32_t SetFramesInFlight(uint32_t count) override
+		{
+			const auto frames = m_timeline.SetFramesInFlight(count);
+			applyFrameLatency();
+			return frames;
+		}
+
+		void SetLowLatency(bool enabled) override
+		{
+			m_timeline.SetLowLatency(enabled);
+			applyFrameLatency();
+		}
+
+		uint32_t SetRecordingThreads(uint32_t count) override
+		{
+			m_recordingThreads = std::clamp(count, 1u, MAX_RECORDING_THREADS);
+			return m_recordingThreads;
+		}
+
+		void SetDrawCount(uint32_t count) override
+		{
+			m_drawCount = count;
+		}
+
+		const FrameTimeline& Timeline() const override
+		{
+			return m_timeline;
+		}
+
+		// In low latency mode DXGI only lets one frame queue up, otherwise as many as are in flight
+		void applyFrameLatency()
+		{
+			if (m_pSwapChain)
+			{
+				ThrowIfFailed(m_pSwapChain->SetMaximumFrameLatency(m_timeline.LowLatency() ? 1 : m_timeline.FramesInFlight()));
+			}
+		}
+
 		FrameContext* BeginRender()
 		{
-			FrameContext* frameCon = &m_frameContext[FrameIndex()];
+			waitForAssets();
+			// Wait until the slot's previous frame has finished on the GPU
+			auto queue = Queue();
+			const auto slot = m_timeline.BeginFrame(queue);
+			FrameContext* frameCon = &m_frameContext[slot];
+			m_uploadHeap.Reclaim(queue.CompletedValue());
+			// The slot's transient descriptors were only read by the frame just waited for
+			m_srvHeap.BeginFrame(slot, queue.CompletedValue());
 			// Reclaims the memory allocated by this allocator for our next usage
 			ThrowIfFailed(frameCon->CommandAllocator->Reset());
+			for (uint32_t i = 0; i < frameCon->UsedListAllocators; ++i)
+			{
+				ThrowIfFailed(frameCon->ListAllocators[i]->Reset());
+			}
+			frameCon->UsedListAllocators = 0;
 			return frameCon;
 		}
 
@@ -928,9 +1786,8 @@ namespace LS
 
 		void SetDescriptorHeaps()
 		{
-			ID3D12DescriptorHeap* ppHeaps[] = { m_pSrvDescHeap.Get() };
+			ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Heap() };
 			m_pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
-			m_pCommandList->SetGraphicsRootDescriptorTable(0, m_pSrvDescHeap->GetGPUDescriptorHandleForHeapStart());
 		}
 
 		void SetViewport()
@@ -944,10 +1801,10 @@ namespace LS
 		{
 			// This will prep the back buffer as our render target and prepare it for transition
 			auto backbufferIndex = m_pSwapChain->GetCurrentBackBufferIndex();
-			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_mainRenderTargetResource[backbufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			m_pCommandList->ResourceBarrier(1, &barrier);
+			m_resourceStates.Require(m_mainRenderTargetState[backbufferIndex], D3D12_RESOURCE_STATE_RENDER_TARGET);
+			m_resourceStates.Flush(m_pCommandList.Get());
 
-			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_pRtvDescHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
+			auto rtvHandle = m_rtvHeap.CpuHandle(m_mainRenderTargetDescriptor[backbufferIndex]);
 			m_pCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 			// Similar to D3D11 - this is our command for drawing. For now, testing triangle drawing through MSDN example code
 			const float color[] = { clearColor.r, clearColor.g, clearColor.b, clearColor.a };
@@ -959,15 +1816,16 @@ namespace LS
 		{
 			// This will prep the back buffer as our render target and prepare it for transition
 			auto backbufferIndex = m_pSwapChain->GetCurrentBackBufferIndex();
-			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_mainRenderTargetResource[backbufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			m_pCommandList->ResourceBarrier(1, &barrier);
+			m_resourceStates.Require(m_mainRenderTargetState[backbufferIndex], D3D12_RESOURCE_STATE_RENDER_TARGET);
+			m_resourceStates.Flush(m_pCommandList.Get());
 
-			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_pRtvDescHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
+			auto rtvHandle = m_rtvHeap.CpuHandle(m_mainRenderTargetDescriptor[backbufferIndex]);
 			m_pCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 		}
 
 		void Draw(D3D12_VERTEX_BUFFER_VIEW& bufferView, uint64_t vertices, std::optional<uint64_t> instances = 1u)
 		{
+			m_resourceStates.Flush(m_pCommandList.Get());
 			m_pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 			m_pCommandList->IASetVertexBuffers(0, 1, &bufferView);
 			m_pCommandList->DrawInstanced(vertices, instances.value(), 0, 0);
@@ -978,8 +1836,8 @@ namespace LS
 			auto backbufferIndex = m_pSwapChain->GetCurrentBackBufferIndex();
 
 			// Indicate that the back buffer will now be used to present.
-			auto barrier2 = CD3DX12_RESOURCE_BARRIER::Transition(m_mainRenderTargetResource[backbufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-			m_pCommandList->ResourceBarrier(1, &barrier2);
+			m_resourceStates.Require(m_mainRenderTargetState[backbufferIndex], D3D12_RESOURCE_STATE_PRESENT);
+			m_resourceStates.Flush(m_pCommandList.Get());
 		}
 
 		void CloseCommandList()
@@ -987,34 +1845,54 @@ namespace LS
 			m_pCommandList->Close();
 		}
 
+		// Sends the frame's fence value to the queue, BeginRender waits for it once the slot comes around again
 		void MoveToNextFrame()
 		{
-			// Get frame context and send to the command queu our fence value 
-			auto frameCon = &m_frameContext[m_frameIndex];
-			ThrowIfFailed(m_pCommandQueue->Signal(m_fence.Get(), frameCon->FenceValue));
-
-			// Update frame index
-			m_frameIndex = m_pSwapChain->GetCurrentBackBufferIndex();
-
-			if (m_fence->GetCompletedValue() < frameCon->FenceValue)
-			{
-				ThrowIfFailed(m_fence->SetEventOnCompletion(frameCon->FenceValue, m_fenceEvent));
-				WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
-			}
+			auto queue = Queue();
+			m_timeline.EndFrame(queue);
+			// Uploads made while recording the frame are done with it
+			m_uploadHeap.Close(m_timeline.LastSignalledValue());
+			m_srvHeap.EndFrame(m_timeline.LastSignalledValue());
+		}
 
-			m_frameContext[m_frameIndex].FenceValue = frameCon->FenceValue + 1;
+		bool AssetsReady() const override
+		{
+			const auto ready = [](const std::future<void>& future)
+				{
+					return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+				};
+			// A generated texture's batch is submitted by the first frame, which then only waits for it on the GPU
+			return ready(m_pipelinesReady) && ready(m_textureReady) && m_copyQueue.IsIdle();
 		}
 
-		void OnDestroy()
+		void OnDestroy() override
 		{
+			if (m_pipelinesReady.valid())
+			{
+				m_pipelinesReady.wait();
+			}
+			// The worker writes into the copy queue's staging memory
+			if (m_textureReady.valid())
+			{
+				m_textureReady.wait();
+			}
 			WaitForGpu();
+			m_copyQueue.Destroy();
 
 			CloseHandle(m_fenceEvent);
 		}
 	};
 
-	LSDevice::LSDevice() : m_pImpl(std::make_unique<LSDeviceDX12>())
+	LSDevice::LSDevice(RENDER_BACKEND backend)
 	{
+		if (backend == RENDER_BACKEND::HEADLESS)
+		{
+			m_pImpl = std::make_unique<HeadlessDevice>();
+		}
+		else
+		{
+			m_pImpl = std::make_unique<LSDeviceDX12>();
+		}
 	}
 
 	LSDevice::~LSDevice()
@@ -1024,7 +1902,7 @@ namespace LS
 
 	bool LSDevice::CreateDevice(void* handle, uint32_t x, uint32_t y)
 	{
-		return m_pImpl->CreateDevice(reinterpret_cast<HWND>(handle), x, y);
+		return m_pImpl->CreateDevice(handle, x, y);
 	}
 
 	void LSDevice::CheckFeatures(std::string& s)
@@ -1041,4 +1919,34 @@ namespace LS
 	{
 		m_pImpl->Render(clearColor);
 	}
+
+	uint32_t LSDevice::SetFramesInFlight(uint32_t count)
+	{
+		return m_pImpl->SetFramesInFlight(count);
+	}
+
+	void LSDevice::SetLowLatency(bool enabled)
+	{
+		m_pImpl->SetLowLatency(enabled);
+	}
+
+	uint32_t LSDevice::SetRecordingThreads(uint32_t count)
+	{
+		return m_pImpl->SetRecordingThreads(count);
+	}
+
+	void LSDevice::SetDrawCount(uint32_t count)
+	{
+		m_pImpl->SetDrawCount(count);
+	}
+
+	const FrameTimeline& LSDevice::Timeline() const
+	{
+		return m_pImpl->Timeline();
+	}
+
+	bool LSDevice::AssetsReady() const
+	{
+		return m_pImpl->AssetsReady();
+	}
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+export module MappedFile;
+
+namespace Data
+{
+	// Read only memory mapping of a whole file. The bytes are paged in on first touch, so opening even a large file
+	// costs next to nothing, and the mapping starts on a page boundary.
+	export class MappedFile
+	{
+	public:
+		MappedFile() = default;
+
+		explicit MappedFile(const std::filesystem::path& path)
+		{
+			Open(path);
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept
+		{
+			*this = std::move(other);
+		}
+
+		MappedFile& operator=(MappedFile&& other) noexcept
+		{
+			if (this != &other)
+			{
+				Close();
+				m_data = std::exchange(other.m_data, nullptr);
+				m_size = std::exchange(other.m_size, 0);
+#if defined(_WIN32)
+				m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+				m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+			}
+			return *this;
+		}
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		// Maps the file, replacing any previous mapping. Empty and missing files fail.
+		bool Open(const std::filesystem::path& path)
+		{
+			Close();
+#if defined(_WIN32)
+			m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size{};
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			{
+				Close();
+				return false;
+			}
+
+			m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_mapping)
+			{
+				Close();
+				return false;
+			}
+
+			m_data = static_cast<const std::byte*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+			if (!m_data)
+			{
+				Close();
+				return false;
+			}
+			m_size = static_cast<size_t>(size.QuadPart);
+#else
+			const auto fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return false;
+
+			struct stat info {};
+			if (fstat(fd, &info) != 0 || info.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+
+			auto* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			// The mapping keeps the file referenced after the descriptor is closed
+			::close(fd);
+			if (data == MAP_FAILED)
+				return false;
+
+			m_data = static_cast<const std::byte*>(data);
+			m_size = static_cast<size_t>(info.st_size);
+#endif
+			return true;
+		}
+
+		void Close()
+		{
+#if defined(_WIN32)
+			if (m_data)
+			{
+				UnmapViewOfFile(m_data);
+			}
+			if (m_mapping)
+			{
+				CloseHandle(m_mapping);
+				m_mapping = nullptr;
+			}
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+				m_file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (m_data)
+			{
+				munmap(const_cast<std::byte*>(m_data), m_size);
+			}
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		bool IsOpen() const
+		{
+			return m_data != nullptr;
+		}
+
+		std::span<const std::byte> Bytes() const
+		{
+			return { m_data, m_size };
+		}
+
+		size_t Size() const
+		{
+			return m_size;
+		}
+
+	private:
+		const std::byte* m_data = nullptr;
+		size_t m_size = 0;
+#if defined(_WIN32)
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#endif
+	};
+
+	// Writes bytes to path through a temporary file that is renamed over the target once complete, so a reader
+	// mapping the file never sees a half written one
+	export bool writeFile(const std::filesystem::path& path, std::span<const std::byte> bytes)
+	{
+		auto temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			if (!out)
+				return false;
+			out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!out)
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp, path, error);
+		return !error;
+	}
+}
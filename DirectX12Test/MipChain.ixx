@@ -0,0 +1,463 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <numbers>
+#include <stdexcept>
+#if defined(_M_X64) || defined(__x86_64__)
+#define LS_MIP_X86 1
+#include <immintrin.h>
+#endif
+// MSVC emits any intrinsic on request, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define LS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LS_TARGET_AVX2
+#endif
+export module MipChain;
+
+import BoxKernels;
+import Parallel;
+import TextureFormat;
+
+// Mip chains built on the CPU, each level filtered from the one above it. Filtering happens on linear values, so
+// sRGB levels are decoded before they are averaged and encoded after. A level that is exactly half the size of its
+// source both ways goes through a 2x2 box kernel: 8 bit UNORM texels are averaged as integers with SSE or AVX2,
+// everything else is unpacked and averaged as floats with SSE. Any other size or filter goes through a separable
+// resampler that filters each source row horizontally once and then combines rows vertically. Rows of a level are
+// split between workers, every level waits for the one before it.
+namespace LS
+{
+	export enum class MIP_FILTER : uint32_t
+	{
+		BOX,// Average of the source texels a destination texel covers, 2x2 when a size halves evenly
+		TENT,// Bilinear tent, 4x4 taps when a size halves evenly
+		LANCZOS3// Three lobe windowed sinc, 12x12 taps when a size halves evenly; sharpest, rings at hard edges
+	};
+
+	// Size of level of a size texels wide dimension, like D3D12 sizes mips
+	export uint32_t mipSize(uint32_t size, uint32_t level)
+	{
+		return std::max(1u, size >> level);
+	}
+
+	// Levels in a full chain, down to 1x1
+	export uint32_t mipLevelCount(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+	}
+
+	namespace
+	{
+		// Rows are handed out so that a worker gets at least this many destination texels
+		constexpr size_t MIN_TEXELS_PER_WORKER = 16 * 1024;
+		constexpr uint32_t NO_ROW = UINT32_MAX;
+
+		// The source texels each destination texel is made from, the same number for every destination texel.
+		// Texels with fewer are padded with zero weights.
+		struct Taps
+		{
+			uint32_t count = 0;
+			std::vector<uint32_t> indices;
+			std::vector<float> weights;
+		};
+
+		float filterRadius(MIP_FILTER filter)
+		{
+			switch (filter)
+			{
+			case MIP_FILTER::BOX:
+				return 0.5f;
+			case MIP_FILTER::TENT:
+				return 1.0f;
+			case MIP_FILTER::LANCZOS3:
+				return 3.0f;
+			}
+			throw std::runtime_error("Unknown mip filter");
+		}
+
+		// Weight at distance x from the destination texel's centre, in destination texels
+		double filterWeight(MIP_FILTER filter, double x)
+		{
+			x = std::abs(x);
+			switch (filter)
+			{
+			case MIP_FILTER::BOX:
+				return x < 0.5 ? 1.0 : 0.0;
+			case MIP_FILTER::TENT:
+				return std::max(0.0, 1.0 - x);
+			case MIP_FILTER::LANCZOS3:
+				if (x < 1e-6)
+					return 1.0;
+				if (x >= 3.0)
+					return 0.0;
+				return 3.0 * std::sin(std::numbers::pi * x) * std::sin(std::numbers::pi * x / 3.0) / (std::numbers::pi * std::numbers::pi * x * x);
+			}
+			throw std::runtime_error("Unknown mip filter");
+		}
+
+		// Taps taking source texels down to destination, edges clamp
+		Taps makeTaps(uint32_t source, uint32_t destination, MIP_FILTER filter)
+		{
+			const auto scale = static_cast<double>(source) / static_cast<double>(destination);
+			const auto radius = filterRadius(filter) * scale;
+			std::vector<std::vector<std::pair<uint32_t, double>>> texels(destination);
+			uint32_t count = 1;
+			for (uint32_t i = 0; i < destination; ++i)
+			{
+				const auto centre = (static_cast<double>(i) + 0.5) * scale;
+				const auto first = static_cast<int64_t>(std::floor(centre - radius));
+				const auto last = static_cast<int64_t>(std::ceil(centre + radius));
+				auto& taps = texels[i];
+				auto total = 0.0;
+				for (auto j = first; j < last; ++j)
+				{
+					// The box weighs each source texel by how much of it the destination texel covers, so sizes that do
+					// not halve evenly still average exactly what they cover
+					const auto weight = filter == MIP_FILTER::BOX ?
+						std::max(0.0, std::min(static_cast<double>(j + 1), centre + radius) - std::max(static_cast<double>(j), centre - radius)) :
+						filterWeight(filter, (static_cast<double>(j) + 0.5 - centre) / scale);
+					if (weight == 0.0)
+						continue;
+
+					const auto index = static_cast<uint32_t>(std::clamp<int64_t>(j, 0, source - 1));
+					if (!taps.empty() && taps.back().first == index)
+					{
+						taps.back().second += weight;
+					}
+					else
+					{
+						taps.emplace_back(index, weight);
+					}
+					total += weight;
+				}
+				for (auto& tap : taps)
+				{
+					tap.second /= total;
+				}
+				count = std::max(count, static_cast<uint32_t>(taps.size()));
+			}
+
+			Taps result;
+			result.count = count;
+			result.indices.resize(static_cast<size_t>(destination) * count);
+			result.weights.resize(static_cast<size_t>(destination) * count);
+			for (uint32_t i = 0; i < destination; ++i)
+			{
+				const auto& taps = texels[i];
+				for (uint32_t k = 0; k < count; ++k)
+				{
+					const auto tap = k < taps.size() ? taps[k] : std::pair<uint32_t, double>{ taps.back().first, 0.0 };
+					result.indices[i * count + k] = tap.first;
+					result.weights[i * count + k] = static_cast<float>(tap.second);
+				}
+			}
+			return result;
+		}
+
+		void filterChannel(const float* in, const Taps& taps, uint32_t width, float* out)
+		{
+			const auto* indices = taps.indices.data();
+			const auto* weights = taps.weights.data();
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				auto sum = 0.0f;
+				for (uint32_t k = 0; k < taps.count; ++k)
+				{
+					sum += weights[x * taps.count + k] * in[indices[x * taps.count + k]];
+				}
+				out[x] = sum;
+			}
+		}
+
+		// in filtered horizontally into out, out is sized to the taps' destination
+		void filterRow(const LinearRow& in, const Taps& taps, LinearRow& out)
+		{
+			const auto width = static_cast<uint32_t>(taps.indices.size() / taps.count);
+			out.Resize(width);
+			filterChannel(in.r.data(), taps, width, out.r.data());
+			filterChannel(in.g.data(), taps, width, out.g.data());
+			filterChannel(in.b.data(), taps, width, out.b.data());
+			filterChannel(in.a.data(), taps, width, out.a.data());
+		}
+
+		void accumulateChannel(float* out, const float* in, float weight, uint32_t width)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				out[x] += weight * in[x];
+			}
+		}
+
+		void accumulateRow(LinearRow& out, const LinearRow& in, float weight)
+		{
+			const auto width = out.Width();
+			accumulateChannel(out.r.data(), in.r.data(), weight, width);
+			accumulateChannel(out.g.data(), in.g.data(), weight, width);
+			accumulateChannel(out.b.data(), in.b.data(), weight, width);
+			accumulateChannel(out.a.data(), in.a.data(), weight, width);
+		}
+
+		// Rows [begin, end) of destination through the separable resampler. Source rows are filtered horizontally
+		// once and kept in a ring that holds every row one destination row needs, neighbouring destination rows
+		// share most of theirs.
+		void resampleRows(const TextureData& source, const TextureData& destination, const Taps& horizontal, const Taps& vertical,
+			uint32_t begin, uint32_t end)
+		{
+			struct CachedRow
+			{
+				uint32_t row = NO_ROW;
+				LinearRow filtered;
+			};
+			std::vector<CachedRow> cache(vertical.count + 1);
+			LinearRow decoded;
+			LinearRow out;
+			out.Resize(destination.width);
+			for (auto y = begin; y < end; ++y)
+			{
+				std::fill(out.r.begin(), out.r.end(), 0.0f);
+				std::fill(out.g.begin(), out.g.end(), 0.0f);
+				std::fill(out.b.begin(), out.b.end(), 0.0f);
+				std::fill(out.a.begin(), out.a.end(), 0.0f);
+				for (uint32_t k = 0; k < vertical.count; ++k)
+				{
+					const auto weight = vertical.weights[y * vertical.count + k];
+					if (weight == 0.0f)
+						continue;
+
+					const auto row = vertical.indices[y * vertical.count + k];
+					auto& cached = cache[row % cache.size()];
+					if (cached.row != row)
+					{
+						unpackRow(source.Row(row), source.format, source.width, decoded);
+						filterRow(decoded, horizontal, cached.filtered);
+						cached.row = row;
+					}
+					accumulateRow(out, cached.filtered, weight);
+				}
+				packRow(out, destination.format, destination.Row(y));
+			}
+		}
+
+		// 2x2 averages of 8 bit texels with channels bytes each, rounded to nearest
+		void halveBytesScalar(const uint8_t* above, const uint8_t* below, uint32_t channels, uint32_t begin, uint32_t end,
+			uint8_t* out)
+		{
+			for (auto x = begin; x < end; ++x)
+			{
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					const auto left = x * 2 * channels + c;
+					const auto right = left + channels;
+					out[x * channels + c] = static_cast<uint8_t>((above[left] + above[right] + below[left] + below[right] + 2) >> 2);
+				}
+			}
+		}
+
+		// The float average adds the pairs of each row first, so every path rounds the same way
+		void halveFloatsScalar(const float* above, const float* below, uint32_t begin, uint32_t end, float* out)
+		{
+			for (auto x = begin; x < end; ++x)
+			{
+				out[x] = ((above[x * 2] + above[x * 2 + 1]) + (below[x * 2] + below[x * 2 + 1])) * 0.25f;
+			}
+		}
+
+#if LS_MIP_X86
+		void halve8888Sse(const uint8_t* above, const uint8_t* below, uint32_t width, uint8_t* out)
+		{
+			const auto zero = _mm_setzero_si128();
+			const auto two = _mm_set1_epi16(2);
+			// Sums of the two texels in each 64 bit half of rows added as 16 bit lanes, in the low half
+			const auto pairs = [&](__m128i a, __m128i b, bool high)
+				{
+					const auto sum = high ?
+						_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)) :
+						_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+					return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+				};
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				const auto a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x * 8));
+				const auto a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x * 8 + 16));
+				const auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x * 8));
+				const auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x * 8 + 16));
+				const auto first = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pairs(a0, b0, false), pairs(a0, b0, true)), two), 2);
+				const auto second = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pairs(a1, b1, false), pairs(a1, b1, true)), two), 2);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(first, second));
+			}
+			halveBytesScalar(above, below, 4, x, width, out);
+		}
+
+		LS_TARGET_AVX2 void halve8888Avx2(const uint8_t* above, const uint8_t* below, uint32_t width, uint8_t* out)
+		{
+			const auto zero = _mm256_setzero_si256();
+			const auto two = _mm256_set1_epi16(2);
+			// Like the SSE kernel in each 128 bit lane, so the lanes come out as texels 0 1 4 5 and 2 3 6 7
+			const auto pairs = [&](__m256i a, __m256i b, bool high) LS_TARGET_AVX2
+				{
+					const auto sum = high ?
+						_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)) :
+						_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+					return _mm256_add_epi16(sum, _mm256_srli_si256(sum, 8));
+				};
+			uint32_t x = 0;
+			for (; x + 8 <= width; x += 8)
+			{
+				const auto a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x * 8));
+				const auto a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x * 8 + 32));
+				const auto b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x * 8));
+				const auto b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x * 8 + 32));
+				const auto first = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(pairs(a0, b0, false), pairs(a0, b0, true)), two), 2);
+				const auto second = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(pairs(a1, b1, false), pairs(a1, b1, true)), two), 2);
+				const auto packed = _mm256_packus_epi16(first, second);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+			}
+			halveBytesScalar(above, below, 4, x, width, out);
+		}
+
+		void halveFloatsSse(const float* above, const float* below, uint32_t width, float* out)
+		{
+			const auto quarter = _mm_set1_ps(0.25f);
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				const auto a0 = _mm_loadu_ps(above + x * 2);
+				const auto a1 = _mm_loadu_ps(above + x * 2 + 4);
+				const auto b0 = _mm_loadu_ps(below + x * 2);
+				const auto b1 = _mm_loadu_ps(below + x * 2 + 4);
+				const auto a = _mm_add_ps(_mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1)));
+				const auto b = _mm_add_ps(_mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_ps(out + x, _mm_mul_ps(_mm_add_ps(a, b), quarter));
+			}
+			halveFloatsScalar(above, below, x, width, out);
+		}
+#endif
+
+		void halve8888(const uint8_t* above, const uint8_t* below, uint32_t width, uint8_t* out)
+		{
+#if LS_MIP_X86
+			const auto level = Data::simdLevel();
+			if (level == Data::SIMD_LEVEL::AVX2)
+				return halve8888Avx2(above, below, width, out);
+			if (level == Data::SIMD_LEVEL::SSE)
+				return halve8888Sse(above, below, width, out);
+#endif
+			halveBytesScalar(above, below, 4, 0, width, out);
+		}
+
+		void halveFloats(const float* above, const float* below, uint32_t width, float* out)
+		{
+#if LS_MIP_X86
+			if (Data::simdLevel() != Data::SIMD_LEVEL::SCALAR)
+				return halveFloatsSse(above, below, width, out);
+#endif
+			halveFloatsScalar(above, below, 0, width, out);
+		}
+
+		// Formats whose 2x2 average can be taken on the stored bytes
+		uint32_t unormBytes(TEXEL_FORMAT format)
+		{
+			switch (format)
+			{
+			case TEXEL_FORMAT::R8_UNORM:
+				return 1;
+			case TEXEL_FORMAT::R8G8_UNORM:
+				return 2;
+			case TEXEL_FORMAT::R8G8B8A8_UNORM:
+			case TEXEL_FORMAT::B8G8R8A8_UNORM:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+
+		// Rows [begin, end) of a destination exactly half its source's size
+		void halveRows(const TextureData& source, const TextureData& destination, uint32_t begin, uint32_t end)
+		{
+			const auto channels = unormBytes(source.format);
+			if (channels != 0)
+			{
+				for (auto y = begin; y < end; ++y)
+				{
+					const auto* above = reinterpret_cast<const uint8_t*>(source.Row(y * 2));
+					const auto* below = reinterpret_cast<const uint8_t*>(source.Row(y * 2 + 1));
+					auto* out = reinterpret_cast<uint8_t*>(destination.Row(y));
+					if (channels == 4)
+					{
+						halve8888(above, below, destination.width, out);
+					}
+					else
+					{
+						halveBytesScalar(above, below, channels, 0, destination.width, out);
+					}
+				}
+				return;
+			}
+
+			LinearRow above;
+			LinearRow below;
+			LinearRow out;
+			out.Resize(destination.width);
+			const auto halve = [&](const std::vector<float>& a, const std::vector<float>& b, std::vector<float>& o)
+				{
+					halveFloats(a.data(), b.data(), destination.width, o.data());
+				};
+			for (auto y = begin; y < end; ++y)
+			{
+				unpackRow(source.Row(y * 2), source.format, source.width, above);
+				unpackRow(source.Row(y * 2 + 1), source.format, source.width, below);
+				halve(above.r, below.r, out.r);
+				halve(above.g, below.g, out.g);
+				halve(above.b, below.b, out.b);
+				halve(above.a, below.a, out.a);
+				packRow(out, destination.format, destination.Row(y));
+			}
+		}
+	}
+
+	// Filters source down into destination, which has to be of the same format and no larger either way. Rows are
+	// split between up to threads workers, 0 uses every hardware thread, and the output does not depend on how many
+	// there are.
+	export void generateMip(const TextureData& source, const TextureData& destination, MIP_FILTER filter = MIP_FILTER::BOX,
+		uint32_t threads = 0)
+	{
+		if (source.format != destination.format)
+			throw std::runtime_error("Mip levels have to share a format");
+		if (destination.width > source.width || destination.height > source.height || destination.width == 0 || destination.height == 0)
+			throw std::runtime_error("Mip level is not smaller than its source");
+
+		const auto minRows = std::max<size_t>(1, MIN_TEXELS_PER_WORKER / destination.width);
+		const auto workers = Parallel::workerCount(destination.height, minRows, threads);
+		if (filter == MIP_FILTER::BOX && source.width == destination.width * 2 && source.height == destination.height * 2)
+		{
+			Parallel::forChunks(destination.height, workers, [&](size_t begin, size_t end, uint32_t)
+				{
+					halveRows(source, destination, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+				});
+			return;
+		}
+
+		const auto horizontal = makeTaps(source.width, destination.width, filter);
+		const auto vertical = makeTaps(source.height, destination.height, filter);
+		Parallel::forChunks(destination.height, workers, [&](size_t begin, size_t end, uint32_t)
+			{
+				resampleRows(source, destination, horizontal, vertical, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+			});
+	}
+
+	// Fills levels[1] onwards from levels[0], each from the level before it
+	export void generateMipChain(std::span<const TextureData> levels, MIP_FILTER filter = MIP_FILTER::BOX, uint32_t threads = 0)
+	{
+		for (size_t level = 1; level < levels.size(); ++level)
+		{
+			generateMip(levels[level - 1], levels[level], filter, threads);
+		}
+	}
+}
@@ -0,0 +1,249 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <utility>
+export module Parallel;
+
+namespace Parallel
+{
+	// Number of workers worth starting for count elements when each should get at least minPerWorker of them.
+	// requested = 0 uses every hardware thread.
+	export uint32_t workerCount(size_t count, size_t minPerWorker, uint32_t requested = 0)
+	{
+		if (requested == 0)
+		{
+			requested = std::max(1u, std::thread::hardware_concurrency());
+		}
+		return static_cast<uint32_t>(std::clamp<size_t>(count / std::max<size_t>(minPerWorker, 1), 1, requested));
+	}
+
+	// Splits [0, count) into one contiguous chunk per worker and runs fn(begin, end, chunk) on each of them,
+	// the first chunk on the calling thread. Every worker is joined before it returns; when chunks throw, the
+	// exception of the lowest one is rethrown on the calling thread.
+	export
+	template <class Fn>
+	void forChunks(size_t count, uint32_t chunks, Fn&& fn)
+	{
+		chunks = std::max(chunks, 1u);
+		std::vector<std::exception_ptr> errors(chunks);
+		const auto step = (count + chunks - 1) / chunks;
+		const auto run = [&fn, &errors, count, step](uint32_t c) noexcept
+			{
+				try
+				{
+					const auto begin = std::min(count, step * c);
+					fn(begin, std::min(count, begin + step), c);
+				}
+				catch (...)
+				{
+					errors[c] = std::current_exception();
+				}
+			};
+
+		std::vector<std::thread> workers;
+		workers.reserve(chunks - 1);
+		uint32_t started = 1;
+		try
+		{
+			for (; started < chunks; ++started)
+			{
+				workers.emplace_back(run, started);
+			}
+		}
+		catch (...)
+		{
+			// Out of threads, the chunks that did not get one run here
+		}
+		run(0);
+		for (auto c = started; c < chunks; ++c)
+		{
+			run(c);
+		}
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		for (const auto& error : errors)
+		{
+			if (error)
+				std::rethrow_exception(error);
+		}
+	}
+
+	// Threads that stay around for chunked work that comes back every frame, so it does not pay for starting threads
+	// each time. ForChunks splits [0, count) like forChunks does and the calling thread takes chunks as well. A call
+	// made while the pool is busy, from one of its own chunks or from another thread, runs its chunks on the calling
+	// thread instead of waiting for the pool.
+	export class WorkerPool
+	{
+	public:
+		// threads = 0 starts one less than there are hardware threads, the calling thread makes up the rest
+		explicit WorkerPool(uint32_t threads = 0)
+		{
+			if (threads == 0)
+			{
+				threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			}
+			m_threads.reserve(threads);
+			for (uint32_t i = 0; i < threads; ++i)
+			{
+				m_threads.emplace_back([this]() { work(); });
+			}
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (auto& thread : m_threads)
+			{
+				thread.join();
+			}
+		}
+
+		uint32_t Threads() const
+		{
+			return static_cast<uint32_t>(m_threads.size());
+		}
+
+		// Runs fn(begin, end, chunk) on every chunk and returns once all of them are done. When chunks throw, the
+		// exception of the lowest one is rethrown on the calling thread.
+		template <class Fn>
+		void ForChunks(size_t count, uint32_t chunks, Fn&& fn)
+		{
+			chunks = std::max(chunks, 1u);
+			struct Job
+			{
+				std::remove_reference_t<Fn>* fn;
+				size_t count;
+				size_t step;
+			};
+			Job job{ .fn = &fn, .count = count, .step = (count + chunks - 1) / chunks };
+			const auto run = [](void* context, uint32_t c)
+				{
+					const auto& job = *static_cast<const Job*>(context);
+					const auto begin = std::min(job.count, job.step * c);
+					(*job.fn)(begin, std::min(job.count, begin + job.step), c);
+				};
+
+			std::unique_lock lock(m_mutex);
+			if (m_chunks != 0 || m_threads.empty() || chunks == 1)
+			{
+				lock.unlock();
+				runInline(run, &job, chunks);
+				return;
+			}
+
+			m_run = run;
+			m_context = &job;
+			m_chunks = chunks;
+			m_next = 0;
+			m_done = 0;
+			m_error = nullptr;
+			m_wake.notify_all();
+			while (m_next < m_chunks)
+			{
+				runClaimed(lock);
+			}
+			// Chunks are claimed and counted under the lock, so once all are done no worker touches job again
+			m_finished.wait(lock, [this]() { return m_done == m_chunks; });
+			m_chunks = 0;
+			const auto error = std::exchange(m_error, nullptr);
+			lock.unlock();
+			if (error)
+				std::rethrow_exception(error);
+		}
+
+	private:
+		using Run = void (*)(void*, uint32_t);
+
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;// Workers wait here for chunks to claim
+		std::condition_variable m_finished;// The caller waits here for the last chunk
+		bool m_stop = false;
+		// The job being run, all under m_mutex. m_chunks is 0 while the pool is idle.
+		Run m_run = nullptr;
+		void* m_context = nullptr;
+		uint32_t m_chunks = 0;
+		uint32_t m_next = 0;
+		uint32_t m_done = 0;
+		uint32_t m_errorChunk = 0;
+		std::exception_ptr m_error;
+
+		static void runInline(Run run, void* context, uint32_t chunks)
+		{
+			std::exception_ptr first;
+			for (uint32_t c = 0; c < chunks; ++c)
+			{
+				try
+				{
+					run(context, c);
+				}
+				catch (...)
+				{
+					if (!first)
+					{
+						first = std::current_exception();
+					}
+				}
+			}
+			if (first)
+				std::rethrow_exception(first);
+		}
+
+		// Claims the next chunk and runs it with the lock released
+		void runClaimed(std::unique_lock<std::mutex>& lock)
+		{
+			const auto c = m_next++;
+			const auto run = m_run;
+			auto* context = m_context;
+			lock.unlock();
+			std::exception_ptr error;
+			try
+			{
+				run(context, c);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			lock.lock();
+			if (error && (!m_error || c < m_errorChunk))
+			{
+				m_error = error;
+				m_errorChunk = c;
+			}
+			if (++m_done == m_chunks)
+			{
+				m_finished.notify_one();
+			}
+		}
+
+		void work()
+		{
+			std::unique_lock lock(m_mutex);
+			while (true)
+			{
+				m_wake.wait(lock, [this]() { return m_stop || m_next < m_chunks; });
+				if (m_stop)
+					return;
+				runClaimed(lock);
+			}
+		}
+	};
+}
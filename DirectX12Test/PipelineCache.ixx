@@ -0,0 +1,345 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <span>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <atomic>
+#include <filesystem>
+#include <type_traits>
+#include <utility>
+export module PipelineCache;
+
+import MappedFile;
+
+namespace LS
+{
+	// 128 bit content hash that names a cache entry
+	export struct CacheKey
+	{
+		uint64_t low = 0;
+		uint64_t high = 0;
+
+		bool operator==(const CacheKey&) const = default;
+
+		// 32 hex digits, high half first
+		std::string ToString() const
+		{
+			constexpr char DIGITS[] = "0123456789abcdef";
+			std::string text(32, '0');
+			for (int i = 0; i < 16; ++i)
+			{
+				text[15 - i] = DIGITS[(high >> (i * 4)) & 0xf];
+				text[31 - i] = DIGITS[(low >> (i * 4)) & 0xf];
+			}
+			return text;
+		}
+	};
+
+	// Streaming hash over everything that decides what a compile produces. Every Add is prefixed with its length, so
+	// ("ab", "c") and ("a", "bc") hash differently. Two 64 bit lanes are mixed a word at a time and avalanched on
+	// Finish; good enough to tell cache entries apart, not meant to stand up to someone forging collisions.
+	export class ContentHasher
+	{
+	public:
+		ContentHasher& Add(std::span<const std::byte> bytes)
+		{
+			const auto size = static_cast<uint64_t>(bytes.size());
+			raw(&size, sizeof(size));
+			raw(bytes.data(), bytes.size());
+			return *this;
+		}
+
+		ContentHasher& Add(std::string_view text)
+		{
+			return Add(std::as_bytes(std::span(text.data(), text.size())));
+		}
+
+		ContentHasher& Add(const char* text)
+		{
+			return Add(std::string_view(text ? text : ""));
+		}
+
+		ContentHasher& Add(const CacheKey& key)
+		{
+			return AddValue(key);
+		}
+
+		// Hashes the object representation, padding included, so structs with padding have to be zero initialized
+		template<class T>
+			requires std::is_trivially_copyable_v<T>
+		ContentHasher& AddValue(const T& value)
+		{
+			return Add(std::as_bytes(std::span(&value, 1)));
+		}
+
+		CacheKey Finish() const
+		{
+			auto low = m_low;
+			auto high = m_high;
+			if (m_tailSize > 0)
+			{
+				uint64_t word = 0;
+				std::memcpy(&word, m_tail.data(), m_tailSize);
+				mix(low, high, word);
+			}
+			low ^= m_length;
+			high ^= m_length;
+			low += high;
+			high += low;
+			low = avalanche(low);
+			high = avalanche(high);
+			low += high;
+			high += low;
+			return { .low = low, .high = high };
+		}
+
+	private:
+		static constexpr uint64_t K1 = 0x87c37b91114253d5ull;
+		static constexpr uint64_t K2 = 0x4cf5ad432745937full;
+
+		uint64_t m_low = 0x9e3779b97f4a7c15ull;
+		uint64_t m_high = 0xc2b2ae3d27d4eb4full;
+		uint64_t m_length = 0;
+		std::array<std::byte, 8> m_tail = {};
+		uint32_t m_tailSize = 0;
+
+		static uint64_t rotl(uint64_t value, int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		static uint64_t avalanche(uint64_t value)
+		{
+			value ^= value >> 33;
+			value *= 0xff51afd7ed558ccdull;
+			value ^= value >> 33;
+			value *= 0xc4ceb9fe1a85ec53ull;
+			value ^= value >> 33;
+			return value;
+		}
+
+		static void mix(uint64_t& low, uint64_t& high, uint64_t word)
+		{
+			low ^= rotl(word * K1, 31) * K2;
+			low = rotl(low, 27) * 5 + 0x52dce729;
+			high ^= rotl(word * K2, 33) * K1;
+			high = rotl(high, 31) * 5 + 0x38495ab5;
+			high += low;
+		}
+
+		void raw(const void* data, size_t size)
+		{
+			auto* bytes = static_cast<const std::byte*>(data);
+			m_length += size;
+			// Top up a word left over from the previous call first
+			while (size > 0 && m_tailSize > 0)
+			{
+				m_tail[m_tailSize++] = *bytes++;
+				--size;
+				if (m_tailSize == m_tail.size())
+				{
+					uint64_t word;
+					std::memcpy(&word, m_tail.data(), sizeof(word));
+					mix(m_low, m_high, word);
+					m_tailSize = 0;
+				}
+			}
+			for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+			{
+				uint64_t word;
+				std::memcpy(&word, bytes, sizeof(word));
+				mix(m_low, m_high, word);
+			}
+			// An empty span may have no data pointer at all
+			if (size > 0)
+			{
+				std::memcpy(m_tail.data() + m_tailSize, bytes, size);
+				m_tailSize += static_cast<uint32_t>(size);
+			}
+		}
+	};
+
+	// A cache entry mapped into memory, the bytes stay valid for as long as the blob lives
+	export class CachedBlob
+	{
+	public:
+		CachedBlob(Data::MappedFile&& file, size_t offset, size_t size) :
+			m_file(std::move(file)), m_offset(offset), m_size(size)
+		{
+		}
+
+		std::span<const std::byte> Bytes() const
+		{
+			return m_file.Bytes().subspan(m_offset, m_size);
+		}
+
+		const void* Data() const
+		{
+			return Bytes().data();
+		}
+
+		size_t Size() const
+		{
+			return m_size;
+		}
+
+	private:
+		Data::MappedFile m_file;
+		size_t m_offset;
+		size_t m_size;
+	};
+
+	export struct PipelineCacheStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t rejected = 0;// Entries that were there but failed validation, also counted as misses
+		uint64_t stores = 0;
+		uint64_t failedStores = 0;
+	};
+
+	// Content addressed store for compiled shaders and pipeline blobs, one file per entry in a directory. Entries are
+	// found by the hash of their inputs, so a changed source, define or pipeline description simply misses and the new
+	// result is stored next to the old one. Files start with a small header that repeats the key and carries the
+	// payload's size and hash; an entry that is truncated, from another version or byte order, or named after a
+	// different key is treated as a miss and replaced by the next Store. Entries are written to a temporary file and
+	// renamed into place, so a reader never maps half an entry, and loaded by mapping the file, so a warm start reads
+	// no more than it hands to the driver. Find and Store can be called from several threads at once, as long as no
+	// two of them store the same key at the same time.
+	export class PipelineCache
+	{
+	public:
+		explicit PipelineCache(std::filesystem::path directory = {}) : m_directory(std::move(directory))
+		{
+		}
+
+		// Not thread safe, has to happen before the cache is shared
+		void Open(std::filesystem::path directory)
+		{
+			m_directory = std::move(directory);
+		}
+
+		const std::filesystem::path& Directory() const
+		{
+			return m_directory;
+		}
+
+		std::filesystem::path Path(const CacheKey& key) const
+		{
+			return m_directory / (key.ToString() + ".bin");
+		}
+
+		std::optional<CachedBlob> Find(const CacheKey& key)
+		{
+			Data::MappedFile file(Path(key));
+			if (!file.IsOpen())
+			{
+				++m_misses;
+				return std::nullopt;
+			}
+
+			const auto bytes = file.Bytes();
+			if (!valid(key, bytes))
+			{
+				++m_rejected;
+				++m_misses;
+				return std::nullopt;
+			}
+
+			++m_hits;
+			const auto size = static_cast<size_t>(reinterpret_cast<const EntryHeader*>(bytes.data())->payloadSize);
+			return CachedBlob(std::move(file), sizeof(EntryHeader), size);
+		}
+
+		// Writes bytes as the entry for key, replacing what was there. A failed store only costs the next run a miss.
+		bool Store(const CacheKey& key, std::span<const std::byte> bytes)
+		{
+			std::error_code error;
+			std::filesystem::create_directories(m_directory, error);
+
+			EntryHeader header{};
+			header.magic = ENTRY_MAGIC;
+			header.byteOrder = ENTRY_BYTE_ORDER;
+			header.version = ENTRY_VERSION;
+			header.headerSize = sizeof(EntryHeader);
+			header.key = key;
+			header.payloadSize = bytes.size();
+			header.payloadHash = ContentHasher().Add(bytes).Finish();
+
+			std::vector<std::byte> entry(sizeof(EntryHeader) + bytes.size());
+			std::memcpy(entry.data(), &header, sizeof(header));
+			if (!bytes.empty())
+			{
+				std::memcpy(entry.data() + sizeof(header), bytes.data(), bytes.size());
+			}
+
+			if (!Data::writeFile(Path(key), entry))
+			{
+				++m_failedStores;
+				return false;
+			}
+			++m_stores;
+			return true;
+		}
+
+		PipelineCacheStats Stats() const
+		{
+			return { .hits = m_hits, .misses = m_misses, .rejected = m_rejected, .stores = m_stores, .failedStores = m_failedStores };
+		}
+
+		void ResetStats()
+		{
+			m_hits = 0;
+			m_misses = 0;
+			m_rejected = 0;
+			m_stores = 0;
+			m_failedStores = 0;
+		}
+
+	private:
+		static constexpr uint32_t ENTRY_MAGIC = 0x4350534C;// "LSPC"
+		static constexpr uint32_t ENTRY_VERSION = 1;
+		static constexpr uint32_t ENTRY_BYTE_ORDER = 0x01020304;
+
+		// The payload follows right after, 16 byte aligned within the file
+		struct EntryHeader
+		{
+			uint32_t magic;
+			uint32_t byteOrder;// ENTRY_BYTE_ORDER in the writer's byte order
+			uint32_t version;
+			uint32_t headerSize;
+			CacheKey key;
+			uint64_t payloadSize;
+			uint64_t reserved;
+			CacheKey payloadHash;
+		};
+		static_assert(sizeof(EntryHeader) % 16 == 0);
+
+		std::filesystem::path m_directory;
+		std::atomic<uint64_t> m_hits = 0;
+		std::atomic<uint64_t> m_misses = 0;
+		std::atomic<uint64_t> m_rejected = 0;
+		std::atomic<uint64_t> m_stores = 0;
+		std::atomic<uint64_t> m_failedStores = 0;
+
+		static bool valid(const CacheKey& key, std::span<const std::byte> bytes)
+		{
+			if (bytes.size() < sizeof(EntryHeader))
+				return false;
+
+			EntryHeader header;
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			if (header.magic != ENTRY_MAGIC || header.byteOrder != ENTRY_BYTE_ORDER || header.version != ENTRY_VERSION
+				|| header.headerSize != sizeof(EntryHeader) || header.key != key
+				|| header.payloadSize != bytes.size() - sizeof(EntryHeader))
+				return false;
+
+			return ContentHasher().Add(bytes.subspan(sizeof(EntryHeader))).Finish() == header.payloadHash;
+		}
+	};
+}
@@ -0,0 +1,311 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+export module ProceduralTexture;
+
+import Parallel;
+import TextureFormat;
+import RenderBackend;
+
+namespace LS
+{
+	export enum class PATTERN : uint32_t
+	{
+		SOLID,// color0 everywhere
+		CHECKERBOARD,// cellsX by cellsY cells, color0 where the cell's column and row are both even or both odd
+		GRADIENT,// color0 to color1 along (directionX, directionY), stretched so the corners reach both ends
+		NOISE// Value noise from color0 to color1, cellsX by cellsY lattice cells at the lowest octave, tiles seamlessly
+	};
+
+	// Colors are linear, sRGB formats encode them on the way out
+	export struct TexturePattern
+	{
+		PATTERN pattern = PATTERN::CHECKERBOARD;
+		ColorRGBA color0 = { .r = 0.0f, .g = 0.0f, .b = 0.0f, .a = 1.0f };
+		ColorRGBA color1 = { .r = 1.0f, .g = 1.0f, .b = 1.0f, .a = 1.0f };
+		uint32_t cellsX = 8;
+		uint32_t cellsY = 8;
+		float directionX = 1.0f;
+		float directionY = 0.0f;
+		uint32_t seed = 0;
+		uint32_t octaves = 4;// Each doubles the lattice frequency and halves the amplitude of the one before, up to a cell per texel
+	};
+
+	namespace
+	{
+		// Rows are handed out so that a worker gets at least this many texels
+		constexpr size_t MIN_TEXELS_PER_WORKER = 64 * 1024;
+
+		struct Column
+		{
+			uint32_t x0;
+			uint32_t x1;
+			float weight;
+		};
+
+		// Scratch for one worker, the rows it generates go through these
+		struct RowScratch
+		{
+			LinearRow row;
+			std::vector<float> t;// Blend factor between the two colors per texel
+			std::vector<std::byte> packed[2];// Rows that repeat, packed once
+			std::vector<float> lattice[2];
+			std::vector<std::vector<Column>> columns;// Per noise octave, the same for every row
+		};
+
+		void fillSolid(LinearRow& row, const ColorRGBA& color)
+		{
+			std::fill(row.r.begin(), row.r.end(), color.r);
+			std::fill(row.g.begin(), row.g.end(), color.g);
+			std::fill(row.b.begin(), row.b.end(), color.b);
+			std::fill(row.a.begin(), row.a.end(), color.a);
+		}
+
+		// One channel at a time through plain pointers, so the loops vectorize
+		void blendChannel(float* out, float from, float to, const float* t, uint32_t width)
+		{
+			const auto delta = to - from;
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				out[x] = from + delta * t[x];
+			}
+		}
+
+		void blendRow(LinearRow& row, const ColorRGBA& c0, const ColorRGBA& c1, const std::vector<float>& t)
+		{
+			const auto width = row.Width();
+			blendChannel(row.r.data(), c0.r, c1.r, t.data(), width);
+			blendChannel(row.g.data(), c0.g, c1.g, t.data(), width);
+			blendChannel(row.b.data(), c0.b, c1.b, t.data(), width);
+			blendChannel(row.a.data(), c0.a, c1.a, t.data(), width);
+		}
+
+		// Cell of coordinate in [0, size) when size is split into cells, spreads the remainder for sizes that
+		// do not divide evenly
+		uint32_t cellOf(uint32_t coordinate, uint32_t cells, uint32_t size)
+		{
+			return static_cast<uint32_t>(static_cast<uint64_t>(coordinate) * cells / size);
+		}
+
+		void checkerRow(LinearRow& row, const TexturePattern& pattern, uint32_t parity)
+		{
+			const auto width = row.Width();
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const auto& color = (cellOf(x, pattern.cellsX, width) & 1) == parity ? pattern.color0 : pattern.color1;
+				row.r[x] = color.r;
+				row.g[x] = color.g;
+				row.b[x] = color.b;
+				row.a[x] = color.a;
+			}
+		}
+
+		// Lattice values in [0, 1), a hash of the point so any row can be made without the ones before it
+		float latticeValue(uint32_t x, uint32_t y, uint32_t seed)
+		{
+			auto h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+		}
+
+		float smoothstep(float t)
+		{
+			return t * t * (3.0f - 2.0f * t);
+		}
+
+		// Lattice position of texel centre coordinate in a size wide texture with frequency cells
+		void latticePosition(uint32_t coordinate, uint32_t frequency, uint32_t size, uint32_t& cell, float& weight)
+		{
+			const auto position = (static_cast<float>(coordinate) + 0.5f) * static_cast<float>(frequency) / static_cast<float>(size) - 0.5f;
+			const auto floor = std::floor(position);
+			weight = smoothstep(position - floor);
+			// The lattice wraps, so the texture tiles
+			cell = static_cast<uint32_t>(static_cast<int64_t>(floor) + frequency) % frequency;
+		}
+
+		void noiseRow(RowScratch& scratch, const TexturePattern& pattern, uint32_t y, uint32_t height)
+		{
+			const auto width = scratch.row.Width();
+			std::fill(scratch.t.begin(), scratch.t.end(), 0.0f);
+			auto amplitude = 1.0f;
+			auto total = 0.0f;
+			for (uint32_t octave = 0; octave < std::max(pattern.octaves, 1u); ++octave)
+			{
+				// Frequencies past one cell per texel add nothing but cost
+				const auto frequencyX = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(std::max(pattern.cellsX, 1u)) << octave, width));
+				const auto frequencyY = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(std::max(pattern.cellsY, 1u)) << octave, height));
+				const auto seed = pattern.seed + octave * 0x9e3779b9u;
+
+				if (octave == scratch.columns.size())
+				{
+					auto& columns = scratch.columns.emplace_back(width);
+					for (uint32_t x = 0; x < width; ++x)
+					{
+						auto& column = columns[x];
+						latticePosition(x, frequencyX, width, column.x0, column.weight);
+						column.x1 = column.x0 + 1 == frequencyX ? 0 : column.x0 + 1;
+					}
+				}
+				const auto& columns = scratch.columns[octave];
+
+				uint32_t y0;
+				float weightY;
+				latticePosition(y, frequencyY, height, y0, weightY);
+				const auto y1 = y0 + 1 == frequencyY ? 0 : y0 + 1;
+				auto& above = scratch.lattice[0];
+				auto& below = scratch.lattice[1];
+				above.resize(frequencyX);
+				below.resize(frequencyX);
+				for (uint32_t i = 0; i < frequencyX; ++i)
+				{
+					above[i] = latticeValue(i, y0, seed);
+					below[i] = latticeValue(i, y1, seed);
+				}
+
+				auto* t = scratch.t.data();
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					const auto& column = columns[x];
+					const auto top = above[column.x0] + (above[column.x1] - above[column.x0]) * column.weight;
+					const auto bottom = below[column.x0] + (below[column.x1] - below[column.x0]) * column.weight;
+					t[x] += amplitude * (top + (bottom - top) * weightY);
+				}
+				total += amplitude;
+				amplitude *= 0.5f;
+			}
+
+			const auto scale = 1.0f / total;
+			for (auto& t : scratch.t)
+			{
+				t *= scale;
+			}
+			blendRow(scratch.row, pattern.color0, pattern.color1, scratch.t);
+		}
+
+		// Blend factors of row y, projected on the direction and stretched so the texture's corners map to 0 and 1
+		void gradientRow(RowScratch& scratch, const TexturePattern& pattern, uint32_t y, uint32_t height)
+		{
+			const auto width = scratch.row.Width();
+			const auto dx = pattern.directionX;
+			const auto dy = pattern.directionY;
+			const auto lowest = std::min(dx, 0.0f) + std::min(dy, 0.0f);
+			const auto range = std::abs(dx) + std::abs(dy);
+			const auto scale = range > 0.0f ? 1.0f / range : 0.0f;
+			const auto v = (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+			const auto start = (v * dy - lowest) * scale;
+			const auto step = dx * scale / static_cast<float>(width);
+			auto* t = scratch.t.data();
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				t[x] = start + (static_cast<float>(x) + 0.5f) * step;
+			}
+			blendRow(scratch.row, pattern.color0, pattern.color1, scratch.t);
+		}
+
+		void generateRows(const TexturePattern& pattern, const TextureData& destination, uint32_t begin, uint32_t end)
+		{
+			const auto rowBytes = static_cast<size_t>(destination.width) * texelSize(destination.format);
+			RowScratch scratch;
+			scratch.row.Resize(destination.width);
+			scratch.t.resize(destination.width);
+
+			// A row made once and copied to every row that is the same
+			const auto packOnce = [&](uint32_t index)
+				{
+					scratch.packed[index].resize(rowBytes);
+					packRow(scratch.row, destination.format, scratch.packed[index].data());
+				};
+
+			switch (pattern.pattern)
+			{
+			case PATTERN::SOLID:
+				fillSolid(scratch.row, pattern.color0);
+				packOnce(0);
+				for (auto y = begin; y < end; ++y)
+				{
+					std::memcpy(destination.Row(y), scratch.packed[0].data(), rowBytes);
+				}
+				break;
+			case PATTERN::CHECKERBOARD:
+				for (uint32_t parity = 0; parity < 2; ++parity)
+				{
+					checkerRow(scratch.row, pattern, parity);
+					packOnce(parity);
+				}
+				for (auto y = begin; y < end; ++y)
+				{
+					const auto parity = cellOf(y, pattern.cellsY, destination.height) & 1;
+					std::memcpy(destination.Row(y), scratch.packed[parity].data(), rowBytes);
+				}
+				break;
+			case PATTERN::GRADIENT:
+				if (pattern.directionY == 0.0f)
+				{
+					gradientRow(scratch, pattern, 0, destination.height);
+					packOnce(0);
+					for (auto y = begin; y < end; ++y)
+					{
+						std::memcpy(destination.Row(y), scratch.packed[0].data(), rowBytes);
+					}
+					break;
+				}
+				for (auto y = begin; y < end; ++y)
+				{
+					gradientRow(scratch, pattern, y, destination.height);
+					packRow(scratch.row, destination.format, destination.Row(y));
+				}
+				break;
+			case PATTERN::NOISE:
+				for (auto y = begin; y < end; ++y)
+				{
+					noiseRow(scratch, pattern, y, destination.height);
+					packRow(scratch.row, destination.format, destination.Row(y));
+				}
+				break;
+			}
+		}
+	}
+
+	// Writes pattern into destination, straight into its rows so it can be an upload buffer's pitch aligned
+	// footprint. Rows are split between up to threads workers, 0 uses every hardware thread, and the output does not
+	// depend on how many there are. Only the texels of each row are written, the padding up to rowPitch is left alone.
+	export void generateTexture(const TexturePattern& pattern, const TextureData& destination, uint32_t threads = 0)
+	{
+		if (destination.width == 0 || destination.height == 0)
+			return;
+		if (!destination.data || destination.rowPitch < static_cast<size_t>(destination.width) * texelSize(destination.format))
+			throw std::runtime_error("Texture destination is smaller than its rows");
+		if (pattern.cellsX == 0 || pattern.cellsY == 0)
+			throw std::runtime_error("Texture pattern needs at least one cell each way");
+
+		// Octaves stop once the lattice has a cell per texel both ways, the ones after it would only add more of the
+		// same frequency
+		auto clamped = pattern;
+		clamped.octaves = 1;
+		while (clamped.octaves < pattern.octaves &&
+			((static_cast<uint64_t>(pattern.cellsX) << (clamped.octaves - 1)) < destination.width ||
+			(static_cast<uint64_t>(pattern.cellsY) << (clamped.octaves - 1)) < destination.height))
+		{
+			++clamped.octaves;
+		}
+
+		const auto minRows = std::max<size_t>(1, MIN_TEXELS_PER_WORKER / destination.width);
+		const auto workers = Parallel::workerCount(destination.height, minRows, threads);
+		Parallel::forChunks(destination.height, workers, [&](size_t begin, size_t end, uint32_t)
+			{
+				if (begin < end)
+				{
+					generateRows(clamped, destination, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+				}
+			});
+	}
+}
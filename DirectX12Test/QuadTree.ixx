@@ -1,123 +1,1343 @@
 module;
 #include <cstdint>
 #include <vector>
-#include <memory>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <optional>
+#include <functional>
+#include <limits>
+#include <span>
+#include <utility>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <stdexcept>
 export module QuadTree;
 
+export import Geometry;
+import BoxKernels;
+import Parallel;
+
 namespace Data
 {
-	export struct Point
+	// Stable identifier of an inserted element, valid until it is removed
+	export using Handle = uint32_t;
+	export inline constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+	// Spreads the low 16 bits of v over the even bits of the result
+	uint32_t spreadBits(uint32_t v)
+	{
+		v &= 0x0000FFFF;
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	// Stable LSD radix sort of 64 bit keys on their upper 32 bits, in three passes of 11 bits. Every pass
+	// histograms and scatters the keys in parallel, one chunk per worker.
+	void radixSortHigh32(std::vector<uint64_t>& keys, std::vector<uint64_t>& scratch, uint32_t workers)
 	{
-		float x, y;
+		constexpr uint32_t RADIX_BITS = 11;
+		constexpr uint32_t RADIX = 1u << RADIX_BITS;
+		constexpr uint64_t MASK = RADIX - 1;
+		const auto count = keys.size();
+		scratch.resize(count);
+		std::vector<std::array<size_t, RADIX>> offsets(workers);
+
+		for (uint32_t pass = 0; pass < 3; ++pass)
+		{
+			const auto shift = 32 + pass * RADIX_BITS;
+			Parallel::forChunks(count, workers, [&](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& histogram = offsets[chunk];
+					histogram.fill(0);
+					for (auto i = begin; i < end; ++i)
+					{
+						++histogram[(keys[i] >> shift) & MASK];
+					}
+				});
+
+			// Digit major, chunk minor offsets keep the sort stable across chunks
+			size_t offset = 0;
+			bool skip = false;
+			for (uint32_t digit = 0; digit < RADIX; ++digit)
+			{
+				const auto digitStart = offset;
+				for (auto& histogram : offsets)
+				{
+					const auto n = histogram[digit];
+					histogram[digit] = offset;
+					offset += n;
+				}
+				skip |= offset - digitStart == count;
+			}
+			// Every key shares this digit, so the pass would not reorder anything
+			if (skip)
+				continue;
+
+			Parallel::forChunks(count, workers, [&](size_t begin, size_t end, uint32_t chunk)
+				{
+					auto& next = offsets[chunk];
+					for (auto i = begin; i < end; ++i)
+					{
+						scratch[next[(keys[i] >> shift) & MASK]++] = keys[i];
+					}
+				});
+			keys.swap(scratch);
+		}
+	}
+
+	// Result of a pick along a ray: the element hit and its distance along the ray
+	export struct RayHit
+	{
+		Handle handle;
+		float distance;
 	};
 
-	export struct Box
+	// Per frame counters of how moved elements were handled, see QuadTree::ResetStats
+	export struct QuadTreeStats
 	{
-		Point minPoint;
-		Point maxPoint;
+		uint32_t moves = 0;// Calls to Move
+		uint32_t inPlace = 0;// Moves that stayed inside the strict bounds of their leaf
+		uint32_t relocations = 0;// Moves that had to leave their leaf
+		uint32_t avoidedRelocations = 0;// Moves that left the strict bounds but were kept by the loose bounds
+	};
+
+	constexpr uint32_t QUAD_TREE_MAX_DEPTH = 16;
+
+	// Node of the flat pool, shared with snapshots so its layout is part of the file format
+	struct QuadNode
+	{
+		Box region;
+		Box loose;// Bounds every element of the leaf lies within, equal to region for a strict tree
+		uint32_t parent;
+		uint32_t firstChild;// NONE for leaves, otherwise the first of four adjacent children
+		uint32_t firstBlock;// Head of the slot block chain (leaves only)
+		uint32_t lastBlock;// Tail of the slot block chain, where new elements are appended
+		uint32_t count;// Number of elements stored in this leaf
+		uint32_t depth;
+	};
 
-		bool InBounds(const Point& p)
+	// Read only access to the flat arrays of a quad tree. QuadTree and QuadTreeView both answer queries through it,
+	// so the same code runs whether the arrays live in vectors or in a mapped snapshot.
+	struct QuadTreeCore
+	{
+		static constexpr uint32_t NONE = UINT32_MAX;
+		// Each visited branch pops one node and pushes four, so the traversal stack is bounded by the depth
+		static constexpr uint32_t STACK_SIZE = QUAD_TREE_MAX_DEPTH * 3 + 1;
+		// Slots handed to the batch kernels per call, bounds the result buffer for any capacity
+		static constexpr uint32_t SCAN_BATCH = 64;
+
+		const QuadNode* nodes;
+		const float* slotX;
+		const float* slotY;
+		const uint32_t* slotItem;
+		const uint32_t* blockNext;
+		uint32_t capacity;
+		uint32_t size;
+
+		// Calls fn(handle) for every element whose position lies within the box
+		template <class Fn>
+		void Query(const Box& box, Fn&& fn) const
+		{
+			std::array<uint32_t, STACK_SIZE> stack;
+			uint32_t top = 0;
+			stack[top++] = 0;
+
+			while (top > 0)
+			{
+				const auto& node = nodes[stack[--top]];
+				if (!box.Intersects(node.loose))
+					continue;
+
+				if (node.firstChild != NONE)
+				{
+					for (uint32_t i = 0; i < 4; ++i)
+					{
+						stack[top++] = node.firstChild + i;
+					}
+					continue;
+				}
+
+				if (box.Contains(node.loose))
+				{
+					forEachSlot(node, [&](uint32_t s) { fn(static_cast<Handle>(slotItem[s])); });
+					continue;
+				}
+
+				// Leaf blocks are tested a batch at a time with the vector kernels
+				std::array<uint32_t, SCAN_BATCH> hits;
+				forEachBlock(node, [&](uint32_t first, uint32_t count)
+					{
+						for (uint32_t offset = 0; offset < count; offset += SCAN_BATCH)
+						{
+							const auto start = first + offset;
+							const auto n = pointsInBox(&slotX[start], &slotY[start], std::min(count - offset, SCAN_BATCH), box, hits.data());
+							for (uint32_t i = 0; i < n; ++i)
+							{
+								fn(static_cast<Handle>(slotItem[start + hits[i]]));
+							}
+						}
+					});
+			}
+		}
+
+		std::vector<Handle> Query(const Box& box) const
 		{
-			return p.x >= minPoint.x && p.y >= minPoint.y
-				&& p.x <= maxPoint.x && p.y <= maxPoint.y;
+			std::vector<Handle> result;
+			Query(box, [&result](Handle h) { result.emplace_back(h); });
+			return result;
+		}
+
+		// Returns up to k elements ordered from closest to farthest. Nodes are visited best first by their distance
+		// to p, and the search stops once the closest unvisited node is farther than the k-th candidate.
+		std::vector<Handle> Nearest(const Point& p, uint32_t k) const
+		{
+			std::vector<Handle> result;
+			if (k == 0 || size == 0)
+				return result;
+
+			using Entry = std::pair<float, uint32_t>;
+			// Nodes left to visit, closest on top
+			std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+			// The k best candidates so far, farthest on top so it can be evicted
+			std::priority_queue<Entry> best;
+
+			const auto bound = [&]()
+				{
+					return best.size() < k ? std::numeric_limits<float>::max() : best.top().first;
+				};
+
+			open.emplace(nodes[0].loose.DistanceSquared(p), 0u);
+			while (!open.empty())
+			{
+				const auto [dist, index] = open.top();
+				if (dist > bound())
+					break;
+				open.pop();
+
+				const auto& node = nodes[index];
+				if (node.firstChild != NONE)
+				{
+					for (uint32_t i = 0; i < 4; ++i)
+					{
+						const auto childDist = nodes[node.firstChild + i].loose.DistanceSquared(p);
+						if (childDist <= bound())
+						{
+							open.emplace(childDist, node.firstChild + i);
+						}
+					}
+					continue;
+				}
+
+				forEachSlot(node, [&](uint32_t s)
+					{
+						const auto dx = slotX[s] - p.x;
+						const auto dy = slotY[s] - p.y;
+						const auto d = dx * dx + dy * dy;
+						if (best.size() < k)
+						{
+							best.emplace(d, slotItem[s]);
+						}
+						else if (d < best.top().first)
+						{
+							best.pop();
+							best.emplace(d, slotItem[s]);
+						}
+					});
+			}
+
+			result.resize(best.size());
+			for (auto i = result.size(); i > 0; --i)
+			{
+				result[i - 1] = best.top().second;
+				best.pop();
+			}
+			return result;
+		}
+
+		std::optional<RayHit> Raycast(const Point& origin, const Point& dir, float maxDist, float pickRadius) const
+		{
+			const auto length = std::sqrt(dir.x * dir.x + dir.y * dir.y);
+			if (length == 0.0f || size == 0)
+				return std::nullopt;
+
+			const auto d = Point{ .x = dir.x / length, .y = dir.y / length };
+			const auto radiusSq = pickRadius * pickRadius;
+			auto bestT = maxDist;
+			auto hit = NONE;
+
+			using Entry = std::pair<float, uint32_t>;
+			std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+			float t = 0.0f;
+			if (nodes[0].loose.Expanded(pickRadius).Raycast(origin, d, maxDist, t))
+			{
+				open.emplace(t, 0u);
+			}
+
+			while (!open.empty())
+			{
+				const auto [entry, index] = open.top();
+				if (entry > bestT)
+					break;
+				open.pop();
+
+				const auto& node = nodes[index];
+				if (node.firstChild != NONE)
+				{
+					for (uint32_t i = 0; i < 4; ++i)
+					{
+						if (nodes[node.firstChild + i].loose.Expanded(pickRadius).Raycast(origin, d, bestT, t))
+						{
+							open.emplace(t, node.firstChild + i);
+						}
+					}
+					continue;
+				}
+
+				forEachSlot(node, [&](uint32_t s)
+					{
+						const auto vx = slotX[s] - origin.x;
+						const auto vy = slotY[s] - origin.y;
+						const auto along = vx * d.x + vy * d.y;
+						if (along < 0.0f || along > bestT)
+							return;
+						if (vx * vx + vy * vy - along * along <= radiusSq)
+						{
+							bestT = along;
+							hit = slotItem[s];
+						}
+					});
+			}
+
+			if (hit == NONE)
+				return std::nullopt;
+			return RayHit{ .handle = hit, .distance = bestT };
+		}
+
+		// Calls fn(first, count) for each run of occupied slots in the leaf's block chain
+		template <class Fn>
+		void forEachBlock(const QuadNode& node, Fn&& fn) const
+		{
+			uint32_t remaining = node.count;
+			for (auto block = node.firstBlock; remaining > 0; block = blockNext[block])
+			{
+				const auto count = std::min(remaining, capacity);
+				fn(block * capacity, count);
+				remaining -= count;
+			}
+		}
+
+		// Calls fn(slot) for every occupied slot of a leaf
+		template <class Fn>
+		void forEachSlot(const QuadNode& node, Fn&& fn) const
+		{
+			forEachBlock(node, [&fn](uint32_t first, uint32_t count)
+				{
+					for (auto s = first; s < first + count; ++s)
+					{
+						fn(s);
+					}
+				});
 		}
 	};
 
-	export template <typename T>
-		struct Node
+	// Serialized quad tree (see QuadTree::Serialize). The header is followed by the tree's arrays, each at the offset
+	// the header records and aligned to SNAPSHOT_ALIGNMENT from the start, so a snapshot loaded or mapped at an
+	// aligned address is used in place. Links between nodes, blocks and items are indices, never pointers.
+	// Snapshots are only read on machines with the byte order they were written with.
+	constexpr uint32_t SNAPSHOT_MAGIC = 0x5451534C;// "LSQT"
+	constexpr uint32_t SNAPSHOT_VERSION = 1;
+	constexpr uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+	constexpr uint64_t SNAPSHOT_ALIGNMENT = 16;
+
+	static_assert(std::numeric_limits<float>::is_iec559);
+	static_assert(std::is_trivially_copyable_v<QuadNode> && sizeof(QuadNode) == 56);
+
+	struct SnapshotHeader
 	{
-		std::shared_ptr<T> data;
+		uint32_t magic;
+		uint32_t byteOrder;// SNAPSHOT_BYTE_ORDER in the writer's byte order
+		uint32_t version;
+		uint32_t headerSize;
+		uint32_t payloadSize;// sizeof(T)
+		uint32_t capacity;
+		float looseness;
+		uint32_t size;
 		Box region;
-		Point position;
+		uint32_t nodeCount;
+		uint32_t itemCount;
+		uint32_t blockCount;
+		uint32_t freeNodes;
+		uint32_t freeItems;
+		uint32_t freeBlocks;
+		// Section offsets from the start of the snapshot
+		uint64_t nodes;
+		uint64_t itemData;
+		uint64_t itemPosition;
+		uint64_t itemNode;
+		uint64_t itemSlot;
+		uint64_t slotX;
+		uint64_t slotY;
+		uint64_t slotItem;
+		uint64_t blockNext;
+		uint64_t totalSize;
 	};
 
+	uint64_t alignSnapshot(uint64_t offset)
+	{
+		return (offset + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+	}
+
+	// Fills in the section offsets for the counts already set in the header
+	void layoutSnapshot(SnapshotHeader& header)
+	{
+		const uint64_t slots = static_cast<uint64_t>(header.blockCount) * header.capacity;
+		auto offset = alignSnapshot(sizeof(SnapshotHeader));
+		const auto place = [&offset](uint64_t bytes)
+			{
+				const auto at = offset;
+				offset = alignSnapshot(offset + bytes);
+				return at;
+			};
+		header.nodes = place(header.nodeCount * sizeof(QuadNode));
+		header.itemData = place(header.itemCount * static_cast<uint64_t>(header.payloadSize));
+		header.itemPosition = place(header.itemCount * sizeof(Point));
+		header.itemNode = place(header.itemCount * sizeof(uint32_t));
+		header.itemSlot = place(header.itemCount * sizeof(uint32_t));
+		header.slotX = place(slots * sizeof(float));
+		header.slotY = place(slots * sizeof(float));
+		header.slotItem = place(slots * sizeof(uint32_t));
+		header.blockNext = place(header.blockCount * sizeof(uint32_t));
+		header.totalSize = offset;
+	}
+
+	template <class U>
+	const U* snapshotSection(std::span<const std::byte> bytes, uint64_t offset)
+	{
+		return reinterpret_cast<const U*>(bytes.data() + offset);
+	}
+
+	// Checks every index stored in the sections of a snapshot whose header and layout are valid, so a corrupt or
+	// hostile file cannot make queries, Load or later edits of the loaded tree read or write outside the arrays.
+	// The nodes reachable from the root have to form a tree of four child groups no deeper than
+	// QUAD_TREE_MAX_DEPTH; every leaf's block chain has to hold exactly its count of slots in blocks no other leaf
+	// uses, with each occupied slot and its item pointing at each other; and the free lists of node groups, items
+	// and blocks have to cover exactly what the tree does not use. Linear in the size of the snapshot.
+	bool validSnapshotLinks(std::span<const std::byte> bytes, const SnapshotHeader& header)
+	{
+		constexpr uint32_t NONE = QuadTreeCore::NONE;
+		const auto capacity = header.capacity;
+		const auto nodeCount = header.nodeCount;
+		const auto itemCount = header.itemCount;
+		const auto blockCount = header.blockCount;
+		// Slots are addressed by 32 bit indices and the loose bounds are scaled by the looseness
+		if ((nodeCount - 1) % 4 != 0 || static_cast<uint64_t>(blockCount) * capacity >= NONE
+			|| !std::isfinite(header.looseness) || header.looseness < 1.0f
+			|| !(header.region.minPoint.x <= header.region.maxPoint.x) || !(header.region.minPoint.y <= header.region.maxPoint.y))
+			return false;
+
+		const auto* nodes = snapshotSection<QuadNode>(bytes, header.nodes);
+		const auto* itemPosition = snapshotSection<Point>(bytes, header.itemPosition);
+		const auto* itemNode = snapshotSection<uint32_t>(bytes, header.itemNode);
+		const auto* itemSlot = snapshotSection<uint32_t>(bytes, header.itemSlot);
+		const auto* slotX = snapshotSection<float>(bytes, header.slotX);
+		const auto* slotY = snapshotSection<float>(bytes, header.slotY);
+		const auto* slotItem = snapshotSection<uint32_t>(bytes, header.slotItem);
+		const auto* blockNext = snapshotSection<uint32_t>(bytes, header.blockNext);
+
+		// Relocating a moved element climbs to the first ancestor whose region holds it, the root has to hold all
+		if (nodes[0].parent != NONE || nodes[0].depth != 0 || std::memcmp(&nodes[0].region, &header.region, sizeof(Box)) != 0)
+			return false;
+
+		std::vector<uint8_t> nodeSeen(nodeCount);
+		std::vector<uint8_t> itemSeen(itemCount);
+		std::vector<uint8_t> blockSeen(blockCount);
+		uint32_t seenNodes = 1;
+		uint32_t seenBlocks = 0;
+		uint32_t liveItems = 0;
+		const auto validGroup = [&](uint32_t first)
+			{
+				return first != 0 && first < nodeCount && (first - 1) % 4 == 0 && !nodeSeen[first];
+			};
+
+		std::vector<uint32_t> stack{ 0u };
+		nodeSeen[0] = 1;
+		while (!stack.empty())
+		{
+			const auto index = stack.back();
+			stack.pop_back();
+			const auto& node = nodes[index];
+			if (node.firstChild != NONE)
+			{
+				if (node.count != 0 || node.depth >= QUAD_TREE_MAX_DEPTH || !validGroup(node.firstChild))
+					return false;
+
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					const auto child = node.firstChild + i;
+					if (nodes[child].parent != index || nodes[child].depth != node.depth + 1)
+						return false;
+					nodeSeen[child] = 1;
+					stack.push_back(child);
+				}
+				seenNodes += 4;
+				continue;
+			}
+
+			if (node.count == 0)
+			{
+				if (node.firstBlock != NONE || node.lastBlock != NONE)
+					return false;
+				continue;
+			}
+
+			auto remaining = node.count;
+			auto block = node.firstBlock;
+			auto last = NONE;
+			while (remaining > 0)
+			{
+				if (block >= blockCount || blockSeen[block])
+					return false;
+				blockSeen[block] = 1;
+				++seenBlocks;
+
+				const auto first = block * capacity;
+				const auto count = std::min(remaining, capacity);
+				for (auto slot = first; slot < first + count; ++slot)
+				{
+					const auto item = slotItem[slot];
+					if (item >= itemCount || itemSeen[item] || itemSlot[item] != slot || itemNode[item] != index
+						|| std::memcmp(&itemPosition[item].x, &slotX[slot], sizeof(float)) != 0
+						|| std::memcmp(&itemPosition[item].y, &slotY[slot], sizeof(float)) != 0)
+						return false;
+					itemSeen[item] = 1;
+					++liveItems;
+				}
+				remaining -= count;
+				last = block;
+				block = blockNext[block];
+			}
+			if (block != NONE || last != node.lastBlock)
+				return false;
+		}
+
+		// Free lists are walked with the same marks, which also rules out cycles
+		for (auto first = header.freeNodes; first != NONE; first = nodes[first].firstChild)
+		{
+			if (!validGroup(first))
+				return false;
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				nodeSeen[first + i] = 1;
+			}
+			seenNodes += 4;
+		}
+		uint32_t freeItems = 0;
+		for (auto item = header.freeItems; item != NONE; item = itemNode[item])
+		{
+			if (item >= itemCount || itemSeen[item] || itemSlot[item] != NONE)
+				return false;
+			itemSeen[item] = 1;
+			++freeItems;
+		}
+		for (auto block = header.freeBlocks; block != NONE; block = blockNext[block])
+		{
+			if (block >= blockCount || blockSeen[block])
+				return false;
+			blockSeen[block] = 1;
+			++seenBlocks;
+		}
+
+		return seenNodes == nodeCount && seenBlocks == blockCount && liveItems == header.size && liveItems + freeItems == itemCount;
+	}
+
+	// Returns the header when bytes hold a complete, consistent snapshot of payloadSize elements that can be used in
+	// place
+	const SnapshotHeader* readSnapshotHeader(std::span<const std::byte> bytes, uint32_t payloadSize)
+	{
+		if (bytes.size() < sizeof(SnapshotHeader) || reinterpret_cast<uintptr_t>(bytes.data()) % SNAPSHOT_ALIGNMENT != 0)
+			return nullptr;
+
+		const auto* header = reinterpret_cast<const SnapshotHeader*>(bytes.data());
+		if (header->magic != SNAPSHOT_MAGIC || header->byteOrder != SNAPSHOT_BYTE_ORDER || header->version != SNAPSHOT_VERSION
+			|| header->headerSize != sizeof(SnapshotHeader) || header->payloadSize != payloadSize
+			|| header->capacity == 0 || header->nodeCount == 0 || header->size > header->itemCount)
+			return nullptr;
+
+		// The offsets must be the ones this version lays out, which also keeps every section inside the snapshot
+		auto expected = *header;
+		layoutSnapshot(expected);
+		if (std::memcmp(&expected, header, sizeof(SnapshotHeader)) != 0 || header->totalSize > bytes.size()
+			|| !validSnapshotLinks(bytes, *header))
+			return nullptr;
+		return header;
+	}
+
+	// Quad tree stored as a flat pool of nodes linked by index. Children of a node are allocated as a group
+	// of four adjacent nodes, and each leaf owns a chain of fixed size slot blocks (capacity wide) that hold its
+	// elements' positions contiguously, so queries walk plain arrays instead of chasing pointers.
+	// With a looseness above 1 it becomes a loose quad tree: every node also owns loose bounds, its region scaled
+	// by looseness around its center, and an element may drift anywhere inside its leaf's loose bounds before it
+	// has to be relocated. Elements are still routed by the strict regions; queries prune by the loose bounds.
 	export
 	template <class T>
 		struct QuadTree
 	{
 	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint32_t MAX_DEPTH = QUAD_TREE_MAX_DEPTH;
+
+		using Node = QuadNode;
+
+		struct Item
+		{
+			T data;
+			Point position;
+			uint32_t node;// Leaf holding the element, or the next free item when released
+			uint32_t slot;// Absolute index into the slot arrays, NONE when released
+		};
+
 		Box region;
 		uint32_t capacity;
-		std::vector<std::shared_ptr<Node<T>>> nodes;
-
-		std::unique_ptr<QuadTree<T>> topLeft;
-		std::unique_ptr<QuadTree<T>> topRight;
-		std::unique_ptr<QuadTree<T>> bottomLeft;
-		std::unique_ptr<QuadTree<T>> bottomRight;
+		float looseness;
+		QuadTreeStats stats;
+		std::vector<Node> nodes;
+		std::vector<Item> items;
+		// Slot pool, laid out as blocks of capacity entries (structure of arrays)
+		std::vector<float> slotX;
+		std::vector<float> slotY;
+		std::vector<uint32_t> slotItem;
+		std::vector<uint32_t> blockNext;
+		uint32_t freeNodes = NONE;
+		uint32_t freeItems = NONE;
+		uint32_t freeBlocks = NONE;
+		uint32_t size = 0;
 
 	public:
-		QuadTree(Box r, uint32_t cap) : region(r),
-			capacity(cap),
-			nodes(),
-			topLeft(nullptr),
-			topRight(nullptr),
-			bottomLeft(nullptr),
-			bottomRight(nullptr)
+		QuadTree(Box r, uint32_t cap, float loose = 1.0f) : region(r),
+			capacity(std::max(cap, 1u)),
+			looseness(std::max(loose, 1.0f))
+		{
+			Clear();
+		}
+
+		Handle Insert(const T& data, const Point& p)
 		{
+			if (!region.InBounds(p))
+				return INVALID_HANDLE;
+
+			uint32_t handle = freeItems;
+			if (handle != NONE)
+			{
+				freeItems = items[handle].node;
+				items[handle] = Item{ .data = data, .position = p, .node = NONE, .slot = NONE };
+			}
+			else
+			{
+				handle = static_cast<uint32_t>(items.size());
+				items.emplace_back(Item{ .data = data, .position = p, .node = NONE, .slot = NONE });
+			}
+
+			insertFrom(0, handle);
+			++size;
+			return handle;
 		}
 
-		void subdivide()
+		bool Remove(Handle h)
 		{
-			const auto& minPoint = region.minPoint;
-			const auto& maxPoint = region.maxPoint;
-			const auto dist = Point{ .x = abs(maxPoint.x) - abs(minPoint.x), .y = abs(maxPoint.y) - abs(minPoint.y) };
-			const auto halfPoint = Point{ .x = minPoint.x + dist.x * 0.5f, .y = minPoint.y + dist.y * 0.5f};
+			if (!Contains(h))
+				return false;
 
-			// min = {min, hp}, max = {hp, max}
-			topLeft = std::make_unique<QuadTree<T>>(Data::Box{ .minPoint = {minPoint.x, halfPoint.y},
-				.maxPoint = {halfPoint.y, maxPoint.y} }, capacity);
-			// min = hp, hp, max = max, max
-			topRight = std::make_unique<QuadTree<T>>(Data::Box{ .minPoint = {halfPoint.x, halfPoint.y},
-				.maxPoint = {maxPoint.x, maxPoint.x} }, capacity);
-			// min = min, min, max = hp, hp
-			bottomLeft = std::make_unique<QuadTree<T>>(Data::Box{ .minPoint = {minPoint.x, minPoint.y},
-				.maxPoint = {halfPoint.y, halfPoint.y} }, capacity);
-			// min = hp, min, max = max, hp
-			bottomRight = std::make_unique<QuadTree<T>>(Data::Box{ .minPoint = {minPoint.x, halfPoint.y},
-				.maxPoint = {maxPoint.y, halfPoint.y} }, capacity);
+			const auto leaf = items[h].node;
+			removeFromLeaf(leaf, items[h].slot);
+			items[h].slot = NONE;
+			items[h].node = freeItems;
+			freeItems = h;
+			--size;
+			merge(nodes[leaf].parent);
+			return true;
 		}
 
-		void Insert(std::shared_ptr<Node<T>>& data, const Point& p)
+		// Replaces the contents of the tree with the given points in one pass. The points are keyed by their Morton
+		// code on the MAX_DEPTH grid of the region, radix sorted in parallel, and the sorted run is then cut into
+		// quadrants by the code digits so every leaf receives a contiguous range of it. Handles are handed out in
+		// Morton order, so elements that are close in space are also close in memory; when handles is not empty it
+		// receives the handle of each point (INVALID_HANDLE for points outside the region, which are skipped).
+		// Returns the number of elements inserted. Throws, leaving the tree as it was, when handles is not empty but
+		// shorter than the points that are built.
+		uint32_t Build(std::span<const Point> points, std::span<const T> data, std::span<Handle> handles = {}, uint32_t workers = 0)
 		{
-			if (!data)
-				return;
+			const auto count = std::min(points.size(), data.size());
+			if (!handles.empty() && handles.size() < count)
+				throw std::runtime_error("QuadTree::Build needs a handle for every point");
 
-			if (!region.InBounds(p))
-				return;
+			Clear();
+			if (!handles.empty())
+			{
+				std::fill(handles.begin(), handles.end(), INVALID_HANDLE);
+			}
+			if (count == 0)
+				return 0;
+
+			// Threads do not pay for themselves on small inputs
+			workers = Parallel::workerCount(count, 16384, workers);
+
+			constexpr auto cells = static_cast<float>(1u << MAX_DEPTH);
+			const auto scaleX = cells / (region.maxPoint.x - region.minPoint.x);
+			const auto scaleY = cells / (region.maxPoint.y - region.minPoint.y);
+			const auto maxCell = static_cast<float>((1u << MAX_DEPTH) - 1);
+
+			// Key = Morton code in the upper half, point index in the lower half. Out of region points are marked
+			// and dropped before sorting.
+			std::vector<uint64_t> keys(count);
+			Parallel::forChunks(count, workers, [&](size_t begin, size_t end, uint32_t)
+				{
+					for (auto i = begin; i < end; ++i)
+					{
+						const auto& p = points[i];
+						if (!region.InBounds(p))
+						{
+							keys[i] = UINT64_MAX;
+							continue;
+						}
+						const auto cx = static_cast<uint32_t>(std::clamp((p.x - region.minPoint.x) * scaleX, 0.0f, maxCell));
+						const auto cy = static_cast<uint32_t>(std::clamp((p.y - region.minPoint.y) * scaleY, 0.0f, maxCell));
+						const auto code = spreadBits(cx) | (spreadBits(cy) << 1);
+						keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+					}
+				});
+
+			std::erase(keys, UINT64_MAX);
+			std::vector<uint64_t> scratch;
+			radixSortHigh32(keys, scratch, workers);
+
+			const auto inserted = static_cast<uint32_t>(keys.size());
+			items.resize(inserted, Item{ .data = data[0], .position = {}, .node = NONE, .slot = NONE });
+			Parallel::forChunks(inserted, workers, [&](size_t begin, size_t end, uint32_t)
+				{
+					for (auto i = begin; i < end; ++i)
+					{
+						const auto source = static_cast<uint32_t>(keys[i]);
+						items[i].data = data[source];
+						items[i].position = points[source];
+						if (!handles.empty())
+						{
+							handles[source] = static_cast<Handle>(i);
+						}
+					}
+				});
+
+			// Leaves end up between half and completely full, reserve for the worst case up front
+			const auto blocks = 2 * (inserted / capacity + 1);
+			nodes.reserve(2 * blocks);
+			blockNext.reserve(blocks);
+			slotX.reserve(blocks * capacity);
+			slotY.reserve(blocks * capacity);
+			slotItem.reserve(blocks * capacity);
+
+			// Cut the sorted run into quadrants. Float rounding can leave a point that sits on a split line on the
+			// other side of the line than its code says; those are put through the regular insert afterwards.
+			struct Range
+			{
+				uint32_t node;
+				uint32_t begin;
+				uint32_t end;
+			};
+			std::vector<Range> stack;
+			std::vector<uint32_t> stray;
+			stack.emplace_back(Range{ .node = 0, .begin = 0, .end = inserted });
+			while (!stack.empty())
+			{
+				const auto range = stack.back();
+				stack.pop_back();
+
+				const auto depth = nodes[range.node].depth;
+				if (range.end - range.begin <= capacity || depth == MAX_DEPTH)
+				{
+					for (auto i = range.begin; i < range.end; ++i)
+					{
+						if (nodes[range.node].region.InBounds(items[i].position))
+						{
+							appendToLeaf(range.node, i, items[i].position);
+						}
+						else
+						{
+							stray.emplace_back(i);
+						}
+					}
+					continue;
+				}
 
-			if (nodes.size() >= capacity)
+				const auto first = makeChildren(range.node);
+				nodes[range.node].firstChild = first;
+				const auto shift = 32 + 2 * (MAX_DEPTH - 1 - depth);
+				auto begin = range.begin;
+				for (uint64_t quad = 0; quad < 4; ++quad)
+				{
+					const auto end = static_cast<uint32_t>(std::partition_point(keys.begin() + begin, keys.begin() + range.end,
+						[shift, quad](uint64_t key) { return ((key >> shift) & 3) <= quad; }) - keys.begin());
+					stack.emplace_back(Range{ .node = first + static_cast<uint32_t>(quad), .begin = begin, .end = end });
+					begin = end;
+				}
+			}
+
+			size = inserted;
+			for (auto item : stray)
 			{
-				// subdivide and resize
-				subdivide();
-				balance();
-				return;
+				insertFrom(0, item);
 			}
-			nodes.emplace_back(data);
+			return inserted;
 		}
 
-		void balance()
+		// Updates the position of an element. Elements that stay inside the loose bounds of their leaf are updated in
+		// place, the rest are relocated starting from the closest ancestor that still contains the new position.
+		bool Move(Handle h, const Point& p)
 		{
-			for (auto n : nodes)
+			if (!Contains(h) || !region.InBounds(p))
+				return false;
+
+			++stats.moves;
+			auto& item = items[h];
+			item.position = p;
+			const auto leaf = item.node;
+			if (nodes[leaf].loose.InBounds(p))
 			{
-				if (topLeft && topLeft->region.InBounds(n->position))
+				if (nodes[leaf].region.InBounds(p))
 				{
-					topLeft->Insert(n, n->position);
+					++stats.inPlace;
 				}
-				if (topRight && topRight->region.InBounds(n->position))
+				else
 				{
-					topRight->Insert(n, n->position);
+					++stats.avoidedRelocations;
 				}
-				if (bottomLeft && bottomLeft->region.InBounds(n->position))
+				slotX[item.slot] = p.x;
+				slotY[item.slot] = p.y;
+				return true;
+			}
+
+			++stats.relocations;
+
+			removeFromLeaf(leaf, item.slot);
+			auto ancestor = nodes[leaf].parent;
+			while (!nodes[ancestor].region.InBounds(p))
+			{
+				ancestor = nodes[ancestor].parent;
+			}
+			insertFrom(ancestor, h);
+			merge(nodes[leaf].parent);
+			return true;
+		}
+
+		// Calls fn(handle) for every element whose position lies within the box
+		template <class Fn>
+		void Query(const Box& box, Fn&& fn) const
+		{
+			core().Query(box, std::forward<Fn>(fn));
+		}
+
+		std::vector<Handle> Query(const Box& box) const
+		{
+			return core().Query(box);
+		}
+
+		// Returns up to k elements ordered from closest to farthest
+		std::vector<Handle> Nearest(const Point& p, uint32_t k) const
+		{
+			return core().Nearest(p, k);
+		}
+
+		// Picks the first element along the segment origin + t * dir, t in [0, maxDist]. Elements are points, so
+		// anything within pickRadius of the segment counts as a hit; the reported distance is measured along the ray.
+		std::optional<RayHit> Raycast(const Point& origin, const Point& dir, float maxDist, float pickRadius = 1.0f) const
+		{
+			return core().Raycast(origin, dir, maxDist, pickRadius);
+		}
+
+		bool Contains(Handle h) const
+		{
+			return h < items.size() && items[h].slot != NONE;
+		}
+
+		T& Get(Handle h)
+		{
+			return items[h].data;
+		}
+
+		const T& Get(Handle h) const
+		{
+			return items[h].data;
+		}
+
+		Point Position(Handle h) const
+		{
+			return items[h].position;
+		}
+
+		uint32_t Size() const
+		{
+			return size;
+		}
+
+		const Box& Region() const
+		{
+			return region;
+		}
+
+		float Looseness() const
+		{
+			return looseness;
+		}
+
+		const QuadTreeStats& Stats() const
+		{
+			return stats;
+		}
+
+		// Returns the counters gathered since the previous call and starts a new period, call once per frame
+		QuadTreeStats ResetStats()
+		{
+			return std::exchange(stats, QuadTreeStats{});
+		}
+
+		// Writes the tree into a flat snapshot that QuadTreeView can query in place or Load can turn back into a tree
+		std::vector<std::byte> Serialize() const requires std::is_trivially_copyable_v<T>
+		{
+			SnapshotHeader header{};
+			header.magic = SNAPSHOT_MAGIC;
+			header.byteOrder = SNAPSHOT_BYTE_ORDER;
+			header.version = SNAPSHOT_VERSION;
+			header.headerSize = sizeof(SnapshotHeader);
+			header.payloadSize = sizeof(T);
+			header.capacity = capacity;
+			header.looseness = looseness;
+			header.size = size;
+			header.region = region;
+			header.nodeCount = static_cast<uint32_t>(nodes.size());
+			header.itemCount = static_cast<uint32_t>(items.size());
+			header.blockCount = static_cast<uint32_t>(blockNext.size());
+			header.freeNodes = freeNodes;
+			header.freeItems = freeItems;
+			header.freeBlocks = freeBlocks;
+			layoutSnapshot(header);
+
+			std::vector<std::byte> bytes(header.totalSize);
+			auto* base = bytes.data();
+			std::memcpy(base, &header, sizeof(header));
+			std::memcpy(base + header.nodes, nodes.data(), nodes.size() * sizeof(Node));
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				std::memcpy(base + header.itemData + i * sizeof(T), &items[i].data, sizeof(T));
+				std::memcpy(base + header.itemPosition + i * sizeof(Point), &items[i].position, sizeof(Point));
+				std::memcpy(base + header.itemNode + i * sizeof(uint32_t), &items[i].node, sizeof(uint32_t));
+				std::memcpy(base + header.itemSlot + i * sizeof(uint32_t), &items[i].slot, sizeof(uint32_t));
+			}
+			std::memcpy(base + header.slotX, slotX.data(), slotX.size() * sizeof(float));
+			std::memcpy(base + header.slotY, slotY.data(), slotY.size() * sizeof(float));
+			std::memcpy(base + header.slotItem, slotItem.data(), slotItem.size() * sizeof(uint32_t));
+			std::memcpy(base + header.blockNext, blockNext.data(), blockNext.size() * sizeof(uint32_t));
+			return bytes;
+		}
+
+		// Rebuilds a modifiable tree from a snapshot, nullopt when it is not a valid snapshot of this payload type
+		static std::optional<QuadTree> Load(std::span<const std::byte> snapshot) requires std::is_trivially_copyable_v<T>
+		{
+			const auto* header = readSnapshotHeader(snapshot, sizeof(T));
+			if (!header)
+				return std::nullopt;
+
+			QuadTree tree(header->region, header->capacity, header->looseness);
+			const auto slots = static_cast<size_t>(header->blockCount) * header->capacity;
+			const auto* nodeData = snapshotSection<Node>(snapshot, header->nodes);
+			tree.nodes.assign(nodeData, nodeData + header->nodeCount);
+			tree.items.resize(header->itemCount);
+			for (size_t i = 0; i < header->itemCount; ++i)
+			{
+				auto& item = tree.items[i];
+				std::memcpy(&item.data, snapshot.data() + header->itemData + i * sizeof(T), sizeof(T));
+				item.position = snapshotSection<Point>(snapshot, header->itemPosition)[i];
+				item.node = snapshotSection<uint32_t>(snapshot, header->itemNode)[i];
+				item.slot = snapshotSection<uint32_t>(snapshot, header->itemSlot)[i];
+			}
+			const auto* x = snapshotSection<float>(snapshot, header->slotX);
+			const auto* y = snapshotSection<float>(snapshot, header->slotY);
+			const auto* slotItems = snapshotSection<uint32_t>(snapshot, header->slotItem);
+			const auto* next = snapshotSection<uint32_t>(snapshot, header->blockNext);
+			tree.slotX.assign(x, x + slots);
+			tree.slotY.assign(y, y + slots);
+			tree.slotItem.assign(slotItems, slotItems + slots);
+			tree.blockNext.assign(next, next + header->blockCount);
+			tree.freeNodes = header->freeNodes;
+			tree.freeItems = header->freeItems;
+			tree.freeBlocks = header->freeBlocks;
+			tree.size = header->size;
+			return tree;
+		}
+
+		void Clear()
+		{
+			nodes.clear();
+			items.clear();
+			slotX.clear();
+			slotY.clear();
+			slotItem.clear();
+			blockNext.clear();
+			freeNodes = NONE;
+			freeItems = NONE;
+			freeBlocks = NONE;
+			size = 0;
+			nodes.emplace_back(Node{ .region = region, .loose = region, .parent = NONE, .firstChild = NONE,
+				.firstBlock = NONE, .lastBlock = NONE, .count = 0, .depth = 0 });
+		}
+
+	private:
+		QuadTreeCore core() const
+		{
+			return QuadTreeCore{ .nodes = nodes.data(), .slotX = slotX.data(), .slotY = slotY.data(), .slotItem = slotItem.data(),
+				.blockNext = blockNext.data(), .capacity = capacity, .size = size };
+		}
+
+		Box looseBounds(const Box& r) const
+		{
+			const auto c = r.Center();
+			const auto hx = (r.maxPoint.x - r.minPoint.x) * 0.5f * looseness;
+			const auto hy = (r.maxPoint.y - r.minPoint.y) * 0.5f * looseness;
+			return Box{ .minPoint = { c.x - hx, c.y - hy }, .maxPoint = { c.x + hx, c.y + hy } };
+		}
+
+		uint32_t quadrant(const Node& node, const Point& p) const
+		{
+			// 0 = top left, 1 = top right, 2 = bottom left, 3 = bottom right (screen space, y down)
+			const auto center = node.region.Center();
+			return (p.x >= center.x ? 1u : 0u) | (p.y >= center.y ? 2u : 0u);
+		}
+
+		uint32_t findLeaf(uint32_t index, const Point& p) const
+		{
+			while (nodes[index].firstChild != NONE)
+			{
+				index = nodes[index].firstChild + quadrant(nodes[index], p);
+			}
+			return index;
+		}
+
+		void insertFrom(uint32_t index, uint32_t item)
+		{
+			const auto p = items[item].position;
+			auto leaf = findLeaf(index, p);
+			while (nodes[leaf].count >= capacity && nodes[leaf].depth < MAX_DEPTH)
+			{
+				subdivide(leaf);
+				leaf = findLeaf(leaf, p);
+			}
+			appendToLeaf(leaf, item, p);
+		}
+
+		uint32_t allocBlock()
+		{
+			if (freeBlocks != NONE)
+			{
+				const auto block = freeBlocks;
+				freeBlocks = blockNext[block];
+				blockNext[block] = NONE;
+				return block;
+			}
+
+			const auto block = static_cast<uint32_t>(blockNext.size());
+			blockNext.emplace_back(NONE);
+			slotX.resize(slotX.size() + capacity);
+			slotY.resize(slotY.size() + capacity);
+			slotItem.resize(slotItem.size() + capacity);
+			return block;
+		}
+
+		void releaseBlock(uint32_t block)
+		{
+			blockNext[block] = freeBlocks;
+			freeBlocks = block;
+		}
+
+		void appendToLeaf(uint32_t leaf, uint32_t item, const Point& p)
+		{
+			const auto n = nodes[leaf].count;
+			if (n % capacity == 0)
+			{
+				const auto block = allocBlock();
+				if (n == 0)
 				{
-					bottomLeft->Insert(n, n->position);
+					nodes[leaf].firstBlock = block;
 				}
-				if (bottomRight && bottomRight->region.InBounds(n->position))
+				else
 				{
-					bottomRight->Insert(n, n->position);
+					blockNext[nodes[leaf].lastBlock] = block;
 				}
+				nodes[leaf].lastBlock = block;
+			}
+
+			const auto s = nodes[leaf].lastBlock * capacity + n % capacity;
+			slotX[s] = p.x;
+			slotY[s] = p.y;
+			slotItem[s] = item;
+			items[item].node = leaf;
+			items[item].slot = s;
+			++nodes[leaf].count;
+		}
+
+		// Swap-removes a slot with the leaf's last element and releases the trailing block once it empties
+		void removeFromLeaf(uint32_t leaf, uint32_t s)
+		{
+			auto& node = nodes[leaf];
+			const auto lastIndex = node.count - 1;
+			const auto last = node.lastBlock * capacity + lastIndex % capacity;
+			if (last != s)
+			{
+				slotX[s] = slotX[last];
+				slotY[s] = slotY[last];
+				slotItem[s] = slotItem[last];
+				items[slotItem[s]].slot = s;
+			}
+			--node.count;
+
+			if (lastIndex % capacity == 0)
+			{
+				const auto block = last / capacity;
+				if (node.count == 0)
+				{
+					node.firstBlock = NONE;
+					node.lastBlock = NONE;
+				}
+				else
+				{
+					auto prev = node.firstBlock;
+					while (blockNext[prev] != block)
+					{
+						prev = blockNext[prev];
+					}
+					blockNext[prev] = NONE;
+					node.lastBlock = prev;
+				}
+				releaseBlock(block);
+			}
+		}
+
+		uint32_t allocChildren()
+		{
+			if (freeNodes != NONE)
+			{
+				const auto first = freeNodes;
+				freeNodes = nodes[first].firstChild;
+				return first;
+			}
+
+			const auto first = static_cast<uint32_t>(nodes.size());
+			nodes.resize(nodes.size() + 4);
+			return first;
+		}
+
+		void releaseChildren(uint32_t first)
+		{
+			nodes[first].firstChild = freeNodes;
+			freeNodes = first;
+		}
+
+		// Allocates the four children of a node and sets up their quadrant regions, leaving the node itself untouched
+		uint32_t makeChildren(uint32_t index)
+		{
+			const auto first = allocChildren();
+			const auto r = nodes[index].region;
+			const auto c = r.Center();
+			const std::array<Box, 4> quads = {
+				Box{ .minPoint = r.minPoint, .maxPoint = c },
+				Box{ .minPoint = { c.x, r.minPoint.y }, .maxPoint = { r.maxPoint.x, c.y } },
+				Box{ .minPoint = { r.minPoint.x, c.y }, .maxPoint = { c.x, r.maxPoint.y } },
+				Box{ .minPoint = c, .maxPoint = r.maxPoint }
+			};
+
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				nodes[first + i] = Node{ .region = quads[i], .loose = looseBounds(quads[i]), .parent = index, .firstChild = NONE,
+					.firstBlock = NONE, .lastBlock = NONE, .count = 0, .depth = nodes[index].depth + 1 };
+			}
+			return first;
+		}
+
+		void subdivide(uint32_t index)
+		{
+			const auto first = makeChildren(index);
+
+			// Hand every element down to its quadrant before the leaf turns into a branch. In a loose tree an element
+			// may have drifted out of this node's region and then fits no child, those are inserted again afterwards.
+			std::vector<uint32_t> drifted;
+			const auto count = nodes[index].count;
+			auto block = nodes[index].firstBlock;
+			for (uint32_t n = 0; n < count; ++n)
+			{
+				const auto s = block * capacity + n % capacity;
+				const auto p = Point{ slotX[s], slotY[s] };
+				const auto child = first + quadrant(nodes[index], p);
+				if (nodes[child].loose.InBounds(p))
+				{
+					appendToLeaf(child, slotItem[s], p);
+				}
+				else
+				{
+					drifted.emplace_back(slotItem[s]);
+				}
+				if ((n + 1) % capacity == 0)
+				{
+					const auto next = blockNext[block];
+					releaseBlock(block);
+					block = next;
+				}
+			}
+			if (block != NONE)
+			{
+				releaseBlock(block);
+			}
+
+			nodes[index].firstBlock = NONE;
+			nodes[index].lastBlock = NONE;
+			nodes[index].count = 0;
+			nodes[index].firstChild = first;
+
+			for (auto item : drifted)
+			{
+				insertFrom(0, item);
+			}
+		}
+
+		// Collapses branches whose four children are leaves holding no more than capacity elements
+		void merge(uint32_t index)
+		{
+			while (index != NONE)
+			{
+				const auto first = nodes[index].firstChild;
+				uint32_t total = 0;
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					if (nodes[first + i].firstChild != NONE)
+						return;
+					total += nodes[first + i].count;
+				}
+				if (total > capacity)
+					return;
+
+				nodes[index].firstChild = NONE;
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					const auto& child = nodes[first + i];
+					auto block = child.firstBlock;
+					for (uint32_t n = 0; n < child.count; ++n)
+					{
+						const auto s = block * capacity + n % capacity;
+						appendToLeaf(index, slotItem[s], Point{ slotX[s], slotY[s] });
+						if ((n + 1) % capacity == 0)
+						{
+							const auto next = blockNext[block];
+							releaseBlock(block);
+							block = next;
+						}
+					}
+					if (block != NONE)
+					{
+						releaseBlock(block);
+					}
+				}
+				releaseChildren(first);
+				index = nodes[index].parent;
 			}
-			nodes.clear();
 		}
 	};
-}
 
+	// Read only quad tree over a snapshot written by QuadTree::Serialize, typically a mapped file. Opening checks
+	// the header, the section layout and every index in the sections once, so untrusted files are rejected rather
+	// than read out of bounds, and then queries the snapshot in place: no copies, no allocations. The bytes must
+	// outlive the view, must not change while it is open and must sit at a SNAPSHOT_ALIGNMENT aligned address
+	// (mapped files and vectors both do).
+	export
+	template <class T>
+		requires std::is_trivially_copyable_v<T> && (alignof(T) <= SNAPSHOT_ALIGNMENT)
+	struct QuadTreeView
+	{
+	private:
+		QuadTreeCore core{};
+		Box region{};
+		const T* itemData = nullptr;
+		const Point* itemPosition = nullptr;
+		const uint32_t* itemSlot = nullptr;
+		uint32_t itemCount = 0;
+
+	public:
+		static std::optional<QuadTreeView> Open(std::span<const std::byte> snapshot)
+		{
+			const auto* header = readSnapshotHeader(snapshot, sizeof(T));
+			if (!header)
+				return std::nullopt;
+
+			QuadTreeView view;
+			view.core = QuadTreeCore{ .nodes = snapshotSection<QuadNode>(snapshot, header->nodes),
+				.slotX = snapshotSection<float>(snapshot, header->slotX),
+				.slotY = snapshotSection<float>(snapshot, header->slotY),
+				.slotItem = snapshotSection<uint32_t>(snapshot, header->slotItem),
+				.blockNext = snapshotSection<uint32_t>(snapshot, header->blockNext),
+				.capacity = header->capacity,
+				.size = header->size };
+			view.region = header->region;
+			view.itemData = snapshotSection<T>(snapshot, header->itemData);
+			view.itemPosition = snapshotSection<Point>(snapshot, header->itemPosition);
+			view.itemSlot = snapshotSection<uint32_t>(snapshot, header->itemSlot);
+			view.itemCount = header->itemCount;
+			return view;
+		}
+
+		template <class Fn>
+		void Query(const Box& box, Fn&& fn) const
+		{
+			core.Query(box, std::forward<Fn>(fn));
+		}
+
+		std::vector<Handle> Query(const Box& box) const
+		{
+			return core.Query(box);
+		}
+
+		std::vector<Handle> Nearest(const Point& p, uint32_t k) const
+		{
+			return core.Nearest(p, k);
+		}
+
+		std::optional<RayHit> Raycast(const Point& origin, const Point& dir, float maxDist, float pickRadius = 1.0f) const
+		{
+			return core.Raycast(origin, dir, maxDist, pickRadius);
+		}
+
+		bool Contains(Handle h) const
+		{
+			return h < itemCount && itemSlot[h] != QuadTreeCore::NONE;
+		}
+
+		const T& Get(Handle h) const
+		{
+			return itemData[h];
+		}
+
+		Point Position(Handle h) const
+		{
+			return itemPosition[h];
+		}
+
+		uint32_t Size() const
+		{
+			return core.size;
+		}
+
+		const Box& Region() const
+		{
+			return region;
+		}
+	};
+}
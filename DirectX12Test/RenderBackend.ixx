@@ -0,0 +1,76 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+export module RenderBackend;
+
+export import FrameTimeline;
+
+namespace LS
+{
+	export struct ColorRGBA
+	{
+		float r = 0.0f;
+		float g = 0.0f;
+		float b = 0.0f;
+		float a = 1.0f;
+	};
+
+	template<class T, size_t Count>
+	struct Vector
+	{
+		std::array<T, Count> Vec;
+	};
+
+	export struct Vertex
+	{
+		Vector<float, 3> position;
+		Vector<float, 4> color;
+	};
+
+	export struct VertexPT
+	{
+		Vector<float, 4> position;
+		Vector<float, 2> uv;
+	};
+
+	// Command lists the scene draws can be split across, each recorded on its own thread
+	export constexpr uint32_t MAX_RECORDING_THREADS = 8;
+
+	export enum class RENDER_BACKEND
+	{
+		DX12,
+		HEADLESS// Software device with a simulated queue and fence, needs neither a GPU nor a window
+	};
+
+	// What LSDevice forwards to. Every backend records and submits the same frame: clear, the bundled gradient
+	// triangle, the scene draws through a sorted render queue (SetDrawCount of them, recorded on up to
+	// SetRecordingThreads threads), present, then waits for the frame slot it reuses next.
+	export class RenderBackend
+	{
+	public:
+		virtual ~RenderBackend() = default;
+
+		// Creates the device and pipeline. handle is the native window, x and y the back buffer size (0 uses the
+		// window size). Assets keep loading in the background after it returns, the first Render waits for them.
+		virtual bool CreateDevice(void* handle, uint32_t x, uint32_t y) = 0;
+		virtual void CheckFeatures(std::string& s) = 0;
+		virtual void Render(const ColorRGBA& clearColor) = 0;
+		// Frames the CPU may record ahead of the GPU, clamped to [1, MAX_FRAMES_IN_FLIGHT]
+		virtual uint32_t SetFramesInFlight(uint32_t count) = 0;
+		// Waits on the swap chain before each frame instead of only on the frame slot's fence
+		virtual void SetLowLatency(bool enabled) = 0;
+		// Threads recording the scene draws, clamped to [1, MAX_RECORDING_THREADS]. Fewer are used when there are
+		// not enough draws to be worth splitting.
+		virtual uint32_t SetRecordingThreads(uint32_t count) = 0;
+		// Scene draws each frame, alternating the textured triangle and the gradient triangle behind it, stands in
+		// for a scene with many draws. 1 draws only the textured triangle.
+		virtual void SetDrawCount(uint32_t count) = 0;
+		virtual const FrameTimeline& Timeline() const = 0;
+		// Whether the assets CreateDevice started loading are done, so the first Render will not have to wait
+		virtual bool AssetsReady() const = 0;
+		// Waits for all submitted work before the device goes away
+		virtual void OnDestroy() = 0;
+	};
+}
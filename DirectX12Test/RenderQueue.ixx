@@ -0,0 +1,240 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <concepts>
+#include <stdexcept>
+export module RenderQueue;
+
+namespace LS
+{
+	// The state a draw needs, packed into 64 bits so that sorting the keys groups draws by state. Fields are ordered
+	// from most to least expensive to change: layer first (so background, opaque, transparent and UI keep their
+	// order), then pipeline, root signature, descriptor table and vertex buffer, and depth last to order draws that
+	// share all of their state. Ids are chosen by the backend and have to fit their field.
+	export struct DrawKey
+	{
+		static constexpr uint32_t LAYER_BITS = 4;
+		static constexpr uint32_t PIPELINE_BITS = 10;
+		static constexpr uint32_t ROOT_SIGNATURE_BITS = 6;
+		static constexpr uint32_t DESCRIPTOR_TABLE_BITS = 16;
+		static constexpr uint32_t VERTEX_BUFFER_BITS = 12;
+		static constexpr uint32_t DEPTH_BITS = 16;
+		static constexpr uint32_t NO_TABLE = (1u << DESCRIPTOR_TABLE_BITS) - 1;// For root signatures without a table
+
+		uint32_t layer = 0;
+		uint32_t pipeline = 0;
+		uint32_t rootSignature = 0;
+		uint32_t descriptorTable = NO_TABLE;// Index of the table's first descriptor in the shader visible heap
+		uint32_t vertexBuffer = 0;
+		uint32_t depth = 0;// Front to back for opaque draws, quantized back to front for transparent ones
+
+		uint64_t Pack() const
+		{
+#ifdef _DEBUG
+			if (layer >> LAYER_BITS || pipeline >> PIPELINE_BITS || rootSignature >> ROOT_SIGNATURE_BITS ||
+				descriptorTable >> DESCRIPTOR_TABLE_BITS || vertexBuffer >> VERTEX_BUFFER_BITS || depth >> DEPTH_BITS)
+				throw std::runtime_error("Draw key field does not fit its bits");
+#endif
+			uint64_t key = layer;
+			key = key << PIPELINE_BITS | pipeline;
+			key = key << ROOT_SIGNATURE_BITS | rootSignature;
+			key = key << DESCRIPTOR_TABLE_BITS | descriptorTable;
+			key = key << VERTEX_BUFFER_BITS | vertexBuffer;
+			key = key << DEPTH_BITS | depth;
+			return key;
+		}
+
+		static DrawKey Unpack(uint64_t key)
+		{
+			DrawKey k;
+			k.depth = field(key, DEPTH_BITS);
+			k.vertexBuffer = field(key, VERTEX_BUFFER_BITS);
+			k.descriptorTable = field(key, DESCRIPTOR_TABLE_BITS);
+			k.rootSignature = field(key, ROOT_SIGNATURE_BITS);
+			k.pipeline = field(key, PIPELINE_BITS);
+			k.layer = field(key, LAYER_BITS);
+			return k;
+		}
+
+	private:
+		// Takes the lowest bits off key
+		static uint32_t field(uint64_t& key, uint32_t bits)
+		{
+			const auto value = static_cast<uint32_t>(key & ((uint64_t{ 1 } << bits) - 1));
+			key >>= bits;
+			return value;
+		}
+	};
+
+	export struct DrawItem
+	{
+		uint32_t vertexCount = 0;
+		uint32_t instanceCount = 1;
+		uint32_t startVertex = 0;
+	};
+
+	// What a replay emitted, draws plus the state changes that were needed for them
+	export struct RenderQueueStats
+	{
+		uint64_t draws = 0;
+		uint64_t pipelineChanges = 0;
+		uint64_t rootSignatureChanges = 0;
+		uint64_t descriptorTableChanges = 0;
+		uint64_t vertexBufferChanges = 0;
+
+		uint64_t StateChanges() const
+		{
+			return pipelineChanges + rootSignatureChanges + descriptorTableChanges + vertexBufferChanges;
+		}
+
+		RenderQueueStats& operator+=(const RenderQueueStats& other)
+		{
+			draws += other.draws;
+			pipelineChanges += other.pipelineChanges;
+			rootSignatureChanges += other.rootSignatureChanges;
+			descriptorTableChanges += other.descriptorTableChanges;
+			vertexBufferChanges += other.vertexBufferChanges;
+			return *this;
+		}
+	};
+
+	// Receives a replayed queue, ids are the ones the draw keys were made from
+	export template<class T>
+	concept DrawSink = requires(T sink, uint32_t id, const DrawItem& item)
+	{
+		sink.SetPipeline(id);
+		sink.SetRootSignature(id);
+		sink.SetDescriptorTable(id);
+		sink.SetVertexBuffer(id);
+		sink.Draw(item);
+	};
+
+	// The frame's draws, filled each frame, sorted by key and replayed into command lists. A replay only passes on
+	// the state a draw needs when it differs from what the draw before it left bound, so after sorting the state
+	// changes grow with the number of distinct states rather than with the number of draws.
+	export class RenderQueue
+	{
+	public:
+		void Clear()
+		{
+			m_entries.clear();
+			m_items.clear();
+		}
+
+		void Submit(const DrawKey& key, const DrawItem& item)
+		{
+			m_entries.emplace_back(Entry{ .key = key.Pack(), .item = static_cast<uint32_t>(m_items.size()) });
+			m_items.emplace_back(item);
+		}
+
+		// Stable LSD radix sort on the keys, a byte per pass. Bytes that are the same in every key (unused ids,
+		// depth when nothing sets it) are skipped, which leaves few passes for the usual handful of states.
+		void Sort()
+		{
+			const auto count = m_entries.size();
+			if (count < 2)
+				return;
+
+			std::array<std::array<uint32_t, 256>, 8> histograms = {};
+			for (const auto& entry : m_entries)
+			{
+				for (uint32_t pass = 0; pass < 8; ++pass)
+				{
+					++histograms[pass][(entry.key >> (pass * 8)) & 0xff];
+				}
+			}
+
+			m_scratch.resize(count);
+			for (uint32_t pass = 0; pass < 8; ++pass)
+			{
+				auto& histogram = histograms[pass];
+				const auto shift = pass * 8;
+				if (histogram[(m_entries[0].key >> shift) & 0xff] == count)
+					continue;
+
+				uint32_t offset = 0;
+				for (auto& bucket : histogram)
+				{
+					const auto size = bucket;
+					bucket = offset;
+					offset += size;
+				}
+				for (const auto& entry : m_entries)
+				{
+					m_scratch[histogram[(entry.key >> shift) & 0xff]++] = entry;
+				}
+				m_entries.swap(m_scratch);
+			}
+		}
+
+		size_t Size() const
+		{
+			return m_entries.size();
+		}
+
+		uint64_t Key(size_t index) const
+		{
+			return m_entries[index].key;
+		}
+
+		// Replays the draws in [begin, end) as if into a command list with nothing bound yet, so slices of one
+		// queue can go to different lists (and threads) at once
+		template<DrawSink Sink>
+		RenderQueueStats Replay(Sink& sink, size_t begin, size_t end) const
+		{
+			RenderQueueStats stats;
+			auto pipeline = UNSET;
+			auto rootSignature = UNSET;
+			auto descriptorTable = UNSET;
+			auto vertexBuffer = UNSET;
+			for (auto i = begin; i < end; ++i)
+			{
+				const auto key = DrawKey::Unpack(m_entries[i].key);
+				if (key.pipeline != pipeline)
+				{
+					pipeline = key.pipeline;
+					sink.SetPipeline(pipeline);
+					++stats.pipelineChanges;
+				}
+				if (key.rootSignature != rootSignature)
+				{
+					rootSignature = key.rootSignature;
+					sink.SetRootSignature(rootSignature);
+					++stats.rootSignatureChanges;
+					// Setting a root signature drops the root arguments bound with the previous one
+					descriptorTable = UNSET;
+				}
+				if (key.descriptorTable != descriptorTable && key.descriptorTable != DrawKey::NO_TABLE)
+				{
+					descriptorTable = key.descriptorTable;
+					sink.SetDescriptorTable(descriptorTable);
+					++stats.descriptorTableChanges;
+				}
+				if (key.vertexBuffer != vertexBuffer)
+				{
+					vertexBuffer = key.vertexBuffer;
+					sink.SetVertexBuffer(vertexBuffer);
+					++stats.vertexBufferChanges;
+				}
+				sink.Draw(m_items[m_entries[i].item]);
+				++stats.draws;
+			}
+			return stats;
+		}
+
+	private:
+		static constexpr uint32_t UNSET = UINT32_MAX;
+
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t item;// Index into m_items, only the small entries move while sorting
+		};
+
+		std::vector<Entry> m_entries;
+		std::vector<Entry> m_scratch;
+		std::vector<DrawItem> m_items;
+	};
+}
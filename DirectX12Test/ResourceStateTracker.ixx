@@ -0,0 +1,210 @@
+module;
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <bit>
+#include <stdexcept>
+export module ResourceStateTracker;
+
+namespace LS
+{
+	export struct ResourceTransition
+	{
+		uint32_t resource;
+		uint32_t before;
+		uint32_t after;
+	};
+
+	export struct ResourceStateTrackerStats
+	{
+		uint64_t requests = 0;
+		uint64_t elided = 0;// Requests already satisfied, or undone before they were flushed
+		uint64_t transitions = 0;// Handed to a barrier call
+		uint64_t flushes = 0;// Barrier calls made, flushes with nothing pending are not counted
+	};
+
+	// Knows the state of every tracked resource as of the commands recorded so far. Before a resource is used the
+	// recorder asks for the state the use needs, and the tracker queues a transition only when the resource is not
+	// in it already. Queued transitions are handed out together on Flush, to become one barrier call, which has to
+	// happen before the use is recorded. Several read requests for one resource between flushes fold into one
+	// transition to the combined read state. States are bit masks in the backend's encoding:
+	// writeStates names the bits that cannot be combined with any other, every other bit is a read state that can be,
+	// so a resource in a combined read state needs no transition for any read it includes. Resources are small dense
+	// ids chosen by the caller. Debug builds throw on requests for untracked resources, on write states combined with
+	// anything, on a write state requested over a different state that is still waiting for a flush, or the other way
+	// round, and on untracking a resource with a transition still queued.
+	export class ResourceStateTracker
+	{
+	public:
+		explicit ResourceStateTracker(uint32_t writeStates = 0) : m_writeStates(writeStates)
+		{
+		}
+
+		// Starts tracking resource, whose commands so far have left it in state
+		void Track(uint32_t resource, uint32_t state)
+		{
+			if (resource >= m_resources.size())
+			{
+				m_resources.resize(resource + 1);
+			}
+			m_resources[resource] = Entry{ .state = state, .pending = NONE, .tracked = true };
+		}
+
+		void Untrack(uint32_t resource)
+		{
+#ifdef _DEBUG
+			if (entry(resource).pending != NONE)
+				throw std::runtime_error("Untracking a resource with a transition that was never flushed");
+#endif
+			m_resources[resource].tracked = false;
+		}
+
+		bool IsTracked(uint32_t resource) const
+		{
+			return resource < m_resources.size() && m_resources[resource].tracked;
+		}
+
+		// State the resource is in once the queued transitions are flushed
+		uint32_t State(uint32_t resource) const
+		{
+			const auto& e = entry(resource);
+			return e.pending == NONE ? e.state : m_pending[e.pending].after;
+		}
+
+		// The next use of resource needs it in state
+		void Require(uint32_t resource, uint32_t state)
+		{
+			auto& e = entry(resource);
+#ifdef _DEBUG
+			const auto writes = state & m_writeStates;
+			if (writes != 0 && (std::popcount(writes) > 1 || writes != state))
+				throw std::runtime_error("Resource state combines a write state with other states");
+#endif
+			++m_stats.requests;
+			if (e.pending != NONE)
+			{
+				auto& transition = m_pending[e.pending];
+				++m_stats.elided;
+				if (includes(transition.after, state))
+					return;
+#ifdef _DEBUG
+				// The use queued behind the pending transition would be recorded in the wrong state
+				if (((transition.after | state) & m_writeStates) != 0)
+					throw std::runtime_error("Resource state conflicts with a write state still waiting for a flush");
+#endif
+				// Both uses come after the one barrier, so the reads are combined into one state that serves both
+				if (isRead(transition.after) && isRead(state))
+				{
+					transition.after |= state;
+				}
+				else
+				{
+					transition.after = state;
+				}
+				return;
+			}
+
+			if (includes(e.state, state))
+			{
+				++m_stats.elided;
+				return;
+			}
+			e.pending = static_cast<uint32_t>(m_pending.size());
+			m_pending.emplace_back(ResourceTransition{ .resource = resource, .before = e.state, .after = state });
+		}
+
+		// Transitions queued since the last flush, including ones that folded back to where they started
+		std::span<const ResourceTransition> Pending() const
+		{
+			return m_pending;
+		}
+
+		// Hands every queued transition to emit in one span, in the order they were first requested, and marks the
+		// resources as being in their new states. emit is not called when nothing needs a barrier. Returns the
+		// number of transitions emitted.
+		template<class Emit>
+		uint32_t Flush(Emit&& emit)
+		{
+			uint32_t count = 0;
+			for (const auto& transition : m_pending)
+			{
+				auto& e = m_resources[transition.resource];
+				e.pending = NONE;
+				e.state = transition.after;
+				if (transition.before != transition.after)
+				{
+					m_pending[count++] = transition;
+				}
+				else
+				{
+					++m_stats.elided;
+				}
+			}
+			m_pending.resize(count);
+
+			if (count > 0)
+			{
+				emit(std::span<const ResourceTransition>(m_pending));
+				++m_stats.flushes;
+				m_stats.transitions += count;
+			}
+			m_pending.clear();
+			return count;
+		}
+
+		const ResourceStateTrackerStats& Stats() const
+		{
+			return m_stats;
+		}
+
+		void ResetStats()
+		{
+			m_stats = {};
+		}
+
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		struct Entry
+		{
+			uint32_t state = 0;
+			uint32_t pending = NONE;// Index of the resource's queued transition
+			bool tracked = false;
+		};
+
+		uint32_t m_writeStates;
+		std::vector<Entry> m_resources;
+		std::vector<ResourceTransition> m_pending;
+		ResourceStateTrackerStats m_stats;
+
+		bool isRead(uint32_t state) const
+		{
+			return state != 0 && (state & m_writeStates) == 0;
+		}
+
+		// A state satisfies a request when it is the same, or when both are reads and it has every bit asked for
+		bool includes(uint32_t current, uint32_t required) const
+		{
+			return current == required ||
+				(required != 0 && (current & required) == required && (current & m_writeStates) == 0);
+		}
+
+		Entry& entry(uint32_t resource)
+		{
+#ifdef _DEBUG
+			if (!IsTracked(resource))
+				throw std::runtime_error("Resource state requested for a resource that is not tracked");
+#endif
+			return m_resources[resource];
+		}
+
+		const Entry& entry(uint32_t resource) const
+		{
+#ifdef _DEBUG
+			if (!IsTracked(resource))
+				throw std::runtime_error("Resource state requested for a resource that is not tracked");
+#endif
+			return m_resources[resource];
+		}
+	};
+}
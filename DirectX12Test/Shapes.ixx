@@ -55,6 +55,7 @@ namespace Shape
 				D2D1::Point2F(centerPoint.x, centerPoint.y), 
 				static_cast<float>(length.x), 
 				static_cast<float>(length.y) );
+			UpdateBounds();
 		}
 
 		// Inherited via IShape
@@ -135,6 +136,16 @@ namespace Shape
 			m_ellipse = D2D1::Ellipse(D2D1::Point2F(m_radiusPos.x, m_radiusPos.y), 
 				static_cast<float>(m_lengthPoints.x),
 				static_cast<float>(m_lengthPoints.y) );
+			UpdateBounds();
+		}
+
+		// Keeps the AObject bounds around the ellipse for hit testing and culling
+		void UpdateBounds()
+		{
+			const auto rx = std::abs(m_lengthPoints.x);
+			const auto ry = std::abs(m_lengthPoints.y);
+			m_position = m_radiusPos;
+			m_bounds = { m_radiusPos.x - rx, m_radiusPos.y - ry, m_radiusPos.x + rx, m_radiusPos.y + ry };
 		}
 
 		void CreateBrushes(ID2D1RenderTarget* pRenderTarget)
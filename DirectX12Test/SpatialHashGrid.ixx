@@ -0,0 +1,447 @@
+module;
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <functional>
+#include <limits>
+export module SpatialHashGrid;
+
+import QuadTree;
+import BoxKernels;
+
+namespace Data
+{
+	// Uniform grid of square cells over a region, with the cells hashed into a power of two bucket table so sparse
+	// scenes do not pay for empty cells. Each bucket owns a chain of fixed size slot blocks holding its elements'
+	// positions and cell keys contiguously (structure of arrays), the same layout the quad tree leaves use.
+	// Several cells may share a bucket; every slot records its cell so lookups skip foreign elements.
+	export
+	template <class T>
+		struct SpatialHashGrid
+	{
+	private:
+		static constexpr uint32_t NONE = UINT32_MAX;
+		static constexpr uint32_t BLOCK_SIZE = 16;
+		static constexpr uint32_t MAX_BUCKETS = 1u << 20;
+
+		struct Bucket
+		{
+			uint32_t firstBlock;
+			uint32_t lastBlock;
+			uint32_t count;
+		};
+
+		struct Item
+		{
+			T data;
+			Point position;
+			uint32_t cell;// Cell key, or the next free item when released
+			uint32_t slot;// Absolute index into the slot arrays, NONE when released
+		};
+
+		Box region;
+		float cellSize;
+		float invCellSize;
+		uint32_t columns;
+		uint32_t rows;
+		uint32_t bucketShift;
+		std::vector<Bucket> buckets;
+		std::vector<Item> items;
+		std::vector<float> slotX;
+		std::vector<float> slotY;
+		std::vector<uint32_t> slotCell;
+		std::vector<uint32_t> slotItem;
+		std::vector<uint32_t> blockNext;
+		uint32_t freeItems = NONE;
+		uint32_t freeBlocks = NONE;
+		uint32_t size = 0;
+
+	public:
+		// bucketCount is rounded up to a power of two; 0 picks one bucket per cell (capped at MAX_BUCKETS)
+		SpatialHashGrid(Box r, float cell, uint32_t bucketCount = 0) : region(r),
+			cellSize(cell),
+			invCellSize(1.0f / cell)
+		{
+			columns = std::max(1u, static_cast<uint32_t>(std::ceil((region.maxPoint.x - region.minPoint.x) * invCellSize)));
+			rows = std::max(1u, static_cast<uint32_t>(std::ceil((region.maxPoint.y - region.minPoint.y) * invCellSize)));
+			if (bucketCount == 0)
+			{
+				bucketCount = static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(columns) * rows, MAX_BUCKETS));
+			}
+
+			uint32_t bits = 0;
+			while ((1u << bits) < bucketCount && bits < 31)
+			{
+				++bits;
+			}
+			bucketShift = 32 - bits;
+			buckets.resize(size_t{ 1 } << bits);
+			Clear();
+		}
+
+		Handle Insert(const T& data, const Point& p)
+		{
+			if (!region.InBounds(p))
+				return INVALID_HANDLE;
+
+			uint32_t handle = freeItems;
+			if (handle != NONE)
+			{
+				freeItems = items[handle].cell;
+				items[handle] = Item{ .data = data, .position = p, .cell = cellOf(p), .slot = NONE };
+			}
+			else
+			{
+				handle = static_cast<uint32_t>(items.size());
+				items.emplace_back(Item{ .data = data, .position = p, .cell = cellOf(p), .slot = NONE });
+			}
+
+			append(handle);
+			++size;
+			return handle;
+		}
+
+		bool Remove(Handle h)
+		{
+			if (!Contains(h))
+				return false;
+
+			removeSlot(bucketOf(items[h].cell), items[h].slot);
+			items[h].slot = NONE;
+			items[h].cell = freeItems;
+			freeItems = h;
+			--size;
+			return true;
+		}
+
+		// Updates in place while the element stays in its cell, otherwise moves it to the new cell's bucket
+		bool Move(Handle h, const Point& p)
+		{
+			if (!Contains(h) || !region.InBounds(p))
+				return false;
+
+			auto& item = items[h];
+			item.position = p;
+			const auto cell = cellOf(p);
+			if (cell == item.cell)
+			{
+				slotX[item.slot] = p.x;
+				slotY[item.slot] = p.y;
+				return true;
+			}
+
+			removeSlot(bucketOf(item.cell), item.slot);
+			item.cell = cell;
+			append(h);
+			return true;
+		}
+
+		// Calls fn(handle) for every element whose position lies within the box
+		template <class Fn>
+		void Query(const Box& box, Fn&& fn) const
+		{
+			if (!box.Intersects(region))
+				return;
+
+			const auto [x0, y0] = cellCoords(box.minPoint);
+			const auto [x1, y1] = cellCoords(box.maxPoint);
+			const auto cells = static_cast<uint64_t>(x1 - x0 + 1) * (y1 - y0 + 1);
+
+			// A box covering more cells than there are buckets is cheaper to answer with one pass over the buckets
+			if (cells >= buckets.size())
+			{
+				for (const auto& bucket : buckets)
+				{
+					forEachHit(bucket, box, [&](uint32_t s) { fn(static_cast<Handle>(slotItem[s])); });
+				}
+				return;
+			}
+
+			for (auto y = y0; y <= y1; ++y)
+			{
+				for (auto x = x0; x <= x1; ++x)
+				{
+					const auto cell = y * columns + x;
+					forEachHit(buckets[bucketOf(cell)], box, [&](uint32_t s)
+						{
+							if (slotCell[s] == cell)
+							{
+								fn(static_cast<Handle>(slotItem[s]));
+							}
+						});
+				}
+			}
+		}
+
+		std::vector<Handle> Query(const Box& box) const
+		{
+			std::vector<Handle> result;
+			Query(box, [&result](Handle h) { result.emplace_back(h); });
+			return result;
+		}
+
+		// Returns up to k elements ordered from closest to farthest. Cells are searched in square rings around the
+		// cell of p; the search stops once the k-th candidate is closer than anything the next ring could hold.
+		std::vector<Handle> Nearest(const Point& p, uint32_t k) const
+		{
+			std::vector<Handle> result;
+			if (k == 0 || size == 0)
+				return result;
+
+			using Entry = std::pair<float, uint32_t>;
+			std::priority_queue<Entry> best;
+			const auto [cx, cy] = cellCoords(p);
+			const auto maxRing = static_cast<int64_t>(std::max(columns, rows));
+
+			const auto visit = [&](int64_t x, int64_t y)
+				{
+					if (x < 0 || y < 0 || x >= columns || y >= rows)
+						return;
+					const auto cell = static_cast<uint32_t>(y * columns + x);
+					forEachSlot(buckets[bucketOf(cell)], [&](uint32_t s)
+						{
+							if (slotCell[s] != cell)
+								return;
+							const auto dx = slotX[s] - p.x;
+							const auto dy = slotY[s] - p.y;
+							const auto d = dx * dx + dy * dy;
+							if (best.size() < k)
+							{
+								best.emplace(d, slotItem[s]);
+							}
+							else if (d < best.top().first)
+							{
+								best.pop();
+								best.emplace(d, slotItem[s]);
+							}
+						});
+				};
+
+			for (int64_t ring = 0; ring <= maxRing; ++ring)
+			{
+				if (ring == 0)
+				{
+					visit(cx, cy);
+				}
+				else
+				{
+					for (auto x = cx - ring; x <= cx + ring; ++x)
+					{
+						visit(x, cy - ring);
+						visit(x, cy + ring);
+					}
+					for (auto y = cy - ring + 1; y <= cy + ring - 1; ++y)
+					{
+						visit(cx - ring, y);
+						visit(cx + ring, y);
+					}
+				}
+
+				// Everything in the next ring is at least ring cells away from p
+				const auto reach = static_cast<float>(ring) * cellSize;
+				if (best.size() == k && best.top().first <= reach * reach)
+					break;
+			}
+
+			result.resize(best.size());
+			for (auto i = result.size(); i > 0; --i)
+			{
+				result[i - 1] = best.top().second;
+				best.pop();
+			}
+			return result;
+		}
+
+		bool Contains(Handle h) const
+		{
+			return h < items.size() && items[h].slot != NONE;
+		}
+
+		T& Get(Handle h)
+		{
+			return items[h].data;
+		}
+
+		const T& Get(Handle h) const
+		{
+			return items[h].data;
+		}
+
+		Point Position(Handle h) const
+		{
+			return items[h].position;
+		}
+
+		uint32_t Size() const
+		{
+			return size;
+		}
+
+		const Box& Region() const
+		{
+			return region;
+		}
+
+		float CellSize() const
+		{
+			return cellSize;
+		}
+
+		void Clear()
+		{
+			std::fill(buckets.begin(), buckets.end(), Bucket{ .firstBlock = NONE, .lastBlock = NONE, .count = 0 });
+			items.clear();
+			slotX.clear();
+			slotY.clear();
+			slotCell.clear();
+			slotItem.clear();
+			blockNext.clear();
+			freeItems = NONE;
+			freeBlocks = NONE;
+			size = 0;
+		}
+
+	private:
+		std::array<int64_t, 2> cellCoords(const Point& p) const
+		{
+			const auto x = static_cast<int64_t>((p.x - region.minPoint.x) * invCellSize);
+			const auto y = static_cast<int64_t>((p.y - region.minPoint.y) * invCellSize);
+			return { std::clamp<int64_t>(x, 0, columns - 1), std::clamp<int64_t>(y, 0, rows - 1) };
+		}
+
+		uint32_t cellOf(const Point& p) const
+		{
+			const auto [x, y] = cellCoords(p);
+			return static_cast<uint32_t>(y * columns + x);
+		}
+
+		// Fibonacci hashing spreads neighbouring cells over the table
+		uint32_t bucketOf(uint32_t cell) const
+		{
+			return bucketShift == 32 ? 0u : (cell * 0x9E3779B1u) >> bucketShift;
+		}
+
+		template <class Fn>
+		void forEachSlot(const Bucket& bucket, Fn&& fn) const
+		{
+			uint32_t remaining = bucket.count;
+			for (auto block = bucket.firstBlock; remaining > 0; block = blockNext[block])
+			{
+				const auto first = block * BLOCK_SIZE;
+				const auto last = first + std::min(remaining, BLOCK_SIZE);
+				for (auto s = first; s < last; ++s)
+				{
+					fn(s);
+				}
+				remaining -= last - first;
+			}
+		}
+
+		// Calls fn(slot) for every slot of the bucket whose position lies within the box, a block at a time
+		template <class Fn>
+		void forEachHit(const Bucket& bucket, const Box& box, Fn&& fn) const
+		{
+			std::array<uint32_t, BLOCK_SIZE> hits;
+			uint32_t remaining = bucket.count;
+			for (auto block = bucket.firstBlock; remaining > 0; block = blockNext[block])
+			{
+				const auto first = block * BLOCK_SIZE;
+				const auto count = std::min(remaining, BLOCK_SIZE);
+				const auto n = pointsInBox(&slotX[first], &slotY[first], count, box, hits.data());
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					fn(first + hits[i]);
+				}
+				remaining -= count;
+			}
+		}
+
+		uint32_t allocBlock()
+		{
+			if (freeBlocks != NONE)
+			{
+				const auto block = freeBlocks;
+				freeBlocks = blockNext[block];
+				blockNext[block] = NONE;
+				return block;
+			}
+
+			const auto block = static_cast<uint32_t>(blockNext.size());
+			blockNext.emplace_back(NONE);
+			slotX.resize(slotX.size() + BLOCK_SIZE);
+			slotY.resize(slotY.size() + BLOCK_SIZE);
+			slotCell.resize(slotCell.size() + BLOCK_SIZE);
+			slotItem.resize(slotItem.size() + BLOCK_SIZE);
+			return block;
+		}
+
+		void append(uint32_t item)
+		{
+			auto& bucket = buckets[bucketOf(items[item].cell)];
+			const auto n = bucket.count;
+			if (n % BLOCK_SIZE == 0)
+			{
+				const auto block = allocBlock();
+				if (n == 0)
+				{
+					bucket.firstBlock = block;
+				}
+				else
+				{
+					blockNext[bucket.lastBlock] = block;
+				}
+				bucket.lastBlock = block;
+			}
+
+			const auto s = bucket.lastBlock * BLOCK_SIZE + n % BLOCK_SIZE;
+			slotX[s] = items[item].position.x;
+			slotY[s] = items[item].position.y;
+			slotCell[s] = items[item].cell;
+			slotItem[s] = item;
+			items[item].slot = s;
+			++bucket.count;
+		}
+
+		// Swap-removes a slot with the bucket's last element and releases the trailing block once it empties
+		void removeSlot(uint32_t index, uint32_t s)
+		{
+			auto& bucket = buckets[index];
+			const auto lastIndex = bucket.count - 1;
+			const auto last = bucket.lastBlock * BLOCK_SIZE + lastIndex % BLOCK_SIZE;
+			if (last != s)
+			{
+				slotX[s] = slotX[last];
+				slotY[s] = slotY[last];
+				slotCell[s] = slotCell[last];
+				slotItem[s] = slotItem[last];
+				items[slotItem[s]].slot = s;
+			}
+			--bucket.count;
+
+			if (lastIndex % BLOCK_SIZE == 0)
+			{
+				const auto block = bucket.lastBlock;
+				if (bucket.count == 0)
+				{
+					bucket.firstBlock = NONE;
+					bucket.lastBlock = NONE;
+				}
+				else
+				{
+					auto prev = bucket.firstBlock;
+					while (blockNext[prev] != block)
+					{
+						prev = blockNext[prev];
+					}
+					blockNext[prev] = NONE;
+					bucket.lastBlock = prev;
+				}
+				blockNext[block] = freeBlocks;
+				freeBlocks = block;
+			}
+		}
+	};
+}
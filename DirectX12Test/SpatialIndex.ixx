@@ -0,0 +1,33 @@
+module;
+#include <cstdint>
+#include <concepts>
+#include <vector>
+export module SpatialIndex;
+
+export import QuadTree;
+export import SpatialHashGrid;
+
+namespace Data
+{
+	// Operations shared by every spatial structure holding T payloads at points. Code written against the
+	// concept can swap the quad tree for the hash grid (or any later structure) per workload.
+	export
+	template <class S, class T>
+	concept SpatialIndex = requires(S index, const S constIndex, const T & data, const Point & p, const Box & box, Handle h, uint32_t k)
+	{
+		{ index.Insert(data, p) } -> std::same_as<Handle>;
+		{ index.Remove(h) } -> std::same_as<bool>;
+		{ index.Move(h, p) } -> std::same_as<bool>;
+		{ index.Get(h) } -> std::same_as<T&>;
+		{ index.Clear() };
+		{ constIndex.Query(box) } -> std::same_as<std::vector<Handle>>;
+		{ constIndex.Nearest(p, k) } -> std::same_as<std::vector<Handle>>;
+		{ constIndex.Contains(h) } -> std::same_as<bool>;
+		{ constIndex.Position(h) } -> std::same_as<Point>;
+		{ constIndex.Size() } -> std::convertible_to<uint32_t>;
+		{ constIndex.Region() } -> std::convertible_to<const Box&>;
+	};
+
+	static_assert(SpatialIndex<QuadTree<int>, int>);
+	static_assert(SpatialIndex<SpatialHashGrid<int>, int>);
+}
@@ -0,0 +1,554 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <span>
+#include <optional>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+export module TextureAtlas;
+
+import TextureFormat;
+
+namespace LS
+{
+	// Texels of an atlas page, x and y are the top left corner
+	export struct AtlasRect
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		uint32_t Right() const
+		{
+			return x + width;
+		}
+
+		uint32_t Bottom() const
+		{
+			return y + height;
+		}
+
+		uint64_t Area() const
+		{
+			return static_cast<uint64_t>(width) * height;
+		}
+
+		bool Contains(const AtlasRect& other) const
+		{
+			return other.x >= x && other.y >= y && other.Right() <= Right() && other.Bottom() <= Bottom();
+		}
+
+		bool Overlaps(const AtlasRect& other) const
+		{
+			return other.x < Right() && x < other.Right() && other.y < Bottom() && y < other.Bottom();
+		}
+	};
+
+	// Normalized texture coordinates of the texel edges of a rect
+	export struct UVRect
+	{
+		float u0 = 0.0f;
+		float v0 = 0.0f;
+		float u1 = 0.0f;
+		float v1 = 0.0f;
+	};
+
+	export struct AtlasSize
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// Where an image landed, rect excludes the padding around it
+	export struct AtlasEntry
+	{
+		uint32_t page = 0;
+		AtlasRect rect;
+		UVRect uv;
+	};
+
+	export struct TextureAtlasStats
+	{
+		uint64_t insertions = 0;
+		uint64_t evictions = 0;
+		uint64_t failedInsertions = 0;
+		uint64_t rebuilds = 0;// Free lists rebuilt after evictions
+	};
+
+	// One page packed with MaxRects: the free space is kept as the list of maximal free rectangles, which may overlap,
+	// and a rect goes where it leaves the shortest side over (best short side fit). Placing a rect splits every free
+	// rectangle it overlaps into the up to four maximal pieces around it and drops pieces another free rectangle
+	// contains. A removed rect goes back on the free list as it is, which is cheap but leaves it unmerged with the free
+	// space around it; the maximal rectangles are rebuilt from the remaining rects when a rect does not fit otherwise
+	// or the removed rects make up a quarter of the list, so a burst of evictions costs one rebuild.
+	export class AtlasPage
+	{
+	public:
+		AtlasPage(uint32_t width, uint32_t height) :
+			m_width(width),
+			m_height(height)
+		{
+			m_free.push_back(AtlasRect{ .width = width, .height = height });
+		}
+
+		// Position of a width by height rect, or nothing when no free rectangle holds it
+		std::optional<AtlasRect> Insert(uint32_t width, uint32_t height)
+		{
+			if (width == 0 || height == 0 || width > m_width || height > m_height)
+				return std::nullopt;
+
+			const auto fit = Find(width, height);
+			if (!fit)
+				return std::nullopt;
+
+			return Place(*fit, width, height);
+		}
+
+		// Rect of an earlier Insert, the space is reused from the next insertion on
+		void Remove(const AtlasRect& rect)
+		{
+			const auto it = std::find_if(m_used.begin(), m_used.end(), [&](const AtlasRect& used)
+				{
+					return used.x == rect.x && used.y == rect.y && used.width == rect.width && used.height == rect.height;
+				});
+			if (it == m_used.end())
+				throw std::runtime_error("Removing a rect that is not in the atlas page");
+
+			// No free rectangle overlaps a used one, so the rect neither contains one nor is contained in one
+			m_free.push_back(*it);
+			m_usedArea -= it->Area();
+			*it = m_used.back();
+			m_used.pop_back();
+			++m_unmerged;
+		}
+
+		struct Fit
+		{
+			size_t index = 0;
+			uint32_t shortSide = 0;
+			uint32_t longSide = 0;
+		};
+
+		// Best short side fit, ties go to the longer side and then to the first free rectangle. Callers compare the
+		// fit of several pages before inserting into one.
+		std::optional<Fit> Find(uint32_t width, uint32_t height)
+		{
+			// Unmerged rects make the list longer and every placement slower, past a quarter of it a rebuild pays off
+			if (m_unmerged > 0 && m_unmerged * 4 > m_free.size())
+			{
+				rebuild();
+			}
+			auto best = find(width, height);
+			if (!best && m_unmerged > 0)
+			{
+				rebuild();
+				best = find(width, height);
+			}
+			return best;
+		}
+
+		// Puts a width by height rect where the fit Find returned for that size says, before anything else changes
+		// the page
+		AtlasRect Place(const Fit& fit, uint32_t width, uint32_t height)
+		{
+			const AtlasRect rect{ .x = m_free[fit.index].x, .y = m_free[fit.index].y, .width = width, .height = height };
+			place(rect);
+			return rect;
+		}
+
+		uint32_t Width() const
+		{
+			return m_width;
+		}
+
+		uint32_t Height() const
+		{
+			return m_height;
+		}
+
+		uint64_t UsedArea() const
+		{
+			return m_usedArea;
+		}
+
+		size_t RectCount() const
+		{
+			return m_used.size();
+		}
+
+		bool Empty() const
+		{
+			return m_used.empty();
+		}
+
+		uint64_t Rebuilds() const
+		{
+			return m_rebuilds;
+		}
+
+	private:
+		std::optional<Fit> find(uint32_t width, uint32_t height) const
+		{
+			std::optional<Fit> best;
+			for (size_t i = 0; i < m_free.size(); ++i)
+			{
+				const auto& free = m_free[i];
+				if (free.width < width || free.height < height)
+					continue;
+
+				const auto leftX = free.width - width;
+				const auto leftY = free.height - height;
+				const Fit fit{ .index = i, .shortSide = std::min(leftX, leftY), .longSide = std::max(leftX, leftY) };
+				if (!best || fit.shortSide < best->shortSide || (fit.shortSide == best->shortSide && fit.longSide < best->longSide))
+				{
+					best = fit;
+				}
+			}
+			return best;
+		}
+
+		void place(const AtlasRect& rect)
+		{
+			// Split the free rectangles the rect overlaps, the pieces go to the back
+			const auto kept = std::partition(m_free.begin(), m_free.end(), [&](const AtlasRect& free)
+				{
+					return !free.Overlaps(rect);
+				});
+			m_split.assign(kept, m_free.end());
+			m_free.erase(kept, m_free.end());
+			const auto oldCount = m_free.size();
+			auto bounds = rect;
+			for (const auto& free : m_split)
+			{
+				if (rect.x > free.x)
+					m_free.push_back(AtlasRect{ .x = free.x, .y = free.y, .width = rect.x - free.x, .height = free.height });
+				if (rect.Right() < free.Right())
+					m_free.push_back(AtlasRect{ .x = rect.Right(), .y = free.y, .width = free.Right() - rect.Right(), .height = free.height });
+				if (rect.y > free.y)
+					m_free.push_back(AtlasRect{ .x = free.x, .y = free.y, .width = free.width, .height = rect.y - free.y });
+				if (rect.Bottom() < free.Bottom())
+					m_free.push_back(AtlasRect{ .x = free.x, .y = rect.Bottom(), .width = free.width, .height = free.Bottom() - rect.Bottom() });
+
+				const auto right = std::max(bounds.Right(), free.Right());
+				const auto bottom = std::max(bounds.Bottom(), free.Bottom());
+				bounds.x = std::min(bounds.x, free.x);
+				bounds.y = std::min(bounds.y, free.y);
+				bounds.width = right - bounds.x;
+				bounds.height = bottom - bounds.y;
+			}
+			prune(oldCount, bounds);
+
+			m_used.push_back(rect);
+			m_usedArea += rect.Area();
+		}
+
+		// Drops the new pieces after oldCount that another free rectangle contains, first against each other, which
+		// leaves few, then against the untouched rectangles that overlap bounds, the split ones, as only those can.
+		// An untouched rectangle is never inside a piece: it would have been inside the split one it came from.
+		void prune(size_t oldCount, const AtlasRect& bounds)
+		{
+			for (size_t i = oldCount; i < m_free.size();)
+			{
+				auto contained = false;
+				for (size_t j = oldCount; j < m_free.size() && !contained; ++j)
+				{
+					// Of two equal pieces the later one goes
+					contained = j != i && m_free[j].Contains(m_free[i]) && (j < i || !m_free[i].Contains(m_free[j]));
+				}
+				if (contained)
+				{
+					m_free[i] = m_free.back();
+					m_free.pop_back();
+				}
+				else
+				{
+					++i;
+				}
+			}
+
+			for (size_t j = 0; j < oldCount; ++j)
+			{
+				const auto old = m_free[j];
+				if (!old.Overlaps(bounds))
+					continue;
+
+				for (size_t i = oldCount; i < m_free.size();)
+				{
+					if (old.Contains(m_free[i]))
+					{
+						m_free[i] = m_free.back();
+						m_free.pop_back();
+					}
+					else
+					{
+						++i;
+					}
+				}
+			}
+		}
+
+		void rebuild()
+		{
+			m_free.assign(1, AtlasRect{ .width = m_width, .height = m_height });
+			// Top to bottom keeps the free list short while it is rebuilt
+			auto used = std::move(m_used);
+			m_used.clear();
+			std::sort(used.begin(), used.end(), [](const AtlasRect& a, const AtlasRect& b)
+				{
+					return a.y != b.y ? a.y < b.y : a.x < b.x;
+				});
+			m_usedArea = 0;
+			for (const auto& rect : used)
+			{
+				place(rect);
+			}
+			m_unmerged = 0;
+			++m_rebuilds;
+		}
+
+		uint32_t m_width;
+		uint32_t m_height;
+		std::vector<AtlasRect> m_free;
+		std::vector<AtlasRect> m_used;
+		std::vector<AtlasRect> m_split;
+		uint64_t m_usedArea = 0;
+		uint64_t m_rebuilds = 0;
+		size_t m_unmerged = 0;
+	};
+
+	// Packs many small images (glyphs, sprites, shape textures) into shared pages, so draws that sample any of them
+	// bind one descriptor per page instead of one per image and can be batched. Every image gets padding texels of
+	// gutter on each side so filtering and coarser mips do not bleed in neighbours; copyToAtlas fills it. Images are
+	// inserted one at a time as they show up, into the page they fit best, and a new page is opened when none holds
+	// them, up to maxPages. Evicted ids are reused. Pack places a known set at once, largest first, which fills pages
+	// tighter than inserting in arrival order.
+	export class TextureAtlas
+	{
+	public:
+		TextureAtlas(uint32_t pageWidth, uint32_t pageHeight, uint32_t padding = 1, uint32_t maxPages = UINT32_MAX) :
+			m_pageWidth(pageWidth),
+			m_pageHeight(pageHeight),
+			m_padding(padding),
+			m_maxPages(maxPages)
+		{
+			if (pageWidth == 0 || pageHeight == 0 || maxPages == 0)
+				throw std::runtime_error("A texture atlas needs a page size and at least one page");
+		}
+
+		// Id of the entry for a width by height image, or nothing when it does not fit in a page or every page is
+		// full
+		std::optional<uint32_t> Insert(uint32_t width, uint32_t height)
+		{
+			const auto paddedWidth = static_cast<uint64_t>(width) + 2 * m_padding;
+			const auto paddedHeight = static_cast<uint64_t>(height) + 2 * m_padding;
+			if (width == 0 || height == 0 || paddedWidth > m_pageWidth || paddedHeight > m_pageHeight)
+			{
+				++m_stats.failedInsertions;
+				return std::nullopt;
+			}
+
+			const auto w = static_cast<uint32_t>(paddedWidth);
+			const auto h = static_cast<uint32_t>(paddedHeight);
+			std::optional<uint32_t> bestPage;
+			AtlasPage::Fit bestFit;
+			for (uint32_t page = 0; page < m_pages.size(); ++page)
+			{
+				const auto fit = m_pages[page].Find(w, h);
+				if (fit && (!bestPage || fit->shortSide < bestFit.shortSide ||
+					(fit->shortSide == bestFit.shortSide && fit->longSide < bestFit.longSide)))
+				{
+					bestPage = page;
+					bestFit = *fit;
+				}
+			}
+			if (!bestPage)
+			{
+				if (m_pages.size() == m_maxPages)
+				{
+					++m_stats.failedInsertions;
+					return std::nullopt;
+				}
+				bestPage = static_cast<uint32_t>(m_pages.size());
+				bestFit = *m_pages.emplace_back(m_pageWidth, m_pageHeight).Find(w, h);
+			}
+
+			const auto placed = m_pages[*bestPage].Place(bestFit, w, h);
+			const AtlasRect rect{ .x = placed.x + m_padding, .y = placed.y + m_padding, .width = width, .height = height };
+			const AtlasEntry entry{ .page = *bestPage, .rect = rect, .uv = UVRect{
+				.u0 = static_cast<float>(rect.x) / m_pageWidth,
+				.v0 = static_cast<float>(rect.y) / m_pageHeight,
+				.u1 = static_cast<float>(rect.Right()) / m_pageWidth,
+				.v1 = static_cast<float>(rect.Bottom()) / m_pageHeight } };
+
+			uint32_t id;
+			if (m_freeIds.empty())
+			{
+				id = static_cast<uint32_t>(m_entries.size());
+				m_entries.push_back(entry);
+				m_live.push_back(true);
+			}
+			else
+			{
+				id = m_freeIds.back();
+				m_freeIds.pop_back();
+				m_entries[id] = entry;
+				m_live[id] = true;
+			}
+			++m_liveCount;
+			++m_stats.insertions;
+			return id;
+		}
+
+		// Ids in the order of sizes, nothing for the images that did not fit. The images are placed largest side first
+		// and, on equal sides, largest area first.
+		std::vector<std::optional<uint32_t>> Pack(std::span<const AtlasSize> sizes)
+		{
+			std::vector<uint32_t> order(sizes.size());
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+				{
+					const auto sideA = std::max(sizes[a].width, sizes[a].height);
+					const auto sideB = std::max(sizes[b].width, sizes[b].height);
+					if (sideA != sideB)
+						return sideA > sideB;
+					return static_cast<uint64_t>(sizes[a].width) * sizes[a].height > static_cast<uint64_t>(sizes[b].width) * sizes[b].height;
+				});
+
+			std::vector<std::optional<uint32_t>> ids(sizes.size());
+			for (const auto index : order)
+			{
+				ids[index] = Insert(sizes[index].width, sizes[index].height);
+			}
+			return ids;
+		}
+
+		// The caller has to make sure no submitted work still samples the entry before its space is reused
+		void Evict(uint32_t id)
+		{
+			if (id >= m_entries.size() || !m_live[id])
+				throw std::runtime_error("Evicting an atlas entry that is not in the atlas");
+
+			const auto& entry = m_entries[id];
+			m_pages[entry.page].Remove(AtlasRect{ .x = entry.rect.x - m_padding, .y = entry.rect.y - m_padding,
+				.width = entry.rect.width + 2 * m_padding, .height = entry.rect.height + 2 * m_padding });
+			m_live[id] = false;
+			m_freeIds.push_back(id);
+			--m_liveCount;
+			++m_stats.evictions;
+		}
+
+		const AtlasEntry& Entry(uint32_t id) const
+		{
+#ifdef _DEBUG
+			if (id >= m_entries.size() || !m_live[id])
+				throw std::runtime_error("Looking up an atlas entry that is not in the atlas");
+#endif
+			return m_entries[id];
+		}
+
+		// Empties every page, pages stay open
+		void Clear()
+		{
+			for (auto& page : m_pages)
+			{
+				m_stats.rebuilds += page.Rebuilds();
+				page = AtlasPage(m_pageWidth, m_pageHeight);
+			}
+			m_entries.clear();
+			m_live.clear();
+			m_freeIds.clear();
+			m_liveCount = 0;
+		}
+
+		uint32_t PageCount() const
+		{
+			return static_cast<uint32_t>(m_pages.size());
+		}
+
+		const AtlasPage& Page(uint32_t page) const
+		{
+			return m_pages[page];
+		}
+
+		uint32_t EntryCount() const
+		{
+			return m_liveCount;
+		}
+
+		uint32_t Padding() const
+		{
+			return m_padding;
+		}
+
+		// Share of the open pages covered by entries and their padding
+		double Occupancy() const
+		{
+			if (m_pages.empty())
+				return 0.0;
+
+			uint64_t used = 0;
+			for (const auto& page : m_pages)
+			{
+				used += page.UsedArea();
+			}
+			return static_cast<double>(used) / (static_cast<double>(m_pageWidth) * m_pageHeight * m_pages.size());
+		}
+
+		TextureAtlasStats Stats() const
+		{
+			auto stats = m_stats;
+			for (const auto& page : m_pages)
+			{
+				stats.rebuilds += page.Rebuilds();
+			}
+			return stats;
+		}
+
+	private:
+		uint32_t m_pageWidth;
+		uint32_t m_pageHeight;
+		uint32_t m_padding;
+		uint32_t m_maxPages;
+		std::vector<AtlasPage> m_pages;
+		std::vector<AtlasEntry> m_entries;
+		std::vector<bool> m_live;
+		std::vector<uint32_t> m_freeIds;
+		uint32_t m_liveCount = 0;
+		TextureAtlasStats m_stats;
+	};
+
+	// Copies image into the rect of an entry on its page and repeats the image's edge texels across the padding
+	// around it, clamped to the page, so bilinear taps at the edge of the rect read the image and not a neighbour.
+	// Both have to be in the same format and the image has to be the size of the rect.
+	export void copyToAtlas(const TextureData& image, const TextureData& page, const AtlasRect& rect, uint32_t padding)
+	{
+		if (image.format != page.format || image.width != rect.width || image.height != rect.height ||
+			rect.Right() > page.width || rect.Bottom() > page.height)
+			throw std::runtime_error("Image does not match its atlas rect");
+
+		const auto texel = static_cast<size_t>(texelSize(page.format));
+		const auto left = std::min(padding, rect.x);
+		const auto right = std::min(padding, page.width - rect.Right());
+		const auto top = std::min(padding, rect.y);
+		const auto bottom = std::min(padding, page.height - rect.Bottom());
+		for (uint32_t y = rect.y - top; y < rect.Bottom() + bottom; ++y)
+		{
+			const auto sourceY = std::clamp(y, rect.y, rect.Bottom() - 1) - rect.y;
+			const auto* source = image.Row(sourceY);
+			auto* dest = page.Row(y) + rect.x * texel;
+			std::memcpy(dest, source, rect.width * texel);
+			for (uint32_t x = 1; x <= left; ++x)
+			{
+				std::memcpy(dest - x * texel, source, texel);
+			}
+			for (uint32_t x = 0; x < right; ++x)
+			{
+				std::memcpy(dest + (rect.width + x) * texel, source + (rect.width - 1) * texel, texel);
+			}
+		}
+	}
+}
@@ -0,0 +1,576 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+export module TextureContainer;
+
+import MappedFile;
+
+// Texture files in the DDS and KTX2 containers, read through a memory mapping. Only what a 2D texture with a mip
+// chain needs is accepted: one layer and face, uncompressed or block compressed formats the renderer can sample, no
+// KTX2 supercompression. Headers are checked against the file before any level is handed out, so a truncated or
+// malformed file fails when it is opened rather than when a copy reads past the end. Levels are copied straight from
+// the mapping to wherever they go, which pages in only the parts of the file that are copied.
+namespace LS
+{
+	export enum class CONTAINER : uint32_t
+	{
+		DDS,
+		KTX2
+	};
+
+	// Layout of a format the loader knows, by its DXGI_FORMAT value so the module does not need the D3D headers
+	export struct SurfaceFormat
+	{
+		uint32_t dxgiFormat = 0;
+		uint32_t blockDimension = 1;// 4 for block compressed formats, 1 otherwise
+		uint32_t bytesPerBlock = 0;// Bytes of a texel, or of a block
+	};
+
+	// A mip level in the file, rows of texels or blocks rowBytes apart with no padding
+	export struct TextureLevel
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t rows = 0;// Rows of blocks for block compressed formats
+		size_t rowBytes = 0;
+		size_t offset = 0;// From the start of the file
+		size_t size = 0;
+	};
+
+	export struct TextureHeader
+	{
+		CONTAINER container = CONTAINER::DDS;
+		SurfaceFormat format;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<TextureLevel> levels;// Level 0 first
+	};
+
+	namespace
+	{
+		// DXGI_FORMAT values
+		constexpr uint32_t DXGI_R32G32B32A32_FLOAT = 2;
+		constexpr uint32_t DXGI_R16G16B16A16_FLOAT = 10;
+		constexpr uint32_t DXGI_R8G8B8A8_UNORM = 28;
+		constexpr uint32_t DXGI_R8G8B8A8_UNORM_SRGB = 29;
+		constexpr uint32_t DXGI_R32_FLOAT = 41;
+		constexpr uint32_t DXGI_R8G8_UNORM = 49;
+		constexpr uint32_t DXGI_R8_UNORM = 61;
+		constexpr uint32_t DXGI_BC1_UNORM = 71;
+		constexpr uint32_t DXGI_BC1_UNORM_SRGB = 72;
+		constexpr uint32_t DXGI_BC3_UNORM = 77;
+		constexpr uint32_t DXGI_BC3_UNORM_SRGB = 78;
+		constexpr uint32_t DXGI_B8G8R8A8_UNORM = 87;
+		constexpr uint32_t DXGI_B8G8R8A8_UNORM_SRGB = 91;
+		constexpr uint32_t DXGI_BC7_UNORM = 98;
+		constexpr uint32_t DXGI_BC7_UNORM_SRGB = 99;
+
+		constexpr SurfaceFormat FORMATS[] = {
+			{ DXGI_R32G32B32A32_FLOAT, 1, 16 },
+			{ DXGI_R16G16B16A16_FLOAT, 1, 8 },
+			{ DXGI_R8G8B8A8_UNORM, 1, 4 },
+			{ DXGI_R8G8B8A8_UNORM_SRGB, 1, 4 },
+			{ DXGI_R32_FLOAT, 1, 4 },
+			{ DXGI_R8G8_UNORM, 1, 2 },
+			{ DXGI_R8_UNORM, 1, 1 },
+			{ DXGI_BC1_UNORM, 4, 8 },
+			{ DXGI_BC1_UNORM_SRGB, 4, 8 },
+			{ DXGI_BC3_UNORM, 4, 16 },
+			{ DXGI_BC3_UNORM_SRGB, 4, 16 },
+			{ DXGI_B8G8R8A8_UNORM, 1, 4 },
+			{ DXGI_B8G8R8A8_UNORM_SRGB, 1, 4 },
+			{ DXGI_BC7_UNORM, 4, 16 },
+			{ DXGI_BC7_UNORM_SRGB, 4, 16 },
+		};
+
+		// VkFormat values KTX2 stores, and their DXGI_FORMAT
+		constexpr std::pair<uint32_t, uint32_t> VK_FORMATS[] = {
+			{ 9, DXGI_R8_UNORM },
+			{ 16, DXGI_R8G8_UNORM },
+			{ 37, DXGI_R8G8B8A8_UNORM },
+			{ 43, DXGI_R8G8B8A8_UNORM_SRGB },
+			{ 44, DXGI_B8G8R8A8_UNORM },
+			{ 50, DXGI_B8G8R8A8_UNORM_SRGB },
+			{ 97, DXGI_R16G16B16A16_FLOAT },
+			{ 100, DXGI_R32_FLOAT },
+			{ 109, DXGI_R32G32B32A32_FLOAT },
+			{ 131, DXGI_BC1_UNORM },// BC1_RGB
+			{ 132, DXGI_BC1_UNORM_SRGB },
+			{ 133, DXGI_BC1_UNORM },// BC1_RGBA
+			{ 134, DXGI_BC1_UNORM_SRGB },
+			{ 137, DXGI_BC3_UNORM },
+			{ 138, DXGI_BC3_UNORM_SRGB },
+			{ 145, DXGI_BC7_UNORM },
+			{ 146, DXGI_BC7_UNORM_SRGB },
+		};
+
+		constexpr uint32_t DDS_MAGIC = 0x20534444;// "DDS "
+		constexpr uint32_t DDS_MIPMAPCOUNT = 0x20000;
+		constexpr uint32_t DDPF_ALPHAPIXELS = 0x1;
+		constexpr uint32_t DDPF_FOURCC = 0x4;
+		constexpr uint32_t DDPF_RGB = 0x40;
+		constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+		constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+		constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+		constexpr uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+		constexpr uint32_t fourCC(char a, char b, char c, char d)
+		{
+			return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+		}
+
+		struct DdsPixelFormat
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t fourCC;
+			uint32_t rgbBitCount;
+			uint32_t rMask;
+			uint32_t gMask;
+			uint32_t bMask;
+			uint32_t aMask;
+		};
+
+		struct DdsHeader
+		{
+			uint32_t size;
+			uint32_t flags;
+			uint32_t height;
+			uint32_t width;
+			uint32_t pitchOrLinearSize;
+			uint32_t depth;
+			uint32_t mipMapCount;
+			uint32_t reserved1[11];
+			DdsPixelFormat format;
+			uint32_t caps;
+			uint32_t caps2;
+			uint32_t caps3;
+			uint32_t caps4;
+			uint32_t reserved2;
+		};
+		static_assert(sizeof(DdsHeader) == 124);
+
+		struct DdsHeaderDx10
+		{
+			uint32_t dxgiFormat;
+			uint32_t resourceDimension;
+			uint32_t miscFlag;
+			uint32_t arraySize;
+			uint32_t miscFlags2;
+		};
+
+		constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+		struct Ktx2Header
+		{
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(Ktx2Header) == 80);
+
+		struct Ktx2Level
+		{
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		[[noreturn]] void invalid(const char* reason)
+		{
+			throw std::runtime_error(std::string("Invalid texture file: ") + reason);
+		}
+
+		template<class T>
+		T read(std::span<const std::byte> bytes, size_t offset)
+		{
+			if (offset > bytes.size() || bytes.size() - offset < sizeof(T))
+				invalid("truncated header");
+			T value;
+			std::memcpy(&value, bytes.data() + offset, sizeof(T));
+			return value;
+		}
+
+		SurfaceFormat surfaceFormat(uint32_t dxgiFormat)
+		{
+			const auto* found = std::find_if(std::begin(FORMATS), std::end(FORMATS), [&](const SurfaceFormat& f) { return f.dxgiFormat == dxgiFormat; });
+			if (found == std::end(FORMATS))
+				invalid("unsupported format");
+			return *found;
+		}
+
+		// The DXGI format of a DDS file without the DX10 header, from its FourCC or channel masks
+		uint32_t legacyDdsFormat(const DdsPixelFormat& format)
+		{
+			if (format.flags & DDPF_FOURCC)
+			{
+				switch (format.fourCC)
+				{
+				case fourCC('D', 'X', 'T', '1'):
+					return DXGI_BC1_UNORM;
+				case fourCC('D', 'X', 'T', '4'):
+				case fourCC('D', 'X', 'T', '5'):
+					return DXGI_BC3_UNORM;
+				}
+				invalid("unsupported FourCC");
+			}
+			if ((format.flags & DDPF_RGB) && format.rgbBitCount == 32)
+			{
+				const auto alpha = (format.flags & DDPF_ALPHAPIXELS) ? format.aMask : 0u;
+				if (format.rMask == 0xff && format.gMask == 0xff00 && format.bMask == 0xff0000 && (alpha == 0 || alpha == 0xff000000))
+					return DXGI_R8G8B8A8_UNORM;
+				if (format.rMask == 0xff0000 && format.gMask == 0xff00 && format.bMask == 0xff && (alpha == 0 || alpha == 0xff000000))
+					return DXGI_B8G8R8A8_UNORM;
+			}
+			invalid("unsupported pixel format");
+		}
+
+		uint32_t levelSize(uint32_t size, uint32_t level)
+		{
+			return std::max(1u, size >> level);
+		}
+
+		// Lays out count levels of a width x height texture from offset on, each right after the one before. Returns
+		// the offset past the last.
+		size_t packedLevels(TextureHeader& header, uint32_t count, size_t offset)
+		{
+			const auto& format = header.format;
+			for (uint32_t level = 0; level < count; ++level)
+			{
+				TextureLevel mip;
+				mip.width = levelSize(header.width, level);
+				mip.height = levelSize(header.height, level);
+				mip.rows = (mip.height + format.blockDimension - 1) / format.blockDimension;
+				mip.rowBytes = static_cast<size_t>((mip.width + format.blockDimension - 1) / format.blockDimension) * format.bytesPerBlock;
+				mip.offset = offset;
+				mip.size = mip.rowBytes * mip.rows;
+				offset += mip.size;
+				header.levels.push_back(mip);
+			}
+			return offset;
+		}
+
+		void checkSize(uint32_t width, uint32_t height, uint32_t levels)
+		{
+			// D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION, which also keeps every size computation far from overflowing
+			constexpr uint32_t MAX_DIMENSION = 16384;
+			if (width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION)
+				invalid("bad dimensions");
+			const auto fullChain = static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+			if (levels == 0 || levels > fullChain)
+				invalid("bad mip level count");
+		}
+
+		TextureHeader parseDds(std::span<const std::byte> bytes)
+		{
+			const auto header = read<DdsHeader>(bytes, 4);
+			if (header.size != sizeof(DdsHeader) || header.format.size != sizeof(DdsPixelFormat))
+				invalid("bad DDS header size");
+			if (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+				invalid("only 2D textures are supported");
+
+			TextureHeader result;
+			result.container = CONTAINER::DDS;
+			result.width = header.width;
+			result.height = header.height;
+			auto offset = 4 + sizeof(DdsHeader);
+			uint32_t dxgiFormat;
+			if ((header.format.flags & DDPF_FOURCC) && header.format.fourCC == fourCC('D', 'X', '1', '0'))
+			{
+				const auto dx10 = read<DdsHeaderDx10>(bytes, offset);
+				offset += sizeof(DdsHeaderDx10);
+				if (dx10.resourceDimension != DDS_DIMENSION_TEXTURE2D || (dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) || dx10.arraySize > 1)
+					invalid("only 2D textures are supported");
+				dxgiFormat = dx10.dxgiFormat;
+			}
+			else
+			{
+				dxgiFormat = legacyDdsFormat(header.format);
+			}
+			result.format = surfaceFormat(dxgiFormat);
+
+			const auto levels = (header.flags & DDS_MIPMAPCOUNT) ? std::max(header.mipMapCount, 1u) : 1u;
+			checkSize(header.width, header.height, levels);
+			if (packedLevels(result, levels, offset) > bytes.size())
+				invalid("levels run past the end of the file");
+			return result;
+		}
+
+		TextureHeader parseKtx2(std::span<const std::byte> bytes)
+		{
+			const auto header = read<Ktx2Header>(bytes, 0);
+			if (header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1)
+				invalid("only 2D textures are supported");
+			if (header.supercompressionScheme != 0)
+				invalid("supercompressed KTX2 is not supported");
+			const auto* vk = std::find_if(std::begin(VK_FORMATS), std::end(VK_FORMATS), [&](const auto& f) { return f.first == header.vkFormat; });
+			if (vk == std::end(VK_FORMATS))
+				invalid("unsupported format");
+
+			TextureHeader result;
+			result.container = CONTAINER::KTX2;
+			result.format = surfaceFormat(vk->second);
+			result.width = header.pixelWidth;
+			result.height = header.pixelHeight;
+			// A level count of 0 asks the loader to make the chain, the file only has the top level
+			const auto levels = std::max(header.levelCount, 1u);
+			checkSize(header.pixelWidth, header.pixelHeight, levels);
+
+			// The sizes are known, only the offsets come from the level index
+			packedLevels(result, levels, 0);
+			for (uint32_t level = 0; level < levels; ++level)
+			{
+				const auto index = read<Ktx2Level>(bytes, sizeof(Ktx2Header) + level * sizeof(Ktx2Level));
+				auto& mip = result.levels[level];
+				if (index.byteLength != mip.size || index.byteOffset > bytes.size() || bytes.size() - index.byteOffset < index.byteLength)
+					invalid("level does not match its size or runs past the end of the file");
+				mip.offset = static_cast<size_t>(index.byteOffset);
+			}
+			return result;
+		}
+	}
+
+	// Reads and checks the header of a DDS or KTX2 file held in bytes. Throws on anything the loader cannot use.
+	export TextureHeader parseTextureHeader(std::span<const std::byte> bytes)
+	{
+		if (bytes.size() >= sizeof(KTX2_IDENTIFIER) && std::memcmp(bytes.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+			return parseKtx2(bytes);
+		if (bytes.size() >= 4 && read<uint32_t>(bytes, 0) == DDS_MAGIC)
+			return parseDds(bytes);
+		invalid("not a DDS or KTX2 file");
+	}
+
+	// Copies rows [firstRow, firstRow + rows) of level from source to destination, rowPitch bytes apart like an upload
+	// footprint of the level. Rows that are already as far apart go in a single copy.
+	export void copyRows(std::span<const std::byte> source, const TextureLevel& level, uint32_t firstRow, uint32_t rows,
+		std::byte* destination, size_t rowPitch)
+	{
+		if (rowPitch < level.rowBytes)
+			throw std::runtime_error("Texture destination is smaller than its rows");
+		if (firstRow > level.rows || rows > level.rows - firstRow)
+			throw std::runtime_error("Texture rows are outside the level");
+		const auto* from = source.data() + level.offset + firstRow * level.rowBytes;
+		if (rowPitch == level.rowBytes)
+		{
+			std::memcpy(destination, from, rows * level.rowBytes);
+			return;
+		}
+		for (uint32_t row = 0; row < rows; ++row)
+		{
+			std::memcpy(destination + row * rowPitch, from + row * level.rowBytes, level.rowBytes);
+		}
+	}
+
+	export void copyLevel(std::span<const std::byte> source, const TextureLevel& level, std::byte* destination, size_t rowPitch)
+	{
+		copyRows(source, level, 0, level.rows, destination, rowPitch);
+	}
+
+	// A texture file mapped into memory with its header checked. The levels stay valid for as long as the file lives.
+	export class TextureFile
+	{
+	public:
+		// Throws when the file cannot be mapped or is not a texture the loader can use
+		explicit TextureFile(const std::filesystem::path& path) : m_file(path)
+		{
+			if (!m_file.IsOpen())
+				throw std::runtime_error("Texture file " + path.string() + " cannot be opened");
+			m_header = parseTextureHeader(m_file.Bytes());
+		}
+
+		const TextureHeader& Header() const
+		{
+			return m_header;
+		}
+
+		uint32_t LevelCount() const
+		{
+			return static_cast<uint32_t>(m_header.levels.size());
+		}
+
+		const TextureLevel& Level(uint32_t level) const
+		{
+			return m_header.levels[level];
+		}
+
+		std::span<const std::byte> LevelBytes(uint32_t level) const
+		{
+			const auto& mip = m_header.levels[level];
+			return m_file.Bytes().subspan(mip.offset, mip.size);
+		}
+
+		void CopyRows(uint32_t level, uint32_t firstRow, uint32_t rows, std::byte* destination, size_t rowPitch) const
+		{
+			copyRows(m_file.Bytes(), m_header.levels[level], firstRow, rows, destination, rowPitch);
+		}
+
+		void CopyLevel(uint32_t level, std::byte* destination, size_t rowPitch) const
+		{
+			copyLevel(m_file.Bytes(), m_header.levels[level], destination, rowPitch);
+		}
+
+	private:
+		Data::MappedFile m_file;
+		TextureHeader m_header;
+	};
+
+	// Rows of a level to copy in one go, the level is complete once the copy with last set has landed
+	export struct MipCopy
+	{
+		uint32_t level = 0;
+		uint32_t firstRow = 0;
+		uint32_t rows = 0;
+		bool last = false;
+	};
+
+	// Order and progress of streaming a texture's levels in, the coarsest first so there is something to sample after
+	// the first few kilobytes and every level that lands adds detail. Work is handed out by a byte budget, so a step
+	// can cover several small levels or part of a large one, and staging never has to hold a whole level at once. The
+	// levels resident are always a tail of the chain, MostDetailedMip is where it starts.
+	export class MipStream
+	{
+	public:
+		MipStream() = default;
+
+		// A row costs its bytes rounded up to pitchAlignment, what it takes in an upload footprint
+		MipStream(const TextureHeader& header, size_t pitchAlignment)
+		{
+			for (const auto& level : header.levels)
+			{
+				m_rows.push_back(level.rows);
+				m_rowCosts.push_back((level.rowBytes + pitchAlignment - 1) / pitchAlignment * pitchAlignment);
+			}
+			m_next = static_cast<uint32_t>(m_rows.size());
+			m_resident = m_next;
+		}
+
+		// Copies to make next, coarsest level first, as many rows as fit in budget bytes and always at least one while
+		// any are left
+		std::vector<MipCopy> Take(size_t budget)
+		{
+			std::vector<MipCopy> copies;
+			size_t taken = 0;
+			while (m_next > 0)
+			{
+				const auto level = m_next - 1;
+				const auto left = m_rows[level] - m_nextRow;
+				const auto affordable = budget > taken ? (budget - taken) / m_rowCosts[level] : 0;
+				const auto rows = static_cast<uint32_t>(std::min<size_t>(left, affordable));
+				if (rows == 0 && !copies.empty())
+					break;
+				const MipCopy copy{ .level = level, .firstRow = m_nextRow, .rows = std::max(rows, 1u), .last = std::max(rows, 1u) == left };
+				copies.push_back(copy);
+				taken += copy.rows * m_rowCosts[level];
+				m_nextRow += copy.rows;
+				if (!copy.last)
+					break;
+				m_next = level;
+				m_nextRow = 0;
+			}
+			return copies;
+		}
+
+		// copy has landed. Copies come back in the order Take gave them out.
+		void Complete(const MipCopy& copy)
+		{
+			if (!copy.last)
+				return;
+#ifdef _DEBUG
+			if (copy.level + 1 != m_resident)
+				throw std::runtime_error("Mip levels have to complete coarsest first");
+#endif
+			m_resident = copy.level;
+		}
+
+		// Finest level that can be sampled along with everything below it, LevelCount() while none can
+		uint32_t MostDetailedMip() const
+		{
+			return m_resident;
+		}
+
+		uint32_t LevelCount() const
+		{
+			return static_cast<uint32_t>(m_rows.size());
+		}
+
+		bool AllTaken() const
+		{
+			return m_next == 0;
+		}
+
+		bool AllResident() const
+		{
+			return m_resident == 0;
+		}
+
+	private:
+		std::vector<uint32_t> m_rows;
+		std::vector<size_t> m_rowCosts;
+		uint32_t m_next = 0;// Levels below it are taken
+		uint32_t m_nextRow = 0;// First row of level m_next - 1 not taken yet
+		uint32_t m_resident = 0;
+	};
+
+	// Writes a DDS file with the DX10 header holding a texture of dxgiFormat and its levels, level 0 first, each with
+	// rows as TextureLevel lays them out. The file is renamed into place once complete.
+	export bool writeDds(const std::filesystem::path& path, uint32_t dxgiFormat, uint32_t width, uint32_t height,
+		std::span<const std::span<const std::byte>> levels)
+	{
+		TextureHeader layout;
+		layout.format = surfaceFormat(dxgiFormat);
+		layout.width = width;
+		layout.height = height;
+		checkSize(width, height, static_cast<uint32_t>(levels.size()));
+		const auto dataOffset = 4 + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+		const auto end = packedLevels(layout, static_cast<uint32_t>(levels.size()), dataOffset);
+		for (size_t level = 0; level < levels.size(); ++level)
+		{
+			if (levels[level].size() != layout.levels[level].size)
+				throw std::runtime_error("Texture level is not the size its format and dimensions make");
+		}
+
+		DdsHeader header = {};
+		header.size = sizeof(DdsHeader);
+		// DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT, and the mip count
+		header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | DDS_MIPMAPCOUNT;
+		header.height = height;
+		header.width = width;
+		header.mipMapCount = static_cast<uint32_t>(levels.size());
+		header.format.size = sizeof(DdsPixelFormat);
+		header.format.flags = DDPF_FOURCC;
+		header.format.fourCC = fourCC('D', 'X', '1', '0');
+		header.caps = 0x1000 | (levels.size() > 1 ? 0x400008u : 0u);// DDSCAPS_TEXTURE, DDSCAPS_MIPMAP | DDSCAPS_COMPLEX
+		const DdsHeaderDx10 dx10 = { .dxgiFormat = dxgiFormat, .resourceDimension = DDS_DIMENSION_TEXTURE2D, .miscFlag = 0, .arraySize = 1, .miscFlags2 = 0 };
+
+		std::vector<std::byte> file(end);
+		std::memcpy(file.data(), &DDS_MAGIC, 4);
+		std::memcpy(file.data() + 4, &header, sizeof(header));
+		std::memcpy(file.data() + 4 + sizeof(header), &dx10, sizeof(dx10));
+		for (size_t level = 0; level < levels.size(); ++level)
+		{
+			std::memcpy(file.data() + layout.levels[level].offset, levels[level].data(), levels[level].size());
+		}
+		return Data::writeFile(path, file);
+	}
+}
@@ -0,0 +1,592 @@
+module;
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#if defined(_M_X64) || defined(__x86_64__)
+#define LS_TEXEL_X86 1
+#include <immintrin.h>
+#endif
+// MSVC emits any intrinsic on request, GCC and Clang need the target enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define LS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LS_TARGET_AVX2
+#endif
+export module TextureFormat;
+
+import BoxKernels;
+
+// Texel formats the CPU side of the texture path reads and writes, and the conversions between them and linear float
+// rows. Rows are kept as one float array per channel, so the kernels that work on them and the packing below handle
+// runs of texels rather than one texel at a time. 8 bit formats pack with SSE or AVX2, picked through the same SIMD
+// level as the BoxKernels.
+namespace LS
+{
+	// Named and laid out like their DXGI_FORMAT counterparts
+	export enum class TEXEL_FORMAT : uint32_t
+	{
+		R8_UNORM,
+		R8G8_UNORM,
+		R8G8B8A8_UNORM,
+		R8G8B8A8_UNORM_SRGB,
+		B8G8R8A8_UNORM,
+		B8G8R8A8_UNORM_SRGB,
+		R16G16B16A16_FLOAT,
+		R32_FLOAT,
+		R32G32B32A32_FLOAT
+	};
+
+	export uint32_t texelSize(TEXEL_FORMAT format)
+	{
+		switch (format)
+		{
+		case TEXEL_FORMAT::R8_UNORM:
+			return 1;
+		case TEXEL_FORMAT::R8G8_UNORM:
+			return 2;
+		case TEXEL_FORMAT::R8G8B8A8_UNORM:
+		case TEXEL_FORMAT::R8G8B8A8_UNORM_SRGB:
+		case TEXEL_FORMAT::B8G8R8A8_UNORM:
+		case TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB:
+		case TEXEL_FORMAT::R32_FLOAT:
+			return 4;
+		case TEXEL_FORMAT::R16G16B16A16_FLOAT:
+			return 8;
+		case TEXEL_FORMAT::R32G32B32A32_FLOAT:
+			return 16;
+		}
+		throw std::runtime_error("Unknown texel format");
+	}
+
+	// Formats whose colour channels are stored sRGB encoded, alpha is always linear
+	export bool isSrgb(TEXEL_FORMAT format)
+	{
+		return format == TEXEL_FORMAT::R8G8B8A8_UNORM_SRGB || format == TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB;
+	}
+
+	// Where a texture's texels go, or come from: width x height texels of format, rows rowPitch bytes apart. The
+	// pitch can be larger than a row, like the D3D12_TEXTURE_DATA_PITCH_ALIGNMENT aligned rows of an upload buffer.
+	export struct TextureData
+	{
+		std::byte* data = nullptr;
+		size_t rowPitch = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		TEXEL_FORMAT format = TEXEL_FORMAT::R8G8B8A8_UNORM;
+
+		std::byte* Row(uint32_t y) const
+		{
+			return data + y * rowPitch;
+		}
+	};
+
+	// A row of linear colours, one array per channel
+	export struct LinearRow
+	{
+		std::vector<float> r;
+		std::vector<float> g;
+		std::vector<float> b;
+		std::vector<float> a;
+
+		void Resize(uint32_t width)
+		{
+			r.resize(width);
+			g.resize(width);
+			b.resize(width);
+			a.resize(width);
+		}
+
+		uint32_t Width() const
+		{
+			return static_cast<uint32_t>(r.size());
+		}
+	};
+
+	export float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	export float linearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// Round to nearest even, overflow goes to infinity and NaN stays NaN
+	export uint16_t floatToHalf(float value)
+	{
+		const auto bits = std::bit_cast<uint32_t>(value);
+		const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		const auto exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+		auto mantissa = bits & 0x7fffff;
+		if (exponent == 0xff)
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+		const auto halfExponent = exponent - 127 + 15;
+		if (halfExponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7c00);
+		if (halfExponent <= 0)
+		{
+			// Denormal or zero in half precision
+			if (halfExponent < -10)
+				return sign;
+			mantissa |= 0x800000;
+			const auto shift = static_cast<uint32_t>(14 - halfExponent);
+			auto half = mantissa >> shift;
+			const auto remainder = mantissa & ((1u << shift) - 1);
+			const auto halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+			{
+				++half;
+			}
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		// A carry out of the mantissa moves into the exponent, which is the right result up to infinity
+		auto half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+		const auto remainder = mantissa & 0x1fff;
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0))
+		{
+			++half;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	export float halfToFloat(uint16_t half)
+	{
+		const auto sign = static_cast<uint32_t>(half & 0x8000) << 16;
+		const auto exponent = static_cast<uint32_t>(half >> 10) & 0x1f;
+		const auto mantissa = static_cast<uint32_t>(half) & 0x3ff;
+		if (exponent == 0x1f)
+			return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+		if (exponent == 0)
+		{
+			// Zero or denormal, both exact in single precision
+			const auto magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+			return sign != 0 ? -magnitude : magnitude;
+		}
+		return std::bit_cast<float>(sign | ((exponent + 127 - 15) << 23) | (mantissa << 13));
+	}
+
+	namespace
+	{
+		// Linear values are quantized to this many steps before the table lookup, fine enough that the result is
+		// within one code of the exact encoding everywhere
+		constexpr uint32_t SRGB_TABLE_SIZE = 1u << 14;
+
+		const std::array<uint8_t, SRGB_TABLE_SIZE>& srgbEncodeTable()
+		{
+			static const auto table = []()
+				{
+					std::array<uint8_t, SRGB_TABLE_SIZE> t = {};
+					for (uint32_t i = 0; i < SRGB_TABLE_SIZE; ++i)
+					{
+						const auto linear = static_cast<float>(i) / static_cast<float>(SRGB_TABLE_SIZE - 1);
+						t[i] = static_cast<uint8_t>(std::lrint(linearToSrgb(linear) * 255.0f));
+					}
+					return t;
+				}();
+			return table;
+		}
+
+		const std::array<float, 256>& srgbDecodeTable()
+		{
+			static const auto table = []()
+				{
+					std::array<float, 256> t = {};
+					for (uint32_t i = 0; i < 256; ++i)
+					{
+						t[i] = srgbToLinear(static_cast<float>(i) / 255.0f);
+					}
+					return t;
+				}();
+			return table;
+		}
+
+		// NaN clamps to 0 like the SSE max does. Two selects rather than nested ones, so it compiles to max and min.
+		float saturate(float value)
+		{
+			value = value > 0.0f ? value : 0.0f;
+			return value < 1.0f ? value : 1.0f;
+		}
+
+		// Rounds half up, the same way the SIMD paths do
+		uint8_t unorm8(float value)
+		{
+			return static_cast<uint8_t>(saturate(value) * 255.0f + 0.5f);
+		}
+
+		uint8_t srgb8(float value, const uint8_t* table)
+		{
+			return table[static_cast<uint32_t>(saturate(value) * static_cast<float>(SRGB_TABLE_SIZE - 1) + 0.5f)];
+		}
+
+		// Four 8 bit channels, c0 to c3 in memory order, from begin to the end of the row
+		void pack8888Scalar(const float* c0, const float* c1, const float* c2, const float* c3, uint32_t begin, uint32_t end,
+			uint8_t* out)
+		{
+			for (auto x = begin; x < end; ++x)
+			{
+				out[x * 4 + 0] = unorm8(c0[x]);
+				out[x * 4 + 1] = unorm8(c1[x]);
+				out[x * 4 + 2] = unorm8(c2[x]);
+				out[x * 4 + 3] = unorm8(c3[x]);
+			}
+		}
+
+		void pack8888SrgbScalar(const float* c0, const float* c1, const float* c2, const float* alpha, uint32_t begin,
+			uint32_t end, uint8_t* out)
+		{
+			const auto* table = srgbEncodeTable().data();
+			for (auto x = begin; x < end; ++x)
+			{
+				out[x * 4 + 0] = srgb8(c0[x], table);
+				out[x * 4 + 1] = srgb8(c1[x], table);
+				out[x * 4 + 2] = srgb8(c2[x], table);
+				out[x * 4 + 3] = unorm8(alpha[x]);
+			}
+		}
+
+		void packHalfScalar(const float* r, const float* g, const float* b, const float* a, uint32_t begin, uint32_t end, uint8_t* out)
+		{
+			for (auto x = begin; x < end; ++x)
+			{
+				const uint16_t texel[4] = { floatToHalf(r[x]), floatToHalf(g[x]), floatToHalf(b[x]), floatToHalf(a[x]) };
+				std::memcpy(out + x * sizeof(texel), texel, sizeof(texel));
+			}
+		}
+
+#if LS_TEXEL_X86
+		void pack8888Sse(const float* c0, const float* c1, const float* c2, const float* c3, uint32_t width, uint8_t* out)
+		{
+			const auto zero = _mm_setzero_ps();
+			const auto one = _mm_set1_ps(1.0f);
+			const auto scale = _mm_set1_ps(255.0f);
+			const auto half = _mm_set1_ps(0.5f);
+			const auto quantize = [&](const float* c, uint32_t x)
+				{
+					return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(c + x), zero), one), scale), half));
+				};
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				const auto texels = _mm_or_si128(
+					_mm_or_si128(quantize(c0, x), _mm_slli_epi32(quantize(c1, x), 8)),
+					_mm_or_si128(_mm_slli_epi32(quantize(c2, x), 16), _mm_slli_epi32(quantize(c3, x), 24)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), texels);
+			}
+			pack8888Scalar(c0, c1, c2, c3, x, width, out);
+		}
+
+		LS_TARGET_AVX2 void pack8888Avx2(const float* c0, const float* c1, const float* c2, const float* c3, uint32_t width, uint8_t* out)
+		{
+			const auto zero = _mm256_setzero_ps();
+			const auto one = _mm256_set1_ps(1.0f);
+			const auto scale = _mm256_set1_ps(255.0f);
+			const auto half = _mm256_set1_ps(0.5f);
+			const auto quantize = [&](const float* c, uint32_t x) LS_TARGET_AVX2
+				{
+					return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(c + x), zero), one), scale), half));
+				};
+			uint32_t x = 0;
+			for (; x + 8 <= width; x += 8)
+			{
+				const auto texels = _mm256_or_si256(
+					_mm256_or_si256(quantize(c0, x), _mm256_slli_epi32(quantize(c1, x), 8)),
+					_mm256_or_si256(_mm256_slli_epi32(quantize(c2, x), 16), _mm256_slli_epi32(quantize(c3, x), 24)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), texels);
+			}
+			pack8888Scalar(c0, c1, c2, c3, x, width, out);
+		}
+
+		// The encode is a table lookup either way, SSE does the clamping and scaling into table indices
+		void pack8888SrgbSse(const float* c0, const float* c1, const float* c2, const float* alpha, uint32_t width, uint8_t* out)
+		{
+			const auto* table = srgbEncodeTable().data();
+			const auto zero = _mm_setzero_ps();
+			const auto one = _mm_set1_ps(1.0f);
+			const auto half = _mm_set1_ps(0.5f);
+			const auto quantize = [&](const float* c, uint32_t x, float scale)
+				{
+					return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(c + x), zero), one), _mm_set1_ps(scale)), half));
+				};
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				alignas(16) uint32_t indices[3][4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices[0]), quantize(c0, x, static_cast<float>(SRGB_TABLE_SIZE - 1)));
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices[1]), quantize(c1, x, static_cast<float>(SRGB_TABLE_SIZE - 1)));
+				_mm_store_si128(reinterpret_cast<__m128i*>(indices[2]), quantize(c2, x, static_cast<float>(SRGB_TABLE_SIZE - 1)));
+				alignas(16) uint32_t texels[4];
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					texels[i] = table[indices[0][i]] | table[indices[1][i]] << 8 | table[indices[2][i]] << 16;
+				}
+				const auto alphas = _mm_slli_epi32(quantize(alpha, x, 255.0f), 24);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4),
+					_mm_or_si128(_mm_load_si128(reinterpret_cast<const __m128i*>(texels)), alphas));
+			}
+			pack8888SrgbScalar(c0, c1, c2, alpha, x, width, out);
+		}
+
+		// floatToHalf four at a time, branches turned into selects. Each lane's half is in its low 16 bits.
+		__m128i halvesSse(__m128 values)
+		{
+			constexpr uint32_t DENORMAL_MAGIC = ((127 - 15) + (23 - 10) + 1) << 23;
+			const auto bits = _mm_castps_si128(values);
+			const auto sign = _mm_and_si128(bits, _mm_set1_epi32(static_cast<int>(0x80000000u)));
+			const auto magnitude = _mm_xor_si128(bits, sign);
+
+			// Too large for a half, or infinity or NaN
+			const auto overflow = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(((127 + 16) << 23) - 1));
+			const auto nan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(255 << 23));
+			const auto special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(nan, _mm_set1_epi32(0x200)));
+
+			// Adding the magic number lets the FPU do the rounding shift into the denormal's mantissa
+			const auto magic = _mm_set1_epi32(DENORMAL_MAGIC);
+			const auto denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), _mm_castsi128_ps(magic))), magic);
+			const auto isDenormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23));
+
+			// Rebias the exponent and round to nearest even on the dropped 13 bits
+			const auto odd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+			const auto rebiased = _mm_add_epi32(magnitude, _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(15 - 127) << 23) + 0xfff)));
+			const auto normal = _mm_srli_epi32(_mm_add_epi32(rebiased, odd), 13);
+
+			auto result = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+			result = _mm_or_si128(_mm_and_si128(overflow, special), _mm_andnot_si128(overflow, result));
+			return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+		}
+
+		void packHalfSse(const float* r, const float* g, const float* b, const float* a, uint32_t width, uint8_t* out)
+		{
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				const auto rg = _mm_or_si128(halvesSse(_mm_loadu_ps(r + x)), _mm_slli_epi32(halvesSse(_mm_loadu_ps(g + x)), 16));
+				const auto ba = _mm_or_si128(halvesSse(_mm_loadu_ps(b + x)), _mm_slli_epi32(halvesSse(_mm_loadu_ps(a + x)), 16));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 8), _mm_unpacklo_epi32(rg, ba));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 8 + 16), _mm_unpackhi_epi32(rg, ba));
+			}
+			packHalfScalar(r, g, b, a, x, width, out);
+		}
+#endif
+
+		// Four 8 bit channels in memory order to c0 to c3, from begin to the end of the row
+		void unpack8888Scalar(const uint8_t* in, uint32_t begin, uint32_t end, float* c0, float* c1, float* c2, float* c3)
+		{
+			for (auto x = begin; x < end; ++x)
+			{
+				c0[x] = static_cast<float>(in[x * 4 + 0]) * (1.0f / 255.0f);
+				c1[x] = static_cast<float>(in[x * 4 + 1]) * (1.0f / 255.0f);
+				c2[x] = static_cast<float>(in[x * 4 + 2]) * (1.0f / 255.0f);
+				c3[x] = static_cast<float>(in[x * 4 + 3]) * (1.0f / 255.0f);
+			}
+		}
+
+#if LS_TEXEL_X86
+		void unpack8888Sse(const uint8_t* in, uint32_t width, float* c0, float* c1, float* c2, float* c3)
+		{
+			const auto mask = _mm_set1_epi32(0xff);
+			const auto scale = _mm_set1_ps(1.0f / 255.0f);
+			const auto channel = [&](__m128i texels, int shift)
+				{
+					return _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(texels, shift), mask)), scale);
+				};
+			uint32_t x = 0;
+			for (; x + 4 <= width; x += 4)
+			{
+				const auto texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 4));
+				_mm_storeu_ps(c0 + x, channel(texels, 0));
+				_mm_storeu_ps(c1 + x, channel(texels, 8));
+				_mm_storeu_ps(c2 + x, channel(texels, 16));
+				_mm_storeu_ps(c3 + x, channel(texels, 24));
+			}
+			unpack8888Scalar(in, x, width, c0, c1, c2, c3);
+		}
+#endif
+
+		void unpack8888(const uint8_t* in, uint32_t width, float* c0, float* c1, float* c2, float* c3)
+		{
+#if LS_TEXEL_X86
+			if (Data::simdLevel() != Data::SIMD_LEVEL::SCALAR)
+				return unpack8888Sse(in, width, c0, c1, c2, c3);
+#endif
+			unpack8888Scalar(in, 0, width, c0, c1, c2, c3);
+		}
+
+		void unpack8888Srgb(const uint8_t* in, uint32_t width, float* c0, float* c1, float* c2, float* alpha)
+		{
+			const auto* table = srgbDecodeTable().data();
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				c0[x] = table[in[x * 4 + 0]];
+				c1[x] = table[in[x * 4 + 1]];
+				c2[x] = table[in[x * 4 + 2]];
+				alpha[x] = static_cast<float>(in[x * 4 + 3]) * (1.0f / 255.0f);
+			}
+		}
+
+		void pack8888(const float* c0, const float* c1, const float* c2, const float* c3, uint32_t width, uint8_t* out)
+		{
+#if LS_TEXEL_X86
+			const auto level = Data::simdLevel();
+			if (level == Data::SIMD_LEVEL::AVX2)
+				return pack8888Avx2(c0, c1, c2, c3, width, out);
+			if (level == Data::SIMD_LEVEL::SSE)
+				return pack8888Sse(c0, c1, c2, c3, width, out);
+#endif
+			pack8888Scalar(c0, c1, c2, c3, 0, width, out);
+		}
+
+		// The table lookups do not get faster with wider vectors, AVX2 uses the SSE path
+		void pack8888Srgb(const float* c0, const float* c1, const float* c2, const float* alpha, uint32_t width, uint8_t* out)
+		{
+#if LS_TEXEL_X86
+			if (Data::simdLevel() != Data::SIMD_LEVEL::SCALAR)
+				return pack8888SrgbSse(c0, c1, c2, alpha, width, out);
+#endif
+			pack8888SrgbScalar(c0, c1, c2, alpha, 0, width, out);
+		}
+
+		void packHalf(const float* r, const float* g, const float* b, const float* a, uint32_t width, uint8_t* out)
+		{
+#if LS_TEXEL_X86
+			if (Data::simdLevel() != Data::SIMD_LEVEL::SCALAR)
+				return packHalfSse(r, g, b, a, width, out);
+#endif
+			packHalfScalar(r, g, b, a, 0, width, out);
+		}
+	}
+
+	// Converts row into format at out, which has to hold row.Width() texels. Values are clamped to [0, 1] for the
+	// UNORM formats and sRGB encoded for the sRGB ones, float formats store them as they are.
+	export void packRow(const LinearRow& row, TEXEL_FORMAT format, std::byte* out)
+	{
+		const auto width = row.Width();
+		auto* bytes = reinterpret_cast<uint8_t*>(out);
+		const auto* r = row.r.data();
+		const auto* g = row.g.data();
+		const auto* b = row.b.data();
+		const auto* a = row.a.data();
+		switch (format)
+		{
+		case TEXEL_FORMAT::R8_UNORM:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				bytes[x] = unorm8(r[x]);
+			}
+			break;
+		case TEXEL_FORMAT::R8G8_UNORM:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				bytes[x * 2 + 0] = unorm8(r[x]);
+				bytes[x * 2 + 1] = unorm8(g[x]);
+			}
+			break;
+		case TEXEL_FORMAT::R8G8B8A8_UNORM:
+			pack8888(r, g, b, a, width, bytes);
+			break;
+		case TEXEL_FORMAT::B8G8R8A8_UNORM:
+			pack8888(b, g, r, a, width, bytes);
+			break;
+		case TEXEL_FORMAT::R8G8B8A8_UNORM_SRGB:
+			pack8888Srgb(r, g, b, a, width, bytes);
+			break;
+		case TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB:
+			pack8888Srgb(b, g, r, a, width, bytes);
+			break;
+		case TEXEL_FORMAT::R16G16B16A16_FLOAT:
+			packHalf(r, g, b, a, width, bytes);
+			break;
+		case TEXEL_FORMAT::R32_FLOAT:
+			std::memcpy(bytes, r, width * sizeof(float));
+			break;
+		case TEXEL_FORMAT::R32G32B32A32_FLOAT:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float texel[4] = { r[x], g[x], b[x], a[x] };
+				std::memcpy(bytes + x * sizeof(texel), texel, sizeof(texel));
+			}
+			break;
+		}
+	}
+
+	// Converts width texels of format at in into row, which is resized to fit. Channels the format does not have
+	// read as 0, and alpha as 1.
+	export void unpackRow(const std::byte* in, TEXEL_FORMAT format, uint32_t width, LinearRow& row)
+	{
+		row.Resize(width);
+		const auto* bytes = reinterpret_cast<const uint8_t*>(in);
+		auto* r = row.r.data();
+		auto* g = row.g.data();
+		auto* b = row.b.data();
+		auto* a = row.a.data();
+		switch (format)
+		{
+		case TEXEL_FORMAT::R8_UNORM:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				r[x] = static_cast<float>(bytes[x]) * (1.0f / 255.0f);
+			}
+			std::fill(g, g + width, 0.0f);
+			std::fill(b, b + width, 0.0f);
+			std::fill(a, a + width, 1.0f);
+			break;
+		case TEXEL_FORMAT::R8G8_UNORM:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				r[x] = static_cast<float>(bytes[x * 2 + 0]) * (1.0f / 255.0f);
+				g[x] = static_cast<float>(bytes[x * 2 + 1]) * (1.0f / 255.0f);
+			}
+			std::fill(b, b + width, 0.0f);
+			std::fill(a, a + width, 1.0f);
+			break;
+		case TEXEL_FORMAT::R8G8B8A8_UNORM:
+			unpack8888(bytes, width, r, g, b, a);
+			break;
+		case TEXEL_FORMAT::B8G8R8A8_UNORM:
+			unpack8888(bytes, width, b, g, r, a);
+			break;
+		case TEXEL_FORMAT::R8G8B8A8_UNORM_SRGB:
+			unpack8888Srgb(bytes, width, r, g, b, a);
+			break;
+		case TEXEL_FORMAT::B8G8R8A8_UNORM_SRGB:
+			unpack8888Srgb(bytes, width, b, g, r, a);
+			break;
+		case TEXEL_FORMAT::R16G16B16A16_FLOAT:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				uint16_t texel[4];
+				std::memcpy(texel, bytes + x * sizeof(texel), sizeof(texel));
+				r[x] = halfToFloat(texel[0]);
+				g[x] = halfToFloat(texel[1]);
+				b[x] = halfToFloat(texel[2]);
+				a[x] = halfToFloat(texel[3]);
+			}
+			break;
+		case TEXEL_FORMAT::R32_FLOAT:
+			std::memcpy(r, bytes, width * sizeof(float));
+			std::fill(g, g + width, 0.0f);
+			std::fill(b, b + width, 0.0f);
+			std::fill(a, a + width, 1.0f);
+			break;
+		case TEXEL_FORMAT::R32G32B32A32_FLOAT:
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				float texel[4];
+				std::memcpy(texel, bytes + x * sizeof(texel), sizeof(texel));
+				r[x] = texel[0];
+				g[x] = texel[1];
+				b[x] = texel[2];
+				a[x] = texel[3];
+			}
+			break;
+		}
+	}
+}
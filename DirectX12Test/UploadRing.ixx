@@ -0,0 +1,167 @@
+module;
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <algorithm>
+export module UploadRing;
+
+namespace LS
+{
+	export struct UploadRingStats
+	{
+		uint64_t allocations = 0;
+		uint64_t failedAllocations = 0;// Did not fit until more of the ring was reclaimed
+		uint64_t wraps = 0;
+		uint64_t allocatedBytes = 0;// Requested sizes, without alignment or wrap padding
+	};
+
+	// Sub-allocator for a staging buffer of fixed capacity that is used front to back and wraps around. Allocations
+	// hand out offsets only, so the same logic serves a mapped upload heap or plain memory. Everything allocated
+	// between two Close calls belongs to one batch, tagged with the fence value that is signalled once the copies
+	// reading it have executed; Reclaim releases every batch whose fence value the GPU has reached, oldest first.
+	export class UploadRing
+	{
+	public:
+		explicit UploadRing(uint64_t capacity = 0) : m_capacity(capacity)
+		{
+		}
+
+		// Offset of size bytes aligned to alignment (a power of two), or nothing when the free part of the ring
+		// is too small right now
+		std::optional<uint64_t> Allocate(uint64_t size, uint64_t alignment = 1)
+		{
+			if (size == 0 || size > m_capacity)
+			{
+				++m_stats.failedAllocations;
+				return std::nullopt;
+			}
+
+			// Nothing in flight, start over from the front so large requests see the whole ring
+			if (m_used == 0)
+			{
+				m_head = 0;
+				m_tail = 0;
+			}
+
+			auto offset = alignUp(m_head, alignment);
+			uint64_t consumed = 0;
+			// head == tail with anything in use means the ring is full
+			if (m_head > m_tail || m_used == 0)
+			{
+				// In use is [tail, head), free is [head, capacity) and [0, tail)
+				if (offset + size <= m_capacity)
+				{
+					consumed = offset + size - m_head;
+				}
+				else if (size <= m_tail)
+				{
+					// The end of the ring is too short, skip it and continue at the front
+					offset = 0;
+					consumed = m_capacity - m_head + size;
+					++m_stats.wraps;
+				}
+				else
+				{
+					++m_stats.failedAllocations;
+					return std::nullopt;
+				}
+			}
+			else if (offset + size <= m_tail)
+			{
+				// Wrapped, free is [head, tail)
+				consumed = offset + size - m_head;
+			}
+			else
+			{
+				++m_stats.failedAllocations;
+				return std::nullopt;
+			}
+
+			m_head = offset + size;
+			m_used += consumed;
+			m_openBytes += consumed;
+			m_highWaterMark = std::max(m_highWaterMark, m_used);
+			++m_stats.allocations;
+			m_stats.allocatedBytes += size;
+			return offset;
+		}
+
+		// Ends the current batch, its memory is released once the fence reaches fenceValue
+		void Close(uint64_t fenceValue)
+		{
+			if (m_openBytes == 0)
+				return;
+
+			m_batches.emplace_back(Batch{ .fenceValue = fenceValue, .end = m_head, .bytes = m_openBytes });
+			m_openBytes = 0;
+		}
+
+		// Releases the batches whose fence value has been reached
+		void Reclaim(uint64_t completedValue)
+		{
+			while (!m_batches.empty() && m_batches.front().fenceValue <= completedValue)
+			{
+				m_tail = m_batches.front().end;
+				m_used -= m_batches.front().bytes;
+				m_batches.pop_front();
+			}
+		}
+
+		// Fence value to wait for before the oldest batch can be reclaimed
+		std::optional<uint64_t> OldestFenceValue() const
+		{
+			if (m_batches.empty())
+				return std::nullopt;
+			return m_batches.front().fenceValue;
+		}
+
+		uint64_t Capacity() const
+		{
+			return m_capacity;
+		}
+
+		// Bytes allocated and not reclaimed yet, including alignment and wrap padding
+		uint64_t Used() const
+		{
+			return m_used;
+		}
+
+		// Most bytes ever in use at once, what the ring needs to be sized to for this workload
+		uint64_t HighWaterMark() const
+		{
+			return m_highWaterMark;
+		}
+
+		uint32_t PendingBatches() const
+		{
+			return static_cast<uint32_t>(m_batches.size());
+		}
+
+		const UploadRingStats& Stats() const
+		{
+			return m_stats;
+		}
+
+	private:
+		struct Batch
+		{
+			uint64_t fenceValue;
+			uint64_t end;// Head once the batch was closed, the tail after it is reclaimed
+			uint64_t bytes;
+		};
+
+		uint64_t m_capacity;
+		uint64_t m_head = 0;
+		uint64_t m_tail = 0;
+		uint64_t m_used = 0;
+		uint64_t m_openBytes = 0;// Allocated since the last Close
+		uint64_t m_highWaterMark = 0;
+		std::deque<Batch> m_batches;
+		UploadRingStats m_stats;
+
+		static uint64_t alignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	};
+}
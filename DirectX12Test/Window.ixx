@@ -17,6 +17,8 @@ module;
 #include <dwrite_3.h>
 #include <d2d1.h>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
 #pragma comment(lib, "d2d1")
 #pragma comment(lib, "Dwrite")
 
@@ -30,6 +32,7 @@ module;
 
 export module Window;
 import UI;
+import BoxGrid;
 export import DX12Device;
 
 namespace Application
@@ -44,6 +47,13 @@ namespace Application
 		}
 	}
 
+	// What the last onPaint2D submitted: texts and widgets intersecting the client area were drawn, the rest culled
+	export struct PaintStats
+	{
+		uint32_t drawn = 0;
+		uint32_t culled = 0;
+	};
+
 	export class LSWindow
 	{
 	public:
@@ -257,6 +267,8 @@ namespace Application
 			}
 			case(WM_MOUSELEAVE):
 			{
+				m_bIsTrackingMouse = false;
+				setHovered(NO_HIT);
 				break;
 			}
 			}
@@ -282,6 +294,8 @@ namespace Application
 		void addText(const UI::LSText& text)
 		{
 			m_texts.emplace_back(text);
+			const auto key = static_cast<uint32_t>(m_texts.size() - 1);
+			m_hitIndex.Insert(key, Data::toBox(m_texts.back().m_bounds));
 		}
 		
 		void addWidget(UI::Widget* widget)
@@ -289,6 +303,26 @@ namespace Application
 			if (!widget)
 				return;
 			m_widgets.emplace_back(widget);
+			const auto key = WIDGET_BIT | static_cast<uint32_t>(m_widgets.size() - 1);
+			m_widgetHandles[widget] = m_hitIndex.Insert(key, Data::toBox(widget->m_bounds));
+		}
+
+		// Call after changing a widget's m_bounds so hit testing sees the new bounds
+		void updateWidget(UI::Widget* widget)
+		{
+			const auto it = m_widgetHandles.find(widget);
+			if (it == m_widgetHandles.end())
+				return;
+
+			m_hitIndex.Move(it->second, Data::toBox(widget->m_bounds));
+			// The widget may have moved under or away from a cursor that stands still
+			setHovered(hitTest(m_mousePoint.x, m_mousePoint.y));
+		}
+
+		// Topmost widget or text under the point (in DIPs), nullptr when there is none
+		UI::Widget* widgetAt(float dipPixelX, float dipPixelY)
+		{
+			return resolve(hitTest(dipPixelX, dipPixelY));
 		}
 
 		void onPaint2D()
@@ -302,16 +336,24 @@ namespace Application
 			m_pRenderTarget->BeginDraw();
 			m_pRenderTarget->Clear(D2D1::ColorF(D2D1::ColorF::SkyBlue));
 
-			for (auto&& text : m_texts)
-			{
-				text.Render(m_pRenderTarget.Get());
-			}
+			// Cull against the client area through the hit index, then draw the survivors in the order they were added
+			RECT rc;
+			GetClientRect(m_hwnd, &rc);
+			const auto view = Data::Box{ .minPoint = { PixelToDipsX(rc.left), PixelToDipsY(rc.top) },
+				.maxPoint = { PixelToDipsX(rc.right), PixelToDipsY(rc.bottom) } };
+			m_visible.clear();
+			m_hitIndex.Query(view, [this](Data::Handle h) { m_visible.emplace_back(m_hitIndex.Get(h)); });
+			std::sort(m_visible.begin(), m_visible.end());
 
-			for (auto&& widget : m_widgets)
+			for (auto key : m_visible)
 			{
-				widget->Render(m_pRenderTarget.Get());
+				resolve(key)->Render(m_pRenderTarget.Get());
 			}
 
+			const auto total = static_cast<uint32_t>(m_texts.size() + m_widgets.size());
+			m_paintStats = PaintStats{ .drawn = static_cast<uint32_t>(m_visible.size()),
+				.culled = total - static_cast<uint32_t>(m_visible.size()) };
+
 			hr = m_pRenderTarget->EndDraw();
 
 			if (FAILED(hr) || hr == D2DERR_RECREATE_TARGET)
@@ -388,6 +430,11 @@ namespace Application
 			return m_hwnd;
 		}
 
+		const PaintStats& paintStats() const
+		{
+			return m_paintStats;
+		}
+
 	private:
 		uint32_t	m_width;
 		uint32_t	m_height;
@@ -417,6 +464,20 @@ namespace Application
 		std::vector<UI::LSText> m_texts;
 		std::vector<UI::Widget*> m_widgets;
 		LS::LSDevice m_device3d;
+
+		// Hit testing. Texts and widgets are indexed by their bounds under a key that orders them the way they are
+		// drawn: texts by index first, then widgets (WIDGET_BIT set) by index, so the largest key is the topmost.
+		static constexpr uint32_t WIDGET_BIT = 0x80000000;
+		static constexpr uint32_t NO_HIT = UINT32_MAX;
+		static constexpr float HIT_CELL_SIZE = 64.0f;
+		Data::BoxGrid<uint32_t> m_hitIndex{ HIT_CELL_SIZE };
+		std::unordered_map<UI::Widget*, Data::Handle> m_widgetHandles;
+		uint32_t m_hovered = NO_HIT;
+		// Keys of the texts and widgets drawn by the current frame, reused between frames
+		std::vector<uint32_t> m_visible;
+		PaintStats m_paintStats;
+		bool m_bIsTrackingMouse = false;
+
 		void createD2D()
 		{
 			auto hr = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, m_pFactory.ReleaseAndGetAddressOf());
@@ -508,12 +569,68 @@ namespace Application
 		{
 			m_mousePoint = { dipPixelX, dipPixelY };
 
+			// Ask for WM_MOUSELEAVE so the hovered widget gets its exit when the cursor leaves the window
+			if (!m_bIsTrackingMouse)
+			{
+				TRACKMOUSEEVENT tme{ .cbSize = sizeof(TRACKMOUSEEVENT), .dwFlags = TME_LEAVE, .hwndTrack = m_hwnd };
+				m_bIsTrackingMouse = TrackMouseEvent(&tme);
+			}
+
+			setHovered(hitTest(dipPixelX, dipPixelY));
+			if (auto pHovered = resolve(m_hovered))
+			{
+				pHovered->onMouseMove(dipPixelX, dipPixelY);
+			}
+
 			if (m_onMouseMove)
 			{
 				m_onMouseMove(dipPixelX, dipPixelY, flags);
 			}
 		}
 
+		uint32_t hitTest(float dipPixelX, float dipPixelY) const
+		{
+			uint32_t top = NO_HIT;
+			m_hitIndex.QueryPoint(Data::Point{ .x = dipPixelX, .y = dipPixelY }, [&](Data::Handle h)
+				{
+					const auto key = m_hitIndex.Get(h);
+					if (top == NO_HIT || key > top)
+					{
+						top = key;
+					}
+				});
+			return top;
+		}
+
+		UI::Widget* resolve(uint32_t key)
+		{
+			if (key == NO_HIT)
+				return nullptr;
+			if (key & WIDGET_BIT)
+				return m_widgets[key & ~WIDGET_BIT];
+			return &m_texts[key];
+		}
+
+		// Sends the exit and enter transitions when the hovered widget changes
+		void setHovered(uint32_t key)
+		{
+			if (key == m_hovered)
+				return;
+
+			const auto cursor = UI::WidgetArgs{ .CursorPos = Position{ .x = m_mousePoint.x, .y = m_mousePoint.y } };
+			if (auto pPrevious = resolve(m_hovered))
+			{
+				pPrevious->onExit();
+				pPrevious->onEvent(UI::WidgetEvent::LEAVE, cursor);
+			}
+			m_hovered = key;
+			if (auto pCurrent = resolve(m_hovered))
+			{
+				pCurrent->onEnter();
+				pCurrent->onEvent(UI::WidgetEvent::ENTER, cursor);
+			}
+		}
+
 		void onLButtonUp(float dipPixelX, float dipPixelY, [[maybe_unused]] DWORD flags)
 		{
 			m_mousePoint = { dipPixelX, dipPixelY };